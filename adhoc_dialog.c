@@ -25,6 +25,7 @@
 #include "message_dialog.h"
 #include "uncommon_dialog.h"
 #include "io_process.h"
+#include "io_profile.h"
 
 #define SHARE_MAGIC 0x574F4C46
 #define SHARE_TYPE_FOLDER 0
@@ -102,10 +103,12 @@ int sendFile(const char *src_path, FileProcessParam *param) {
     return ret;
   }
   
-  void *buf = memalign(4096, SHARE_SIZE);
+  // Read in large blocks, but send them in pieces the receiver expects
+  int buf_size = ALIGN(ioProfileGetReadSize(src_path), SHARE_SIZE);
+  void *buf = memalign(4096, buf_size);
   
   while (1) {
-    int read = sceIoRead(fdsrc, buf, SHARE_SIZE);
+    int read = sceIoRead(fdsrc, buf, buf_size);
 
     if (read < 0) {
       free(buf);
@@ -116,11 +119,14 @@ int sendFile(const char *src_path, FileProcessParam *param) {
     if (read == 0)
       break;
 
-    int sended = adhocSend(client_socket, buf, read);
-    if (sended < 0) {
-      free(buf);
-      sceIoClose(fdsrc);
-      return sended;
+    int offset;
+    for (offset = 0; offset < read; offset += SHARE_SIZE) {
+      int sended = adhocSend(client_socket, (char *)buf + offset, MIN(read - offset, SHARE_SIZE));
+      if (sended < 0) {
+        free(buf);
+        sceIoClose(fdsrc);
+        return sended;
+      }
     }
 
     if (param) {
@@ -230,15 +236,16 @@ int send_thread(SceSize args_size, SendArguments *args) {
 
   int count = 0;
   FileListEntry *head = NULL;
-  FileListEntry *mark_entry_one = NULL;
+  FileList mark_list_one;
+  memset(&mark_list_one, 0, sizeof(FileList));
 
   if (fileListFindEntry(args->mark_list, file_entry->name)) { // On marked entry
     count = args->mark_list->length;
     head = args->mark_list->head;
   } else {
     count = 1;
-    mark_entry_one = fileListCopyEntry(file_entry);
-    head = mark_entry_one;
+    fileListAddEntry(&mark_list_one, fileListCopyEntry(&mark_list_one, file_entry), SORT_NONE);
+    head = mark_list_one.head;
   }
 
   char path[MAX_PATH_LENGTH];
@@ -329,8 +336,7 @@ CANCELED:
   errorDialog(res);
 
 EXIT:
-  if (mark_entry_one)
-    free(mark_entry_one);
+  fileListEmpty(&mark_list_one);
 
   if (thid >= 0)
     sceKernelWaitThreadEnd(thid, NULL, NULL);
@@ -19,10 +19,63 @@
 #include "main.h"
 #include "archive.h"
 #include "psarc.h"
+#include "zip_reader.h"
+#include "transfer.h"
+#include "io_profile.h"
 #include "file.h"
 #include "utils.h"
 #include "elf.h"
 
+#define CHECKPOINT_WINDOW_SIZE (32 * 1024)
+#define CHECKPOINT_SPAN (1 * 1024 * 1024)
+#define MAX_CHECKPOINTS 64
+
+#define SCE_HEADER_CHECK_SIZE 0x88
+
+#define ARCHIVE_ARENA_BLOCK_SIZE (64 * 1024)
+#define ARCHIVE_HASH_THRESHOLD 8
+
+enum ArchiveReadModes {
+  ARCHIVE_READ_DEFAULT, // libarchive does all the work
+  ARCHIVE_READ_RECORD,  // Inflate gzip ourselves and record decoder checkpoints
+  ARCHIVE_READ_ENTRY,   // Start reading at the header of an entry
+};
+
+typedef struct ArchiveFileNode {
+  struct ArchiveFileNode *child;
+  struct ArchiveFileNode *next;
+  char *name;
+  SceIoStat stat;
+  int index;         // Position of the entry in the archive, -1 for implicit folders
+  int64_t header_pos; // Offset of the entry header in the uncompressed stream
+  int method;         // Zip compression method
+  uint32_t crc;
+  int64_t compressed_size;
+
+  // Case-insensitive index of the children, created once a folder gets large
+  struct ArchiveFileNode *last_child;
+  struct ArchiveFileNode *hash_next;
+  struct ArchiveFileNode **buckets;
+  uint32_t n_buckets;
+  uint32_t n_children;
+  uint32_t hash;
+} ArchiveFileNode;
+
+typedef struct ArchiveArenaBlock {
+  struct ArchiveArenaBlock *next;
+  size_t used;
+  size_t size;
+  uint8_t data[];
+} ArchiveArenaBlock;
+
+// Decoder state at a deflate block boundary (see zlib's examples/zran.c)
+typedef struct {
+  int64_t in;  // Offset of the first complete compressed byte
+  int64_t out; // Offset in the uncompressed stream
+  int bits;    // Number of bits of the byte before 'in' that belong to the block
+  uint8_t *window;
+} ArchiveCheckpoint;
+
 static int is_psarc = 0;
 static char archive_file[MAX_PATH_LENGTH];
 static int archive_path_start = 0;
@@ -30,7 +83,23 @@ struct archive *archive_fd = NULL;
 static int need_password = 0;
 static char password[128];
 
+// Entry index
+static int archive_is_tar = 0;
+static int archive_is_gzip = 0;
+static ArchiveCheckpoint checkpoints[MAX_CHECKPOINTS];
+static int n_checkpoints = 0;
+static int64_t checkpoint_span = CHECKPOINT_SPAN;
+
+// Zip archives are listed from the central directory and read without libarchive
+static int archive_is_zip = 0;
+static ZipEntryReader *zip_reader = NULL;
+
+// The reader is kept open after archiveFileClose, so the next entry can continue from there
+static int archive_fd_opened = 0;
+static int archive_fd_index = -1;
+
 int checkForUnsafeImports(void *buffer);
+SceMode convert_stat_mode(mode_t mode);
 char *uncompressBuffer(const Elf32_Ehdr *ehdr, const Elf32_Phdr *phdr, const segment_info *segment,
                        const char *buffer);
 
@@ -43,8 +112,185 @@ struct archive_data {
   SceUID fd;
   void *buffer;
   int block_size;
+
+  int mode;
+  int64_t start;                  // File offset to start reading at
+  ArchiveCheckpoint *checkpoint;  // Checkpoint to resume inflating at
+  int64_t skip;                   // Uncompressed bytes to drop before passing data on
+
+  z_stream strm;
+  uint8_t *window;
+  int64_t in;
+  int64_t out;
+  int stream_end;
+  int member_end;
 };
 
+static void freeCheckpoints() {
+  int i;
+  for (i = 0; i < n_checkpoints; i++) {
+    free(checkpoints[i].window);
+  }
+
+  n_checkpoints = 0;
+  checkpoint_span = CHECKPOINT_SPAN;
+}
+
+static void addCheckpoint(struct archive_data *archive_data) {
+  z_stream *strm = &archive_data->strm;
+
+  // Keep memory bounded by dropping every second checkpoint and doubling the span
+  if (n_checkpoints == MAX_CHECKPOINTS) {
+    int i;
+    for (i = 0; i < MAX_CHECKPOINTS / 2; i++) {
+      free(checkpoints[2 * i + 1].window);
+      checkpoints[i] = checkpoints[2 * i];
+    }
+
+    n_checkpoints = MAX_CHECKPOINTS / 2;
+    checkpoint_span *= 2;
+  }
+
+  if (n_checkpoints > 0 && archive_data->out - checkpoints[n_checkpoints - 1].out < checkpoint_span)
+    return;
+
+  ArchiveCheckpoint *checkpoint = &checkpoints[n_checkpoints];
+  checkpoint->window = malloc(CHECKPOINT_WINDOW_SIZE);
+  if (!checkpoint->window)
+    return;
+
+  checkpoint->in = archive_data->start + archive_data->in - strm->avail_in;
+  checkpoint->out = archive_data->out;
+  checkpoint->bits = strm->data_type & 7;
+
+  // Unroll the circular output window
+  int left = strm->avail_out;
+  if (left)
+    memcpy(checkpoint->window, archive_data->window + CHECKPOINT_WINDOW_SIZE - left, left);
+  if (left < CHECKPOINT_WINDOW_SIZE)
+    memcpy(checkpoint->window + left, archive_data->window, CHECKPOINT_WINDOW_SIZE - left);
+
+  n_checkpoints++;
+}
+
+static ArchiveCheckpoint *findCheckpoint(int64_t offset) {
+  ArchiveCheckpoint *checkpoint = NULL;
+
+  int i;
+  for (i = 0; i < n_checkpoints && checkpoints[i].out <= offset; i++) {
+    checkpoint = &checkpoints[i];
+  }
+
+  return checkpoint;
+}
+
+static int inflate_open(struct archive_data *archive_data) {
+  z_stream *strm = &archive_data->strm;
+  ArchiveCheckpoint *checkpoint = archive_data->checkpoint;
+
+  memset(strm, 0, sizeof(z_stream));
+  archive_data->in = 0;
+  archive_data->out = 0;
+  archive_data->stream_end = 0;
+  archive_data->member_end = 0;
+
+  archive_data->window = malloc(CHECKPOINT_WINDOW_SIZE);
+  if (!archive_data->window)
+    return ARCHIVE_FATAL;
+
+  // Start of the gzip file
+  if (!checkpoint)
+    return inflateInit2(strm, 47) == Z_OK ? ARCHIVE_OK : ARCHIVE_FATAL;
+
+  // Resume raw inflate at the checkpoint
+  if (inflateInit2(strm, -15) != Z_OK)
+    return ARCHIVE_FATAL;
+
+  if (sceIoLseek(archive_data->fd, checkpoint->in - (checkpoint->bits ? 1 : 0), SCE_SEEK_SET) < 0)
+    return ARCHIVE_FATAL;
+
+  if (checkpoint->bits) {
+    uint8_t byte = 0;
+    if (sceIoRead(archive_data->fd, &byte, 1) != 1)
+      return ARCHIVE_FATAL;
+
+    inflatePrime(strm, checkpoint->bits, byte >> (8 - checkpoint->bits));
+  }
+
+  inflateSetDictionary(strm, checkpoint->window, CHECKPOINT_WINDOW_SIZE);
+
+  archive_data->start = checkpoint->in;
+  archive_data->out = checkpoint->out;
+
+  return ARCHIVE_OK;
+}
+
+static ssize_t inflate_read(struct archive_data *archive_data, const void **buff) {
+  z_stream *strm = &archive_data->strm;
+
+  while (1) {
+    if (archive_data->stream_end)
+      return 0;
+
+    if (strm->avail_out == 0) {
+      strm->next_out = archive_data->window;
+      strm->avail_out = CHECKPOINT_WINDOW_SIZE;
+    }
+
+    if (strm->avail_in == 0) {
+      int read = sceIoRead(archive_data->fd, archive_data->buffer, archive_data->block_size);
+      if (read < 0)
+        return ARCHIVE_FATAL;
+
+      if (read == 0)
+        return 0;
+
+      strm->next_in = archive_data->buffer;
+      strm->avail_in = read;
+      archive_data->in += read;
+    }
+
+    uint8_t *start = strm->next_out;
+
+    int ret = inflate(strm, Z_BLOCK);
+    if (ret == Z_DATA_ERROR && archive_data->member_end) // Trailing garbage after the last member
+      return 0;
+    if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+      return ARCHIVE_FATAL;
+
+    int length = strm->next_out - start;
+    archive_data->out += length;
+    if (length > 0)
+      archive_data->member_end = 0;
+
+    if (ret == Z_STREAM_END) {
+      if (archive_data->checkpoint) {
+        // Raw deflate stream of the first member has ended
+        archive_data->stream_end = 1;
+      } else {
+        // Concatenated gzip members, checkpoints are only taken in the first one
+        archive_data->mode = ARCHIVE_READ_DEFAULT;
+        archive_data->member_end = 1;
+        inflateReset(strm);
+      }
+    } else if (archive_data->mode == ARCHIVE_READ_RECORD &&
+               (strm->data_type & 128) && !(strm->data_type & 64)) {
+      addCheckpoint(archive_data);
+    }
+
+    if (length == 0 || archive_data->skip >= length) {
+      archive_data->skip -= length;
+      continue;
+    }
+
+    *buff = start + archive_data->skip;
+    length -= archive_data->skip;
+    archive_data->skip = 0;
+
+    return length;
+  }
+}
+
 static const char *file_passphrase(struct archive *a, void *client_data) {
   return password;
 }
@@ -56,14 +302,24 @@ static int file_open(struct archive *a, void *client_data) {
   if (archive_data->fd < 0)
     return ARCHIVE_FATAL;
   
-  archive_data->buffer = memalign(4096, TRANSFER_SIZE);
-  archive_data->block_size = TRANSFER_SIZE;
+  archive_data->block_size = ioProfileGetReadSize(archive_data->filename);
+  archive_data->buffer = memalign(4096, archive_data->block_size);
+
+  if (archive_data->mode == ARCHIVE_READ_RECORD || archive_data->checkpoint)
+    return inflate_open(archive_data);
+
+  if (archive_data->start > 0 && sceIoLseek(archive_data->fd, archive_data->start, SCE_SEEK_SET) < 0)
+    return ARCHIVE_FATAL;
   
   return ARCHIVE_OK;
 }
 
 static ssize_t file_read(struct archive *a, void *client_data, const void **buff) {
   struct archive_data *archive_data = client_data;
+
+  if (archive_data->window)
+    return inflate_read(archive_data, buff);
+
   *buff = archive_data->buffer;
   return sceIoRead(archive_data->fd, archive_data->buffer, archive_data->block_size);
 }
@@ -72,6 +328,10 @@ static int64_t file_skip(struct archive *a, void *client_data, int64_t request)
   struct archive_data *archive_data = client_data;
   int64_t old_offset, new_offset;
 
+  // Inflated data cannot be skipped
+  if (archive_data->window)
+    return 0;
+
   if ((old_offset = sceIoLseek(archive_data->fd, 0, SCE_SEEK_CUR)) >= 0 &&
       (new_offset = sceIoLseek(archive_data->fd, request, SCE_SEEK_CUR)) >= 0)
     return new_offset - old_offset;
@@ -83,6 +343,10 @@ static int64_t file_seek(struct archive *a, void *client_data, int64_t request,
   struct archive_data *archive_data = client_data;
   int64_t r;
 
+  // Only plain reads from the start of the file can seek
+  if (archive_data->window || archive_data->start > 0)
+    return ARCHIVE_FATAL;
+
   r = sceIoLseek(archive_data->fd, request, whence);
   if (r >= 0)
     return r;
@@ -98,6 +362,12 @@ static int file_close2(struct archive *a, void *client_data) {
     archive_data->fd = -1;
   }
 
+  if (archive_data->window) {
+    inflateEnd(&archive_data->strm);
+    free(archive_data->window);
+    archive_data->window = NULL;
+  }
+
   free(archive_data->buffer);
   archive_data->buffer = NULL;
 
@@ -117,9 +387,30 @@ static int file_switch(struct archive *a, void *client_data1, void *client_data2
   return file_open(a, client_data2);
 }
 
+static struct archive_data *append_archive_data(struct archive *a, const char *filename) {
+  struct archive_data *archive_data = malloc(sizeof(struct archive_data));
+  if (!archive_data)
+    return NULL;
+
+  memset(archive_data, 0, sizeof(struct archive_data));
+  archive_data->fd = -1;
+  archive_data->filename = malloc(strlen(filename) + 1);
+  strcpy(archive_data->filename, filename);
+
+  if (archive_read_append_callback_data(a, archive_data) != ARCHIVE_OK) {
+    free(archive_data->filename);
+    free(archive_data);
+    return NULL;
+  }
+
+  return archive_data;
+}
+
 int append_archive(struct archive *a, const char *filename) {
   struct archive_data *archive_data = malloc(sizeof(struct archive_data));
   if (archive_data) {
+    memset(archive_data, 0, sizeof(struct archive_data));
+    archive_data->fd = -1;
     archive_data->filename = malloc(strlen(filename) + 1);
     strcpy(archive_data->filename, filename);
     if (archive_read_append_callback_data(a, archive_data) != ARCHIVE_OK) {
@@ -246,14 +537,188 @@ struct archive *open_archive(const char *filename) {
   return a;
 }
 
-typedef struct ArchiveFileNode {
-  struct ArchiveFileNode *child;
-  struct ArchiveFileNode *next;
-  char *name;
-  SceIoStat stat;
-} ArchiveFileNode;
+static void set_archive_callbacks(struct archive *a) {
+  archive_read_set_passphrase_callback(a, NULL, file_passphrase);
+  archive_read_set_open_callback(a, file_open);
+  archive_read_set_read_callback(a, file_read);
+  archive_read_set_skip_callback(a, file_skip);
+  archive_read_set_close_callback(a, file_close);
+  archive_read_set_switch_callback(a, file_switch);
+  archive_read_set_seek_callback(a, file_seek);
+}
+
+// Open a gzip compressed archive and record decoder checkpoints while it is being read
+static struct archive *open_archive_record(const char *filename) {
+  struct archive *a = archive_read_new();
+  if (!a)
+    return NULL;
+
+  archive_read_support_filter_all(a);
+  archive_read_support_format_all(a);
+  set_archive_callbacks(a);
+
+  struct archive_data *archive_data = append_archive_data(a, filename);
+  if (!archive_data) {
+    archive_read_free(a);
+    return NULL;
+  }
+
+  archive_data->mode = ARCHIVE_READ_RECORD;
+
+  if (archive_read_open1(a)) {
+    archive_read_free(a);
+    return NULL;
+  }
+
+  return a;
+}
+
+// Open a tar archive directly at the header of an entry
+static struct archive *open_archive_entry(const char *filename, ArchiveFileNode *node) {
+  ArchiveCheckpoint *checkpoint = NULL;
+
+  if (!archive_is_tar || node->index < 0)
+    return NULL;
+
+  if (archive_is_gzip) {
+    checkpoint = findCheckpoint(node->header_pos);
+    if (!checkpoint)
+      return NULL;
+  }
+
+  struct archive *a = archive_read_new();
+  if (!a)
+    return NULL;
+
+  // The data handed to libarchive is always an uncompressed tar stream
+  archive_read_support_format_tar(a);
+  set_archive_callbacks(a);
+
+  struct archive_data *archive_data = append_archive_data(a, filename);
+  if (!archive_data) {
+    archive_read_free(a);
+    return NULL;
+  }
+
+  archive_data->mode = ARCHIVE_READ_ENTRY;
+
+  if (checkpoint) {
+    archive_data->checkpoint = checkpoint;
+    archive_data->skip = node->header_pos - checkpoint->out;
+  } else {
+    archive_data->start = node->header_pos;
+  }
+
+  if (archive_read_open1(a)) {
+    archive_read_free(a);
+    return NULL;
+  }
+
+  return a;
+}
 
 static ArchiveFileNode *archive_root = NULL;
+static ArchiveArenaBlock *archive_arena = NULL;
+
+static void *arenaAlloc(size_t size) {
+  size = ALIGN(size, 8);
+
+  if (!archive_arena || archive_arena->used + size > archive_arena->size) {
+    size_t block_size = MAX(size, ARCHIVE_ARENA_BLOCK_SIZE);
+
+    ArchiveArenaBlock *block = malloc(sizeof(ArchiveArenaBlock) + block_size);
+    if (!block)
+      return NULL;
+
+    block->next = archive_arena;
+    block->used = 0;
+    block->size = block_size;
+    archive_arena = block;
+  }
+
+  void *p = archive_arena->data + archive_arena->used;
+  archive_arena->used += size;
+  return p;
+}
+
+static uint32_t hashArchiveName(const char *name) {
+  uint32_t hash = 2166136261u;
+
+  while (*name) {
+    hash ^= (uint8_t)tolower((uint8_t)*name++);
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+static int rehashArchiveChildren(ArchiveFileNode *parent, uint32_t n_buckets) {
+  // Old bucket arrays stay in the arena until the tree is freed
+  ArchiveFileNode **buckets = arenaAlloc(n_buckets * sizeof(ArchiveFileNode *));
+  if (!buckets)
+    return -1;
+
+  memset(buckets, 0, n_buckets * sizeof(ArchiveFileNode *));
+
+  ArchiveFileNode *curr = parent->child;
+  while (curr) {
+    uint32_t i = curr->hash & (n_buckets - 1);
+    curr->hash_next = buckets[i];
+    buckets[i] = curr;
+    curr = curr->next;
+  }
+
+  parent->buckets = buckets;
+  parent->n_buckets = n_buckets;
+
+  return 0;
+}
+
+static void addArchiveChild(ArchiveFileNode *parent, ArchiveFileNode *node) {
+  // Append to keep the archive order for listings
+  if (!parent->child) {
+    parent->child = node;
+  } else {
+    parent->last_child->next = node;
+  }
+
+  parent->last_child = node;
+  parent->n_children++;
+
+  // Small folders are searched linearly
+  if (parent->n_children <= ARCHIVE_HASH_THRESHOLD)
+    return;
+
+  if (parent->n_children > parent->n_buckets * 2 &&
+      rehashArchiveChildren(parent, parent->n_buckets ? parent->n_buckets * 4 : ARCHIVE_HASH_THRESHOLD * 2) == 0)
+    return;
+
+  if (parent->buckets) {
+    uint32_t i = node->hash & (parent->n_buckets - 1);
+    node->hash_next = parent->buckets[i];
+    parent->buckets[i] = node;
+  }
+}
+
+static ArchiveFileNode *findArchiveChild(ArchiveFileNode *parent, const char *name, int is_folder) {
+  uint32_t hash = hashArchiveName(name);
+
+  ArchiveFileNode *curr;
+  if (parent->buckets)
+    curr = parent->buckets[hash & (parent->n_buckets - 1)];
+  else
+    curr = parent->child;
+
+  while (curr) {
+    if (curr->hash == hash && strcasecmp(curr->name, name) == 0 &&
+        (!is_folder || SCE_S_ISDIR(curr->stat.st_mode)))
+      return curr;
+
+    curr = parent->buckets ? curr->hash_next : curr->next;
+  }
+
+  return NULL;
+}
 
 char *serializePathName(char *name, char **p) {
   if (!p)
@@ -272,22 +737,19 @@ char *serializePathName(char *name, char **p) {
 }
 
 ArchiveFileNode *createArchiveNode(const char *name, SceIoStat *stat) {
-  ArchiveFileNode *node = malloc(sizeof(ArchiveFileNode));
+  ArchiveFileNode *node = arenaAlloc(sizeof(ArchiveFileNode));
   if (!node)
     return NULL;
   
   memset(node, 0, sizeof(ArchiveFileNode));
 
-  node->name = malloc(strlen(name) + 1);
-  if (!node->name) {
-    free(node);
+  node->name = arenaAlloc(strlen(name) + 1);
+  if (!node->name)
     return NULL;
-  }
   
   strcpy(node->name, name);
-  
-  node->child = NULL;
-  node->next = NULL;
+  node->hash = hashArchiveName(name);
+  node->index = -1;
   
   memcpy(&node->stat, stat, sizeof(SceIoStat));
   
@@ -295,9 +757,8 @@ ArchiveFileNode *createArchiveNode(const char *name, SceIoStat *stat) {
 }
 
 ArchiveFileNode *_findArchiveNode(ArchiveFileNode *parent, char *name, ArchiveFileNode **parent_out,
-                                  ArchiveFileNode **prev_out, char **name_out, char **p_out) {
+                                  char **name_out, char **p_out) {
   char *p = NULL;
-  ArchiveFileNode *prev = NULL;
 
   // Remove trailing slash
   removeEndSlash(name);
@@ -310,36 +771,26 @@ ArchiveFileNode *_findArchiveNode(ArchiveFileNode *parent, char *name, ArchiveFi
     return parent;
   
   // Traverse
-  ArchiveFileNode *curr = parent->child;
-  while (curr) {
-    // Found name
-    if (strcasecmp(curr->name, name) == 0) {
-      // Found node
-      if (!p)
-        return curr;
-      
-      // Is folder
-      if (SCE_S_ISDIR(curr->stat.st_mode)) {
-        // Serialize path name
-        name = serializePathName(name, &p);
-        
-        // Get child entry of this directory
-        parent = curr;
-        curr = curr->child;
-        continue;
-      }
-    }
+  while (1) {
+    // Path components in the middle must be folders
+    ArchiveFileNode *curr = findArchiveChild(parent, name, p != NULL);
+    if (!curr)
+      break;
+
+    // Found node
+    if (!p)
+      return curr;
+
+    // Serialize path name
+    name = serializePathName(name, &p);
     
-    // Get next entry in this directory
-    prev = curr;
-    curr = curr->next;
+    // Get child entry of this directory
+    parent = curr;
   }
   
   // Out
   if (parent_out)
     *parent_out = parent;
-  if (prev_out)
-    *prev_out = prev;
   if (name_out)
     *name_out = name;
   if (p_out)
@@ -351,22 +802,21 @@ ArchiveFileNode *_findArchiveNode(ArchiveFileNode *parent, char *name, ArchiveFi
 ArchiveFileNode *findArchiveNode(const char *path) {
   char name[MAX_PATH_LENGTH];
   strcpy(name, path);
-  return _findArchiveNode(archive_root, name, NULL, NULL, NULL, NULL);
+  return _findArchiveNode(archive_root, name, NULL, NULL, NULL);
 }
 
-int addArchiveNodeRecursive(ArchiveFileNode *parent, char *name, SceIoStat *stat) {  
+ArchiveFileNode *addArchiveNodeRecursive(ArchiveFileNode *parent, char *name, SceIoStat *stat) {  
   char *p = NULL;
-  ArchiveFileNode *prev = NULL;
   
   if (!parent)
-    return -1;
+    return NULL;
   
-  ArchiveFileNode *res = _findArchiveNode(parent, name, &parent, &prev, &name, &p);
+  ArchiveFileNode *res = _findArchiveNode(parent, name, &parent, &name, &p);
   
   // Already exist
   if (res) {
     memcpy(&res->stat, stat, sizeof(SceIoStat));
-    return 0;
+    return res;
   }
   
   // Create new node
@@ -376,132 +826,48 @@ int addArchiveNodeRecursive(ArchiveFileNode *parent, char *name, SceIoStat *stat
   node_stat.st_size = 0;
   
   ArchiveFileNode *node = createArchiveNode(name, p ? &node_stat : stat);  
-  if (!parent->child) { // First child
-    parent->child = node;
-  } else {              // Neighbour
-    prev->next = node;
-  }
+  if (!node)
+    return NULL;
+
+  addArchiveChild(parent, node);
   
   // Recursion
   if (p)
-    addArchiveNodeRecursive(node, p + 1, stat);
+    return addArchiveNodeRecursive(node, p + 1, stat);
   
-  return 0;
+  return node;
 }
 
-void addArchiveNode(const char *path, SceIoStat *stat) {  
+ArchiveFileNode *addArchiveNode(const char *path, SceIoStat *stat) {  
   char name[MAX_PATH_LENGTH];
   strcpy(name, path);
-  addArchiveNodeRecursive(archive_root, name, stat);
+  return addArchiveNodeRecursive(archive_root, name, stat);
 }
 
-void freeArchiveNodes(ArchiveFileNode *curr) {
-  // Traverse
-  while (curr) {
-    // Enter directory
-    if (SCE_S_ISDIR(curr->stat.st_mode)) {
-      // Traverse child entry of this directory
-      freeArchiveNodes(curr->child);
-    }
-    
-    // Get next entry in this directory
-    ArchiveFileNode *next = curr->next;
-    free(curr->name);
-    free(curr);
-    curr = next;
+void freeArchiveNodes() {
+  // All nodes, names and hash tables live in the arena
+  while (archive_arena) {
+    ArchiveArenaBlock *next = archive_arena->next;
+    free(archive_arena);
+    archive_arena = next;
   }
+
+  archive_root = NULL;
 }
 
-int archiveCheckFilesForUnsafeFself() {  
-  // Open archive file
-  struct archive *archive = open_archive(archive_file);
-  if (!archive)
-    return 0;
-  
-  // Traverse
-  while (1) {
-    struct archive_entry *archive_entry;
-    int res = archive_read_next_header(archive, &archive_entry);
-    if (res == ARCHIVE_EOF)
-      break;
-    
-    if (res != ARCHIVE_OK) {
-      archive_read_free(archive);
-      return 0;
-    }
-    
-    // Get entry information
-    const char *name = archive_entry_pathname(archive_entry);
-    const struct stat *stat = archive_entry_stat(archive_entry);
-        
-    // Read magic
-    uint32_t magic = 0;
-    archive_read_data(archive, &magic, sizeof(uint32_t));
-    
-    // SCE magic
-    if (magic == 0x00454353) {
-      char sce_header[0x84];
-      archive_read_data(archive, sce_header, sizeof(sce_header));
-
-      uint64_t elf1_offset = *(uint64_t *)(sce_header + 0x3C);
-      uint64_t phdr_offset = *(uint64_t *)(sce_header + 0x44);
-      uint64_t section_info_offset = *(uint64_t *)(sce_header + 0x54);
-
-      // jump to elf1
-      // Until here we have read 0x88 bytes
-      int i;
-      for (i = 0; i < elf1_offset - 0x88; i += sizeof(uint32_t)) {
-        uint32_t dummy = 0;
-        archive_read_data(archive, &dummy, sizeof(uint32_t));
-      }
-
-      // Check imports
-      char *buffer = malloc(stat->st_size);
-      if (buffer) {
-        archive_read_data(archive, buffer, stat->st_size);
-
-        Elf32_Ehdr *elf1 = (Elf32_Ehdr*)buffer;
-        Elf32_Phdr *phdr = (Elf32_Phdr*)(buffer + phdr_offset - elf1_offset);
-        segment_info *info = (segment_info*)(buffer + section_info_offset - elf1_offset);
-        
-        // segment is elf2 section
-        char *segment = buffer + info->offset - elf1_offset;
-
-        // zlib compress magic
-        char *uncompressed_buffer = NULL;
-        if (segment[0] == 0x78) {
-          // uncompressedBuffer will return elf2 section
-          uncompressed_buffer = uncompressBuffer(elf1, phdr, info, segment);
-          if (uncompressed_buffer) {
-            segment = uncompressed_buffer;
-          }
-        }
-        
-        int unsafe = checkForUnsafeImports(segment);
-
-        if (uncompressed_buffer)
-          free(uncompressed_buffer);
-        free(buffer);
-
-        if (unsafe) {
-          archive_read_free(archive);
-          return unsafe;
-        }
-      }
+static int createArchiveRoot() {
+  SceIoStat root_stat;
+  memset(&root_stat, 0, sizeof(SceIoStat));
+  root_stat.st_mode = SCE_S_IFDIR;
 
-      // Check authid flag
-      uint64_t authid = *(uint64_t *)(sce_header + 0x7C);
-      if (authid != 0x2F00000000000002) {
-        archive_read_free(archive);
-        return 1; // Unsafe
-      }
-    }
-  }
+  archive_root = createArchiveNode("/", &root_stat);
+  if (!archive_root)
+    return -1;
 
-  archive_read_free(archive);
   return 0;
 }
 
+
 int fileListGetArchiveEntries(FileList *list, const char *path, int sort) {
   if (is_psarc)
     return fileListGetPsarcEntries(list, path, sort);
@@ -511,35 +877,24 @@ int fileListGetArchiveEntries(FileList *list, const char *path, int sort) {
   if (!list)
     return -1;
 
-  FileListEntry *entry = malloc(sizeof(FileListEntry));
-  if (entry) {
-    entry->name_length = strlen(DIR_UP);
-    entry->name = malloc(entry->name_length + 1);
-    strcpy(entry->name, DIR_UP);
-    entry->is_folder = 1;
-    entry->type = FILE_TYPE_UNKNOWN;
-    fileListAddEntry(list, entry, sort);
-  }
+  fileListAddEntry(list, fileListCreateUpEntry(&list->arena), SORT_NONE);
   
   // Traverse
   ArchiveFileNode *curr = findArchiveNode(path + archive_path_start);
   if (curr)
     curr = curr->child;
   while (curr) {
-    FileListEntry *entry = malloc(sizeof(FileListEntry));
+    int is_folder = SCE_S_ISDIR(curr->stat.st_mode);
+
+    FileListEntry *entry = fileListAllocEntry(&list->arena, strlen(curr->name) + (is_folder ? 1 : 0));
     if (entry) {
-      entry->is_folder = SCE_S_ISDIR(curr->stat.st_mode);
+      entry->is_folder = is_folder;
+      strcpy(entry->name, curr->name);
       if (entry->is_folder) {
-        entry->name_length = strlen(curr->name) + 1;
-        entry->name = malloc(entry->name_length + 1);
-        strcpy(entry->name, curr->name);
         addEndSlash(entry->name);
         entry->type = FILE_TYPE_UNKNOWN;
         list->folders++;
       } else {
-        entry->name_length = strlen(curr->name);
-        entry->name = malloc(entry->name_length + 1);
-        strcpy(entry->name, curr->name);
         entry->type = getFileType(entry->name);
         list->files++;
       }
@@ -550,13 +905,15 @@ int fileListGetArchiveEntries(FileList *list, const char *path, int sort) {
       memcpy(&entry->mtime, (SceDateTime *)&curr->stat.st_mtime, sizeof(SceDateTime));
       memcpy(&entry->atime, (SceDateTime *)&curr->stat.st_atime, sizeof(SceDateTime));
       
-      fileListAddEntry(list, entry, sort);
+      fileListAddEntry(list, entry, SORT_NONE);
     }
     
     // Get next entry in this directory
     curr = curr->next;
   }
 
+  fileListSort(list, sort);
+
   return 0;
 }
 
@@ -624,77 +981,357 @@ int getArchivePathInfo(const char *path, uint64_t *size, uint32_t *folders, uint
   return 1;
 }
 
+static int readArchiveFd(void *argp, void *data, SceSize size) {
+  return archiveFileRead(*(SceUID *)argp, data, size);
+}
+
 int extractArchiveFile(const char *src_path, const char *dst_path, FileProcessParam *param) {
+  SceIoStat stat;
+  memset(&stat, 0, sizeof(SceIoStat));
+  archiveFileGetstat(src_path, &stat);
+
   SceUID fdsrc = archiveFileOpen(src_path, SCE_O_RDONLY, 0);
   if (fdsrc < 0)
     return fdsrc;
 
   SceUID fddst = sceIoOpen(dst_path, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
   if (fddst < 0) {
-    psarcFileClose(fdsrc);
+    archiveFileClose(fdsrc);
     return fddst;
   }
 
-  void *buf = memalign(4096, TRANSFER_SIZE);
+  // Decompression and write are overlapped
+  int res = transferFile(readArchiveFd, &fdsrc, fddst, stat.st_size,
+                         ioProfileGetTransferSize(src_path, dst_path), param);
 
-  while (1) {
-    int read = archiveFileRead(fdsrc, buf, TRANSFER_SIZE);
+  sceIoClose(fddst);
+  archiveFileClose(fdsrc);
 
-    if (read < 0) {
-      free(buf);
+  if (res <= 0) {
+    sceIoRemove(dst_path);
+    return res;
+  }
 
-      sceIoClose(fddst);
-      archiveFileClose(fdsrc);
+  return 1;
+}
 
-      sceIoRemove(dst_path);
+typedef struct {
+  char src[MAX_PATH_LENGTH]; // Path inside the archive without trailing slash
+  int src_length;
+  char dst[MAX_PATH_LENGTH]; // Destination path without trailing slash
+} ArchiveExtractTarget;
 
-      return read;
-    }
+static void initArchiveExtractTarget(ArchiveExtractTarget *target, const char *src_path, const char *dst_path) {
+  strcpy(target->src, src_path + archive_path_start);
+  removeEndSlash(target->src);
+  target->src_length = strlen(target->src);
 
-    if (read == 0)
-      break;
+  strcpy(target->dst, dst_path);
+  removeEndSlash(target->dst);
+}
 
-    int written = sceIoWrite(fddst, buf, read);
+static int createArchiveDirectories(ArchiveFileNode *node, const char *dst_path, FileProcessParam *param) {
+  int ret = sceIoMkdir(dst_path, 0777);
+  if (ret < 0 && ret != SCE_ERROR_ERRNO_EEXIST)
+    return ret;
 
-    if (written < 0) {
-      free(buf);
+  if (param) {
+    if (param->value)
+      (*param->value) += DIRECTORY_SIZE;
 
-      sceIoClose(fddst);
-      archiveFileClose(fdsrc);
+    if (param->SetProgress)
+      param->SetProgress(param->value ? *param->value : 0, param->max);
 
-      sceIoRemove(dst_path);
+    if (param->cancelHandler && param->cancelHandler())
+      return 0;
+  }
 
-      return written;
+  // Traverse
+  ArchiveFileNode *curr = node->child;
+  while (curr) {
+    if (SCE_S_ISDIR(curr->stat.st_mode)) {
+      char *new_dst_path = malloc(strlen(dst_path) + strlen(curr->name) + 2);
+      if (!new_dst_path)
+        return -1;
+
+      sprintf(new_dst_path, "%s/%s", dst_path, curr->name);
+
+      int ret = createArchiveDirectories(curr, new_dst_path, param);
+
+      free(new_dst_path);
+
+      if (ret <= 0)
+        return ret;
     }
 
-    if (param) {
-      if (param->value)
-        (*param->value) += read;
+    // Get next entry in this directory
+    curr = curr->next;
+  }
 
-      if (param->SetProgress)
-        param->SetProgress(param->value ? *param->value : 0, param->max);
+  return 1;
+}
 
-      if (param->cancelHandler && param->cancelHandler()) {
-        free(buf);
+static int getArchiveTargetPath(ArchiveExtractTarget *target, const char *name, char *dst_path) {
+  // Whole archive
+  if (target->src_length == 0) {
+    snprintf(dst_path, MAX_PATH_LENGTH - 1, "%s/%s", target->dst, name);
+    return 1;
+  }
 
-        sceIoClose(fddst);
-        archiveFileClose(fdsrc);
+  if (strncasecmp(name, target->src, target->src_length) != 0)
+    return 0;
 
-        sceIoRemove(dst_path);
+  // The target itself
+  if (name[target->src_length] == '\0') {
+    strcpy(dst_path, target->dst);
+    return 1;
+  }
 
-        return 0;
+  // Entry inside the target folder
+  if (name[target->src_length] == '/') {
+    snprintf(dst_path, MAX_PATH_LENGTH - 1, "%s%s", target->dst, name + target->src_length);
+    return 1;
+  }
+
+  return 0;
+}
+
+// Inspects the SCE header and the imports of an entry while it is being extracted
+typedef struct {
+  uint64_t size;
+  uint64_t offset;
+  uint8_t header[SCE_HEADER_CHECK_SIZE];
+  uint64_t elf1_offset;
+  char *buffer;
+  int unsafe; // 0: Safe, 1: Unsafe, 2: Dangerous
+} FselfCheck;
+
+static void fselfCheckInit(FselfCheck *check, uint64_t size) {
+  memset(check, 0, sizeof(FselfCheck));
+  check->size = size;
+}
+
+static void fselfCheckUpdate(FselfCheck *check, const uint8_t *data, int size) {
+  uint64_t offset = check->offset;
+  check->offset += size;
+
+  // Collect the SCE header
+  if (offset < SCE_HEADER_CHECK_SIZE) {
+    int length = MIN(size, SCE_HEADER_CHECK_SIZE - offset);
+    memcpy(check->header + offset, data, length);
+    offset += length;
+    data += length;
+    size -= length;
+
+    if (offset < SCE_HEADER_CHECK_SIZE)
+      return;
+
+    // SCE magic
+    if (*(uint32_t *)check->header != 0x00454353)
+      return;
+
+    check->elf1_offset = *(uint64_t *)(check->header + 0x40);
+    if (check->elf1_offset < SCE_HEADER_CHECK_SIZE || check->elf1_offset >= check->size)
+      return;
+
+    // Everything from elf1 up to the end is needed to check the imports
+    check->buffer = malloc(check->size - check->elf1_offset);
+  }
+
+  if (!check->buffer)
+    return;
+
+  // Bytes before elf1 are skipped
+  uint64_t end = offset + size;
+  if (end <= check->elf1_offset || offset >= check->size)
+    return;
+
+  if (offset < check->elf1_offset) {
+    data += check->elf1_offset - offset;
+    offset = check->elf1_offset;
+  }
+
+  memcpy(check->buffer + offset - check->elf1_offset, data, MIN(end, check->size) - offset);
+}
+
+static int fselfCheckFinish(FselfCheck *check) {
+  if (check->offset < SCE_HEADER_CHECK_SIZE || *(uint32_t *)check->header != 0x00454353)
+    return 0;
+
+  uint8_t *sce_header = check->header + 4;
+  uint64_t phdr_offset = *(uint64_t *)(sce_header + 0x44);
+  uint64_t section_info_offset = *(uint64_t *)(sce_header + 0x54);
+  uint64_t buffer_size = check->size - check->elf1_offset;
+
+  // Check imports
+  if (check->buffer && check->offset >= check->size &&
+      phdr_offset >= check->elf1_offset && phdr_offset - check->elf1_offset < buffer_size &&
+      section_info_offset >= check->elf1_offset && section_info_offset - check->elf1_offset < buffer_size) {
+    char *buffer = check->buffer;
+
+    Elf32_Ehdr *elf1 = (Elf32_Ehdr*)buffer;
+    Elf32_Phdr *phdr = (Elf32_Phdr*)(buffer + phdr_offset - check->elf1_offset);
+    segment_info *info = (segment_info*)(buffer + section_info_offset - check->elf1_offset);
+
+    if (info->offset >= check->elf1_offset && info->offset - check->elf1_offset < buffer_size) {
+      // segment is elf2 section
+      char *segment = buffer + info->offset - check->elf1_offset;
+
+      // zlib compress magic
+      char *uncompressed_buffer = NULL;
+      if (segment[0] == 0x78) {
+        // uncompressedBuffer will return elf2 section
+        uncompressed_buffer = uncompressBuffer(elf1, phdr, info, segment);
+        if (uncompressed_buffer) {
+          segment = uncompressed_buffer;
+        }
       }
+
+      check->unsafe = checkForUnsafeImports(segment);
+
+      if (uncompressed_buffer)
+        free(uncompressed_buffer);
     }
   }
 
-  free(buf);
+  free(check->buffer);
+  check->buffer = NULL;
+
+  if (check->unsafe)
+    return check->unsafe;
+
+  // Check authid flag
+  uint64_t authid = *(uint64_t *)(sce_header + 0x7C);
+  if (authid != 0x2F00000000000002)
+    return 1; // Unsafe
+
+  return 0;
+}
+
+typedef struct {
+  struct archive *archive;
+  FselfCheck *check;
+} ArchiveEntryReadArgs;
+
+static int readArchiveEntry(void *argp, void *data, SceSize size) {
+  ArchiveEntryReadArgs *args = (ArchiveEntryReadArgs *)argp;
+
+  int read = archive_read_data(args->archive, data, size);
+  if (read > 0 && args->check)
+    fselfCheckUpdate(args->check, data, read);
+
+  return read;
+}
+
+static int writeArchiveEntry(struct archive *archive, const char *dst_path, uint64_t size,
+                             FileProcessParam *param, FselfCheck *check) {
+  SceUID fddst = sceIoOpen(dst_path, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
+  if (fddst < 0)
+    return fddst;
+
+  ArchiveEntryReadArgs args;
+  args.archive = archive;
+  args.check = check;
+
+  int res = transferFile(readArchiveEntry, &args, fddst, size,
+                         ioProfileGetTransferSize(NULL, dst_path), param);
 
   sceIoClose(fddst);
-  archiveFileClose(fdsrc);
+
+  if (res <= 0) {
+    sceIoRemove(dst_path);
+    return res;
+  }
 
   return 1;
 }
 
+// Extract all targets with a single forward pass over the archive
+static int extractArchiveTargets(ArchiveExtractTarget *targets, int n_targets, FileProcessParam *param,
+                                 int *unsafe) {
+  int i, ret;
+
+  // Create the folder structure first, so that entries can be written as they stream by
+  for (i = 0; i < n_targets; i++) {
+    ArchiveFileNode *node = findArchiveNode(targets[i].src);
+    if (!node)
+      return -1;
+
+    if (SCE_S_ISDIR(node->stat.st_mode)) {
+      ret = createArchiveDirectories(node, targets[i].dst, param);
+      if (ret <= 0)
+        return ret;
+    }
+  }
+
+  char *dst_path = malloc(MAX_PATH_LENGTH);
+  if (!dst_path)
+    return -1;
+
+  // Open archive file
+  struct archive *archive = open_archive(archive_file);
+  if (!archive) {
+    free(dst_path);
+    return -1;
+  }
+
+  ret = 1;
+
+  // Traverse
+  while (1) {
+    struct archive_entry *archive_entry;
+    int res = archive_read_next_header(archive, &archive_entry);
+    if (res == ARCHIVE_EOF)
+      break;
+
+    if (res != ARCHIVE_OK) {
+      ret = -1;
+      break;
+    }
+
+    // Folders have already been created
+    if (SCE_S_ISDIR(convert_stat_mode(archive_entry_mode(archive_entry))))
+      continue;
+
+    // Get entry information
+    char name[MAX_PATH_LENGTH];
+    strncpy(name, archive_entry_pathname(archive_entry), MAX_PATH_LENGTH - 1);
+    name[MAX_PATH_LENGTH - 1] = '\0';
+    removeEndSlash(name);
+
+    // Find the selected target that contains this entry
+    for (i = 0; i < n_targets; i++) {
+      if (getArchiveTargetPath(&targets[i], name, dst_path))
+        break;
+    }
+
+    // Not selected, the data is skipped by the next header read
+    if (i == n_targets)
+      continue;
+
+    if (unsafe) {
+      FselfCheck check;
+      fselfCheckInit(&check, archive_entry_size(archive_entry));
+
+      ret = writeArchiveEntry(archive, dst_path, archive_entry_size(archive_entry), param, &check);
+
+      int res = fselfCheckFinish(&check);
+      *unsafe = MAX(*unsafe, res);
+    } else {
+      ret = writeArchiveEntry(archive, dst_path, archive_entry_size(archive_entry), param, NULL);
+    }
+
+    if (ret <= 0)
+      break;
+  }
+
+  free(dst_path);
+
+  archive_read_free(archive);
+
+  return ret;
+}
+
 int extractArchivePath(const char *src_path, const char *dst_path, FileProcessParam *param) {
   if (is_psarc)
     return extractPsarcPath(src_path, dst_path, param);
@@ -705,64 +1342,74 @@ int extractArchivePath(const char *src_path, const char *dst_path, FileProcessPa
   int res = archiveFileGetstat(src_path, &stat);
   if (res < 0)
     return res;
-  
-  if (SCE_S_ISDIR(stat.st_mode)) {
-    FileList list;
-    memset(&list, 0, sizeof(FileList));
-    fileListGetArchiveEntries(&list, src_path, SORT_NONE);
 
-    int ret = sceIoMkdir(dst_path, 0777);
-    if (ret < 0 && ret != SCE_ERROR_ERRNO_EEXIST) {
-      fileListEmpty(&list);
-      return ret;
-    }
+  if (!SCE_S_ISDIR(stat.st_mode))
+    return extractArchiveFile(src_path, dst_path, param);
 
-    if (param) {
-      if (param->value)
-        (*param->value) += DIRECTORY_SIZE;
+  ArchiveExtractTarget *target = malloc(sizeof(ArchiveExtractTarget));
+  if (!target)
+    return -1;
 
-      if (param->SetProgress)
-        param->SetProgress(param->value ? *param->value : 0, param->max);
-      
-      if (param->cancelHandler && param->cancelHandler()) {
-        fileListEmpty(&list);
-        return 0;
-      }
-    }
+  initArchiveExtractTarget(target, src_path, dst_path);
+  res = extractArchiveTargets(target, 1, param, NULL);
 
-    FileListEntry *entry = list.head->next; // Ignore ..
+  free(target);
+  return res;
+}
 
-    int i;
-    for (i = 0; i < list.length - 1; i++, entry = entry->next) {
-      char *new_src_path = malloc(strlen(src_path) + strlen(entry->name) + 2);
-      snprintf(new_src_path, MAX_PATH_LENGTH - 1, "%s%s", src_path, entry->name);
+int extractArchivePathCheckUnsafe(const char *src_path, const char *dst_path, FileProcessParam *param, int *unsafe) {
+  *unsafe = 0;
 
-      char *new_dst_path = malloc(strlen(dst_path) + strlen(entry->name) + 2);
-      snprintf(new_dst_path, MAX_PATH_LENGTH - 1, "%s%s", dst_path, entry->name);
+  if (is_psarc)
+    return extractPsarcPath(src_path, dst_path, param);
 
-      int ret = 0;
-      
-      if (entry->is_folder) {
-        ret = extractArchivePath(new_src_path, new_dst_path, param);
-      } else {
-        ret = extractArchiveFile(new_src_path, new_dst_path, param);
-      }
-        
-      free(new_dst_path);
-      free(new_src_path);
+  ArchiveExtractTarget *target = malloc(sizeof(ArchiveExtractTarget));
+  if (!target)
+    return -1;
 
-      if (ret <= 0) {
-        fileListEmpty(&list);
-        return ret;
-      }
+  initArchiveExtractTarget(target, src_path, dst_path);
+  int res = extractArchiveTargets(target, 1, param, unsafe);
+
+  free(target);
+  return res;
+}
+
+int extractArchiveList(FileList *list, const char *dst_path, FileProcessParam *param) {
+  char src_path[MAX_PATH_LENGTH], new_dst_path[MAX_PATH_LENGTH];
+  int i, res;
+
+  if (!list || list->length == 0)
+    return 1;
+
+  FileListEntry *entry = list->head;
+
+  if (is_psarc) {
+    for (i = 0; i < list->length; i++, entry = entry->next) {
+      snprintf(src_path, MAX_PATH_LENGTH - 1, "%s%s", list->path, entry->name);
+      snprintf(new_dst_path, MAX_PATH_LENGTH - 1, "%s%s", dst_path, entry->name);
+
+      res = extractPsarcPath(src_path, new_dst_path, param);
+      if (res <= 0)
+        return res;
     }
 
-    fileListEmpty(&list);
-  } else {
-    return extractArchiveFile(src_path, dst_path, param);
+    return 1;
   }
 
-  return 1;
+  ArchiveExtractTarget *targets = malloc(list->length * sizeof(ArchiveExtractTarget));
+  if (!targets)
+    return -1;
+
+  for (i = 0; i < list->length; i++, entry = entry->next) {
+    snprintf(src_path, MAX_PATH_LENGTH - 1, "%s%s", list->path, entry->name);
+    snprintf(new_dst_path, MAX_PATH_LENGTH - 1, "%s%s", dst_path, entry->name);
+    initArchiveExtractTarget(&targets[i], src_path, new_dst_path);
+  }
+
+  res = extractArchiveTargets(targets, list->length, param, NULL);
+
+  free(targets);
+  return res;
 }
 
 int archiveFileGetstat(const char *file, SceIoStat *stat) {
@@ -779,40 +1426,103 @@ int archiveFileGetstat(const char *file, SceIoStat *stat) {
   return 0;
 }
 
+static void freeParkedArchive() {
+  if (archive_fd && !archive_fd_opened) {
+    archive_read_free(archive_fd);
+    archive_fd = NULL;
+  }
+
+  archive_fd_index = -1;
+}
+
+// Read headers from archive_fd until the entry with the given name is reached
+static int seekArchiveEntry(const char *file, int index) {
+  archive_fd_index = index - 1;
+
+  while (1) {
+    struct archive_entry *archive_entry;
+    int res = archive_read_next_header(archive_fd, &archive_entry);
+    if (res != ARCHIVE_OK)
+      return 0;
+
+    archive_fd_index++;
+
+    // Compare pathname
+    const char *name = archive_entry_pathname(archive_entry);
+    if (strcasecmp(name, file) == 0)
+      return 1;
+  }
+}
+
 int archiveFileOpen(const char *file, int flags, SceMode mode) {
   if (is_psarc)
     return psarcFileOpen(file, flags, mode);
     
+  // Seek to the entry data and inflate it directly
+  if (archive_is_zip) {
+    if (zip_reader)
+      return -1;
+
+    ArchiveFileNode *node = findArchiveNode(file + archive_path_start);
+    if (!node || SCE_S_ISDIR(node->stat.st_mode))
+      return -1;
+
+    int res = zipEntryOpen(&zip_reader, archive_file, node->method, node->crc, node->header_pos,
+                           node->compressed_size, node->stat.st_size);
+    if (res < 0) {
+      zip_reader = NULL;
+      return res;
+    }
+
+    return ARCHIVE_FD;
+  }
+
   // A file is already open
-  if (archive_fd)
+  if (archive_fd && archive_fd_opened)
     return -1;
 
+  file += archive_path_start;
+
+  ArchiveFileNode *node = findArchiveNode(file);
+
+  // Continue with the parked reader if the entry comes after it
+  if (archive_fd) {
+    if (node && node->index > archive_fd_index && seekArchiveEntry(file, archive_fd_index + 1)) {
+      archive_fd_opened = 1;
+      return ARCHIVE_FD;
+    }
+
+    freeParkedArchive();
+  }
+
+  // Jump directly to the entry header
+  if (node) {
+    archive_fd = open_archive_entry(archive_file, node);
+    if (archive_fd) {
+      if (seekArchiveEntry(file, node->index) && archive_fd_index == node->index) {
+        archive_fd_opened = 1;
+        return ARCHIVE_FD;
+      }
+
+      archive_read_free(archive_fd);
+      archive_fd = NULL;
+    }
+  }
+
   // Open archive file
   archive_fd = open_archive(archive_file);
   if (!archive_fd)
     return -1;
 
   // Traverse
-  while (1) {
-    struct archive_entry *archive_entry;
-    int res = archive_read_next_header(archive_fd, &archive_entry);
-    if (res == ARCHIVE_EOF)
-      break;
-    
-    if (res != ARCHIVE_OK) {
-      archive_read_free(archive_fd);
-      return -1;
-    }
-    
-    // Compare pathname
-    const char *name = archive_entry_pathname(archive_entry);
-    if (strcasecmp(name, file + archive_path_start) == 0) {
-      return ARCHIVE_FD;
-    }
+  if (seekArchiveEntry(file, 0)) {
+    archive_fd_opened = 1;
+    return ARCHIVE_FD;
   }
 
   archive_read_free(archive_fd);
   archive_fd = NULL;
+  archive_fd_index = -1;
 
   return -1;
 }
@@ -821,7 +1531,14 @@ int archiveFileRead(SceUID fd, void *data, SceSize size) {
   if (is_psarc)
     return psarcFileRead(fd, data, size);
   
-  if (!archive_fd || fd != ARCHIVE_FD)
+  if (archive_is_zip) {
+    if (!zip_reader || fd != ARCHIVE_FD)
+      return -1;
+
+    return zipEntryRead(zip_reader, data, size);
+  }
+
+  if (!archive_fd || !archive_fd_opened || fd != ARCHIVE_FD)
     return -1;
 
   return archive_read_data(archive_fd, data, size);
@@ -831,11 +1548,21 @@ int archiveFileClose(SceUID fd) {
   if (is_psarc)
     return psarcFileClose(fd);
   
-  if (!archive_fd || fd != ARCHIVE_FD)
+  if (archive_is_zip) {
+    if (!zip_reader || fd != ARCHIVE_FD)
+      return -1;
+
+    zipEntryClose(zip_reader);
+    zip_reader = NULL;
+
+    return 0;
+  }
+
+  if (!archive_fd || !archive_fd_opened || fd != ARCHIVE_FD)
     return -1;
 
-  archive_read_free(archive_fd);
-  archive_fd = NULL;
+  // Keep the reader, the next entry is likely to follow this one
+  archive_fd_opened = 0;
 
   return 0;
 }
@@ -867,7 +1594,13 @@ int archiveClose() {
   if (is_psarc)
     return psarcClose();
   
-  freeArchiveNodes(archive_root);
+  freeParkedArchive();
+  freeCheckpoints();
+
+  zipEntryClose(zip_reader);
+  zip_reader = NULL;
+
+  freeArchiveNodes();
   return 0;
 }
 
@@ -880,6 +1613,22 @@ SceMode convert_stat_mode(mode_t mode) {
   return sce_mode;
 }
 
+static int addZipNode(ZipEntry *entry, void *argp) {
+  int *index = (int *)argp;
+
+  ArchiveFileNode *node = addArchiveNode(entry->name, &entry->stat);
+  if (!node)
+    return -1;
+
+  node->index = (*index)++;
+  node->header_pos = entry->header_offset;
+  node->method = entry->method;
+  node->crc = entry->crc;
+  node->compressed_size = entry->compressed_size;
+
+  return 0;
+}
+
 int archiveOpen(const char *file) {
   // Read magic
   uint32_t magic;
@@ -898,23 +1647,45 @@ int archiveOpen(const char *file) {
   archive_path_start = strlen(file) + 1;
   strcpy(archive_file, file);
 
+  freeParkedArchive();
+  freeCheckpoints();
+
+  // Create archive root
+  freeArchiveNodes();
+  if (createArchiveRoot() < 0)
+    return -1;
+
+  need_password = 0;
+
+  // Zip file. Build the tree from the central directory, unless it needs libarchive
+  archive_is_zip = 0;
+  if ((magic & 0xFFFF) == 0x4B50) {
+    int index = 0;
+    if (zipReadCentralDirectory(file, addZipNode, &index) >= 0) {
+      archive_is_zip = 1;
+      return 0;
+    }
+
+    freeArchiveNodes();
+    if (createArchiveRoot() < 0)
+      return -1;
+  }
+
+  // gzip file. Inflate it ourselves to be able to resume at checkpoints later
+  archive_is_tar = 0;
+  archive_is_gzip = (magic & 0xFFFF) == 0x8B1F;
+
   // Open archive file
-  struct archive *archive = open_archive(file);
+  struct archive *archive = archive_is_gzip ? open_archive_record(file) : open_archive(file);
   if (!archive)
     return -1;
   
   // Need password?
-  need_password = 0;
   if (archive_read_has_encrypted_entries(archive) == 1)
     need_password = 1;
   
-  // Create archive root
-  SceIoStat root_stat;
-  memset(&root_stat, 0, sizeof(SceIoStat));
-  root_stat.st_mode = SCE_S_IFDIR;
-  archive_root = createArchiveNode("/", &root_stat);
-  
   // Traverse
+  int index = 0;
   while (1) {
     struct archive_entry *archive_entry;
     int res = archive_read_next_header(archive, &archive_entry);
@@ -952,9 +1723,23 @@ int archiveOpen(const char *file) {
     convertLocalTimeToUtc(&stat.st_atime, &time);  
     
     // Add node
-    addArchiveNode(name, &stat);
+    ArchiveFileNode *node = addArchiveNode(name, &stat);
+    if (node) {
+      node->index = index;
+      node->header_pos = archive_read_header_position(archive);
+    }
+
+    index++;
   }
 
+  // Entry headers can only be jumped to in uncompressed or gzip compressed tar archives
+  int format = archive_format(archive) & ARCHIVE_FORMAT_BASE_MASK;
+  int filter = archive_filter_code(archive, 0);
+  if (format == ARCHIVE_FORMAT_TAR && (archive_is_gzip || filter == ARCHIVE_FILTER_NONE))
+    archive_is_tar = 1;
+  else
+    freeCheckpoints();
+
   archive_read_free(archive);
   return 0;
 }
\ No newline at end of file
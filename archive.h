@@ -27,6 +27,8 @@ int fileListGetArchiveEntries(FileList *list, const char *path, int sort);
 
 int getArchivePathInfo(const char *path, uint64_t *size, uint32_t *folders, uint32_t *files, int (* handler)(const char *path));
 int extractArchivePath(const char *src_path, const char *dst_path, FileProcessParam *param);
+int extractArchivePathCheckUnsafe(const char *src_path, const char *dst_path, FileProcessParam *param, int *unsafe);
+int extractArchiveList(FileList *list, const char *dst_path, FileProcessParam *param);
 
 int archiveFileGetstat(const char *file, SceIoStat *stat);
 int archiveFileOpen(const char *file, int flags, SceMode mode);
@@ -41,6 +43,4 @@ int archiveNeedPassword();
 void archiveClearPassword();
 void archiveSetPassword(char *string);
 
-int archiveCheckFilesForUnsafeFself();
-
 #endif
\ No newline at end of file
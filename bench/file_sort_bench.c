@@ -0,0 +1,241 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Sorts synthetic 100k-entry file lists with the sort keys of file.c and with strnatcasecmp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "sort_key.h"
+#include "strnatcmp.h"
+
+#define N_ENTRIES 100000
+#define N_INSERTS 10000
+#define MAX_NAME_LENGTH 256
+
+#define DIR_UP ".."
+
+static char *sort_names[] = { "none", "name", "size", "date" };
+
+typedef struct {
+  char *name;
+  int is_folder;
+  int64_t size;
+  uint64_t tick;
+  SortKeys sort;
+} Entry;
+
+static char *words[] = { "IMG_", "img", "DSC", "Track ", "track", "save", "Save Data", "a", "B", "photo-", "v" };
+static char *extensions[] = { "", ".jpg", ".PNG", ".mp3", ".bin", ".txt" };
+
+static uint32_t seed = 1;
+
+static uint32_t nextRandom() {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static int sort_mode = SORT_NONE;
+
+static void removeEndSlash(char *path) {
+  int len = strlen(path);
+  if (len > 1 && path[len - 1] == '/')
+    path[len - 1] = '\0';
+}
+
+// The comparison of file.c before the sort keys, as the reference
+static int compareNames(const void *pa, const void *pb) {
+  Entry *a = *(Entry **)pa, *b = *(Entry **)pb;
+
+  char a_name[MAX_NAME_LENGTH], b_name[MAX_NAME_LENGTH];
+  strcpy(a_name, a->name);
+  removeEndSlash(a_name);
+  strcpy(b_name, b->name);
+  removeEndSlash(b_name);
+
+  int a_up = strcmp(a_name, DIR_UP) == 0;
+  int b_up = strcmp(b_name, DIR_UP) == 0;
+  if (a_up || b_up)
+    return b_up - a_up;
+
+  if (a->is_folder != b->is_folder)
+    return sort_mode == SORT_BY_NAME ? b->is_folder - a->is_folder : a->is_folder - b->is_folder;
+
+  if (sort_mode == SORT_BY_SIZE && !a->is_folder && a->size != b->size)
+    return a->size > b->size ? -1 : 1;
+
+  if (sort_mode == SORT_BY_DATE && a->tick != b->tick)
+    return a->tick > b->tick ? -1 : 1;
+
+  return strnatcasecmp(a_name, b_name);
+}
+
+static void createName(char *name, int is_folder) {
+  int len = sprintf(name, "%s", words[nextRandom() % (sizeof(words) / sizeof(char *))]);
+
+  // Numbers with and without leading zeros, some of them split by spaces
+  int n_numbers = nextRandom() % 3;
+  while (n_numbers-- > 0) {
+    int zeros = nextRandom() % 4 == 0 ? 1 + nextRandom() % 3 : 0;
+    while (zeros-- > 0)
+      name[len++] = '0';
+
+    len += sprintf(name + len, "%u", nextRandom() % 2000);
+    if (nextRandom() % 3 == 0)
+      len += sprintf(name + len, "%s", nextRandom() % 2 ? " " : "_");
+  }
+
+  if (is_folder) {
+    strcpy(name + len, "/");
+  } else {
+    strcpy(name + len, extensions[nextRandom() % (sizeof(extensions) / sizeof(char *))]);
+  }
+}
+
+// Same keys as fileListSetSortKeys
+static int setSortKeys(Entry *entry) {
+  int name_length = strlen(entry->name);
+
+  entry->sort.key = malloc(SORT_KEY_SIZE(name_length));
+  if (!entry->sort.key)
+    return -1;
+
+  sortKeyCreate(entry->sort.key, SORT_KEY_SIZE(name_length), entry->name, name_length);
+  entry->sort.rank = strcmp(entry->name, DIR_UP) == 0 ? 0 : 1;
+  entry->sort.is_folder = entry->is_folder;
+  entry->sort.size = entry->size;
+  entry->sort.tick = entry->tick;
+
+  return 0;
+}
+
+// Returns the index of the first entry that is before its predecessor in strnatcasecmp order, or -1
+static int findMismatch(Entry **list, int n) {
+  int i;
+  for (i = 1; i < n; i++) {
+    if (compareNames(&list[i - 1], &list[i]) > 0)
+      return i;
+  }
+
+  return -1;
+}
+
+static double getMillis(struct timespec *start, struct timespec *end) {
+  return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+int main() {
+  Entry *entries = malloc(N_ENTRIES * sizeof(Entry));
+  Entry **sorted = malloc(N_ENTRIES * sizeof(Entry *));
+  Entry **inserted = malloc(N_INSERTS * sizeof(Entry *));
+  if (!entries || !sorted || !inserted)
+    return 1;
+
+  int i;
+  for (i = 0; i < N_ENTRIES; i++) {
+    Entry *entry = &entries[i];
+    char name[MAX_NAME_LENGTH];
+
+    entry->is_folder = i == 0 || nextRandom() % 8 == 0;
+    if (i == 0) {
+      strcpy(name, DIR_UP);
+    } else {
+      createName(name, entry->is_folder);
+    }
+
+    // Few distinct sizes and dates so that the names decide often
+    entry->name = strdup(name);
+    entry->size = entry->is_folder ? 0 : (nextRandom() % 64) * 1024;
+    entry->tick = 63000000000000000ULL + (nextRandom() % 256) * 1000000ULL;
+  }
+
+  int failed = 0;
+
+  int mode;
+  for (mode = SORT_BY_NAME; mode <= SORT_BY_DATE; mode++) {
+    struct timespec start, end;
+    sort_mode = mode;
+
+    // Reference with strnatcasecmp in every comparison
+    for (i = 0; i < N_ENTRIES; i++)
+      sorted[i] = &entries[(i * 7919) % N_ENTRIES];
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    qsort(sorted, N_ENTRIES, sizeof(Entry *), compareNames);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double names_ms = getMillis(&start, &end);
+
+    // Keys are built once per entry, like fileListAddEntry does
+    for (i = 0; i < N_ENTRIES; i++)
+      sorted[i] = &entries[(i * 7919) % N_ENTRIES];
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < N_ENTRIES; i++) {
+      if (setSortKeys(&entries[i]) < 0)
+        return 1;
+    }
+
+    if (sortKeysSort((void **)sorted, N_ENTRIES, offsetof(Entry, sort), mode) < 0)
+      return 1;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double keys_ms = getMillis(&start, &end);
+
+    int mismatch = findMismatch(sorted, N_ENTRIES);
+
+    // Sorted insertion of a smaller list, like fileListAddEntry with a sort mode
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < N_INSERTS; i++) {
+      Entry *entry = &entries[(i * 7919) % N_ENTRIES];
+      int index = sortKeysFindInsert((void **)inserted, i, offsetof(Entry, sort), &entry->sort, mode);
+      memmove(&inserted[index + 1], &inserted[index], (i - index) * sizeof(Entry *));
+      inserted[index] = entry;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double insert_ms = getMillis(&start, &end);
+
+    int insert_mismatch = findMismatch(inserted, N_INSERTS);
+
+    if (mismatch >= 0 || insert_mismatch >= 0) {
+      Entry **list = mismatch >= 0 ? sorted : inserted;
+      int index = mismatch >= 0 ? mismatch : insert_mismatch;
+      printf("%-5s MISMATCH %s at %d: '%s' before '%s'\n", sort_names[mode], mismatch >= 0 ? "sort" : "insert",
+             index, list[index - 1]->name, list[index]->name);
+      failed = 1;
+    } else {
+      printf("%-5s ok  sort %8.2f ms  strnatcasecmp %8.2f ms  %dk inserts %8.2f ms\n", sort_names[mode], keys_ms,
+             names_ms, N_INSERTS / 1000, insert_ms);
+    }
+
+    for (i = 0; i < N_ENTRIES; i++)
+      free(entries[i].sort.key);
+  }
+
+  for (i = 0; i < N_ENTRIES; i++)
+    free(entries[i].name);
+
+  free(inserted);
+  free(sorted);
+  free(entries);
+
+  return failed;
+}
@@ -0,0 +1,193 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Indexes multi-megabyte texts with the piece table and checks the line lookups
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "piece_table.h"
+
+#define N_QUERIES 100000
+#define N_EDITS 200
+
+static uint32_t text_sizes[] = { 4 * 1024 * 1024, 16 * 1024 * 1024 };
+
+static uint32_t lines[N_QUERIES], offsets[N_QUERIES];
+static uint32_t line_offsets[N_QUERIES], offset_lines[N_QUERIES];
+
+static uint32_t seed = 1;
+
+static uint32_t nextRandom() {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static double getTime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Mostly short lines like a log, with some very long ones
+static void createText(char *data, uint32_t size) {
+  uint32_t i = 0;
+  while (i < size) {
+    uint32_t length = nextRandom() % 64 == 0 ? nextRandom() % 8192 : nextRandom() % 120;
+
+    uint32_t j;
+    for (j = 0; j < length && i < size - 1; j++)
+      data[i++] = ' ' + nextRandom() % 95;
+
+    data[i++] = '\n';
+  }
+}
+
+// Offset after every line break, with 0 for the first line
+static uint32_t createLineStarts(const char *data, uint32_t size, uint32_t *starts) {
+  uint32_t n_starts = 0, i;
+
+  starts[n_starts++] = 0;
+  for (i = 0; i < size; i++) {
+    if (data[i] == '\n')
+      starts[n_starts++] = i + 1;
+  }
+
+  return n_starts;
+}
+
+// Number of line breaks before offset
+static uint32_t findLine(uint32_t *starts, uint32_t n_starts, uint32_t offset) {
+  uint32_t low = 0, high = n_starts - 1;
+  while (low < high) {
+    uint32_t mid = (low + high + 1) / 2;
+    if (starts[mid] <= offset)
+      low = mid;
+    else
+      high = mid - 1;
+  }
+
+  return low;
+}
+
+// Returns the number of wrong lookups
+static int checkQueries(PieceTable *table, const char *data, uint32_t size, uint32_t *starts, double *query_time) {
+  uint32_t n_starts = createLineStarts(data, size, starts);
+  int errors = 0;
+
+  if (pieceTableLines(table) != n_starts - 1)
+    errors++;
+
+  // Some lines and offsets past the end
+  int i;
+  for (i = 0; i < N_QUERIES; i++) {
+    lines[i] = nextRandom() % (n_starts + 16);
+    offsets[i] = nextRandom() % (size + 16);
+  }
+
+  double t0 = getTime();
+
+  for (i = 0; i < N_QUERIES; i++) {
+    line_offsets[i] = pieceTableLineOffset(table, lines[i]);
+    offset_lines[i] = pieceTableOffsetLine(table, offsets[i]);
+  }
+
+  *query_time = getTime() - t0;
+
+  for (i = 0; i < N_QUERIES; i++) {
+    if (line_offsets[i] != (lines[i] < n_starts ? starts[lines[i]] : size))
+      errors++;
+    if (offset_lines[i] != findLine(starts, n_starts, offsets[i] < size ? offsets[i] : size))
+      errors++;
+  }
+
+  return errors;
+}
+
+int main() {
+  int failed = 0;
+
+  int i;
+  for (i = 0; i < (int)(sizeof(text_sizes) / sizeof(uint32_t)); i++) {
+    uint32_t size = text_sizes[i];
+    uint32_t max_size = size + N_EDITS * 64;
+
+    // The table keeps pointing to text, the edits are mirrored in data
+    char *text = malloc(size);
+    char *data = malloc(max_size);
+    uint32_t *starts = malloc((max_size + 1) * sizeof(uint32_t));
+    if (!text || !data || !starts)
+      return 1;
+
+    createText(text, size);
+    memcpy(data, text, size);
+
+    // The text viewer indexes the whole file when it is opened
+    PieceTable table;
+    double t0 = getTime();
+    if (pieceTableInit(&table, text, size) < 0)
+      return 1;
+    double index_time = getTime() - t0;
+
+    t0 = getTime();
+    uint32_t n_lines = createLineStarts(data, size, starts) - 1;
+    double scan_time = getTime() - t0;
+
+    double query_time;
+    int errors = checkQueries(&table, data, size, starts, &query_time);
+
+    printf("%2u MB %7u lines: index %7.2f ms, byte scan %7.2f ms, %d lookups %7.2f ms %s\n",
+           size / (1024 * 1024), n_lines, index_time * 1000.0, scan_time * 1000.0, 2 * N_QUERIES,
+           query_time * 1000.0, errors ? "MISMATCH" : "ok");
+    if (errors)
+      failed = 1;
+
+    // Lookups on a table split by edits
+    int j;
+    for (j = 0; j < N_EDITS; j++) {
+      char line[64];
+      uint32_t length = snprintf(line, sizeof(line), "inserted %u\nline\n", nextRandom());
+      uint32_t offset = nextRandom() % (size + 1);
+
+      if (pieceTableInsert(&table, offset, line, length) < 0)
+        return 1;
+
+      memmove(data + offset + length, data + offset, size - offset);
+      memcpy(data + offset, line, length);
+      size += length;
+    }
+
+    errors = checkQueries(&table, data, size, starts, &query_time);
+
+    printf("%2u MB %4u edits      : %d lookups %7.2f ms %s\n", text_sizes[i] / (1024 * 1024), N_EDITS,
+           2 * N_QUERIES, query_time * 1000.0, errors ? "MISMATCH" : "ok");
+    if (errors)
+      failed = 1;
+
+    pieceTableFree(&table);
+    free(starts);
+    free(data);
+    free(text);
+  }
+
+  return failed;
+}
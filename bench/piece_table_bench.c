@@ -0,0 +1,261 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Replays edit scripts on a 10 MB text with the piece table and a flat buffer
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "piece_table.h"
+
+#define TEXT_SIZE (10 * 1024 * 1024)
+#define N_EDITS 500
+
+enum ScriptModes {
+  SCRIPT_DELETE_LINES, // Like pressing left on the same row
+  SCRIPT_INSERT_LINES, // Empty lines at random rows
+  SCRIPT_EDIT_LINES,   // Replace random rows, like the line editor
+  SCRIPT_CUT_PASTE,    // Move blocks of lines around
+  N_SCRIPTS,
+};
+
+static char *script_names[N_SCRIPTS] = { "delete lines", "insert lines", "edit lines", "cut and paste" };
+
+typedef struct {
+  char *data;
+  uint32_t size;
+} FlatBuffer;
+
+static uint32_t seed = 1;
+
+static uint32_t nextRandom() {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static uint32_t countBreaks(const char *data, uint32_t size) {
+  uint32_t count = 0, i;
+  for (i = 0; i < size; i++) {
+    if (data[i] == '\n')
+      count++;
+  }
+
+  return count;
+}
+
+static double getTime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void flatInsert(FlatBuffer *flat, uint32_t offset, const char *data, uint32_t size) {
+  memmove(flat->data + offset + size, flat->data + offset, flat->size - offset);
+  memcpy(flat->data + offset, data, size);
+  flat->size += size;
+}
+
+static void flatDelete(FlatBuffer *flat, uint32_t offset, uint32_t size) {
+  memmove(flat->data + offset, flat->data + offset + size, flat->size - offset - size);
+  flat->size -= size;
+}
+
+static uint32_t flatLineOffset(FlatBuffer *flat, uint32_t line) {
+  uint32_t offset = 0;
+  while (line > 0) {
+    char *p = memchr(flat->data + offset, '\n', flat->size - offset);
+    if (!p)
+      return flat->size;
+
+    offset = p - flat->data + 1;
+    line--;
+  }
+
+  return offset;
+}
+
+static void createText(char *data, uint32_t size) {
+  uint32_t i = 0;
+  while (i < size) {
+    uint32_t length = 1 + nextRandom() % 120;
+
+    uint32_t j;
+    for (j = 0; j < length && i < size - 1; j++)
+      data[i++] = ' ' + nextRandom() % 95;
+
+    data[i++] = '\n';
+  }
+}
+
+// Both buffers get the same edit, the piece table is timed
+static void runScript(int script, PieceTable *table, FlatBuffer *flat, double *table_time, double *flat_time) {
+  uint32_t lines = pieceTableLines(table);
+  uint32_t line = nextRandom() % lines;
+  uint32_t count = 1 + nextRandom() % 32;
+  uint32_t target = nextRandom() % lines;
+
+  char text[64];
+  uint32_t length = snprintf(text, sizeof(text), "edited line %u\n", nextRandom());
+
+  double t0 = getTime();
+
+  switch (script) {
+    case SCRIPT_DELETE_LINES:
+    {
+      uint32_t start = pieceTableLineOffset(table, 1000);
+      uint32_t end = pieceTableLineOffset(table, 1001);
+      pieceTableDelete(table, start, end - start);
+      break;
+    }
+
+    case SCRIPT_INSERT_LINES:
+      pieceTableInsert(table, pieceTableLineOffset(table, line), "\n", 1);
+      break;
+
+    case SCRIPT_EDIT_LINES:
+    {
+      uint32_t start = pieceTableLineOffset(table, line);
+      uint32_t end = pieceTableLineOffset(table, line + 1);
+      pieceTableDelete(table, start, end - start);
+      pieceTableInsert(table, start, text, length);
+      break;
+    }
+
+    case SCRIPT_CUT_PASTE:
+    {
+      static char block[64 * 1024];
+      uint32_t start = pieceTableLineOffset(table, line);
+      uint32_t end = pieceTableLineOffset(table, line + count);
+      uint32_t size = end - start < sizeof(block) ? end - start : sizeof(block);
+      pieceTableRead(table, start, block, size);
+      pieceTableDelete(table, start, size);
+      uint32_t paste = target % (lines - countBreaks(block, size));
+      pieceTableInsert(table, pieceTableLineOffset(table, paste), block, size);
+      break;
+    }
+  }
+
+  double t1 = getTime();
+
+  switch (script) {
+    case SCRIPT_DELETE_LINES:
+    {
+      uint32_t start = flatLineOffset(flat, 1000);
+      uint32_t end = flatLineOffset(flat, 1001);
+      flatDelete(flat, start, end - start);
+      break;
+    }
+
+    case SCRIPT_INSERT_LINES:
+      flatInsert(flat, flatLineOffset(flat, line), "\n", 1);
+      break;
+
+    case SCRIPT_EDIT_LINES:
+    {
+      uint32_t start = flatLineOffset(flat, line);
+      uint32_t end = flatLineOffset(flat, line + 1);
+      flatDelete(flat, start, end - start);
+      flatInsert(flat, start, text, length);
+      break;
+    }
+
+    case SCRIPT_CUT_PASTE:
+    {
+      static char block[64 * 1024];
+      uint32_t start = flatLineOffset(flat, line);
+      uint32_t end = flatLineOffset(flat, line + count);
+      uint32_t size = end - start < sizeof(block) ? end - start : sizeof(block);
+      memcpy(block, flat->data + start, size);
+      flatDelete(flat, start, size);
+      uint32_t paste = target % (lines - countBreaks(block, size));
+      flatInsert(flat, flatLineOffset(flat, paste), block, size);
+      break;
+    }
+  }
+
+  double t2 = getTime();
+
+  *table_time += t1 - t0;
+  *flat_time += t2 - t1;
+}
+
+static int checkText(PieceTable *table, FlatBuffer *flat) {
+  if (pieceTableSize(table) != flat->size)
+    return -1;
+
+  char *data = malloc(flat->size);
+  if (!data)
+    return -1;
+
+  int res = 0;
+  if (pieceTableRead(table, 0, data, flat->size) != flat->size || memcmp(data, flat->data, flat->size) != 0)
+    res = -1;
+
+  free(data);
+
+  if (pieceTableLines(table) != countBreaks(flat->data, flat->size))
+    res = -1;
+
+  return res;
+}
+
+int main(int argc, char *argv[]) {
+  char *original = malloc(TEXT_SIZE);
+  FlatBuffer flat;
+  flat.data = malloc(TEXT_SIZE * 2);
+  if (!original || !flat.data)
+    return 1;
+
+  createText(original, TEXT_SIZE);
+
+  int failed = 0;
+
+  int script;
+  for (script = 0; script < N_SCRIPTS; script++) {
+    PieceTable table;
+    if (pieceTableInit(&table, original, TEXT_SIZE) < 0)
+      return 1;
+
+    memcpy(flat.data, original, TEXT_SIZE);
+    flat.size = TEXT_SIZE;
+
+    double table_time = 0.0, flat_time = 0.0;
+
+    int i;
+    for (i = 0; i < N_EDITS; i++)
+      runScript(script, &table, &flat, &table_time, &flat_time);
+
+    int res = checkText(&table, &flat);
+    if (res < 0)
+      failed = 1;
+
+    printf("%-14s %d edits: piece table %8.2f ms, flat buffer %8.2f ms %s\n", script_names[script], N_EDITS,
+           table_time * 1000.0, flat_time * 1000.0, res < 0 ? "MISMATCH" : "ok");
+
+    pieceTableFree(&table);
+  }
+
+  free(flat.data);
+  free(original);
+
+  return failed;
+}
@@ -0,0 +1,327 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Writes zlib and LZMA archives and extracts them with the PSARC reader
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <zlib.h>
+#include <lzma.h>
+
+#include "psarc_reader.h"
+
+#define BLOCK_SIZE (64 * 1024)
+#define N_FILES 16
+#define MAX_THREADS 4
+
+typedef struct {
+  uint32_t compression;
+  char *name;
+  uint32_t total_size; // Of all files
+} ArchiveSpec;
+
+static ArchiveSpec specs[] = {
+  { PSARC_COMPRESSION_ZLIB, "zlib", 48 * 1024 * 1024 },
+  { PSARC_COMPRESSION_LZMA, "lzma", 12 * 1024 * 1024 },
+};
+
+typedef struct {
+  uint8_t *data;
+  uint32_t size;
+} BenchFile;
+
+typedef struct {
+  const uint8_t *expected;
+  uint32_t size;
+  uint32_t pos;
+  int mismatch;
+} WriteCheck;
+
+static uint32_t seed = 1;
+
+static uint32_t nextRandom() {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static double getTime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void putBe(uint8_t *p, uint64_t value, int n_bytes) {
+  int i;
+  for (i = 0; i < n_bytes; i++)
+    p[i] = value >> ((n_bytes - 1 - i) * 8);
+}
+
+// Mostly text that compresses, with some random blocks that are stored as is
+static void createData(uint8_t *data, uint32_t size) {
+  static const char *words[] = { "texture", "model", "sound", "level", "script", "shader", "font", "data" };
+
+  uint32_t i = 0;
+  while (i < size) {
+    uint32_t end = i + BLOCK_SIZE < size ? i + BLOCK_SIZE : size;
+
+    if (nextRandom() % 8 == 0) {
+      while (i < end)
+        data[i++] = nextRandom();
+    } else {
+      while (i < end) {
+        const char *word = words[nextRandom() % (sizeof(words) / sizeof(char *))];
+        int length = snprintf((char *)data + i, end - i, "%s %u\n", word, nextRandom() % 10000);
+        i = length < (int)(end - i) ? i + length : end;
+      }
+    }
+  }
+}
+
+// Returns the compressed size, or 0 if the block is stored as is
+static uint32_t compressBlock(uint32_t compression, const uint8_t *in, uint32_t in_size, uint8_t *out, uint32_t out_size) {
+  uint32_t size = 0;
+
+  if (compression == PSARC_COMPRESSION_ZLIB) {
+    uLongf length = out_size;
+    if (compress2(out, &length, in, in_size, 6) == Z_OK)
+      size = length;
+  } else {
+    lzma_options_lzma options;
+    lzma_lzma_preset(&options, 1);
+
+    lzma_stream strm = LZMA_STREAM_INIT;
+    if (lzma_alone_encoder(&strm, &options) == LZMA_OK) {
+      strm.next_in = in;
+      strm.avail_in = in_size;
+      strm.next_out = out;
+      strm.avail_out = out_size;
+
+      if (lzma_code(&strm, LZMA_FINISH) == LZMA_STREAM_END)
+        size = strm.total_out;
+
+      lzma_end(&strm);
+    }
+  }
+
+  return size > 0 && size < in_size ? size : 0;
+}
+
+// Entry 0 is the manifest, followed by the files
+static int writeArchive(const char *path, uint32_t compression, BenchFile *files, int n_files) {
+  BenchFile entries[N_FILES + 1];
+  char manifest[N_FILES * 32];
+  uint32_t manifest_size = 0;
+
+  int i;
+  for (i = 0; i < n_files; i++)
+    manifest_size += snprintf(manifest + manifest_size, sizeof(manifest) - manifest_size, "%s/data/file%02d.bin",
+                              i > 0 ? "\n" : "", i);
+
+  entries[0].data = (uint8_t *)manifest;
+  entries[0].size = manifest_size;
+  memcpy(entries + 1, files, n_files * sizeof(BenchFile));
+
+  int n_entries = n_files + 1;
+
+  uint32_t n_blocks = 0;
+  for (i = 0; i < n_entries; i++)
+    n_blocks += (entries[i].size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+  uint32_t toc_length = 32 + n_entries * 30 + n_blocks * 2;
+
+  uint8_t *toc = calloc(1, toc_length);
+  uint8_t *block = malloc(2 * BLOCK_SIZE);
+  uint8_t **blocks = malloc(n_blocks * sizeof(uint8_t *));
+  uint32_t *block_sizes = malloc(n_blocks * sizeof(uint32_t));
+  if (!toc || !block || !blocks || !block_sizes)
+    return -1;
+
+  // Compress every block and fill the TOC
+  uint64_t offset = toc_length;
+  uint32_t block_index = 0;
+
+  for (i = 0; i < n_entries; i++) {
+    uint8_t *p = toc + 32 + i * 30;
+    putBe(p + 16, block_index, 4);
+    putBe(p + 20, entries[i].size, 5);
+    putBe(p + 25, offset, 5);
+
+    uint32_t pos;
+    for (pos = 0; pos < entries[i].size; pos += BLOCK_SIZE) {
+      uint32_t in_size = entries[i].size - pos < BLOCK_SIZE ? entries[i].size - pos : BLOCK_SIZE;
+      uint32_t size = compressBlock(compression, entries[i].data + pos, in_size, block, 2 * BLOCK_SIZE);
+
+      block_sizes[block_index] = size ? size : in_size;
+      blocks[block_index] = malloc(block_sizes[block_index]);
+      if (!blocks[block_index])
+        return -1;
+
+      memcpy(blocks[block_index], size ? block : entries[i].data + pos, block_sizes[block_index]);
+
+      // A full block stored as is has the size 0 in the table
+      putBe(toc + 32 + n_entries * 30 + block_index * 2, size ? size : in_size % BLOCK_SIZE, 2);
+
+      offset += block_sizes[block_index];
+      block_index++;
+    }
+  }
+
+  memcpy(toc, "PSAR", 4);
+  putBe(toc + 4, 0x00010004, 4);
+  putBe(toc + 8, compression, 4);
+  putBe(toc + 12, toc_length, 4);
+  putBe(toc + 16, 30, 4);
+  putBe(toc + 20, n_entries, 4);
+  putBe(toc + 24, BLOCK_SIZE, 4);
+  putBe(toc + 28, 0, 4);
+
+  int res = 0;
+
+  FILE *file = fopen(path, "wb");
+  if (!file || fwrite(toc, 1, toc_length, file) != toc_length)
+    res = -1;
+
+  uint32_t j;
+  for (j = 0; j < n_blocks; j++) {
+    if (res == 0 && fwrite(blocks[j], 1, block_sizes[j], file) != block_sizes[j])
+      res = -1;
+
+    free(blocks[j]);
+  }
+
+  if (file)
+    fclose(file);
+
+  free(block_sizes);
+  free(blocks);
+  free(block);
+  free(toc);
+
+  return res;
+}
+
+static int checkWrite(void *argp, const void *data, uint32_t size) {
+  WriteCheck *check = argp;
+
+  if (check->pos + size > check->size || memcmp(check->expected + check->pos, data, size) != 0)
+    check->mismatch = 1;
+
+  check->pos += size;
+  return 1;
+}
+
+// Returns the number of files that did not extract correctly
+static int extractAll(PsarcArchive *archive, BenchFile *files, int n_threads) {
+  int errors = 0;
+
+  uint32_t i;
+  for (i = 0; i < archive->n_entries; i++) {
+    PsarcEntry *entry = &archive->entries[i];
+
+    int index;
+    if (sscanf(entry->name, "data/file%d.bin", &index) != 1 || index < 0 || index >= N_FILES) {
+      errors++;
+      continue;
+    }
+
+    WriteCheck check;
+    check.expected = files[index].data;
+    check.size = files[index].size;
+    check.pos = 0;
+    check.mismatch = 0;
+
+    int res = psarcEntryExtract(archive, entry, n_threads, checkWrite, &check);
+    if (res <= 0 || check.mismatch || check.pos != check.size || entry->size != check.size)
+      errors++;
+  }
+
+  return errors;
+}
+
+int main() {
+  int failed = 0;
+
+  int s;
+  for (s = 0; s < (int)(sizeof(specs) / sizeof(ArchiveSpec)); s++) {
+    ArchiveSpec *spec = &specs[s];
+    BenchFile files[N_FILES];
+
+    // Sizes vary and most files end in a partial block
+    uint32_t left = spec->total_size;
+    int i;
+    for (i = 0; i < N_FILES; i++) {
+      uint32_t size = i == N_FILES - 1 ? left : nextRandom() % (2 * spec->total_size / N_FILES);
+      if (size > left)
+        size = left;
+
+      files[i].data = malloc(size ? size : 1);
+      files[i].size = size;
+      if (!files[i].data)
+        return 1;
+
+      createData(files[i].data, size);
+      left -= size;
+    }
+
+    char path[] = "/tmp/psarc_reader_benchXXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+      return 1;
+    close(fd);
+
+    if (writeArchive(path, spec->compression, files, N_FILES) < 0) {
+      unlink(path);
+      return 1;
+    }
+
+    PsarcArchive *archive = NULL;
+    int res = psarcArchiveOpen(&archive, path);
+    if (res < 0 || archive->n_entries != N_FILES) {
+      printf("%s: open failed 0x%08X\n", spec->name, res);
+      failed = 1;
+    } else {
+      int n_threads;
+      for (n_threads = 1; n_threads <= MAX_THREADS; n_threads++) {
+        double t0 = getTime();
+        int errors = extractAll(archive, files, n_threads);
+        double time = getTime() - t0;
+
+        printf("%s %2u MB, %d thread%s: %7.2f ms, %7.2f MB/s %s\n", spec->name, spec->total_size / (1024 * 1024),
+               n_threads, n_threads > 1 ? "s" : " ", time * 1000.0, spec->total_size / (1024.0 * 1024.0) / time,
+               errors ? "MISMATCH" : "ok");
+        if (errors)
+          failed = 1;
+      }
+    }
+
+    psarcArchiveClose(archive);
+    unlink(path);
+
+    for (i = 0; i < N_FILES; i++)
+      free(files[i].data);
+  }
+
+  return failed;
+}
@@ -0,0 +1,257 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Indexes the rows of multi-megabyte texts in one pass and compares them to the per-row wrap
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "text_rows.h"
+
+#define MAX_LINE_CHARACTERS 1024
+#define TAB_SIZE 4
+#define MAX_WIDTH 843.0f // Of a row in the text viewer
+
+#define N_EDITS 500
+#define MAX_EDIT_SIZE 4096
+
+static uint32_t text_sizes[] = { 4 * 1024 * 1024, 16 * 1024 * 1024 };
+
+static char font_size_cache[256];
+
+static uint32_t seed = 1;
+
+static uint32_t nextRandom() {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static double getTime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Printable characters only, the others are drawn as spaces
+static void createFont() {
+  int i;
+  for (i = ' '; i < 0x7F; i++)
+    font_size_cache[i] = 6 + i % 13;
+}
+
+// Logs and code with tabs, some lines wider than the screen and some bytes without a glyph
+static void createText(char *data, uint32_t size) {
+  uint32_t i = 0;
+  while (i < size) {
+    uint32_t kind = nextRandom() % 64;
+    uint32_t length = kind == 0 ? nextRandom() % 8192 : nextRandom() % 100;
+
+    uint32_t j;
+    for (j = 0; j < length && i < size - 1; j++) {
+      uint32_t r = nextRandom() % 64;
+      data[i++] = kind == 1 && r == 0 ? '\t' : r == 1 ? 0x80 + nextRandom() % 0x80 : ' ' + nextRandom() % 95;
+    }
+
+    data[i++] = '\n';
+  }
+}
+
+// The soft wrap of the text viewer before the row index
+static int textReadLine(char *buffer, int offset, int size, char *line) {
+  int line_width = 0;
+  int count = 0;
+
+  int i;
+  for (i = 0; i < size && i < size - offset && i < MAX_LINE_CHARACTERS - 1; i++) {
+    char ch = buffer[offset + i];
+    char ch_width = 0;
+
+    if (ch == '\n') {
+      i++;
+      break;
+    }
+
+    if (ch == '\t') {
+      ch_width = TAB_SIZE * font_size_cache[' '];
+    } else {
+      ch_width = font_size_cache[(uint8_t)ch];
+      if (ch_width == 0) {
+        ch = ' ';
+        ch_width = font_size_cache[(uint8_t)ch];
+      }
+    }
+
+    if ((line_width + ch_width) >= MAX_WIDTH)
+      break;
+
+    line_width += ch_width;
+
+    if (line)
+      line[count++] = ch;
+  }
+
+  if (line)
+    line[count] = '\0';
+
+  return i;
+}
+
+// Measures every character of every row
+static uint32_t createRows(char *data, uint32_t size, uint32_t *offsets) {
+  uint32_t n_rows = 0, offset = 0;
+
+  while (offset < size) {
+    offsets[n_rows++] = offset;
+    offset += textReadLine(data + offset, 0, size - offset, NULL);
+  }
+
+  return n_rows;
+}
+
+// Returns the number of wrong rows
+static int checkRows(TextRows *rows, char *data, uint32_t size, uint32_t *offsets) {
+  uint32_t n_rows = createRows(data, size, offsets);
+  int errors = 0;
+
+  if (!rows->done || rows->n_rows != n_rows)
+    return 1;
+
+  uint32_t i;
+  for (i = 0; i < n_rows; i++) {
+    if (rows->offsets[i] != offsets[i])
+      errors++;
+  }
+
+  // Lookups in the middle of rows
+  for (i = 0; i < 1000; i++) {
+    uint32_t row = nextRandom() % n_rows;
+    uint32_t end = row + 1 < n_rows ? offsets[row + 1] : size;
+    if (textRowsFind(rows, offsets[row] + nextRandom() % (end - offsets[row])) != (int)row)
+      errors++;
+  }
+
+  return errors;
+}
+
+static int buildRows(TextRows *rows, PieceTable *table, uint32_t budget) {
+  int res;
+  do {
+    res = textRowsBuild(rows, table, budget);
+  } while (res == 0);
+
+  return res;
+}
+
+int main() {
+  int failed = 0;
+
+  createFont();
+
+  TextLayout layout;
+  textLayoutInit(&layout, font_size_cache, TAB_SIZE, MAX_WIDTH, MAX_LINE_CHARACTERS);
+
+  int i;
+  for (i = 0; i < (int)(sizeof(text_sizes) / sizeof(uint32_t)); i++) {
+    uint32_t size = text_sizes[i];
+    uint32_t max_size = size + N_EDITS * MAX_EDIT_SIZE;
+
+    // The table keeps pointing to text, the edits are mirrored in data
+    char *text = malloc(size);
+    char *data = malloc(max_size);
+    char *insert = malloc(MAX_EDIT_SIZE);
+    uint32_t *offsets = malloc((max_size + 1) * sizeof(uint32_t));
+    if (!text || !data || !insert || !offsets)
+      return 1;
+
+    createText(text, size);
+    memcpy(data, text, size);
+
+    PieceTable table;
+    TextRows rows;
+    if (pieceTableInit(&table, text, size) < 0 || textRowsInit(&rows, &layout) < 0)
+      return 1;
+
+    double t0 = getTime();
+    uint32_t n_rows = createRows(data, size, offsets);
+    double row_time = getTime() - t0;
+
+    t0 = getTime();
+    int res = buildRows(&rows, &table, TEXT_ROWS_CHUNK_SIZE);
+    double index_time = getTime() - t0;
+
+    int errors = res < 0 ? 1 : checkRows(&rows, data, size, offsets);
+
+    // Edits of lines, some of them while the rows are still being indexed
+    double edit_time = 0;
+    int n;
+    for (n = 0; n < N_EDITS; n++) {
+      uint32_t offset = nextRandom() % size;
+      uint32_t deleted = nextRandom() % 4 == 0 ? 0 : nextRandom() % (nextRandom() % 8 == 0 ? MAX_EDIT_SIZE : 64);
+      uint32_t inserted = nextRandom() % 4 == 0 ? 0 : nextRandom() % (nextRandom() % 8 == 0 ? MAX_EDIT_SIZE : 64);
+
+      if (deleted > size - offset)
+        deleted = size - offset;
+
+      createText(insert, inserted);
+
+      pieceTableDelete(&table, offset, deleted);
+      pieceTableInsert(&table, offset, insert, inserted);
+
+      memmove(data + offset + inserted, data + offset + deleted, size - offset - deleted);
+      memcpy(data + offset, insert, inserted);
+      size = size - deleted + inserted;
+
+      t0 = getTime();
+      res = textRowsEdit(&rows, &table, offset, deleted, inserted);
+      edit_time += getTime() - t0;
+
+      if (res < 0) {
+        errors++;
+        break;
+      }
+
+      if (n % 50 == 49) {
+        if (buildRows(&rows, &table, TEXT_ROWS_CHUNK_SIZE) < 0)
+          errors++;
+        else
+          errors += checkRows(&rows, data, size, offsets);
+      } else if (n % 50 == 0) {
+        textRowsBuild(&rows, &table, nextRandom() % size);
+      }
+    }
+
+    printf("text %2u MB, %7u rows: per-row %7.2f ms, one pass %7.2f ms, edit %6.3f ms %s\n",
+           text_sizes[i] / (1024 * 1024), n_rows, row_time * 1000.0, index_time * 1000.0,
+           edit_time * 1000.0 / N_EDITS, errors ? "MISMATCH" : "ok");
+    if (errors)
+      failed = 1;
+
+    textRowsFree(&rows);
+    pieceTableFree(&table);
+    free(offsets);
+    free(insert);
+    free(data);
+    free(text);
+  }
+
+  return failed;
+}
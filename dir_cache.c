@@ -0,0 +1,302 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "main.h"
+#include "dir_cache.h"
+#include "file.h"
+
+// Recently listed folders, reused as long as the folder mtime is unchanged
+typedef struct {
+  SceOff size;
+  SceDateTime ctime;
+  SceDateTime mtime;
+  SceDateTime atime;
+  uint32_t name_offset;
+  uint16_t name_length;
+  uint8_t is_folder;
+  uint8_t type;
+} DirCacheRecord;
+
+typedef struct {
+  char path[MAX_PATH_LENGTH];
+  SceDateTime mtime;
+  DirCacheRecord *records; // Names follow the records in the same block
+  int n_records;
+  int memory;
+  uint32_t last_use;
+  int prefetched; // Not used yet since it was listed ahead of time
+} DirCacheEntry;
+
+static DirCacheEntry cache[DIR_CACHE_MAX_DIRS];
+static int n_cache = 0;
+static int cache_memory = 0;
+static uint32_t use_counter = 0;
+
+static int hits = 0, misses = 0;
+static int prefetch_hits = 0, prefetch_wasted = 0;
+
+static SceKernelLwMutexWork cache_mutex;
+
+void dirCacheInit() {
+  sceKernelCreateLwMutex(&cache_mutex, "dir_cache_mutex", 2, 0, NULL);
+}
+
+static int findCacheEntry(const char *path) {
+  int i;
+  for (i = 0; i < n_cache; i++) {
+    if (strcmp(cache[i].path, path) == 0)
+      return i;
+  }
+
+  return -1;
+}
+
+static void removeCacheEntry(int i) {
+  if (cache[i].prefetched)
+    prefetch_wasted++;
+
+  free(cache[i].records);
+  cache_memory -= cache[i].memory;
+
+  n_cache--;
+  if (i != n_cache)
+    memcpy(&cache[i], &cache[n_cache], sizeof(DirCacheEntry));
+}
+
+static void evictLeastRecentlyUsed() {
+  int i, lru = 0;
+  for (i = 1; i < n_cache; i++) {
+    if (cache[i].last_use < cache[lru].last_use)
+      lru = i;
+  }
+
+  removeCacheEntry(lru);
+}
+
+int dirCacheGetMtime(const char *path, SceDateTime *mtime) {
+  char stat_path[MAX_PATH_LENGTH];
+  strcpy(stat_path, path);
+
+  // Keep the slash of device roots only
+  int len = strlen(stat_path);
+  if (len > 1 && stat_path[len - 1] == '/' && stat_path[len - 2] != ':')
+    stat_path[len - 1] = '\0';
+
+  SceIoStat stat;
+  memset(&stat, 0, sizeof(SceIoStat));
+  int res = sceIoGetstat(stat_path, &stat);
+  if (res < 0)
+    return res;
+
+  memcpy(mtime, (SceDateTime *)&stat.st_mtime, sizeof(SceDateTime));
+  return 0;
+}
+
+// Returns the index of the cached listing if it is still up to date
+static int findValidCacheEntry(const char *path, SceDateTime *mtime) {
+  int i = findCacheEntry(path);
+  if (i < 0)
+    return -1;
+
+  // The folder has changed since it was cached
+  if (memcmp(&cache[i].mtime, mtime, sizeof(SceDateTime)) != 0) {
+    removeCacheEntry(i);
+    return -1;
+  }
+
+  return i;
+}
+
+int dirCacheLookup(FileList *list, const char *path, int sort, SceDateTime *mtime) {
+  int res = dirCacheGetMtime(path, mtime);
+  if (res < 0)
+    return res;
+
+  sceKernelLockLwMutex(&cache_mutex, 1, NULL);
+
+  int i = findValidCacheEntry(path, mtime);
+  if (i < 0) {
+    misses++;
+    sceKernelUnlockLwMutex(&cache_mutex, 1);
+    return 0;
+  }
+
+  DirCacheEntry *cache_entry = &cache[i];
+  cache_entry->last_use = ++use_counter;
+
+  if (cache_entry->prefetched) {
+    cache_entry->prefetched = 0;
+    prefetch_hits++;
+  }
+
+  char *names = (char *)(cache_entry->records + cache_entry->n_records);
+
+  fileListAddEntry(list, fileListCreateUpEntry(&list->arena), SORT_NONE);
+
+  int j;
+  for (j = 0; j < cache_entry->n_records; j++) {
+    DirCacheRecord *record = &cache_entry->records[j];
+
+    FileListEntry *entry = fileListAllocEntry(&list->arena, record->name_length);
+    if (!entry)
+      break;
+
+    memcpy(entry->name, names + record->name_offset, record->name_length + 1);
+    entry->is_folder = record->is_folder;
+    entry->type = record->type;
+    entry->size = record->size;
+    memcpy(&entry->ctime, &record->ctime, sizeof(SceDateTime));
+    memcpy(&entry->mtime, &record->mtime, sizeof(SceDateTime));
+    memcpy(&entry->atime, &record->atime, sizeof(SceDateTime));
+
+    if (entry->is_folder)
+      list->folders++;
+    else
+      list->files++;
+
+    fileListAddEntry(list, entry, SORT_NONE);
+  }
+
+  hits++;
+  sceKernelUnlockLwMutex(&cache_mutex, 1);
+
+  fileListSort(list, sort);
+
+  return 1;
+}
+
+// Returns 1 if the folder is cached and unchanged, without counting a hit
+int dirCacheIsValid(const char *path) {
+  SceDateTime mtime;
+  if (dirCacheGetMtime(path, &mtime) < 0)
+    return 0;
+
+  sceKernelLockLwMutex(&cache_mutex, 1, NULL);
+  int valid = findValidCacheEntry(path, &mtime) >= 0;
+  sceKernelUnlockLwMutex(&cache_mutex, 1);
+
+  return valid;
+}
+
+void dirCacheStore(FileList *list, SceDateTime *mtime, int prefetched) {
+  sceKernelLockLwMutex(&cache_mutex, 1, NULL);
+
+  int i = findCacheEntry(list->path);
+  if (i >= 0) {
+    // Not wasted, the listing is just replaced by a newer one
+    cache[i].prefetched = 0;
+    removeCacheEntry(i);
+  }
+
+  int n_records = 0, names_size = 0;
+
+  FileListEntry *entry = list->head;
+  while (entry) {
+    if (strcmp(entry->name, DIR_UP) != 0) {
+      n_records++;
+      names_size += entry->name_length + 1;
+    }
+
+    entry = entry->next;
+  }
+
+  int memory = n_records * sizeof(DirCacheRecord) + names_size;
+  if (memory > DIR_CACHE_MAX_MEMORY) {
+    sceKernelUnlockLwMutex(&cache_mutex, 1);
+    return;
+  }
+
+  while (n_cache > 0 && (n_cache >= DIR_CACHE_MAX_DIRS || cache_memory + memory > DIR_CACHE_MAX_MEMORY))
+    evictLeastRecentlyUsed();
+
+  DirCacheRecord *records = malloc(memory > 0 ? memory : 1);
+  if (!records) {
+    sceKernelUnlockLwMutex(&cache_mutex, 1);
+    return;
+  }
+
+  char *names = (char *)(records + n_records);
+  uint32_t name_offset = 0;
+
+  DirCacheRecord *record = records;
+
+  entry = list->head;
+  while (entry) {
+    if (strcmp(entry->name, DIR_UP) != 0) {
+      record->size = entry->size;
+      memcpy(&record->ctime, &entry->ctime, sizeof(SceDateTime));
+      memcpy(&record->mtime, &entry->mtime, sizeof(SceDateTime));
+      memcpy(&record->atime, &entry->atime, sizeof(SceDateTime));
+      record->name_offset = name_offset;
+      record->name_length = entry->name_length;
+      record->is_folder = entry->is_folder;
+      record->type = entry->type;
+
+      memcpy(names + name_offset, entry->name, entry->name_length + 1);
+      name_offset += entry->name_length + 1;
+      record++;
+    }
+
+    entry = entry->next;
+  }
+
+  DirCacheEntry *cache_entry = &cache[n_cache++];
+  strcpy(cache_entry->path, list->path);
+  memcpy(&cache_entry->mtime, mtime, sizeof(SceDateTime));
+  cache_entry->records = records;
+  cache_entry->n_records = n_records;
+  cache_entry->memory = memory;
+  cache_entry->last_use = ++use_counter;
+  cache_entry->prefetched = prefetched;
+
+  cache_memory += memory;
+
+  sceKernelUnlockLwMutex(&cache_mutex, 1);
+}
+
+void dirCacheInvalidate(const char *path) {
+  sceKernelLockLwMutex(&cache_mutex, 1, NULL);
+
+  int i = findCacheEntry(path);
+  if (i >= 0)
+    removeCacheEntry(i);
+
+  sceKernelUnlockLwMutex(&cache_mutex, 1);
+}
+
+void dirCacheClear() {
+  sceKernelLockLwMutex(&cache_mutex, 1, NULL);
+
+  while (n_cache > 0)
+    removeCacheEntry(n_cache - 1);
+
+  sceKernelUnlockLwMutex(&cache_mutex, 1);
+}
+
+void dirCacheGetStats(DirCacheStats *stats) {
+  sceKernelLockLwMutex(&cache_mutex, 1, NULL);
+
+  stats->hits = hits;
+  stats->misses = misses;
+  stats->prefetch_hits = prefetch_hits;
+  stats->prefetch_wasted = prefetch_wasted;
+  stats->n_dirs = n_cache;
+  stats->memory = cache_memory;
+
+  sceKernelUnlockLwMutex(&cache_mutex, 1);
+}
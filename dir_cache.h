@@ -0,0 +1,48 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __DIR_CACHE_H__
+#define __DIR_CACHE_H__
+
+#include "file.h"
+
+#define DIR_CACHE_MAX_DIRS 16
+#define DIR_CACHE_MAX_MEMORY (4 * 1024 * 1024)
+
+typedef struct {
+  int hits;
+  int misses;
+  int prefetch_hits;
+  int prefetch_wasted;
+  int n_dirs;
+  int memory;
+} DirCacheStats;
+
+void dirCacheInit();
+
+int dirCacheGetMtime(const char *path, SceDateTime *mtime);
+
+int dirCacheLookup(FileList *list, const char *path, int sort, SceDateTime *mtime);
+int dirCacheIsValid(const char *path);
+void dirCacheStore(FileList *list, SceDateTime *mtime, int prefetched);
+void dirCacheInvalidate(const char *path);
+void dirCacheClear();
+
+void dirCacheGetStats(DirCacheStats *stats);
+
+#endif
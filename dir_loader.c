@@ -0,0 +1,196 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "main.h"
+#include "dir_loader.h"
+#include "file.h"
+
+// Reads a directory in a thread, the browser takes the entries over in batches
+typedef struct {
+  SceUID thid;
+  SceUID dfd;
+  SceKernelLwMutexWork mutex;
+  FileList *list;
+  char path[MAX_PATH_LENGTH];
+  FileListArena arena; // Only used by the thread, handed over to the list when it ends
+  FileListEntry **pending;
+  int n_pending;
+  int max_pending;
+  volatile int count;
+  volatile int done;
+  volatile int abort;
+  int running;
+} DirLoader;
+
+static DirLoader loader = { .thid = -1, .dfd = -1 };
+
+static void pushEntries(FileListEntry **batch, int n) {
+  sceKernelLockLwMutex(&loader.mutex, 1, NULL);
+
+  if (loader.n_pending + n > loader.max_pending) {
+    int max_pending = MAX(loader.max_pending * 2, loader.n_pending + n);
+    FileListEntry **pending = realloc(loader.pending, max_pending * sizeof(FileListEntry *));
+    if (!pending) {
+      sceKernelUnlockLwMutex(&loader.mutex, 1);
+      return;
+    }
+
+    loader.pending = pending;
+    loader.max_pending = max_pending;
+  }
+
+  memcpy(loader.pending + loader.n_pending, batch, n * sizeof(FileListEntry *));
+  loader.n_pending += n;
+  loader.count += n;
+
+  sceKernelUnlockLwMutex(&loader.mutex, 1);
+}
+
+static int dir_loader_thread(SceSize args, void *argp) {
+  FileListEntry *batch[DIR_LOADER_BATCH];
+  int n = 0;
+
+  while (!loader.abort) {
+    SceIoDirent dir;
+    memset(&dir, 0, sizeof(SceIoDirent));
+
+    if (sceIoDread(loader.dfd, &dir) <= 0)
+      break;
+
+    FileListEntry *entry = fileListCreateDirectoryEntry(&loader.arena, loader.path, &dir);
+    if (!entry)
+      continue;
+
+    batch[n++] = entry;
+    if (n == DIR_LOADER_BATCH) {
+      pushEntries(batch, n);
+      n = 0;
+    }
+  }
+
+  if (n > 0)
+    pushEntries(batch, n);
+
+  sceIoDclose(loader.dfd);
+  loader.dfd = -1;
+
+  sceKernelLockLwMutex(&loader.mutex, 1, NULL);
+  loader.done = 1;
+  sceKernelUnlockLwMutex(&loader.mutex, 1);
+
+  return sceKernelExitThread(0);
+}
+
+static void stopThread() {
+  sceKernelWaitThreadEnd(loader.thid, NULL, NULL);
+  sceKernelDeleteThread(loader.thid);
+  loader.thid = -1;
+
+  // Entries that were not taken over yet are released with the list
+  fileListArenaMove(&loader.list->arena, &loader.arena);
+
+  free(loader.pending);
+  loader.pending = NULL;
+  loader.n_pending = 0;
+  loader.max_pending = 0;
+
+  sceKernelDeleteLwMutex(&loader.mutex);
+
+  loader.running = 0;
+}
+
+int dirLoaderStart(FileList *list, const char *path) {
+  dirLoaderCancel();
+
+  SceUID dfd = sceIoDopen(path);
+  if (dfd < 0)
+    return dfd;
+
+  fileListAddEntry(list, fileListCreateUpEntry(&list->arena), SORT_NONE);
+
+  loader.list = list;
+  strcpy(loader.path, path);
+  loader.dfd = dfd;
+  loader.count = 0;
+  loader.done = 0;
+  loader.abort = 0;
+
+  sceKernelCreateLwMutex(&loader.mutex, "dir_loader_mutex", 2, 0, NULL);
+
+  loader.thid = sceKernelCreateThread("dir_loader_thread", (SceKernelThreadEntry)dir_loader_thread, 0x10000100, 0x4000, 0, 0, NULL);
+  if (loader.thid < 0) {
+    sceKernelDeleteLwMutex(&loader.mutex);
+    sceIoDclose(dfd);
+    loader.dfd = -1;
+    return loader.thid;
+  }
+
+  loader.running = 1;
+  sceKernelStartThread(loader.thid, 0, NULL);
+
+  return 0;
+}
+
+// Returns 1 once all entries have been added to the list
+int dirLoaderUpdate(FileList *list) {
+  if (!loader.running)
+    return 0;
+
+  sceKernelLockLwMutex(&loader.mutex, 1, NULL);
+  FileListEntry **pending = loader.pending;
+  int n_pending = loader.n_pending;
+  int done = loader.done;
+  loader.pending = NULL;
+  loader.n_pending = 0;
+  loader.max_pending = 0;
+  sceKernelUnlockLwMutex(&loader.mutex, 1);
+
+  int i;
+  for (i = 0; i < n_pending; i++) {
+    if (pending[i]->is_folder)
+      list->folders++;
+    else
+      list->files++;
+
+    fileListAddEntry(list, pending[i], SORT_NONE);
+  }
+
+  free(pending);
+
+  if (!done)
+    return 0;
+
+  stopThread();
+  return 1;
+}
+
+void dirLoaderCancel() {
+  if (!loader.running)
+    return;
+
+  loader.abort = 1;
+  stopThread();
+}
+
+int dirLoaderIsRunning() {
+  return loader.running;
+}
+
+int dirLoaderGetCount() {
+  return loader.count;
+}
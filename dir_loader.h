@@ -0,0 +1,33 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __DIR_LOADER_H__
+#define __DIR_LOADER_H__
+
+#include "file.h"
+
+#define DIR_LOADER_BATCH 64
+
+int dirLoaderStart(FileList *list, const char *path);
+int dirLoaderUpdate(FileList *list);
+void dirLoaderCancel();
+
+int dirLoaderIsRunning();
+int dirLoaderGetCount();
+
+#endif
@@ -0,0 +1,198 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "main.h"
+#include "dir_prefetch.h"
+#include "dir_cache.h"
+#include "file.h"
+
+// Lists folders into the folder cache while the browser is idle. There is
+// only one worker, so it never reads more than one folder at a time
+typedef struct {
+  SceUID thid;
+  SceUID sema;
+  SceKernelLwMutexWork mutex;
+  char paths[DIR_PREFETCH_MAX_PATHS][MAX_PATH_LENGTH];
+  int n_paths;
+  volatile uint32_t generation;
+  volatile int exit;
+  int listed;
+  int canceled;
+} DirPrefetch;
+
+static DirPrefetch prefetch = { .thid = -1, .sema = -1 };
+
+static int isCanceled(uint32_t generation) {
+  return prefetch.exit || prefetch.generation != generation;
+}
+
+static void prefetchFolder(const char *path, uint32_t generation) {
+  // Nothing to do if the listing is still up to date
+  if (dirCacheIsValid(path))
+    return;
+
+  // The mtime is taken before reading, so changes while reading invalidate the listing
+  SceDateTime mtime;
+  if (dirCacheGetMtime(path, &mtime) < 0)
+    return;
+
+  SceUID dfd = sceIoDopen(path);
+  if (dfd < 0)
+    return;
+
+  FileList list;
+  memset(&list, 0, sizeof(FileList));
+  strcpy(list.path, path);
+
+  int res = 0;
+
+  while (1) {
+    if (isCanceled(generation) || list.length >= DIR_PREFETCH_MAX_ENTRIES) {
+      res = -1;
+      break;
+    }
+
+    SceIoDirent dir;
+    memset(&dir, 0, sizeof(SceIoDirent));
+
+    res = sceIoDread(dfd, &dir);
+    if (res <= 0)
+      break;
+
+    FileListEntry *entry = fileListCreateDirectoryEntry(&list.arena, path, &dir);
+    if (entry)
+      fileListAddEntry(&list, entry, SORT_NONE);
+  }
+
+  sceIoDclose(dfd);
+
+  // A canceled listing is not stored, a file operation may be about to change the folder
+  sceKernelLockLwMutex(&prefetch.mutex, 1, NULL);
+  if (res == 0 && !isCanceled(generation)) {
+    dirCacheStore(&list, &mtime, 1);
+    prefetch.listed++;
+  } else {
+    prefetch.canceled++;
+  }
+  sceKernelUnlockLwMutex(&prefetch.mutex, 1);
+
+  fileListEmpty(&list);
+}
+
+static int dir_prefetch_thread(SceSize args, void *argp) {
+  while (1) {
+    sceKernelWaitSema(prefetch.sema, 1, NULL);
+
+    if (prefetch.exit)
+      break;
+
+    while (1) {
+      char path[MAX_PATH_LENGTH];
+
+      sceKernelLockLwMutex(&prefetch.mutex, 1, NULL);
+      uint32_t generation = prefetch.generation;
+      int n_paths = prefetch.n_paths;
+      if (n_paths > 0) {
+        strcpy(path, prefetch.paths[0]);
+        memmove(prefetch.paths[0], prefetch.paths[1], (n_paths - 1) * MAX_PATH_LENGTH);
+        prefetch.n_paths--;
+      }
+      sceKernelUnlockLwMutex(&prefetch.mutex, 1);
+
+      if (n_paths == 0)
+        break;
+
+      prefetchFolder(path, generation);
+    }
+  }
+
+  return sceKernelExitThread(0);
+}
+
+void dirPrefetchInit() {
+  prefetch.sema = sceKernelCreateSema("dir_prefetch_sema", 0, 0, 1, NULL);
+  if (prefetch.sema < 0)
+    return;
+
+  sceKernelCreateLwMutex(&prefetch.mutex, "dir_prefetch_mutex", 2, 0, NULL);
+
+  // Lower priority than the main thread and the file operation threads
+  prefetch.thid = sceKernelCreateThread("dir_prefetch_thread", (SceKernelThreadEntry)dir_prefetch_thread, 0x10000120, 0x4000, 0, 0, NULL);
+  if (prefetch.thid < 0) {
+    sceKernelDeleteLwMutex(&prefetch.mutex);
+    sceKernelDeleteSema(prefetch.sema);
+    prefetch.sema = -1;
+    return;
+  }
+
+  sceKernelStartThread(prefetch.thid, 0, NULL);
+}
+
+void dirPrefetchExit() {
+  if (prefetch.thid < 0)
+    return;
+
+  prefetch.exit = 1;
+  sceKernelSignalSema(prefetch.sema, 1);
+
+  sceKernelWaitThreadEnd(prefetch.thid, NULL, NULL);
+  sceKernelDeleteThread(prefetch.thid);
+  prefetch.thid = -1;
+
+  sceKernelDeleteLwMutex(&prefetch.mutex);
+  sceKernelDeleteSema(prefetch.sema);
+  prefetch.sema = -1;
+}
+
+// Replaces the pending requests, the focused folder is listed first
+void dirPrefetchRequest(const char *folder, const char *parent) {
+  if (prefetch.thid < 0)
+    return;
+
+  sceKernelLockLwMutex(&prefetch.mutex, 1, NULL);
+
+  prefetch.generation++;
+  prefetch.n_paths = 0;
+
+  if (folder)
+    strcpy(prefetch.paths[prefetch.n_paths++], folder);
+  if (parent)
+    strcpy(prefetch.paths[prefetch.n_paths++], parent);
+
+  sceKernelUnlockLwMutex(&prefetch.mutex, 1);
+
+  sceKernelSignalSema(prefetch.sema, 1);
+}
+
+// Once this returns, no listing that was in progress will be stored anymore
+void dirPrefetchCancel() {
+  if (prefetch.thid < 0)
+    return;
+
+  sceKernelLockLwMutex(&prefetch.mutex, 1, NULL);
+  prefetch.generation++;
+  prefetch.n_paths = 0;
+  sceKernelUnlockLwMutex(&prefetch.mutex, 1);
+}
+
+void dirPrefetchGetStats(DirPrefetchStats *stats) {
+  sceKernelLockLwMutex(&prefetch.mutex, 1, NULL);
+  stats->listed = prefetch.listed;
+  stats->canceled = prefetch.canceled;
+  sceKernelUnlockLwMutex(&prefetch.mutex, 1);
+}
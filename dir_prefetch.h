@@ -0,0 +1,39 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __DIR_PREFETCH_H__
+#define __DIR_PREFETCH_H__
+
+#define DIR_PREFETCH_DELAY (150 * 1000) // How long the cursor rests before prefetching
+#define DIR_PREFETCH_MAX_ENTRIES 4096   // Bigger folders are left to the regular listing
+#define DIR_PREFETCH_MAX_PATHS 2
+
+typedef struct {
+  int listed;
+  int canceled;
+} DirPrefetchStats;
+
+void dirPrefetchInit();
+void dirPrefetchExit();
+
+void dirPrefetchRequest(const char *folder, const char *parent);
+void dirPrefetchCancel();
+
+void dirPrefetchGetStats(DirPrefetchStats *stats);
+
+#endif
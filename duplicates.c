@@ -0,0 +1,812 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "main.h"
+#include "duplicates.h"
+#include "file.h"
+#include "hash.h"
+#include "search.h"
+#include "message_dialog.h"
+#include "language.h"
+#include "theme.h"
+#include "utils.h"
+#include "sqlite3.h"
+
+/*
+  Files are compared in stages so most of them are never read completely:
+  only files of the same size get a hash of their first and last 64 KB, and
+  only files whose partial hashes match get a full hash. Hashes are cached
+  by path, size and mtime.
+*/
+
+static char *cache_schema =
+  "CREATE TABLE IF NOT EXISTS hashes(path TEXT PRIMARY KEY, size INTEGER, mtime INTEGER, partial BLOB, full BLOB);";
+
+enum DuplicatesStatements {
+  STMT_GET_HASHES,
+  STMT_PUT_HASHES,
+  STMT_DELETE_HASHES,
+  N_STMTS,
+};
+
+static char *statements[N_STMTS] = {
+  "SELECT size, mtime, partial, full FROM hashes WHERE path = ?",
+  "INSERT OR REPLACE INTO hashes VALUES(?, ?, ?, ?, ?)",
+  "DELETE FROM hashes WHERE path = ?",
+};
+
+typedef struct {
+  char roots[DUPLICATES_MAX_ROOTS][MAX_PATH_LENGTH];
+  int n_roots;
+
+  DuplicateFile *files;
+  int n_files;
+  int max_files;
+
+  DuplicateGroup *groups;
+  int n_groups;
+
+  sqlite3 *db;
+  sqlite3_stmt *stmts[N_STMTS];
+
+  SceUID thid;
+  volatile int stage;
+  volatile int progress;
+  volatile int total;
+  volatile int abort;
+  int error;
+} Duplicates;
+
+static Duplicates duplicates;
+
+static uint64_t getTick(SceDateTime *time) {
+  SceRtcTick tick;
+  sceRtcGetTick(time, &tick);
+  return tick.tick;
+}
+
+static int openCache() {
+  int rc = sqlite3_open_v2(DUPLICATES_CACHE_FILE, &duplicates.db, SQLITE_OPEN_CREATE | SQLITE_OPEN_READWRITE, NULL);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_exec(duplicates.db, "PRAGMA journal_mode = MEMORY; PRAGMA synchronous = OFF;", NULL, NULL, NULL);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_exec(duplicates.db, cache_schema, NULL, NULL, NULL);
+
+  int i;
+  for (i = 0; i < N_STMTS && rc == SQLITE_OK; i++)
+    rc = sqlite3_prepare_v2(duplicates.db, statements[i], -1, &duplicates.stmts[i], NULL);
+
+  if (rc != SQLITE_OK) {
+    for (i = 0; i < N_STMTS; i++) {
+      sqlite3_finalize(duplicates.stmts[i]);
+      duplicates.stmts[i] = NULL;
+    }
+
+    sqlite3_close(duplicates.db);
+    duplicates.db = NULL;
+    return -1;
+  }
+
+  return 0;
+}
+
+static void closeCache() {
+  int i;
+  for (i = 0; i < N_STMTS; i++) {
+    sqlite3_finalize(duplicates.stmts[i]);
+    duplicates.stmts[i] = NULL;
+  }
+
+  sqlite3_close(duplicates.db);
+  duplicates.db = NULL;
+}
+
+// Takes the hashes of an unchanged file from the cache
+static void getCachedHashes(DuplicateFile *file) {
+  if (!duplicates.db)
+    return;
+
+  sqlite3_stmt *stmt = duplicates.stmts[STMT_GET_HASHES];
+  sqlite3_bind_text(stmt, 1, file->path, -1, SQLITE_STATIC);
+
+  if (sqlite3_step(stmt) == SQLITE_ROW &&
+      (uint64_t)sqlite3_column_int64(stmt, 0) == file->size &&
+      (uint64_t)sqlite3_column_int64(stmt, 1) == file->mtime) {
+    if (sqlite3_column_bytes(stmt, 2) == SHA1_BLOCK_SIZE) {
+      memcpy(file->partial, sqlite3_column_blob(stmt, 2), SHA1_BLOCK_SIZE);
+      file->has_partial = 1;
+    }
+
+    if (sqlite3_column_bytes(stmt, 3) == SHA1_BLOCK_SIZE) {
+      memcpy(file->full, sqlite3_column_blob(stmt, 3), SHA1_BLOCK_SIZE);
+      file->has_full = 1;
+    }
+  }
+
+  sqlite3_reset(stmt);
+}
+
+static void putCachedHashes(DuplicateFile *file) {
+  if (!duplicates.db)
+    return;
+
+  sqlite3_stmt *stmt = duplicates.stmts[STMT_PUT_HASHES];
+  sqlite3_bind_text(stmt, 1, file->path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, file->size);
+  sqlite3_bind_int64(stmt, 3, file->mtime);
+  sqlite3_bind_blob(stmt, 4, file->partial, file->has_partial ? SHA1_BLOCK_SIZE : 0, SQLITE_STATIC);
+  sqlite3_bind_blob(stmt, 5, file->full, file->has_full ? SHA1_BLOCK_SIZE : 0, SQLITE_STATIC);
+  sqlite3_step(stmt);
+  sqlite3_reset(stmt);
+}
+
+static void deleteCachedHashes(DuplicateFile *file) {
+  if (!duplicates.db)
+    return;
+
+  sqlite3_stmt *stmt = duplicates.stmts[STMT_DELETE_HASHES];
+  sqlite3_bind_text(stmt, 1, file->path, -1, SQLITE_STATIC);
+  sqlite3_step(stmt);
+  sqlite3_reset(stmt);
+}
+
+static int addFile(const char *path, SceIoStat *stat) {
+  if (duplicates.n_files == duplicates.max_files) {
+    int max_files = duplicates.max_files ? duplicates.max_files * 2 : 1024;
+    DuplicateFile *files = realloc(duplicates.files, max_files * sizeof(DuplicateFile));
+    if (!files)
+      return HASH_ERROR_NO_MEMORY;
+
+    duplicates.files = files;
+    duplicates.max_files = max_files;
+  }
+
+  char *copy = malloc(strlen(path) + 1);
+  if (!copy)
+    return HASH_ERROR_NO_MEMORY;
+
+  strcpy(copy, path);
+
+  DuplicateFile *file = &duplicates.files[duplicates.n_files++];
+  memset(file, 0, sizeof(DuplicateFile));
+  file->path = copy;
+  file->size = stat->st_size;
+  file->mtime = getTick((SceDateTime *)&stat->st_mtime);
+
+  return 0;
+}
+
+static int scanFolder(const char *path) {
+  SceUID dfd = sceIoDopen(path);
+  if (dfd < 0)
+    return 0;
+
+  // Same form as the browser and the search index, 'ux0:app/x' and not 'ux0:/app/x'
+  int length = strlen(path);
+  char *separator = (length > 0 && (path[length - 1] == '/' || path[length - 1] == ':')) ? "" : "/";
+
+  int res = 0;
+
+  do {
+    SceIoDirent dir;
+    memset(&dir, 0, sizeof(SceIoDirent));
+
+    res = sceIoDread(dfd, &dir);
+    if (res > 0) {
+      char new_path[MAX_PATH_LENGTH];
+      snprintf(new_path, MAX_PATH_LENGTH, "%s%s%s", path, separator, dir.d_name);
+
+      if (SCE_S_ISDIR(dir.d_stat.st_mode)) {
+        int ret = scanFolder(new_path);
+        if (ret < 0) {
+          res = ret;
+          break;
+        }
+      } else if (dir.d_stat.st_size > 0) {
+        int ret = addFile(new_path, &dir.d_stat);
+        if (ret < 0) {
+          res = ret;
+          break;
+        }
+
+        duplicates.progress = duplicates.n_files;
+      }
+    }
+  } while (res > 0 && !duplicates.abort);
+
+  sceIoDclose(dfd);
+
+  return res;
+}
+
+static int readFull(SceUID fd, uint8_t *buffer, int size) {
+  int total = 0;
+
+  while (total < size) {
+    int read = sceIoRead(fd, buffer + total, size - total);
+    if (read < 0)
+      return read;
+    if (read == 0)
+      break;
+
+    total += read;
+  }
+
+  return total;
+}
+
+// Small files are read completely, which also gives their full hash
+static int hashPartial(DuplicateFile *file) {
+  SceUID fd = sceIoOpen(file->path, SCE_O_RDONLY, 0);
+  if (fd < 0)
+    return fd;
+
+  uint8_t *buffer = malloc(DUPLICATES_PARTIAL_SIZE);
+  if (!buffer) {
+    sceIoClose(fd);
+    return HASH_ERROR_NO_MEMORY;
+  }
+
+  HashContext ctx;
+  hashInit(&ctx, HASH_SHA1);
+
+  int res = readFull(fd, buffer, DUPLICATES_PARTIAL_SIZE);
+  if (res >= 0) {
+    hashUpdate(&ctx, buffer, res);
+
+    if (file->size > 2 * DUPLICATES_PARTIAL_SIZE)
+      sceIoLseek(fd, file->size - DUPLICATES_PARTIAL_SIZE, SCE_SEEK_SET);
+
+    if (file->size > DUPLICATES_PARTIAL_SIZE) {
+      res = readFull(fd, buffer, DUPLICATES_PARTIAL_SIZE);
+      if (res >= 0)
+        hashUpdate(&ctx, buffer, res);
+    }
+  }
+
+  free(buffer);
+  sceIoClose(fd);
+
+  if (res < 0)
+    return res;
+
+  HashDigests digests;
+  hashFinal(&ctx, &digests);
+
+  memcpy(file->partial, digests.sha1, SHA1_BLOCK_SIZE);
+  file->has_partial = 1;
+
+  if (file->size <= 2 * DUPLICATES_PARTIAL_SIZE) {
+    memcpy(file->full, digests.sha1, SHA1_BLOCK_SIZE);
+    file->has_full = 1;
+  }
+
+  return 0;
+}
+
+static int duplicatesCancelHandler() {
+  return duplicates.abort;
+}
+
+static int hashFull(DuplicateFile *file) {
+  uint64_t value = 0;
+
+  FileProcessParam param;
+  param.value = &value;
+  param.max = file->size;
+  param.SetProgress = NULL;
+  param.cancelHandler = duplicatesCancelHandler;
+
+  HashDigests digests;
+  int res = getFileHashes(file->path, HASH_SHA1, &digests, &param);
+  if (res <= 0)
+    return res;
+
+  memcpy(file->full, digests.sha1, SHA1_BLOCK_SIZE);
+  file->has_full = 1;
+
+  return 0;
+}
+
+// Candidates first, largest files first, then by the hash of the stage
+static int cmpPartial(const void *pa, const void *pb) {
+  const DuplicateFile *a = pa, *b = pb;
+
+  if (a->candidate != b->candidate)
+    return b->candidate - a->candidate;
+  if (a->size != b->size)
+    return a->size < b->size ? 1 : -1;
+
+  return memcmp(a->partial, b->partial, SHA1_BLOCK_SIZE);
+}
+
+static int cmpFull(const void *pa, const void *pb) {
+  const DuplicateFile *a = pa, *b = pb;
+
+  if (a->candidate != b->candidate)
+    return b->candidate - a->candidate;
+  if (a->size != b->size)
+    return a->size < b->size ? 1 : -1;
+
+  return memcmp(a->full, b->full, SHA1_BLOCK_SIZE);
+}
+
+// Keeps the files that are equal to a neighbour as candidates
+static int markCandidates(int (* cmp)(const void *a, const void *b)) {
+  int n_candidates = 0;
+
+  int start = 0;
+  while (start < duplicates.n_files && duplicates.files[start].candidate) {
+    int end = start + 1;
+    while (end < duplicates.n_files && duplicates.files[end].candidate &&
+           cmp(&duplicates.files[start], &duplicates.files[end]) == 0)
+      end++;
+
+    int i;
+    for (i = start; i < end; i++)
+      duplicates.files[i].candidate = (end - start) > 1;
+
+    if ((end - start) > 1)
+      n_candidates += end - start;
+
+    start = end;
+  }
+
+  return n_candidates;
+}
+
+static int hashCandidates(int full) {
+  duplicates.progress = 0;
+
+  int i;
+  for (i = 0; i < duplicates.n_files && !duplicates.abort; i++) {
+    DuplicateFile *file = &duplicates.files[i];
+    if (!file->candidate)
+      continue;
+
+    if (!file->has_partial)
+      getCachedHashes(file);
+
+    int res = 0;
+    if (!full && !file->has_partial) {
+      res = hashPartial(file);
+      if (res == 0)
+        putCachedHashes(file);
+    } else if (full && !file->has_full) {
+      res = hashFull(file);
+      if (res == 0)
+        putCachedHashes(file);
+    }
+
+    // Unreadable files are left out
+    if (res < 0)
+      file->candidate = 0;
+
+    duplicates.progress++;
+  }
+
+  return duplicates.abort ? 0 : 1;
+}
+
+static void buildGroups() {
+  int n_groups = 0;
+
+  int i;
+  for (i = 0; i < duplicates.n_files && duplicates.files[i].candidate; i++) {
+    if (i == 0 || cmpFull(&duplicates.files[i - 1], &duplicates.files[i]) != 0)
+      n_groups++;
+  }
+
+  duplicates.groups = malloc(n_groups * sizeof(DuplicateGroup));
+  if (!duplicates.groups)
+    return;
+
+  for (i = 0; i < duplicates.n_files && duplicates.files[i].candidate; i++) {
+    if (i == 0 || cmpFull(&duplicates.files[i - 1], &duplicates.files[i]) != 0) {
+      duplicates.groups[duplicates.n_groups].start = i;
+      duplicates.groups[duplicates.n_groups].count = 0;
+      duplicates.n_groups++;
+    }
+
+    duplicates.groups[duplicates.n_groups - 1].count++;
+  }
+}
+
+static int duplicates_thread(SceSize args, void *argp) {
+  int i;
+
+  // Walk all roots
+  for (i = 0; i < duplicates.n_roots && !duplicates.abort; i++) {
+    int res = scanFolder(duplicates.roots[i]);
+    if (res < 0) {
+      duplicates.error = res;
+      goto EXIT;
+    }
+  }
+
+  if (duplicates.abort)
+    goto EXIT;
+
+  if (duplicates.db)
+    sqlite3_exec(duplicates.db, "BEGIN", NULL, NULL, NULL);
+
+  // Group by size
+  for (i = 0; i < duplicates.n_files; i++)
+    duplicates.files[i].candidate = 1;
+
+  qsort(duplicates.files, duplicates.n_files, sizeof(DuplicateFile), cmpPartial);
+  duplicates.total = markCandidates(cmpPartial);
+
+  // Group by the hash of the first and last 64 KB
+  duplicates.stage = DUPLICATES_STAGE_PARTIAL;
+  if (hashCandidates(0)) {
+    qsort(duplicates.files, duplicates.n_files, sizeof(DuplicateFile), cmpPartial);
+    duplicates.total = markCandidates(cmpPartial);
+
+    // Group by the full hash
+    duplicates.stage = DUPLICATES_STAGE_FULL;
+    if (hashCandidates(1)) {
+      qsort(duplicates.files, duplicates.n_files, sizeof(DuplicateFile), cmpFull);
+      markCandidates(cmpFull);
+      buildGroups();
+    }
+  }
+
+  if (duplicates.db)
+    sqlite3_exec(duplicates.db, "COMMIT", NULL, NULL, NULL);
+
+EXIT:
+  duplicates.stage = DUPLICATES_STAGE_DONE;
+
+  return sceKernelExitThread(0);
+}
+
+static int startDuplicates(const char *path) {
+  memset(&duplicates, 0, sizeof(Duplicates));
+  duplicates.thid = -1;
+
+  // All storages from home
+  if (strcasecmp(path, HOME_PATH) == 0) {
+    static char *roots[] = { "ux0:", "uma0:", "imc0:" };
+
+    int i;
+    for (i = 0; i < sizeof(roots) / sizeof(char *); i++) {
+      if (checkFolderExist(roots[i]))
+        strcpy(duplicates.roots[duplicates.n_roots++], roots[i]);
+    }
+  } else {
+    strcpy(duplicates.roots[duplicates.n_roots++], path);
+  }
+
+  // Compare without the cache if it cannot be opened
+  openCache();
+
+  duplicates.thid = sceKernelCreateThread("duplicates_thread", (SceKernelThreadEntry)duplicates_thread, 0x10000100, 0x40000, 0, 0, NULL);
+  if (duplicates.thid < 0) {
+    closeCache();
+    return duplicates.thid;
+  }
+
+  sceKernelStartThread(duplicates.thid, 0, NULL);
+
+  return 0;
+}
+
+static void stopDuplicates() {
+  duplicates.abort = 1;
+
+  sceKernelWaitThreadEnd(duplicates.thid, NULL, NULL);
+  sceKernelDeleteThread(duplicates.thid);
+  duplicates.thid = -1;
+
+  closeCache();
+
+  int i;
+  for (i = 0; i < duplicates.n_files; i++)
+    free(duplicates.files[i].path);
+
+  free(duplicates.files);
+  free(duplicates.groups);
+}
+
+// A row is a file, or a group header if negative
+static int buildRows(int *rows, int *n_groups, uint64_t *freeable) {
+  int n_rows = 0;
+  *n_groups = 0;
+  *freeable = 0;
+
+  int i, j;
+  for (i = 0; i < duplicates.n_groups; i++) {
+    DuplicateGroup *group = &duplicates.groups[i];
+
+    int count = 0;
+    for (j = group->start; j < group->start + group->count; j++) {
+      if (!duplicates.files[j].deleted)
+        count++;
+    }
+
+    // Not a duplicate anymore
+    if (count < 2)
+      continue;
+
+    *freeable += (count - 1) * duplicates.files[group->start].size;
+    (*n_groups)++;
+
+    if (rows)
+      rows[n_rows] = -(i + 1);
+    n_rows++;
+
+    for (j = group->start; j < group->start + group->count; j++) {
+      if (!duplicates.files[j].deleted) {
+        if (rows)
+          rows[n_rows] = j;
+        n_rows++;
+      }
+    }
+  }
+
+  return n_rows;
+}
+
+// Marks all files but the first one of each group
+static void markDuplicates() {
+  int i, j;
+  for (i = 0; i < duplicates.n_groups; i++) {
+    DuplicateGroup *group = &duplicates.groups[i];
+
+    int first = 1;
+    for (j = group->start; j < group->start + group->count; j++) {
+      if (!duplicates.files[j].deleted) {
+        duplicates.files[j].marked = !first;
+        first = 0;
+      }
+    }
+  }
+}
+
+static DuplicateGroup *getGroup(int file) {
+  int i;
+  for (i = 0; i < duplicates.n_groups; i++) {
+    DuplicateGroup *group = &duplicates.groups[i];
+    if (file >= group->start && file < group->start + group->count)
+      return group;
+  }
+
+  return NULL;
+}
+
+static int countKept(DuplicateGroup *group) {
+  int count = 0, i;
+  for (i = group->start; i < group->start + group->count; i++) {
+    if (!duplicates.files[i].deleted && !duplicates.files[i].marked)
+      count++;
+  }
+
+  return count;
+}
+
+// The last unmarked file of a group can't be marked
+static void toggleMark(int file) {
+  DuplicateFile *entry = &duplicates.files[file];
+  DuplicateGroup *group = getGroup(file);
+
+  if (!entry->marked && (!group || countKept(group) <= 1))
+    return;
+
+  entry->marked = !entry->marked;
+}
+
+// Deletes the marked files, but always keeps one file of each group
+static void deleteMarked() {
+  char **removed = malloc(duplicates.n_files * sizeof(char *));
+  int n_removed = 0;
+
+  int i, j;
+  for (i = 0; i < duplicates.n_groups; i++) {
+    DuplicateGroup *group = &duplicates.groups[i];
+
+    if (countKept(group) == 0) {
+      for (j = group->start; j < group->start + group->count; j++) {
+        if (!duplicates.files[j].deleted) {
+          duplicates.files[j].marked = 0;
+          break;
+        }
+      }
+    }
+
+    for (j = group->start; j < group->start + group->count; j++) {
+      DuplicateFile *file = &duplicates.files[j];
+      if (!file->marked || file->deleted)
+        continue;
+
+      if (removePath(file->path, NULL) >= 0) {
+        file->deleted = 1;
+        deleteCachedHashes(file);
+
+        if (removed)
+          removed[n_removed++] = file->path;
+      }
+
+      file->marked = 0;
+    }
+  }
+
+  if (removed) {
+    searchIndexRemoveFiles(removed, n_removed);
+    free(removed);
+  }
+}
+
+// Returns 1 and the path of the chosen file, 0 if closed
+int duplicatesViewer(const char *path, char *result) {
+  int res = startDuplicates(path);
+  if (res < 0)
+    return res;
+
+  int *rows = NULL;
+  int n_rows = 0, n_groups = 0;
+  uint64_t freeable = 0;
+
+  int base_pos = 0, rel_pos = 0;
+  int ret = 0;
+
+  while (1) {
+    readPad();
+
+    int done = duplicates.stage == DUPLICATES_STAGE_DONE;
+    int dialog_running = isMessageDialogRunning();
+
+    // The groups are complete, list them
+    if (done && !rows && duplicates.n_groups > 0) {
+      n_rows = buildRows(NULL, &n_groups, &freeable);
+      rows = malloc(n_rows * sizeof(int));
+      if (rows)
+        buildRows(rows, &n_groups, &freeable);
+      else
+        n_rows = 0;
+    }
+
+    if (!dialog_running) {
+      if (hold_pad[PAD_UP] || hold2_pad[PAD_LEFT_ANALOG_UP]) {
+        if (rel_pos > 0) {
+          rel_pos--;
+        } else if (base_pos > 0) {
+          base_pos--;
+        }
+      } else if (hold_pad[PAD_DOWN] || hold2_pad[PAD_LEFT_ANALOG_DOWN]) {
+        if ((base_pos + rel_pos + 1) < n_rows) {
+          if ((rel_pos + 1) < MAX_POSITION) {
+            rel_pos++;
+          } else {
+            base_pos++;
+          }
+        }
+      }
+
+      int row = (base_pos + rel_pos < n_rows) ? rows[base_pos + rel_pos] : -1;
+
+      // Mark file
+      if (pressed_pad[PAD_SQUARE] && row >= 0)
+        toggleMark(row);
+
+      // Keep one file of each group
+      if (pressed_pad[PAD_TRIANGLE] && n_rows > 0)
+        markDuplicates();
+
+      // Delete marked files
+      if (pressed_pad[PAD_START] && n_rows > 0) {
+        initMessageDialog(SCE_MSG_DIALOG_BUTTON_TYPE_YESNO, language_container[DELETE_FILES_FOLDERS_QUESTION]);
+      }
+
+      if (pressed_pad[PAD_ENTER] && row >= 0) {
+        strcpy(result, duplicates.files[row].path);
+        ret = 1;
+      }
+    } else {
+      int msg_result = updateMessageDialog();
+      if (msg_result == MESSAGE_DIALOG_RESULT_YES) {
+        deleteMarked();
+
+        n_rows = buildRows(rows, &n_groups, &freeable);
+      }
+    }
+
+    if (base_pos + rel_pos >= n_rows) {
+      base_pos = MAX(0, n_rows - MAX_POSITION);
+      rel_pos = MAX(0, n_rows - 1 - base_pos);
+    }
+
+    // Start drawing
+    startDrawing(bg_browser_image);
+
+    // Draw shell info
+    drawShellInfo(language_container[FIND_DUPLICATES]);
+
+    // Draw scroll bar
+    drawScrollBar(base_pos, n_rows);
+
+    // Status
+    char size_string[16];
+
+    switch (duplicates.stage) {
+      case DUPLICATES_STAGE_SCAN:
+        pgf_draw_textf(SHELL_MARGIN_X, START_Y, PATH_COLOR, language_container[DUPLICATES_SCANNING], duplicates.progress);
+        break;
+
+      case DUPLICATES_STAGE_PARTIAL:
+      case DUPLICATES_STAGE_FULL:
+        pgf_draw_textf(SHELL_MARGIN_X, START_Y, PATH_COLOR, language_container[DUPLICATES_COMPARING],
+                       duplicates.progress, duplicates.total);
+        break;
+
+      case DUPLICATES_STAGE_DONE:
+        if (duplicates.error < 0) {
+          pgf_draw_textf(SHELL_MARGIN_X, START_Y, PATH_COLOR, "0x%08X", duplicates.error);
+        } else {
+          getSizeString(size_string, freeable);
+          pgf_draw_textf(SHELL_MARGIN_X, START_Y, PATH_COLOR, language_container[DUPLICATES_DONE],
+                         n_groups, size_string);
+        }
+        break;
+    }
+
+    // Groups
+    int i;
+    for (i = 0; i < MAX_POSITION && (base_pos + i) < n_rows; i++) {
+      float y = START_Y + ((i + 1) * FONT_Y_SPACE);
+      int row = rows[base_pos + i];
+
+      if (row < 0) {
+        DuplicateGroup *group = &duplicates.groups[-row - 1];
+
+        int count = 0, j;
+        for (j = group->start; j < group->start + group->count; j++) {
+          if (!duplicates.files[j].deleted)
+            count++;
+        }
+
+        getSizeString(size_string, duplicates.files[group->start].size);
+        pgf_draw_textf(SHELL_MARGIN_X, y, i == rel_pos ? FOCUS_COLOR : FOLDER_COLOR,
+                       language_container[DUPLICATES_GROUP], count, size_string);
+        continue;
+      }
+
+      DuplicateFile *file = &duplicates.files[row];
+
+      if (file->marked)
+        vita2d_draw_rectangle(SHELL_MARGIN_X, y + 3.0f, MARK_WIDTH, FONT_Y_SPACE, MARKED_COLOR);
+
+      vita2d_enable_clipping();
+      vita2d_set_clip_rectangle(SHELL_MARGIN_X, y, SCREEN_WIDTH - SHELL_MARGIN_X, y + FONT_Y_SPACE);
+      pgf_draw_text(SHELL_MARGIN_X + FONT_Y_SPACE, y, i == rel_pos ? FOCUS_COLOR : FILE_COLOR, file->path);
+      vita2d_disable_clipping();
+    }
+
+    // End drawing
+    endDrawing();
+
+    if (ret || (pressed_pad[PAD_CANCEL] && !dialog_running))
+      break;
+  }
+
+  free(rows);
+
+  stopDuplicates();
+
+  return ret;
+}
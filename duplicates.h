@@ -0,0 +1,57 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __DUPLICATES_H__
+#define __DUPLICATES_H__
+
+#include "file.h"
+#include "hash.h"
+
+#define DUPLICATES_CACHE_FILE "ux0:VitaShell/internal/hash_cache.db"
+
+#define DUPLICATES_PARTIAL_SIZE (64 * 1024)
+#define DUPLICATES_MAX_ROOTS 4
+
+enum DuplicatesStages {
+  DUPLICATES_STAGE_SCAN,
+  DUPLICATES_STAGE_PARTIAL,
+  DUPLICATES_STAGE_FULL,
+  DUPLICATES_STAGE_DONE,
+};
+
+typedef struct {
+  char *path;
+  uint64_t size;
+  uint64_t mtime;
+  uint8_t partial[SHA1_BLOCK_SIZE]; // First and last 64 KB, the whole file if smaller
+  uint8_t full[SHA1_BLOCK_SIZE];
+  uint8_t has_partial;
+  uint8_t has_full;
+  uint8_t candidate;
+  uint8_t marked;
+  uint8_t deleted;
+} DuplicateFile;
+
+typedef struct {
+  int start; // Members are consecutive in the files
+  int count;
+} DuplicateGroup;
+
+int duplicatesViewer(const char *path, char *result);
+
+#endif
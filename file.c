@@ -20,8 +20,9 @@
 #include "init.h"
 #include "archive.h"
 #include "file.h"
+#include "transfer.h"
+#include "io_profile.h"
 #include "utils.h"
-#include "sha1.h"
 #include "strnatcmp.h"
 
 static char *devices[] = {
@@ -45,6 +46,8 @@ static char *devices[] = {
 
 #define N_DEVICES (sizeof(devices) / sizeof(char **))
 
+#define FILE_LIST_HASH_THRESHOLD 16
+
 int allocateReadFile(const char *file, void **buffer) {
   SceUID fd = sceIoOpen(file, SCE_O_RDONLY, 0);
   if (fd < 0)
@@ -116,68 +119,6 @@ int checkFolderExist(const char *folder) {
   return 1;
 }
 
-int getFileSha1(const char *file, uint8_t *pSha1Out, FileProcessParam *param) {
-  // Set up SHA1 context
-  SHA1_CTX ctx;
-  sha1_init(&ctx);
-
-  // Open the file to read, else return the error
-  SceUID fd = sceIoOpen(file, SCE_O_RDONLY, 0);
-  if (fd < 0)
-    return fd;
-
-  // Open up the buffer for copying data into
-  void *buf = memalign(4096, TRANSFER_SIZE);
-
-  // Actually take the SHA1 sum
-  while (1) {
-    int read = sceIoRead(fd, buf, TRANSFER_SIZE);
-
-    if (read < 0) {
-      free(buf);
-      sceIoClose(fd);
-      return read;
-    }
-
-    if (read == 0)
-      break;
-
-    sha1_update(&ctx, buf, read);
-
-    if (param) {
-      // Defined in io_process.c, check to make sure pointer isn't null before incrementing
-      if (param->value)
-        (*param->value)++; // Note: Max value is filesize/TRANSFER_SIZE
-
-      if (param->SetProgress)
-        param->SetProgress(param->value ? *param->value : 0, param->max);
-
-      // Check to see if param->cancelHandler exists, if so call it and free memory if canceled
-      if (param->cancelHandler && param->cancelHandler()) {
-        free(buf);
-        sceIoClose(fd);
-        return 0;
-      }
-
-      // This is CPU intensive so the progress bar won't refresh unless we sleep
-      // DIALOG_WAIT seemed too long for this application
-      // so I set it to 1/2 of a second every 8192 TRANSFER_SIZE blocks
-      if ((*param->value) % 8192 == 0)
-        sceKernelDelayThread(500000);
-    }
-  }
-
-  // Final iteration of SHA1 sum, dump final value into pSha1Out buffer
-  sha1_final(&ctx, pSha1Out);
-
-  // Free up file buffer
-  free(buf);
-
-  // Close file proper
-  sceIoClose(fd);
-  return 1;
-}
-
 int getPathInfo(const char *path, uint64_t *size, uint32_t *folders, uint32_t *files, int (* handler)(const char *path)) {
   SceUID dfd = sceIoDopen(path);
   if (dfd >= 0) {
@@ -328,6 +269,10 @@ int removePath(const char *path, FileProcessParam *param) {
   return 1;
 }
 
+static int readFd(void *argp, void *data, SceSize size) {
+  return sceIoRead(*(SceUID *)argp, data, size);
+}
+
 int copyFile(const char *src_path, const char *dst_path, FileProcessParam *param) {
   // The source and destination paths are identical
   if (strcasecmp(src_path, dst_path) == 0) {
@@ -350,64 +295,23 @@ int copyFile(const char *src_path, const char *dst_path, FileProcessParam *param
     return fddst;
   }
 
-  void *buf = memalign(4096, TRANSFER_SIZE);
-
-  while (1) {
-    int read = sceIoRead(fdsrc, buf, TRANSFER_SIZE);
-
-    if (read < 0) {
-      free(buf);
-
-      sceIoClose(fddst);
-      sceIoClose(fdsrc);
-
-      sceIoRemove(dst_path);
-
-      return read;
-    }
-
-    if (read == 0)
-      break;
-
-    int written = sceIoWrite(fddst, buf, read);
-
-    if (written < 0) {
-      free(buf);
-
-      sceIoClose(fddst);
-      sceIoClose(fdsrc);
-
-      sceIoRemove(dst_path);
-
-      return written;
-    }
-
-    if (param) {
-      if (param->value)
-        (*param->value) += read;
-
-      if (param->SetProgress)
-        param->SetProgress(param->value ? *param->value : 0, param->max);
-
-      if (param->cancelHandler && param->cancelHandler()) {
-        free(buf);
+  SceIoStat stat;
+  memset(&stat, 0, sizeof(SceIoStat));
+  sceIoGetstatByFd(fdsrc, &stat);
 
-        sceIoClose(fddst);
-        sceIoClose(fdsrc);
+  // Read and write are overlapped
+  int res = transferFile(readFd, &fdsrc, fddst, stat.st_size,
+                         ioProfileGetTransferSize(src_path, dst_path), param);
+  if (res <= 0) {
+    sceIoClose(fddst);
+    sceIoClose(fdsrc);
 
-        sceIoRemove(dst_path);
+    sceIoRemove(dst_path);
 
-        return 0;
-      }
-    }
+    return res;
   }
 
-  free(buf);
-
   // Inherit file stat
-  SceIoStat stat;
-  memset(&stat, 0, sizeof(SceIoStat));
-  sceIoGetstatByFd(fdsrc, &stat);
   sceIoChstatByFd(fddst, &stat, 0x3B);
 
   sceIoClose(fddst);
@@ -648,20 +552,179 @@ static ExtensionType extension_types[] = {
   { ".ZST",      FILE_TYPE_ARCHIVE },
 };
 
+#define N_EXTENSION_TYPES (sizeof(extension_types) / sizeof(ExtensionType))
+
+// Open addressed index of extension_types, filled by initFileTypes
+static uint64_t extension_keys[FILE_TYPE_HASH_SIZE];
+static uint8_t extension_slots[FILE_TYPE_HASH_SIZE]; // Index + 1, 0 if empty
+static int extension_index_ready = 0;
+
+// Sniffed types by path and mtime
+typedef struct {
+  uint64_t path_hash; // 0 if empty
+  uint64_t mtime;
+  int type;
+} FileTypeCacheEntry;
+
+static FileTypeCacheEntry file_type_cache[FILE_TYPE_CACHE_SIZE];
+static SceKernelLwMutexWork file_type_mutex;
+
+// Packs the case folded extension with its dot, 0 if it is too long
+static uint64_t getExtensionKey(const char *extension) {
+  uint64_t key = 0;
+
+  int i;
+  for (i = 0; extension[i]; i++) {
+    if (i == FILE_TYPE_MAX_EXTENSION)
+      return 0;
+
+    key |= (uint64_t)toupper((uint8_t)extension[i]) << (i * 8);
+  }
+
+  return key;
+}
+
+static int getExtensionSlot(uint64_t key) {
+  return (int)((key * 0x9E3779B97F4A7C15ULL) >> 57) & (FILE_TYPE_HASH_SIZE - 1);
+}
+
+void initFileTypes() {
+  int i;
+  for (i = 0; i < N_EXTENSION_TYPES; i++) {
+    uint64_t key = getExtensionKey(extension_types[i].extension);
+
+    int slot = getExtensionSlot(key);
+    while (extension_slots[slot])
+      slot = (slot + 1) & (FILE_TYPE_HASH_SIZE - 1);
+
+    extension_keys[slot] = key;
+    extension_slots[slot] = i + 1;
+  }
+
+  sceKernelCreateLwMutex(&file_type_mutex, "file_type_mutex", 2, 0, NULL);
+
+  extension_index_ready = 1;
+}
+
 int getFileType(const char *file) {
   char *p = strrchr(file, '.');
-  if (p) {
+  if (!p)
+    return FILE_TYPE_UNKNOWN;
+
+  if (!extension_index_ready) {
     int i;
-    for (i = 0; i < (sizeof(extension_types) / sizeof(ExtensionType)); i++) {
+    for (i = 0; i < N_EXTENSION_TYPES; i++) {
       if (strcasecmp(p, extension_types[i].extension) == 0) {
         return extension_types[i].type;
       }
     }
+
+    return FILE_TYPE_UNKNOWN;
+  }
+
+  uint64_t key = getExtensionKey(p);
+  if (key == 0)
+    return FILE_TYPE_UNKNOWN;
+
+  int slot = getExtensionSlot(key);
+  while (extension_slots[slot]) {
+    if (extension_keys[slot] == key)
+      return extension_types[extension_slots[slot] - 1].type;
+
+    slot = (slot + 1) & (FILE_TYPE_HASH_SIZE - 1);
   }
 
   return FILE_TYPE_UNKNOWN;
 }
 
+// Returns the type given by the magic, FILE_TYPE_UNKNOWN for known formats
+// that have no handler and -1 if the content is not recognized
+static int sniffFileType(const char *path) {
+  uint8_t header[32];
+  memset(header, 0, sizeof(header));
+
+  int read = ReadFile(path, header, sizeof(header));
+  if (read < 4)
+    return -1;
+
+  if (memcmp(header, "PK\x03\x04", 4) == 0 || memcmp(header, "PK\x05\x06", 4) == 0)
+    return FILE_TYPE_ARCHIVE;
+  if (memcmp(header, "PSAR", 4) == 0)
+    return FILE_TYPE_ARCHIVE;
+  if (memcmp(header, "Rar!", 4) == 0 || memcmp(header, "7z\xBC\xAF", 4) == 0)
+    return FILE_TYPE_ARCHIVE;
+  if (memcmp(header, "\x1F\x8B", 2) == 0 || memcmp(header, "\xFD" "7zXZ", 5) == 0 || memcmp(header, "BZh", 3) == 0)
+    return FILE_TYPE_ARCHIVE;
+  if (memcmp(header, "\x89PNG", 4) == 0)
+    return FILE_TYPE_PNG;
+  if (memcmp(header, "\xFF\xD8\xFF", 3) == 0)
+    return FILE_TYPE_JPEG;
+  if (memcmp(header, "OggS", 4) == 0)
+    return FILE_TYPE_OGG;
+  if (memcmp(header, "ID3", 3) == 0)
+    return FILE_TYPE_MP3;
+  if (read >= 8 && memcmp(header + 4, "ftyp", 4) == 0)
+    return FILE_TYPE_MP4;
+  if (memcmp(header, "\0PSF", 4) == 0)
+    return FILE_TYPE_SFO;
+
+  // Only core dumps can be opened, other ELFs and SCE files are executables
+  if (memcmp(header, "\x7F" "ELF", 4) == 0)
+    return (read >= 18 && header[16] == 4 && header[17] == 0) ? FILE_TYPE_PSP2DMP : FILE_TYPE_UNKNOWN;
+  if (memcmp(header, "SCE\0", 4) == 0)
+    return FILE_TYPE_UNKNOWN;
+
+  return -1;
+}
+
+static uint64_t getPathHash(const char *path) {
+  uint64_t hash = 14695981039346656037ULL;
+
+  while (*path) {
+    hash ^= (uint8_t)*path++;
+    hash *= 1099511628211ULL;
+  }
+
+  return hash ? hash : 1;
+}
+
+// Corrects the type given by the extension with the content of the file
+int detectFileType(const char *path, SceDateTime *mtime, int type) {
+  if (!extension_index_ready)
+    return type;
+
+  uint64_t path_hash = getPathHash(path);
+
+  SceRtcTick tick;
+  sceRtcGetTick(mtime, &tick);
+
+  FileTypeCacheEntry *cache_entry = &file_type_cache[path_hash & (FILE_TYPE_CACHE_SIZE - 1)];
+
+  sceKernelLockLwMutex(&file_type_mutex, 1, NULL);
+  int cached = cache_entry->path_hash == path_hash && cache_entry->mtime == tick.tick;
+  int content_type = cache_entry->type;
+  sceKernelUnlockLwMutex(&file_type_mutex, 1);
+
+  if (!cached) {
+    content_type = sniffFileType(path);
+
+    sceKernelLockLwMutex(&file_type_mutex, 1, NULL);
+    cache_entry->path_hash = path_hash;
+    cache_entry->mtime = tick.tick;
+    cache_entry->type = content_type;
+    sceKernelUnlockLwMutex(&file_type_mutex, 1);
+  }
+
+  if (content_type < 0)
+    return type;
+
+  // VPKs are zip files
+  if (content_type == FILE_TYPE_ARCHIVE && type == FILE_TYPE_VPK)
+    return type;
+
+  return content_type;
+}
+
 int getNumberOfDevices() {
   return N_DEVICES;
 }
@@ -670,25 +733,237 @@ char **getDevices() {
   return devices;
 }
 
-FileListEntry *fileListCopyEntry(FileListEntry *src) {
-  FileListEntry *dst = malloc(sizeof(FileListEntry));
+void *fileListArenaAlloc(FileListArena *arena, int size) {
+  size = ALIGN(size, 8);
+
+  // Reuse a released block of the same size
+  int class = size / 8 - 1;
+  if (class >= 0 && class < FILE_LIST_ARENA_FREE_CLASSES && arena->free_blocks[class]) {
+    void *p = arena->free_blocks[class];
+    arena->free_blocks[class] = *(void **)p;
+    arena->used += size;
+    return p;
+  }
+
+  FileListArenaChunk *chunk = arena->chunks;
+
+  if (!chunk || chunk->used + size > chunk->size) {
+    int chunk_size = MAX(FILE_LIST_ARENA_CHUNK_SIZE, size + ALIGN(sizeof(FileListArenaChunk), 8));
+
+    chunk = malloc(chunk_size);
+    if (!chunk)
+      return NULL;
+
+    chunk->size = chunk_size;
+    chunk->used = ALIGN(sizeof(FileListArenaChunk), 8);
+
+    // Oversized chunks are full at once, keep filling the current one
+    if (arena->chunks && chunk_size > FILE_LIST_ARENA_CHUNK_SIZE) {
+      chunk->next = arena->chunks->next;
+      arena->chunks->next = chunk;
+    } else {
+      chunk->next = arena->chunks;
+      arena->chunks = chunk;
+    }
+
+    arena->n_chunks++;
+    arena->reserved += chunk_size;
+    arena->peak = MAX(arena->peak, arena->reserved);
+  }
+
+  void *p = (char *)chunk + chunk->used;
+  chunk->used += size;
+  arena->used += size;
+
+  return p;
+}
+
+// Blocks too big for the free lists stay unused until the arena is freed
+void fileListArenaRelease(FileListArena *arena, void *p, int size) {
+  size = ALIGN(size, 8);
+
+  int class = size / 8 - 1;
+  if (!p || class < 0 || class >= FILE_LIST_ARENA_FREE_CLASSES)
+    return;
+
+  *(void **)p = arena->free_blocks[class];
+  arena->free_blocks[class] = p;
+  arena->used -= size;
+}
+
+// Hands the chunks of src over to dst
+void fileListArenaMove(FileListArena *dst, FileListArena *src) {
+  if (!src->chunks)
+    return;
+
+  FileListArenaChunk *last = src->chunks;
+  while (last->next)
+    last = last->next;
+
+  // The current chunk of dst stays in front
+  if (dst->chunks) {
+    last->next = dst->chunks->next;
+    dst->chunks->next = src->chunks;
+  } else {
+    dst->chunks = src->chunks;
+  }
+
+  dst->n_chunks += src->n_chunks;
+  dst->reserved += src->reserved;
+  dst->used += src->used;
+  dst->peak = MAX(dst->peak, dst->reserved);
+
+  int i;
+  for (i = 0; i < FILE_LIST_ARENA_FREE_CLASSES; i++) {
+    while (src->free_blocks[i]) {
+      void *p = src->free_blocks[i];
+      src->free_blocks[i] = *(void **)p;
+      *(void **)p = dst->free_blocks[i];
+      dst->free_blocks[i] = p;
+    }
+  }
+
+  src->chunks = NULL;
+  src->n_chunks = 0;
+  src->reserved = 0;
+  src->used = 0;
+}
+
+void fileListArenaFree(FileListArena *arena) {
+  FileListArenaChunk *chunk = arena->chunks;
+  while (chunk) {
+    FileListArenaChunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+
+  arena->chunks = NULL;
+  arena->n_chunks = 0;
+  arena->reserved = 0;
+  arena->used = 0;
+  memset(arena->free_blocks, 0, sizeof(arena->free_blocks));
+}
+
+// Allocates a cleared entry together with room for its name
+FileListEntry *fileListAllocEntry(FileListArena *arena, int name_length) {
+  FileListEntry *entry = fileListArenaAlloc(arena, sizeof(FileListEntry) + name_length + 1);
+  if (!entry)
+    return NULL;
+
+  memset(entry, 0, sizeof(FileListEntry));
+  entry->arena = arena;
+  entry->name = (char *)(entry + 1);
+  entry->name[0] = '\0';
+  entry->name_length = name_length;
+
+  return entry;
+}
+
+FileListEntry *fileListCopyEntry(FileList *list, FileListEntry *src) {
+  FileListEntry *dst = fileListAllocEntry(&list->arena, src->name_length);
   if (!dst)
     return NULL;
 
+  char *name = dst->name;
   memcpy(dst, src, sizeof(FileListEntry));
-  dst->name = malloc(src->name_length + 1);
-  strcpy(dst->name, src->name);
+  dst->arena = &list->arena;
+  dst->name = name;
+  memcpy(dst->name, src->name, src->name_length + 1);
+  dst->sort.key = NULL;
+  dst->render_key = 0;
+  dst->size_string = NULL;
+  dst->max_size_string = NULL;
+  dst->date_string = NULL;
   return dst;
 }
 
+static uint32_t fileListHashName(const char *name) {
+  uint32_t hash = 2166136261u;
+
+  while (*name) {
+    hash ^= (uint8_t)tolower((uint8_t)*name++);
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+static void fileListRehash(FileList *list, int n_buckets) {
+  FileListEntry **buckets = calloc(n_buckets, sizeof(FileListEntry *));
+  if (!buckets)
+    return;
+
+  free(list->buckets);
+  list->buckets = buckets;
+  list->n_buckets = n_buckets;
+
+  int i;
+  for (i = 0; i < list->length; i++) {
+    FileListEntry *entry = list->entries[i];
+    uint32_t bucket = entry->hash & (n_buckets - 1);
+    entry->hash_next = buckets[bucket];
+    buckets[bucket] = entry;
+  }
+}
+
+// The entry must already be in the index
+static void fileListHashEntry(FileList *list, FileListEntry *entry) {
+  entry->hash = fileListHashName(entry->name);
+  entry->hash_next = NULL;
+
+  if (!list->buckets) {
+    if (list->length >= FILE_LIST_HASH_THRESHOLD)
+      fileListRehash(list, 2 * FILE_LIST_HASH_THRESHOLD);
+    return;
+  }
+
+  if (list->length > list->n_buckets) {
+    fileListRehash(list, list->n_buckets * 2);
+    return;
+  }
+
+  uint32_t bucket = entry->hash & (list->n_buckets - 1);
+  entry->hash_next = list->buckets[bucket];
+  list->buckets[bucket] = entry;
+}
+
+static void fileListUnhashEntry(FileList *list, FileListEntry *entry) {
+  if (!list->buckets)
+    return;
+
+  FileListEntry **p = &list->buckets[entry->hash & (list->n_buckets - 1)];
+  while (*p) {
+    if (*p == entry) {
+      *p = entry->hash_next;
+      break;
+    }
+
+    p = &(*p)->hash_next;
+  }
+}
+
 FileListEntry *fileListFindEntry(FileList *list, const char *name) {
   if (!list)
     return NULL;
 
-  FileListEntry *entry = list->head;
-
   int name_length = strlen(name);
 
+  if (list->buckets) {
+    uint32_t hash = fileListHashName(name);
+
+    FileListEntry *entry = list->buckets[hash & (list->n_buckets - 1)];
+    while (entry) {
+      if (entry->hash == hash && entry->name_length == name_length && strcasecmp(entry->name, name) == 0)
+        return entry;
+
+      entry = entry->hash_next;
+    }
+
+    return NULL;
+  }
+
+  FileListEntry *entry = list->head;
+
   while (entry) {
     if (entry->name_length == name_length && strcasecmp(entry->name, name) == 0)
       return entry;
@@ -700,165 +975,90 @@ FileListEntry *fileListFindEntry(FileList *list, const char *name) {
 }
 
 FileListEntry *fileListGetNthEntry(FileList *list, int n) {
-  if (!list)
+  if (!list || n < 0 || n >= list->length)
     return NULL;
 
-  FileListEntry *entry = list->head;
-
-  while (n > 0 && entry) {
-    n--;
-    entry = entry->next;
-  }
-
-  if (n != 0)
-    return NULL;
-
-  return entry;
+  return list->entries[n];
 }
 
 int fileListGetNumberByName(FileList *list, const char *name) {
   if (!list)
     return -1;
 
-  FileListEntry *entry = list->head;
+  // Comparing pointers is cheaper than comparing names
+  if (list->buckets) {
+    FileListEntry *entry = fileListFindEntry(list, name);
+    if (!entry)
+      return -1;
 
-  int name_length = strlen(name);
+    int i;
+    for (i = 0; i < list->length; i++) {
+      if (list->entries[i] == entry)
+        return i;
+    }
 
-  int n = 0;
+    return -1;
+  }
 
-  while (entry) {
-    if (entry->name_length == name_length && strcasecmp(entry->name, name) == 0)
-      return n;
+  int name_length = strlen(name);
 
-    n++;
-    entry = entry->next;
+  int i;
+  for (i = 0; i < list->length; i++) {
+    FileListEntry *entry = list->entries[i];
+    if (entry->name_length == name_length && strcasecmp(entry->name, name) == 0)
+      return i;
   }
 
   return -1;
 }
 
-void fileListAddEntry(FileList *list, FileListEntry *entry, int sort) {
-  if (!list || !entry)
-    return;
+static char *fileListCreateSortKey(FileListArena *arena, const char *name, int name_length) {
+  char key[SORT_KEY_SIZE(MAX_NAME_LENGTH)];
+  int len = sortKeyCreate(key, sizeof(key), name, name_length);
 
-  entry->next = NULL;
-  entry->previous = NULL;
+  char *sort_key = fileListArenaAlloc(arena, len + 1);
+  if (sort_key)
+    memcpy(sort_key, key, len + 1);
 
-  if (list->head == NULL) {
-    list->head = entry;
-    list->tail = entry;
-  } else {
-    if (sort != SORT_NONE) {
-      FileListEntry *p = list->head;
-      FileListEntry *previous = NULL;
-
-      char entry_name[MAX_NAME_LENGTH];
-      strcpy(entry_name, entry->name);
-      removeEndSlash(entry_name);
-      
-      while (p) {
-        char p_name[MAX_NAME_LENGTH];
-        strcpy(p_name, p->name);
-        removeEndSlash(p_name);
-        
-        // '..' is always at first
-        if (strcmp(entry_name, "..") == 0)
-          break;
-
-        if (strcmp(p_name, "..") == 0) {
-          previous = p;
-          p = p->next;
-          continue;
-        }
+  return sort_key;
+}
 
-        // Sort by type
-        if (sort == SORT_BY_NAME) {
-          // First folders then files
-          if (entry->is_folder > p->is_folder)
-            break;
-        } else if (sort == SORT_BY_SIZE || sort == SORT_BY_DATE) {
-          // First files then folders
-          if (entry->is_folder < p->is_folder)
-            break;
-        }
+static void fileListSetSortKeys(FileList *list, FileListEntry *entry) {
+  SceRtcTick tick;
+  sceRtcGetTick(&entry->mtime, &tick);
 
-        if (sort == SORT_BY_NAME) {
-          // Sort by name within the same type
-          if (entry->is_folder == p->is_folder) {
-            if (strnatcasecmp(entry_name, p_name) < 0) {
-              break;
-            }
-          }
-        } else if (sort == SORT_BY_SIZE) {
-          // Sort by name for folders
-          if (entry->is_folder && p->is_folder) {
-            if (strnatcasecmp(entry_name, p_name) < 0) {
-              break;
-            }
-          } else if (!entry->is_folder && !p->is_folder) {
-            // Sort by size for files
-            if (entry->size > p->size)
-              break;
-
-            // Sort by name for files with the same size
-            if (entry->size == p->size) {
-              if (strnatcasecmp(entry_name, p_name) < 0) {
-                break;
-              }
-            }
-          }
-        } else if (sort == SORT_BY_DATE) {
-          if (entry->is_folder == p->is_folder) {
-            SceRtcTick entry_tick, p_tick;
-            sceRtcGetTick(&entry->mtime, &entry_tick);
-            sceRtcGetTick(&p->mtime, &p_tick);
-
-            // Sort by date within the same type
-            if (entry_tick.tick > p_tick.tick)
-              break;
-
-            // Sort by name for files and folders with the same date
-            if (entry_tick.tick == p_tick.tick) {
-              if (strnatcasecmp(entry_name, p_name) < 0) {
-                break;
-              }
-            }
-          }
-        }
+  entry->sort.key = fileListCreateSortKey(&list->arena, entry->name, entry->name_length);
+  entry->sort.rank = strcmp(entry->name, DIR_UP) == 0 ? 0 : 1;
+  entry->sort.is_folder = entry->is_folder;
+  entry->sort.size = entry->size;
+  entry->sort.tick = tick.tick;
+}
 
-        previous = p;
-        p = p->next;
-      }
+// Rebuild the links from the index
+static void fileListLinkEntries(FileList *list) {
+  int i;
+  for (i = 0; i < list->length; i++) {
+    FileListEntry *entry = list->entries[i];
+    entry->previous = i > 0 ? list->entries[i - 1] : NULL;
+    entry->next = i < list->length - 1 ? list->entries[i + 1] : NULL;
+  }
 
-      if (previous == NULL) { // Order: entry (new head) -> p (old head)
-        entry->next = p;
-        p->previous = entry;
-        list->head = entry;
-      } else if (previous->next == NULL) { // Order: p (old tail) -> entry (new tail)
-        FileListEntry *tail = list->tail;
-        tail->next = entry;
-        entry->previous = tail;
-        list->tail = entry;
-      } else { // Order: previous -> entry -> p
-        previous->next = entry;
-        entry->previous = previous; 
-        entry->next = p;
-        p->previous = entry;
-      }
-    } else {
-      FileListEntry *tail = list->tail;
-      tail->next = entry;
-      entry->previous = tail;
-      list->tail = entry;
-    }
+  list->head = list->length > 0 ? list->entries[0] : NULL;
+  list->tail = list->length > 0 ? list->entries[list->length - 1] : NULL;
+}
+
+static int fileListFindIndex(FileList *list, FileListEntry *entry) {
+  int i;
+  for (i = 0; i < list->length; i++) {
+    if (list->entries[i] == entry)
+      return i;
   }
 
-  list->length++;
+  return -1;
 }
 
-int fileListRemoveEntry(FileList *list, FileListEntry *entry) {
-  if (!list || !entry)
-    return 0;
+static void fileListRemoveIndex(FileList *list, int index) {
+  FileListEntry *entry = list->entries[index];
 
   if (entry->previous) {
     entry->previous->next = entry->next;
@@ -872,73 +1072,110 @@ int fileListRemoveEntry(FileList *list, FileListEntry *entry) {
     list->tail = entry->previous;
   }
 
+  fileListUnhashEntry(list, entry);
+
+  memmove(&list->entries[index], &list->entries[index + 1], (list->length - index - 1) * sizeof(FileListEntry *));
   list->length--;
-  free(entry->name);
-  free(entry);
 
-  if (list->length == 0) {
-    list->head = NULL;
-    list->tail = NULL;
+  // Entries that were allocated for this list are reused, others are released with their arena
+  if (entry->arena == &list->arena) {
+    if (entry->sort.key)
+      fileListArenaRelease(&list->arena, entry->sort.key, strlen(entry->sort.key) + 1);
+    fileListArenaRelease(&list->arena, entry, sizeof(FileListEntry) + entry->name_length + 1);
   }
-
-  return 1;
 }
 
-int fileListRemoveEntryByName(FileList *list, const char *name) {
-  if (!list)
-    return 0;
+void fileListAddEntry(FileList *list, FileListEntry *entry, int sort) {
+  if (!list || !entry)
+    return;
 
-  FileListEntry *entry = list->head;
-  FileListEntry *previous = NULL;
+  if (list->length == list->max_entries) {
+    int max_entries = list->max_entries ? list->max_entries * 2 : 64;
+    FileListEntry **entries = realloc(list->entries, max_entries * sizeof(FileListEntry *));
+    if (!entries)
+      return;
 
-  int name_length = strlen(name);
+    list->entries = entries;
+    list->max_entries = max_entries;
+  }
 
-  while (entry) {
-    if (entry->name_length == name_length && strcasecmp(entry->name, name) == 0) {
-      if (previous) {
-        previous->next = entry->next;
-      } else {
-        list->head = entry->next;
-      }
+  fileListSetSortKeys(list, entry);
 
-      if (list->tail == entry) {
-        list->tail = previous;
-      }
+  // Insert after all entries that do not come after it
+  int index = sortKeysFindInsert((void **)list->entries, list->length, offsetof(FileListEntry, sort), &entry->sort, sort);
 
-      list->length--;
-      free(entry->name);
-      free(entry);
+  memmove(&list->entries[index + 1], &list->entries[index], (list->length - index) * sizeof(FileListEntry *));
+  list->entries[index] = entry;
+  list->length++;
 
-      if (list->length == 0) {
-        list->head = NULL;
-        list->tail = NULL;
-      }
+  entry->previous = index > 0 ? list->entries[index - 1] : NULL;
+  entry->next = index < list->length - 1 ? list->entries[index + 1] : NULL;
 
-      return 1;
-    }
+  if (entry->previous) {
+    entry->previous->next = entry;
+  } else {
+    list->head = entry;
+  }
 
-    previous = entry;
-    entry = entry->next;
+  if (entry->next) {
+    entry->next->previous = entry;
+  } else {
+    list->tail = entry;
   }
 
-  return 0;
+  fileListHashEntry(list, entry);
+}
+
+void fileListSort(FileList *list, int sort) {
+  if (!list || sort == SORT_NONE || list->length < 2)
+    return;
+
+  if (sortKeysSort((void **)list->entries, list->length, offsetof(FileListEntry, sort), sort) < 0)
+    return;
+
+  fileListLinkEntries(list);
+}
+
+int fileListRemoveEntry(FileList *list, FileListEntry *entry) {
+  if (!list || !entry)
+    return 0;
+
+  int index = fileListFindIndex(list, entry);
+  if (index < 0)
+    return 0;
+
+  fileListRemoveIndex(list, index);
+
+  return 1;
+}
+
+int fileListRemoveEntryByName(FileList *list, const char *name) {
+  if (!list)
+    return 0;
+
+  int index = fileListGetNumberByName(list, name);
+  if (index < 0)
+    return 0;
+
+  fileListRemoveIndex(list, index);
+
+  return 1;
 }
 
 void fileListEmpty(FileList *list) {
   if (!list)
     return;
 
-  FileListEntry *entry = list->head;
-
-  while (entry) {
-    FileListEntry *next = entry->next;
-    free(entry->name);
-    free(entry);
-    entry = next;
-  }
+  free(list->entries);
+  free(list->buckets);
+  fileListArenaFree(&list->arena);
 
   list->head = NULL;
   list->tail = NULL;
+  list->entries = NULL;
+  list->max_entries = 0;
+  list->buckets = NULL;
+  list->n_buckets = 0;
   list->length = 0;
   list->files = 0;
   list->folders = 0;
@@ -957,10 +1194,8 @@ int fileListGetDeviceEntries(FileList *list) {
       SceIoStat stat;
       memset(&stat, 0, sizeof(SceIoStat));
       if (sceIoGetstat(devices[i], &stat) >= 0) {
-        FileListEntry *entry = malloc(sizeof(FileListEntry));
+        FileListEntry *entry = fileListAllocEntry(&list->arena, strlen(devices[i]));
         if (entry) {
-          entry->name_length = strlen(devices[i]);
-          entry->name = malloc(entry->name_length + 1);
           strcpy(entry->name, devices[i]);
           entry->is_folder = 1;
           entry->type = FILE_TYPE_UNKNOWN;
@@ -984,7 +1219,7 @@ int fileListGetDeviceEntries(FileList *list) {
           memcpy(&entry->mtime, (SceDateTime *)&stat.st_mtime, sizeof(SceDateTime));
           memcpy(&entry->atime, (SceDateTime *)&stat.st_atime, sizeof(SceDateTime));
 
-          fileListAddEntry(list, entry, SORT_BY_NAME);
+          fileListAddEntry(list, entry, SORT_NONE);
 
           list->folders++;
         }
@@ -992,9 +1227,55 @@ int fileListGetDeviceEntries(FileList *list) {
     }
   }
 
+  fileListSort(list, SORT_BY_NAME);
+
   return 0;
 }
 
+// Types are also detected by content if enabled and the folder path is given
+FileListEntry *fileListCreateDirectoryEntry(FileListArena *arena, const char *path, SceIoDirent *dir) {
+  int is_folder = SCE_S_ISDIR(dir->d_stat.st_mode);
+
+  FileListEntry *entry = fileListAllocEntry(arena, strlen(dir->d_name) + (is_folder ? 1 : 0));
+  if (!entry)
+    return NULL;
+
+  entry->is_folder = is_folder;
+  strcpy(entry->name, dir->d_name);
+  if (entry->is_folder) {
+    addEndSlash(entry->name);
+    entry->type = FILE_TYPE_UNKNOWN;
+  } else {
+    entry->type = getFileType(entry->name);
+  }
+
+  entry->size = dir->d_stat.st_size;
+
+  memcpy(&entry->ctime, (SceDateTime *)&dir->d_stat.st_ctime, sizeof(SceDateTime));
+  memcpy(&entry->mtime, (SceDateTime *)&dir->d_stat.st_mtime, sizeof(SceDateTime));
+  memcpy(&entry->atime, (SceDateTime *)&dir->d_stat.st_atime, sizeof(SceDateTime));
+
+  if (path && !entry->is_folder && vitashell_config.detect_file_types) {
+    char file_path[MAX_PATH_LENGTH];
+    snprintf(file_path, MAX_PATH_LENGTH, "%s%s", path, entry->name);
+    entry->type = detectFileType(file_path, &entry->mtime, entry->type);
+  }
+
+  return entry;
+}
+
+FileListEntry *fileListCreateUpEntry(FileListArena *arena) {
+  FileListEntry *entry = fileListAllocEntry(arena, strlen(DIR_UP));
+  if (!entry)
+    return NULL;
+
+  strcpy(entry->name, DIR_UP);
+  entry->is_folder = 1;
+  entry->type = FILE_TYPE_UNKNOWN;
+
+  return entry;
+}
+
 int fileListGetDirectoryEntries(FileList *list, const char *path, int sort) {
   if (!list)
     return -1;
@@ -1003,15 +1284,7 @@ int fileListGetDirectoryEntries(FileList *list, const char *path, int sort) {
   if (dfd < 0)
     return dfd;
 
-  FileListEntry *entry = malloc(sizeof(FileListEntry));
-  if (entry) {
-    entry->name_length = strlen(DIR_UP);
-    entry->name = malloc(entry->name_length + 1);
-    strcpy(entry->name, DIR_UP);
-    entry->is_folder = 1;
-    entry->type = FILE_TYPE_UNKNOWN;
-    fileListAddEntry(list, entry, sort);
-  }
+  fileListAddEntry(list, fileListCreateUpEntry(&list->arena), SORT_NONE);
 
   int res = 0;
 
@@ -1021,37 +1294,23 @@ int fileListGetDirectoryEntries(FileList *list, const char *path, int sort) {
 
     res = sceIoDread(dfd, &dir);
     if (res > 0) {
-      FileListEntry *entry = malloc(sizeof(FileListEntry));
+      FileListEntry *entry = fileListCreateDirectoryEntry(&list->arena, path, &dir);
       if (entry) {
-        entry->is_folder = SCE_S_ISDIR(dir.d_stat.st_mode);
-        if (entry->is_folder) {
-          entry->name_length = strlen(dir.d_name) + 1;
-          entry->name = malloc(entry->name_length + 1);
-          strcpy(entry->name, dir.d_name);
-          addEndSlash(entry->name);
-          entry->type = FILE_TYPE_UNKNOWN;
+        if (entry->is_folder)
           list->folders++;
-        } else {
-          entry->name_length = strlen(dir.d_name);
-          entry->name = malloc(entry->name_length + 1);
-          strcpy(entry->name, dir.d_name);
-          entry->type = getFileType(entry->name);
+        else
           list->files++;
-        }
-
-        entry->size = dir.d_stat.st_size;
 
-        memcpy(&entry->ctime, (SceDateTime *)&dir.d_stat.st_ctime, sizeof(SceDateTime));
-        memcpy(&entry->mtime, (SceDateTime *)&dir.d_stat.st_mtime, sizeof(SceDateTime));
-        memcpy(&entry->atime, (SceDateTime *)&dir.d_stat.st_atime, sizeof(SceDateTime));
-
-        fileListAddEntry(list, entry, sort);
+        fileListAddEntry(list, entry, SORT_NONE);
       }
     }
   } while (res > 0);
 
   sceIoDclose(dfd);
 
+  // Sort once, instead of inserting every entry at its place
+  fileListSort(list, sort);
+
   return 0;
 }
 
@@ -19,6 +19,8 @@
 #ifndef __FILE_H__
 #define __FILE_H__
 
+#include "sort_key.h"
+
 #define SCE_ERROR_ERRNO_EEXIST 0x80010011
 #define SCE_ERROR_ERRNO_ENODEV 0x80010013
 
@@ -29,6 +31,12 @@
 #define MAX_DIR_LEVELS 32
 
 #define DIRECTORY_SIZE (4 * 1024)
+#define FILE_LIST_ARENA_CHUNK_SIZE (64 * 1024)
+#define FILE_LIST_ARENA_FREE_CLASSES 64 // Released blocks of up to 512 bytes are reused
+
+#define FILE_TYPE_MAX_EXTENSION 8 // With the dot
+#define FILE_TYPE_HASH_SIZE 128   // Power of two, at least twice the number of extensions
+#define FILE_TYPE_CACHE_SIZE 1024 // Power of two
 #define TRANSFER_SIZE (128 * 1024)
 
 #define HOME_PATH "home"
@@ -51,13 +59,6 @@ enum FileTypes {
   FILE_TYPE_XML,
 };
 
-enum FileSortFlags {
-  SORT_NONE,
-  SORT_BY_NAME,
-  SORT_BY_SIZE,
-  SORT_BY_DATE,
-};
-
 enum FileMoveFlags {
   MOVE_INTEGRATE  = 0x1, // Integrate directories
   MOVE_REPLACE    = 0x2, // Replace files
@@ -70,9 +71,29 @@ typedef struct {
   int (* cancelHandler)();
 } FileProcessParam;
 
+// Entries, names and sort keys of a list, released at once by fileListEmpty.
+// Removed entries go to free lists by size and are reused by the next ones.
+typedef struct FileListArenaChunk {
+  struct FileListArenaChunk *next;
+  int size;
+  int used;
+} FileListArenaChunk;
+
+typedef struct {
+  FileListArenaChunk *chunks; // The first chunk is the one being filled
+  int n_chunks;
+  int reserved;
+  int used;
+  int peak; // Highest reserved size, kept when the list is emptied
+  void *free_blocks[FILE_LIST_ARENA_FREE_CLASSES]; // Released blocks by size in 8 byte steps
+} FileListArena;
+
 typedef struct FileListEntry {
   struct FileListEntry *next;
   struct FileListEntry *previous;
+  struct FileListEntry *hash_next;
+  uint32_t hash;
+  FileListArena *arena; // Allocated from
   char *name;
   int name_length;
   int is_folder;
@@ -82,11 +103,25 @@ typedef struct FileListEntry {
   SceDateTime ctime;
   SceDateTime mtime;
   SceDateTime atime;
+  SortKeys sort;      // Set by fileListAddEntry
+  int render_key;     // Settings the strings below were formatted with, 0 if not formatted yet
+  char *size_string;  // Size, folder or used size of devices
+  char *max_size_string;
+  char *date_string;
+  float name_width;
+  float size_width;
+  float max_size_width;
+  float date_width;
 } FileListEntry;
 
 typedef struct {
   FileListEntry *head;
   FileListEntry *tail;
+  FileListEntry **entries; // Same order as the linked list
+  int max_entries;
+  FileListEntry **buckets; // Case-insensitive name index, built for longer lists
+  int n_buckets;
+  FileListArena arena;
   int length;
   char path[MAX_PATH_LENGTH];
   int files;
@@ -102,29 +137,40 @@ int checkFileExist(const char *file);
 int checkFolderExist(const char *folder);
 
 int getFileSize(const char *file);
-int getFileSha1(const char *file, uint8_t *pSha1Out, FileProcessParam *param);
 int getPathInfo(const char *path, uint64_t *size, uint32_t *folders, uint32_t *files, int (* handler)(const char *path));
 int removePath(const char *path, FileProcessParam *param);
 int copyFile(const char *src_path, const char *dst_path, FileProcessParam *param);
 int copyPath(const char *src_path, const char *dst_path, FileProcessParam *param);
 int movePath(const char *src_path, const char *dst_path, int flags, FileProcessParam *param);
 
+void initFileTypes();
 int getFileType(const char *file);
+int detectFileType(const char *path, SceDateTime *mtime, int type);
 
 int getNumberOfDevices();
 char **getDevices();
 
-FileListEntry *fileListCopyEntry(FileListEntry *src);
+void *fileListArenaAlloc(FileListArena *arena, int size);
+void fileListArenaRelease(FileListArena *arena, void *p, int size);
+void fileListArenaMove(FileListArena *dst, FileListArena *src);
+void fileListArenaFree(FileListArena *arena);
+
+FileListEntry *fileListAllocEntry(FileListArena *arena, int name_length);
+FileListEntry *fileListCopyEntry(FileList *list, FileListEntry *src);
 FileListEntry *fileListFindEntry(FileList *list, const char *name);
 FileListEntry *fileListGetNthEntry(FileList *list, int n);
 int fileListGetNumberByName(FileList *list, const char *name);
 
 void fileListAddEntry(FileList *list, FileListEntry *entry, int sort);
+void fileListSort(FileList *list, int sort);
 int fileListRemoveEntry(FileList *list, FileListEntry *entry);
 int fileListRemoveEntryByName(FileList *list, const char *name);
 
 void fileListEmpty(FileList *list);
 
+FileListEntry *fileListCreateDirectoryEntry(FileListArena *arena, const char *path, SceIoDirent *dir);
+FileListEntry *fileListCreateUpEntry(FileListArena *arena);
+
 int fileListGetEntries(FileList *list, const char *path, int sort);
 
 #endif
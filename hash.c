@@ -0,0 +1,217 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <zlib.h>
+
+#include "main.h"
+#include "hash.h"
+#include "io_profile.h"
+
+// One thread reads the file into a ring of buffers while the calling thread
+// hashes the buffers that are already filled
+typedef struct {
+  SceUID fd;
+  int buf_size;
+  void *buffers[HASH_N_BUFFERS];
+  int lengths[HASH_N_BUFFERS];
+  SceUID free_sema;
+  SceUID full_sema;
+  volatile int abort;
+} HashReader;
+
+void hashInit(HashContext *ctx, int algorithms) {
+  ctx->algorithms = algorithms;
+
+  if (algorithms & HASH_SHA1)
+    sha1_init(&ctx->sha1);
+  if (algorithms & HASH_SHA256)
+    sha256_init(&ctx->sha256);
+  if (algorithms & HASH_MD5)
+    md5_init(&ctx->md5);
+  if (algorithms & HASH_CRC32)
+    ctx->crc32 = crc32(0, NULL, 0);
+}
+
+void hashUpdate(HashContext *ctx, const void *data, size_t size) {
+  const uint8_t *p = (const uint8_t *)data;
+
+  // Every algorithm hashes the same chunk while it is still in the cache
+  while (size > 0) {
+    size_t chunk = MIN(size, HASH_CHUNK_SIZE);
+
+    if (ctx->algorithms & HASH_SHA1)
+      sha1_update(&ctx->sha1, p, chunk);
+    if (ctx->algorithms & HASH_SHA256)
+      sha256_update(&ctx->sha256, p, chunk);
+    if (ctx->algorithms & HASH_MD5)
+      md5_update(&ctx->md5, p, chunk);
+    if (ctx->algorithms & HASH_CRC32)
+      ctx->crc32 = crc32(ctx->crc32, p, chunk);
+
+    p += chunk;
+    size -= chunk;
+  }
+}
+
+void hashFinal(HashContext *ctx, HashDigests *digests) {
+  memset(digests, 0, sizeof(HashDigests));
+  digests->algorithms = ctx->algorithms;
+
+  if (ctx->algorithms & HASH_SHA1)
+    sha1_final(&ctx->sha1, digests->sha1);
+  if (ctx->algorithms & HASH_SHA256)
+    sha256_final(&ctx->sha256, digests->sha256);
+  if (ctx->algorithms & HASH_MD5)
+    md5_final(&ctx->md5, digests->md5);
+  if (ctx->algorithms & HASH_CRC32)
+    digests->crc32 = ctx->crc32;
+}
+
+static int hash_read_thread(SceSize args, void *argp) {
+  HashReader *reader = *(HashReader **)argp;
+
+  int i = 0;
+
+  while (1) {
+    sceKernelWaitSema(reader->free_sema, 1, NULL);
+
+    if (reader->abort)
+      break;
+
+    int read = sceIoRead(reader->fd, reader->buffers[i], reader->buf_size);
+    reader->lengths[i] = read;
+
+    sceKernelSignalSema(reader->full_sema, 1);
+
+    if (read <= 0)
+      break;
+
+    i = (i + 1) % HASH_N_BUFFERS;
+  }
+
+  return sceKernelExitThread(0);
+}
+
+int getFileHashes(const char *file, int algorithms, HashDigests *digests, FileProcessParam *param) {
+  HashReader reader;
+  memset(&reader, 0, sizeof(HashReader));
+  reader.free_sema = -1;
+  reader.full_sema = -1;
+
+  SceUID thid = -1;
+  int res = 0;
+
+  // Open the file to read, else return the error
+  reader.fd = sceIoOpen(file, SCE_O_RDONLY, 0);
+  if (reader.fd < 0)
+    return reader.fd;
+
+  reader.buf_size = ioProfileGetReadSize(file);
+
+  int i;
+  for (i = 0; i < HASH_N_BUFFERS; i++) {
+    reader.buffers[i] = memalign(4096, reader.buf_size);
+    if (!reader.buffers[i]) {
+      res = HASH_ERROR_NO_MEMORY;
+      goto EXIT;
+    }
+  }
+
+  reader.free_sema = sceKernelCreateSema("hash_free_sema", 0, HASH_N_BUFFERS, HASH_N_BUFFERS, NULL);
+  reader.full_sema = sceKernelCreateSema("hash_full_sema", 0, 0, HASH_N_BUFFERS, NULL);
+  if (reader.free_sema < 0 || reader.full_sema < 0) {
+    res = reader.free_sema < 0 ? reader.free_sema : reader.full_sema;
+    goto EXIT;
+  }
+
+  thid = sceKernelCreateThread("hash_read_thread", (SceKernelThreadEntry)hash_read_thread,
+                               sceKernelGetThreadCurrentPriority(), 0x4000, 0, 0, NULL);
+  if (thid < 0) {
+    res = thid;
+    goto EXIT;
+  }
+
+  HashReader *reader_ptr = &reader;
+  sceKernelStartThread(thid, sizeof(HashReader *), &reader_ptr);
+
+  HashContext ctx;
+  hashInit(&ctx, algorithms);
+
+  SceUInt64 yield_time = sceKernelGetProcessTimeWide();
+
+  res = 1;
+  i = 0;
+
+  while (1) {
+    sceKernelWaitSema(reader.full_sema, 1, NULL);
+
+    int read = reader.lengths[i];
+    if (read <= 0) {
+      if (read < 0)
+        res = read;
+      break;
+    }
+
+    hashUpdate(&ctx, reader.buffers[i], read);
+
+    sceKernelSignalSema(reader.free_sema, 1);
+    i = (i + 1) % HASH_N_BUFFERS;
+
+    if (param) {
+      if (param->value)
+        (*param->value) += read;
+
+      if (param->SetProgress)
+        param->SetProgress(param->value ? *param->value : 0, param->max);
+
+      if (param->cancelHandler && param->cancelHandler()) {
+        res = 0;
+        break;
+      }
+    }
+
+    // Let the progress dialog refresh
+    if ((sceKernelGetProcessTimeWide() - yield_time) >= HASH_YIELD_TIME) {
+      sceKernelDelayThread(1000);
+      yield_time = sceKernelGetProcessTimeWide();
+    }
+  }
+
+  if (res == 1)
+    hashFinal(&ctx, digests);
+
+EXIT:
+  if (thid >= 0) {
+    reader.abort = 1;
+    sceKernelSignalSema(reader.free_sema, 1);
+    sceKernelWaitThreadEnd(thid, NULL, NULL);
+    sceKernelDeleteThread(thid);
+  }
+
+  if (reader.full_sema >= 0)
+    sceKernelDeleteSema(reader.full_sema);
+  if (reader.free_sema >= 0)
+    sceKernelDeleteSema(reader.free_sema);
+
+  for (i = 0; i < HASH_N_BUFFERS; i++)
+    free(reader.buffers[i]);
+
+  sceIoClose(reader.fd);
+
+  return res;
+}
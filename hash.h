@@ -0,0 +1,63 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __HASH_H__
+#define __HASH_H__
+
+#include "file.h"
+#include "sha1.h"
+#include "sha256.h"
+#include "md5.h"
+
+#define HASH_N_BUFFERS 3
+#define HASH_CHUNK_SIZE (16 * 1024)
+#define HASH_YIELD_TIME (100 * 1000)
+
+#define HASH_ERROR_NO_MEMORY ((int)0x80101401)
+
+enum HashAlgorithms {
+  HASH_SHA1   = 0x1,
+  HASH_SHA256 = 0x2,
+  HASH_MD5    = 0x4,
+  HASH_CRC32  = 0x8,
+  HASH_ALL    = 0xF,
+};
+
+typedef struct {
+  int algorithms;
+  SHA1_CTX sha1;
+  SHA256_CTX sha256;
+  MD5_CTX md5;
+  uint32_t crc32;
+} HashContext;
+
+typedef struct {
+  int algorithms;
+  uint8_t sha1[SHA1_BLOCK_SIZE];
+  uint8_t sha256[SHA256_BLOCK_SIZE];
+  uint8_t md5[MD5_BLOCK_SIZE];
+  uint32_t crc32;
+} HashDigests;
+
+void hashInit(HashContext *ctx, int algorithms);
+void hashUpdate(HashContext *ctx, const void *data, size_t size);
+void hashFinal(HashContext *ctx, HashDigests *digests);
+
+int getFileHashes(const char *file, int algorithms, HashDigests *digests, FileProcessParam *param);
+
+#endif
@@ -0,0 +1,481 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "main.h"
+#include "hash_manifest.h"
+#include "file.h"
+#include "utils.h"
+
+static char *format_extensions[N_HASH_MANIFEST_FORMATS] = { "sha1", "sha256", "md5", "sfv" };
+static int format_algorithms[N_HASH_MANIFEST_FORMATS] = { HASH_SHA1, HASH_SHA256, HASH_MD5, HASH_CRC32 };
+
+// Workers take the next job and add their progress to the batch
+typedef struct {
+  HashBatch *batch;
+  int next_job;
+  SceKernelLwMutexWork mutex;
+  uint64_t done;
+  uint64_t values[HASH_BATCH_N_WORKERS]; // Only accessed with the mutex locked
+  SceUID thids[HASH_BATCH_N_WORKERS];
+  int n_running;
+  int error;
+  volatile int abort;
+} HashPool;
+
+static HashPool pool;
+
+int hashManifestGetFormat(const char *path) {
+  char *p = strrchr(path, '.');
+  if (!p)
+    return -1;
+
+  int i;
+  for (i = 0; i < N_HASH_MANIFEST_FORMATS; i++) {
+    if (strcasecmp(p + 1, format_extensions[i]) == 0)
+      return i;
+  }
+
+  return -1;
+}
+
+const char *hashManifestGetExtension(int format) {
+  return format_extensions[format];
+}
+
+int hashManifestGetAlgorithm(int format) {
+  return format_algorithms[format];
+}
+
+// Returns the digest of algorithm in the byte order it is written
+static int getDigest(HashDigests *digests, int algorithm, uint8_t *digest) {
+  switch (algorithm) {
+    case HASH_SHA1:
+      memcpy(digest, digests->sha1, SHA1_BLOCK_SIZE);
+      return SHA1_BLOCK_SIZE;
+
+    case HASH_SHA256:
+      memcpy(digest, digests->sha256, SHA256_BLOCK_SIZE);
+      return SHA256_BLOCK_SIZE;
+
+    case HASH_MD5:
+      memcpy(digest, digests->md5, MD5_BLOCK_SIZE);
+      return MD5_BLOCK_SIZE;
+
+    case HASH_CRC32:
+      digest[0] = digests->crc32 >> 24;
+      digest[1] = digests->crc32 >> 16;
+      digest[2] = digests->crc32 >> 8;
+      digest[3] = digests->crc32;
+      return 4;
+  }
+
+  return 0;
+}
+
+static int getDigestSize(int algorithm) {
+  HashDigests digests;
+  uint8_t digest[SHA256_BLOCK_SIZE];
+  memset(&digests, 0, sizeof(HashDigests));
+  return getDigest(&digests, algorithm, digest);
+}
+
+static int parseHex(const char *string, uint8_t *data, int size) {
+  int i;
+  for (i = 0; i < size; i++) {
+    unsigned int byte;
+    if (!isxdigit((uint8_t)string[i * 2]) || !isxdigit((uint8_t)string[i * 2 + 1]) ||
+        sscanf(string + i * 2, "%2x", &byte) != 1)
+      return -1;
+
+    data[i] = byte;
+  }
+
+  return 0;
+}
+
+void hashBatchInit(HashBatch *batch, int algorithm) {
+  memset(batch, 0, sizeof(HashBatch));
+  batch->algorithm = algorithm;
+}
+
+void hashBatchFree(HashBatch *batch) {
+  int i;
+  for (i = 0; i < batch->n_jobs; i++)
+    free(batch->jobs[i].path);
+
+  free(batch->jobs);
+  memset(batch, 0, sizeof(HashBatch));
+}
+
+static HashJob *addJob(HashBatch *batch, const char *path, int name_offset, uint64_t size) {
+  if (batch->n_jobs == batch->max_jobs) {
+    int max_jobs = batch->max_jobs ? batch->max_jobs * 2 : 256;
+    HashJob *jobs = realloc(batch->jobs, max_jobs * sizeof(HashJob));
+    if (!jobs)
+      return NULL;
+
+    batch->jobs = jobs;
+    batch->max_jobs = max_jobs;
+  }
+
+  char *copy = malloc(strlen(path) + 1);
+  if (!copy)
+    return NULL;
+
+  strcpy(copy, path);
+
+  HashJob *job = &batch->jobs[batch->n_jobs++];
+  memset(job, 0, sizeof(HashJob));
+  job->path = copy;
+  job->name = copy + name_offset;
+  job->size = size;
+
+  batch->size += size;
+
+  return job;
+}
+
+// Adds every file of manifest, named relative to base
+int hashBatchAddManifest(HashBatch *batch, PathManifest *manifest, const char *base) {
+  // Only the roots are known, there are too many files to list
+  if (manifest->overflow)
+    return HASH_MANIFEST_ERROR_TOO_MANY_FILES;
+
+  char path[MAX_PATH_LENGTH];
+
+  uint32_t i;
+  for (i = 0; i < manifest->n_entries; i++) {
+    if (SCE_S_ISDIR(manifest->entries[i].mode))
+      continue;
+
+    pathManifestGetPath(manifest, i, base, path, MAX_PATH_LENGTH);
+    if (!addJob(batch, path, strlen(base), manifest->entries[i].size))
+      return HASH_ERROR_NO_MEMORY;
+  }
+
+  return 0;
+}
+
+static void reportFile(HashManifestResult *result, const char *name) {
+  if (result->n_reported < HASH_MANIFEST_MAX_REPORTED) {
+    strncpy(result->reported[result->n_reported], name, MAX_NAME_LENGTH - 1);
+    result->reported[result->n_reported][MAX_NAME_LENGTH - 1] = '\0';
+    result->n_reported++;
+  }
+}
+
+/*
+  Reads a .sha1, .sha256, .md5 ("digest *name" or "digest  name") or .sfv
+  ("name CRC32") manifest. Files are looked up relative to the manifest,
+  missing files are counted in result.
+*/
+int hashBatchLoadManifest(HashBatch *batch, const char *path, HashManifestResult *result) {
+  int format = hashManifestGetFormat(path);
+  if (format < 0)
+    return HASH_MANIFEST_ERROR_FORMAT;
+
+  batch->algorithm = format_algorithms[format];
+  int digest_size = getDigestSize(batch->algorithm);
+
+  SceIoStat stat;
+  memset(&stat, 0, sizeof(SceIoStat));
+  int res = sceIoGetstat(path, &stat);
+  if (res < 0)
+    return res;
+
+  if (stat.st_size > HASH_MANIFEST_MAX_SIZE)
+    return HASH_MANIFEST_ERROR_TOO_MANY_FILES;
+
+  char *buffer = malloc(stat.st_size + 1);
+  if (!buffer)
+    return HASH_ERROR_NO_MEMORY;
+
+  int size = ReadFile(path, buffer, stat.st_size);
+  if (size < 0) {
+    free(buffer);
+    return size;
+  }
+
+  buffer[size] = '\0';
+
+  char folder[MAX_PATH_LENGTH];
+  strcpy(folder, path);
+  char *p = strrchr(folder, '/');
+  if (!p)
+    p = strrchr(folder, ':');
+  p[1] = '\0';
+
+  int folder_length = strlen(folder);
+
+  res = 0;
+
+  char *save = NULL;
+  char *line = strtok_r(buffer, "\r\n", &save);
+  while (line) {
+    char *name = NULL;
+    uint8_t expected[SHA256_BLOCK_SIZE];
+
+    while (*line == ' ' || *line == '\t')
+      line++;
+
+    if (*line == '\0' || *line == ';' || *line == '#')
+      goto NEXT;
+
+    if (format == HASH_MANIFEST_FORMAT_SFV) {
+      char *crc = strrchr(line, ' ');
+      if (!crc || strlen(crc + 1) != 8 || parseHex(crc + 1, expected, 4) < 0) {
+        res = HASH_MANIFEST_ERROR_FORMAT;
+        break;
+      }
+
+      while (crc > line && crc[-1] == ' ')
+        crc--;
+      *crc = '\0';
+
+      name = line;
+    } else {
+      if (parseHex(line, expected, digest_size) < 0 || line[digest_size * 2] != ' ') {
+        res = HASH_MANIFEST_ERROR_FORMAT;
+        break;
+      }
+
+      name = line + digest_size * 2 + 1;
+      if (*name == ' ' || *name == '*')
+        name++;
+    }
+
+    // Windows tools write backslashes
+    char *q;
+    for (q = name; *q; q++) {
+      if (*q == '\\')
+        *q = '/';
+    }
+
+    char file_path[MAX_PATH_LENGTH];
+    snprintf(file_path, MAX_PATH_LENGTH, "%s%s", folder, name);
+
+    memset(&stat, 0, sizeof(SceIoStat));
+    if (sceIoGetstat(file_path, &stat) < 0 || SCE_S_ISDIR(stat.st_mode)) {
+      result->missing++;
+      reportFile(result, name);
+      goto NEXT;
+    }
+
+    HashJob *job = addJob(batch, file_path, folder_length, stat.st_size);
+    if (!job) {
+      res = HASH_ERROR_NO_MEMORY;
+      break;
+    }
+
+    memcpy(job->expected, expected, digest_size);
+
+NEXT:
+    line = strtok_r(NULL, "\r\n", &save);
+  }
+
+  free(buffer);
+
+  return res;
+}
+
+static int poolCancelHandler() {
+  return pool.abort;
+}
+
+// Publishes the progress of the calling worker
+static void poolSetProgress(uint64_t value, uint64_t max) {
+  SceUID thid = sceKernelGetThreadId();
+
+  sceKernelLockLwMutex(&pool.mutex, 1, NULL);
+
+  int i;
+  for (i = 0; i < HASH_BATCH_N_WORKERS; i++) {
+    if (pool.thids[i] == thid) {
+      pool.values[i] = value;
+      break;
+    }
+  }
+
+  sceKernelUnlockLwMutex(&pool.mutex, 1);
+}
+
+static int hash_batch_worker_thread(SceSize args, void *argp) {
+  int worker = *(int *)argp;
+
+  while (!pool.abort) {
+    sceKernelLockLwMutex(&pool.mutex, 1, NULL);
+    int n = pool.next_job++;
+    sceKernelUnlockLwMutex(&pool.mutex, 1);
+
+    if (n >= pool.batch->n_jobs)
+      break;
+
+    HashJob *job = &pool.batch->jobs[n];
+
+    uint64_t value = 0;
+
+    FileProcessParam param;
+    param.value = &value;
+    param.max = job->size;
+    param.SetProgress = poolSetProgress;
+    param.cancelHandler = poolCancelHandler;
+
+    job->result = getFileHashes(job->path, pool.batch->algorithm, &job->digests, &param);
+
+    sceKernelLockLwMutex(&pool.mutex, 1, NULL);
+    pool.done += job->size;
+    pool.values[worker] = 0;
+    if (job->result < 0 && pool.error == 0)
+      pool.error = job->result;
+    sceKernelUnlockLwMutex(&pool.mutex, 1);
+  }
+
+  sceKernelLockLwMutex(&pool.mutex, 1, NULL);
+  pool.n_running--;
+  sceKernelUnlockLwMutex(&pool.mutex, 1);
+
+  return sceKernelExitThread(0);
+}
+
+// Hashes all jobs with a pool of workers, the calling thread reports the progress
+int hashBatchRun(HashBatch *batch, FileProcessParam *param) {
+  memset(&pool, 0, sizeof(HashPool));
+  pool.batch = batch;
+
+  sceKernelCreateLwMutex(&pool.mutex, "hash_batch_mutex", 2, 0, NULL);
+
+  uint64_t start_value = (param && param->value) ? *param->value : 0;
+
+  SceUID *thids = pool.thids;
+
+  int i;
+  for (i = 0; i < HASH_BATCH_N_WORKERS; i++) {
+    thids[i] = sceKernelCreateThread("hash_batch_worker_thread", (SceKernelThreadEntry)hash_batch_worker_thread,
+                                     sceKernelGetThreadCurrentPriority(), 0x10000, 0, 0, NULL);
+  }
+
+  for (i = 0; i < HASH_BATCH_N_WORKERS; i++) {
+    if (thids[i] >= 0) {
+      pool.n_running++;
+      sceKernelStartThread(thids[i], sizeof(int), &i);
+    }
+  }
+
+  int res = 1;
+
+  if (pool.n_running == 0)
+    res = thids[0];
+
+  while (1) {
+    sceKernelLockLwMutex(&pool.mutex, 1, NULL);
+    int n_running = pool.n_running;
+    uint64_t value = pool.done;
+    for (i = 0; i < HASH_BATCH_N_WORKERS; i++)
+      value += pool.values[i];
+    sceKernelUnlockLwMutex(&pool.mutex, 1);
+
+    if (n_running == 0)
+      break;
+
+    if (param) {
+      if (param->value)
+        *param->value = start_value + value;
+
+      if (param->SetProgress)
+        param->SetProgress(param->value ? *param->value : 0, param->max);
+
+      if (param->cancelHandler && param->cancelHandler()) {
+        pool.abort = 1;
+        res = 0;
+      }
+    }
+
+    sceKernelDelayThread(10 * 1000);
+  }
+
+  for (i = 0; i < HASH_BATCH_N_WORKERS; i++) {
+    if (thids[i] >= 0) {
+      sceKernelWaitThreadEnd(thids[i], NULL, NULL);
+      sceKernelDeleteThread(thids[i]);
+    }
+  }
+
+  sceKernelDeleteLwMutex(&pool.mutex);
+
+  // Failed jobs keep an empty digest, the caller decides if that is fatal
+  batch->error = pool.error;
+
+  return res;
+}
+
+int hashBatchWriteManifest(HashBatch *batch, const char *path, int format) {
+  SceUID fd = sceIoOpen(path, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
+  if (fd < 0)
+    return fd;
+
+  int res = 0;
+
+  if (format == HASH_MANIFEST_FORMAT_SFV) {
+    char *header = "; Generated by VitaShell\r\n";
+    res = sceIoWrite(fd, header, strlen(header));
+  }
+
+  int i;
+  for (i = 0; i < batch->n_jobs && res >= 0; i++) {
+    HashJob *job = &batch->jobs[i];
+
+    uint8_t digest[SHA256_BLOCK_SIZE];
+    int size = getDigest(&job->digests, batch->algorithm, digest);
+
+    char hex[SHA256_BLOCK_SIZE * 2 + 1];
+    int j;
+    for (j = 0; j < size; j++)
+      sprintf(hex + j * 2, "%02x", digest[j]);
+
+    char line[MAX_PATH_LENGTH + sizeof(hex) + 8];
+    int length;
+    if (format == HASH_MANIFEST_FORMAT_SFV) {
+      length = snprintf(line, sizeof(line), "%s %s\r\n", job->name, hex);
+    } else {
+      length = snprintf(line, sizeof(line), "%s *%s\n", hex, job->name);
+    }
+
+    res = sceIoWrite(fd, line, length);
+  }
+
+  sceIoClose(fd);
+
+  return res < 0 ? res : 1;
+}
+
+void hashBatchCheck(HashBatch *batch, HashManifestResult *result) {
+  int i;
+  for (i = 0; i < batch->n_jobs; i++) {
+    HashJob *job = &batch->jobs[i];
+
+    uint8_t digest[SHA256_BLOCK_SIZE];
+    int size = getDigest(&job->digests, batch->algorithm, digest);
+
+    if (job->result == 1 && memcmp(digest, job->expected, size) == 0) {
+      result->ok++;
+    } else {
+      result->mismatched++;
+      reportFile(result, job->name);
+    }
+  }
+}
@@ -0,0 +1,82 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __HASH_MANIFEST_H__
+#define __HASH_MANIFEST_H__
+
+#include "file.h"
+#include "hash.h"
+#include "path_manifest.h"
+
+#define HASH_BATCH_N_WORKERS 2
+#define HASH_MANIFEST_MAX_SIZE (8 * 1024 * 1024)
+#define HASH_MANIFEST_MAX_REPORTED 5
+
+#define HASH_MANIFEST_ERROR_FORMAT ((int)0x80101402)
+#define HASH_MANIFEST_ERROR_TOO_MANY_FILES ((int)0x80101403)
+
+enum HashManifestFormats {
+  HASH_MANIFEST_FORMAT_SHA1,
+  HASH_MANIFEST_FORMAT_SHA256,
+  HASH_MANIFEST_FORMAT_MD5,
+  HASH_MANIFEST_FORMAT_SFV,
+  N_HASH_MANIFEST_FORMATS,
+};
+
+typedef struct {
+  char *path;
+  const char *name; // Path relative to the manifest, points into path
+  uint64_t size;
+  uint8_t expected[SHA256_BLOCK_SIZE];
+  HashDigests digests;
+  int result; // 1 if hashed, else the error
+} HashJob;
+
+typedef struct {
+  HashJob *jobs;
+  int n_jobs;
+  int max_jobs;
+  int algorithm;
+  uint64_t size;
+  int error; // Of the first job that failed
+} HashBatch;
+
+typedef struct {
+  uint32_t ok;
+  uint32_t mismatched;
+  uint32_t missing;
+  char reported[HASH_MANIFEST_MAX_REPORTED][MAX_NAME_LENGTH];
+  int n_reported;
+} HashManifestResult;
+
+int hashManifestGetFormat(const char *path);
+const char *hashManifestGetExtension(int format);
+int hashManifestGetAlgorithm(int format);
+
+void hashBatchInit(HashBatch *batch, int algorithm);
+void hashBatchFree(HashBatch *batch);
+
+int hashBatchAddManifest(HashBatch *batch, PathManifest *manifest, const char *base);
+int hashBatchLoadManifest(HashBatch *batch, const char *path, HashManifestResult *result);
+
+int hashBatchRun(HashBatch *batch, FileProcessParam *param);
+
+int hashBatchWriteManifest(HashBatch *batch, const char *path, int format);
+void hashBatchCheck(HashBatch *batch, HashManifestResult *result);
+
+#endif
@@ -19,7 +19,10 @@
 #include "main.h"
 #include "io_process.h"
 #include "archive.h"
+#include "path_manifest.h"
 #include "file.h"
+#include "hash.h"
+#include "hash_manifest.h"
 #include "message_dialog.h"
 #include "uncommon_dialog.h"
 #include "language.h"
@@ -95,57 +98,58 @@ int delete_thread(SceSize args_size, DeleteArguments *args) {
 
   int count = 0;
   FileListEntry *head = NULL;
-  FileListEntry *mark_entry_one = NULL;
+  FileList mark_list_one;
+  memset(&mark_list_one, 0, sizeof(FileList));
 
   if (fileListFindEntry(args->mark_list, file_entry->name)) { // On marked entry
     count = args->mark_list->length;
     head = args->mark_list->head;
   } else {
     count = 1;
-    mark_entry_one = fileListCopyEntry(file_entry);
-    head = mark_entry_one;
+    fileListAddEntry(&mark_list_one, fileListCopyEntry(&mark_list_one, file_entry), SORT_NONE);
+    head = mark_list_one.head;
   }
 
-  char path[MAX_PATH_LENGTH];
   FileListEntry *mark_entry = NULL;
 
   // Get paths info
-  uint32_t folders = 0, files = 0;
+  PathManifest manifest;
+  pathManifestInit(&manifest, PATH_MANIFEST_MAX_MEMORY);
 
   mark_entry = head;
 
   int i;
   for (i = 0; i < count; i++) {
-    snprintf(path, MAX_PATH_LENGTH - 1, "%s%s", args->file_list->path, mark_entry->name);
-    getPathInfo(path, NULL, &folders, &files, NULL);
+    int res = pathManifestAdd(&manifest, args->file_list->path, mark_entry->name, NULL);
+    if (res < 0) {
+      closeWaitDialog();
+      errorDialog(res);
+      goto EXIT;
+    }
+
     mark_entry = mark_entry->next;
   }
 
+  uint32_t folders = manifest.folders, files = manifest.files;
+
   // Update thread
   thid = createStartUpdateThread(folders + files, 0);
 
   // Remove process
   uint64_t value = 0;
 
-  mark_entry = head;
-
-  for (i = 0; i < count; i++) {
-    snprintf(path, MAX_PATH_LENGTH - 1, "%s%s", args->file_list->path, mark_entry->name);
-
-    FileProcessParam param;
-    param.value = &value;
-    param.max = folders + files;
-    param.SetProgress = SetProgress;
-    param.cancelHandler = cancelHandler;
-    int res = removePath(path, &param);
-    if (res <= 0) {
-      closeWaitDialog();
-      setDialogStep(DIALOG_STEP_CANCELED);
-      errorDialog(res);
-      goto EXIT;
-    }
+  FileProcessParam param;
+  param.value = &value;
+  param.max = folders + files;
+  param.SetProgress = SetProgress;
+  param.cancelHandler = cancelHandler;
 
-    mark_entry = mark_entry->next;
+  int res = pathManifestRemove(&manifest, args->file_list->path, &param);
+  if (res <= 0) {
+    closeWaitDialog();
+    setDialogStep(DIALOG_STEP_CANCELED);
+    errorDialog(res);
+    goto EXIT;
   }
 
   // Set progress to 100%
@@ -158,8 +162,9 @@ int delete_thread(SceSize args_size, DeleteArguments *args) {
   setDialogStep(DIALOG_STEP_DELETED);
 
 EXIT:
-  if (mark_entry_one)
-    free(mark_entry_one);
+  pathManifestFree(&manifest);
+
+  fileListEmpty(&mark_list_one);
 
   if (thid >= 0)
     sceKernelWaitThreadEnd(thid, NULL, NULL);
@@ -183,6 +188,9 @@ int copy_thread(SceSize args_size, CopyArguments *args) {
   char src_path[MAX_PATH_LENGTH], dst_path[MAX_PATH_LENGTH];
   FileListEntry *copy_entry = NULL;
 
+  PathManifest manifest;
+  pathManifestInit(&manifest, PATH_MANIFEST_MAX_MEMORY);
+
   if (args->copy_mode == COPY_MODE_MOVE) { // Move
     // Update thread
     thid = createStartUpdateThread(args->copy_list->length, 0);
@@ -239,17 +247,29 @@ int copy_thread(SceSize args_size, CopyArguments *args) {
 
     int i;
     for (i = 0; i < args->copy_list->length; i++) {
-      snprintf(src_path, MAX_PATH_LENGTH - 1, "%s%s", args->copy_list->path, copy_entry->name);
-
       if (args->copy_mode == COPY_MODE_EXTRACT) {
+        snprintf(src_path, MAX_PATH_LENGTH - 1, "%s%s", args->copy_list->path, copy_entry->name);
         getArchivePathInfo(src_path, &size, &folders, &files, NULL);
       } else {
-        getPathInfo(src_path, &size, &folders, &files, NULL);
+        // Remember the tree, so that the copy does not have to read it again
+        int res = pathManifestAdd(&manifest, args->copy_list->path, copy_entry->name, NULL);
+        if (res < 0) {
+          closeWaitDialog();
+          errorDialog(res);
+          goto EXIT;
+        }
+
       }
 
       copy_entry = copy_entry->next;
     }
 
+    if (args->copy_mode != COPY_MODE_EXTRACT) {
+      size = manifest.size;
+      folders = manifest.folders;
+      files = manifest.files;
+    }
+
     // Check memory card free space
     if (checkMemoryCardFreeSpace(args->file_list->path, size))
       goto EXIT;
@@ -260,37 +280,29 @@ int copy_thread(SceSize args_size, CopyArguments *args) {
     // Copy process
     uint64_t value = 0;
 
-    copy_entry = args->copy_list->head;
-
-    for (i = 0; i < args->copy_list->length; i++) {
-      snprintf(src_path, MAX_PATH_LENGTH - 1, "%s%s", args->copy_list->path, copy_entry->name);
-      snprintf(dst_path, MAX_PATH_LENGTH - 1, "%s%s", args->file_list->path, copy_entry->name);
-
-      FileProcessParam param;
-      param.value = &value;
-      param.max = size + folders * DIRECTORY_SIZE;
-      param.SetProgress = SetProgress;
-      param.cancelHandler = cancelHandler;
+    FileProcessParam param;
+    param.value = &value;
+    param.max = size + folders * DIRECTORY_SIZE;
+    param.SetProgress = SetProgress;
+    param.cancelHandler = cancelHandler;
 
-      if (args->copy_mode == COPY_MODE_EXTRACT) {
-        int res = extractArchivePath(src_path, dst_path, &param);
-        if (res <= 0) {
-          closeWaitDialog();
-          setDialogStep(DIALOG_STEP_CANCELED);
-          errorDialog(res);
-          goto EXIT;
-        }
-      } else {
-        int res = copyPath(src_path, dst_path, &param);
-        if (res <= 0) {
-          closeWaitDialog();
-          setDialogStep(DIALOG_STEP_CANCELED);
-          errorDialog(res);
-          goto EXIT;
-        }
+    if (args->copy_mode == COPY_MODE_EXTRACT) {
+      // Extract the whole selection in one pass over the archive
+      int res = extractArchiveList(args->copy_list, args->file_list->path, &param);
+      if (res <= 0) {
+        closeWaitDialog();
+        setDialogStep(DIALOG_STEP_CANCELED);
+        errorDialog(res);
+        goto EXIT;
+      }
+    } else {
+      int res = pathManifestCopy(&manifest, args->copy_list->path, args->file_list->path, &param);
+      if (res <= 0) {
+        closeWaitDialog();
+        setDialogStep(DIALOG_STEP_CANCELED);
+        errorDialog(res);
+        goto EXIT;
       }
-
-      copy_entry = copy_entry->next;
     }
 
     // Set progress to 100%
@@ -309,6 +321,8 @@ EXIT:
     archiveClose();
   
 EXIT_ARCHIVE_OPEN:
+  pathManifestFree(&manifest);
+
   if (thid >= 0)
     sceKernelWaitThreadEnd(thid, NULL, NULL);
 
@@ -487,6 +501,28 @@ int exportPath(char *path, uint32_t *songs, uint32_t *videos, uint32_t *pictures
   return 1;
 }
 
+static int exportManifest(PathManifest *manifest, const char *base, uint32_t *songs, uint32_t *videos, uint32_t *pictures, FileProcessParam *param) {
+  char path[MAX_PATH_LENGTH];
+
+  uint32_t i;
+  for (i = 0; i < manifest->n_entries; i++) {
+    pathManifestGetPath(manifest, i, base, path, MAX_PATH_LENGTH);
+
+    int res = 1;
+
+    if (manifest->overflow) {
+      res = exportPath(path, songs, videos, pictures, param);
+    } else if (!SCE_S_ISDIR(manifest->entries[i].mode)) {
+      res = exportMedia(path, songs, videos, pictures, param);
+    }
+
+    if (res <= 0)
+      return res;
+  }
+
+  return 1;
+}
+
 int export_thread(SceSize args_size, ExportArguments *args) {
   SceUID thid = -1;
 
@@ -501,33 +537,40 @@ int export_thread(SceSize args_size, ExportArguments *args) {
 
   int count = 0;
   FileListEntry *head = NULL;
-  FileListEntry *mark_entry_one = NULL;
+  FileList mark_list_one;
+  memset(&mark_list_one, 0, sizeof(FileList));
 
   if (fileListFindEntry(args->mark_list, file_entry->name)) { // On marked entry
     count = args->mark_list->length;
     head = args->mark_list->head;
   } else {
     count = 1;
-    mark_entry_one = fileListCopyEntry(file_entry);
-    head = mark_entry_one;
+    fileListAddEntry(&mark_list_one, fileListCopyEntry(&mark_list_one, file_entry), SORT_NONE);
+    head = mark_list_one.head;
   }
 
-  char path[MAX_PATH_LENGTH];
   FileListEntry *mark_entry = NULL;
 
   // Get paths info
-  uint64_t size = 0;
-  uint32_t files = 0;
+  PathManifest manifest;
+  pathManifestInit(&manifest, PATH_MANIFEST_MAX_MEMORY);
 
   mark_entry = head;
 
   int i;
   for (i = 0; i < count; i++) {
-    snprintf(path, MAX_PATH_LENGTH - 1, "%s%s", args->file_list->path, mark_entry->name);
-    getPathInfo(path, &size, NULL, &files, mediaPathHandler);
+    int res = pathManifestAdd(&manifest, args->file_list->path, mark_entry->name, mediaPathHandler);
+    if (res < 0) {
+      closeWaitDialog();
+      errorDialog(res);
+      goto EXIT;
+    }
+
     mark_entry = mark_entry->next;
   }
 
+  uint64_t size = manifest.size;
+
   // No media files
   if (size == 0) {
     closeWaitDialog();
@@ -546,26 +589,18 @@ int export_thread(SceSize args_size, ExportArguments *args) {
   uint64_t value = 0;
   uint32_t songs = 0, videos = 0, pictures = 0;
 
-  mark_entry = head;
-
-  for (i = 0; i < count; i++) {
-    snprintf(path, MAX_PATH_LENGTH - 1, "%s%s", args->file_list->path, mark_entry->name);
-
-    FileProcessParam param;
-    param.value = &value;
-    param.max = size;
-    param.SetProgress = SetProgress;
-    param.cancelHandler = cancelHandler;
-
-    int res = exportPath(path, &songs, &videos, &pictures, &param);
-    if (res <= 0) {
-      closeWaitDialog();
-      setDialogStep(DIALOG_STEP_CANCELED);
-      errorDialog(res);
-      goto EXIT;
-    }
+  FileProcessParam param;
+  param.value = &value;
+  param.max = size;
+  param.SetProgress = SetProgress;
+  param.cancelHandler = cancelHandler;
 
-    mark_entry = mark_entry->next;
+  int res = exportManifest(&manifest, args->file_list->path, &songs, &videos, &pictures, &param);
+  if (res <= 0) {
+    closeWaitDialog();
+    setDialogStep(DIALOG_STEP_CANCELED);
+    errorDialog(res);
+    goto EXIT;
   }
 
   // Set progress to 100%
@@ -593,8 +628,9 @@ int export_thread(SceSize args_size, ExportArguments *args) {
   }
 
 EXIT:
-  if (mark_entry_one)
-    free(mark_entry_one);
+  pathManifestFree(&manifest);
+
+  fileListEmpty(&mark_list_one);
 
   if (thid >= 0)
     sceKernelWaitThreadEnd(thid, NULL, NULL);
@@ -605,6 +641,25 @@ EXIT:
   return sceKernelExitDeleteThread(0);
 }
 
+// Digests longer than 16 bytes are split in two lines to fit the dialog
+static void appendDigestString(char *msg, const char *name, const uint8_t *digest, int size) {
+  if (msg[0] != '\0')
+    strcat(msg, "\n");
+
+  strcat(msg, name);
+  strcat(msg, size > 16 ? ":\n" : ": ");
+
+  int i;
+  for (i = 0; i < size; i++) {
+    char string[4];
+    sprintf(string, "%02X", digest[i]);
+    strcat(msg, string);
+
+    if (size > 16 && i == (size / 2) - 1)
+      strcat(msg, "\n");
+  }
+}
+
 int hash_thread(SceSize args_size, HashArguments *args) {
   SceUID thid = -1;
 
@@ -615,13 +670,17 @@ int hash_thread(SceSize args_size, HashArguments *args) {
   sceMsgDialogProgressBarSetValue(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, 0);
   sceKernelDelayThread(DIALOG_WAIT); // Needed to see the percentage
 
-  uint64_t max = (uint64_t)(getFileSize(args->file_path) / TRANSFER_SIZE);
+  SceIoStat stat;
+  memset(&stat, 0, sizeof(SceIoStat));
+  sceIoGetstat(args->file_path, &stat);
 
-  // SHA1 process
+  uint64_t max = (uint64_t)stat.st_size;
+
+  // Hash process
   uint64_t value = 0;
 
   // Spin off a thread to update the progress dialog 
-  thid = createStartUpdateThread(max, 0);
+  thid = createStartUpdateThread(max, 1);
 
   FileProcessParam param;
   param.value = &value;
@@ -629,10 +688,10 @@ int hash_thread(SceSize args_size, HashArguments *args) {
   param.SetProgress = SetProgress;
   param.cancelHandler = cancelHandler;
 
-  uint8_t sha1out[20];
-  int res = getFileSha1(args->file_path, sha1out, &param);
+  HashDigests digests;
+  int res = getFileHashes(args->file_path, args->algorithms, &digests, &param);
   if (res <= 0) {
-    // SHA1 Didn't complete successfully, or was canceled
+    // Hashing didn't complete successfully, or was canceled
     closeWaitDialog();
     setDialogStep(DIALOG_STEP_CANCELED);
     errorDialog(res);
@@ -646,32 +705,235 @@ int hash_thread(SceSize args_size, HashArguments *args) {
   // Close
   closeWaitDialog();
 
-  char sha1msg[42];
-  memset(sha1msg, 0, sizeof(sha1msg));
+  // Construct the digest strings
+  char msg[512];
+  msg[0] = '\0';
+
+  if (digests.algorithms & HASH_SHA1)
+    appendDigestString(msg, "SHA1", digests.sha1, SHA1_BLOCK_SIZE);
+  if (digests.algorithms & HASH_SHA256)
+    appendDigestString(msg, "SHA256", digests.sha256, SHA256_BLOCK_SIZE);
+  if (digests.algorithms & HASH_MD5)
+    appendDigestString(msg, "MD5", digests.md5, MD5_BLOCK_SIZE);
+  if (digests.algorithms & HASH_CRC32) {
+    uint8_t crc32[4] = { digests.crc32 >> 24, digests.crc32 >> 16, digests.crc32 >> 8, digests.crc32 };
+    appendDigestString(msg, "CRC32", crc32, sizeof(crc32));
+  }
+
+  infoDialog(msg);
+
+EXIT:
+
+  // Ensure the update thread ends gracefully
+  if (thid >= 0)
+    sceKernelWaitThreadEnd(thid, NULL, NULL);
+
+  powerUnlock();
+
+  // Kill current thread
+  return sceKernelExitDeleteThread(0);
+}
+
+int hash_manifest_thread(SceSize args_size, HashManifestArguments *args) {
+  SceUID thid = -1;
+
+  // Lock power timers
+  powerLock();
+
+  // Set progress to 0%
+  sceMsgDialogProgressBarSetValue(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, 0);
+  sceKernelDelayThread(DIALOG_WAIT); // Needed to see the percentage
+
+  FileListEntry *file_entry = fileListGetNthEntry(args->file_list, args->index);
+
+  int count = 0;
+  FileListEntry *head = NULL;
+  FileList mark_list_one;
+  memset(&mark_list_one, 0, sizeof(FileList));
+
+  if (fileListFindEntry(args->mark_list, file_entry->name)) { // On marked entry
+    count = args->mark_list->length;
+    head = args->mark_list->head;
+  } else {
+    count = 1;
+    fileListAddEntry(&mark_list_one, fileListCopyEntry(&mark_list_one, file_entry), SORT_NONE);
+    head = mark_list_one.head;
+  }
+
+  // Name the manifest after the entry, or after the folder if several are marked
+  char manifest_path[MAX_PATH_LENGTH];
+  char name[MAX_NAME_LENGTH];
+
+  if (count == 1) {
+    strcpy(name, head->name);
+    removeEndSlash(name);
+  } else {
+    char folder[MAX_PATH_LENGTH];
+    strcpy(folder, args->file_list->path);
+    removeEndSlash(folder);
+    char *p = strrchr(folder, '/');
+    if (!p)
+      p = strrchr(folder, ':');
+    strcpy(name, p + 1);
+  }
+
+  snprintf(manifest_path, MAX_PATH_LENGTH, "%s%s.%s", args->file_list->path, name,
+           hashManifestGetExtension(args->format));
+
+  FileListEntry *mark_entry = NULL;
+
+  // Get paths info
+  PathManifest manifest;
+  pathManifestInit(&manifest, PATH_MANIFEST_MAX_MEMORY);
+
+  HashBatch batch;
+  hashBatchInit(&batch, hashManifestGetAlgorithm(args->format));
+
+  mark_entry = head;
 
-  // Construct SHA1 sum string
   int i;
-  for (i = 0; i < 20; i++) {
-    char string[4];
-    sprintf(string, "%02X", sha1out[i]);
-    strcat(sha1msg, string);
+  for (i = 0; i < count; i++) {
+    int res = pathManifestAdd(&manifest, args->file_list->path, mark_entry->name, NULL);
+    if (res < 0) {
+      closeWaitDialog();
+      errorDialog(res);
+      goto EXIT;
+    }
+
+    mark_entry = mark_entry->next;
+  }
 
-    if (i == 9)
-      strcat(sha1msg, "\n");
+  int res = hashBatchAddManifest(&batch, &manifest, args->file_list->path);
+  if (res < 0) {
+    closeWaitDialog();
+    errorDialog(res);
+    goto EXIT;
   }
 
-  sha1msg[41] = '\0';
+  // Update thread
+  thid = createStartUpdateThread(batch.size, 1);
+
+  // Hash process
+  uint64_t value = 0;
+
+  FileProcessParam param;
+  param.value = &value;
+  param.max = batch.size;
+  param.SetProgress = SetProgress;
+  param.cancelHandler = cancelHandler;
+
+  res = hashBatchRun(&batch, &param);
+
+  // Don't write empty digests of files that could not be read
+  if (res > 0 && batch.error < 0)
+    res = batch.error;
 
-  infoDialog(sha1msg);
+  if (res > 0)
+    res = hashBatchWriteManifest(&batch, manifest_path, args->format);
+
+  if (res <= 0) {
+    closeWaitDialog();
+    setDialogStep(DIALOG_STEP_CANCELED);
+    errorDialog(res);
+    goto EXIT;
+  }
+
+  // Set progress to 100%
+  sceMsgDialogProgressBarSetValue(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, 100);
+  sceKernelDelayThread(COUNTUP_WAIT);
+
+  // Close
+  closeWaitDialog();
+
+  infoDialog(language_container[HASH_MANIFEST_CREATED], batch.n_jobs);
 
 EXIT:
+  hashBatchFree(&batch);
+  pathManifestFree(&manifest);
+
+  fileListEmpty(&mark_list_one);
 
-  // Ensure the update thread ends gracefully
   if (thid >= 0)
     sceKernelWaitThreadEnd(thid, NULL, NULL);
 
+  // Unlock power timers
+  powerUnlock();
+
+  return sceKernelExitDeleteThread(0);
+}
+
+int verify_manifest_thread(SceSize args_size, VerifyManifestArguments *args) {
+  SceUID thid = -1;
+
+  // Lock power timers
+  powerLock();
+
+  // Set progress to 0%
+  sceMsgDialogProgressBarSetValue(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, 0);
+  sceKernelDelayThread(DIALOG_WAIT); // Needed to see the percentage
+
+  HashBatch batch;
+  hashBatchInit(&batch, 0);
+
+  HashManifestResult result;
+  memset(&result, 0, sizeof(HashManifestResult));
+
+  int res = hashBatchLoadManifest(&batch, args->file_path, &result);
+  if (res < 0) {
+    closeWaitDialog();
+    errorDialog(res);
+    goto EXIT;
+  }
+
+  // Update thread
+  thid = createStartUpdateThread(batch.size, 1);
+
+  // Hash process
+  uint64_t value = 0;
+
+  FileProcessParam param;
+  param.value = &value;
+  param.max = batch.size;
+  param.SetProgress = SetProgress;
+  param.cancelHandler = cancelHandler;
+
+  res = hashBatchRun(&batch, &param);
+  if (res <= 0) {
+    closeWaitDialog();
+    setDialogStep(DIALOG_STEP_CANCELED);
+    errorDialog(res);
+    goto EXIT;
+  }
+
+  hashBatchCheck(&batch, &result);
+
+  // Set progress to 100%
+  sceMsgDialogProgressBarSetValue(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, 100);
+  sceKernelDelayThread(COUNTUP_WAIT);
+
+  // Close
+  closeWaitDialog();
+
+  // Summary followed by the first failed files
+  char msg[512];
+  snprintf(msg, sizeof(msg), language_container[HASH_MANIFEST_VERIFIED], result.ok, result.mismatched, result.missing);
+
+  int i;
+  for (i = 0; i < result.n_reported; i++) {
+    int length = strlen(msg);
+    snprintf(msg + length, sizeof(msg) - length, "\n%s", result.reported[i]);
+  }
+
+  infoDialog("%s", msg);
+
+EXIT:
+  hashBatchFree(&batch);
+
+  if (thid >= 0)
+    sceKernelWaitThreadEnd(thid, NULL, NULL);
+
+  // Unlock power timers
   powerUnlock();
 
-  // Kill current thread
   return sceKernelExitDeleteThread(0);
 }
@@ -55,8 +55,20 @@ typedef struct {
 
 typedef struct {
   char *file_path;
+  int algorithms;
 } HashArguments;
 
+typedef struct {
+  FileList *file_list;
+  FileList *mark_list;
+  int index;
+  int format;
+} HashManifestArguments;
+
+typedef struct {
+  char *file_path;
+} VerifyManifestArguments;
+
 int cancelHandler();
 void SetProgress(uint64_t value, uint64_t max);
 SceUID createStartUpdateThread(uint64_t max, int show_kbs);
@@ -65,5 +77,7 @@ int delete_thread(SceSize args_size, DeleteArguments *args);
 int copy_thread(SceSize args_size, CopyArguments *args);
 int export_thread(SceSize args_size, ExportArguments *args);
 int hash_thread(SceSize args_size, HashArguments *args);
+int hash_manifest_thread(SceSize args_size, HashManifestArguments *args);
+int verify_manifest_thread(SceSize args_size, VerifyManifestArguments *args);
 
 #endif
@@ -0,0 +1,384 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "main.h"
+#include "io_profile.h"
+#include "transfer.h"
+#include "file.h"
+#include "init.h"
+#include "utils.h"
+
+static const int block_sizes[IO_PROFILE_N_SIZES] = {
+  32 * 1024,
+  64 * 1024,
+  128 * 1024,
+  256 * 1024,
+  512 * 1024,
+  1024 * 1024,
+};
+
+// Devices calibrated by default, the system partitions only when asked for
+static char *writable_devices[] = {
+  "ux0:",
+  "uma0:",
+  "xmc0:",
+};
+
+#define N_WRITABLE_DEVICES (sizeof(writable_devices) / sizeof(char **))
+
+// Read by the transfer threads while a calibration thread updates it
+static IoProfileTable io_profile_table;
+static SceKernelLwMutexWork io_profile_mutex;
+
+int ioProfileGetBlockSize(int i) {
+  return block_sizes[i];
+}
+
+// Called once at startup, before any other thread uses the profiles
+int ioProfileLoad() {
+  IoProfileTable table;
+  memset(&io_profile_table, 0, sizeof(IoProfileTable));
+
+  sceKernelCreateLwMutex(&io_profile_mutex, "io_profile_mutex", 2, 0, NULL);
+
+  int res = ReadFile(IO_PROFILE_FILE, &table, sizeof(IoProfileTable));
+  if (res < 0)
+    return res;
+
+  if (res != sizeof(IoProfileTable) || table.magic != IO_PROFILE_MAGIC ||
+      table.version != IO_PROFILE_VERSION || table.n_profiles > IO_PROFILE_MAX_DEVICES)
+    return -1;
+
+  memcpy(&io_profile_table, &table, sizeof(IoProfileTable));
+  return 0;
+}
+
+int ioProfileSave() {
+  IoProfileTable table;
+
+  sceKernelLockLwMutex(&io_profile_mutex, 1, NULL);
+  memcpy(&table, &io_profile_table, sizeof(IoProfileTable));
+  sceKernelUnlockLwMutex(&io_profile_mutex, 1);
+
+  table.magic = IO_PROFILE_MAGIC;
+  table.version = IO_PROFILE_VERSION;
+
+  int res = WriteFile(IO_PROFILE_FILE, &table, sizeof(IoProfileTable));
+  if (res < 0)
+    return res;
+
+  return 0;
+}
+
+// Must be called with the mutex locked
+static IoProfile *findProfile(const char *path) {
+  char *p = strchr(path, ':');
+  if (!p)
+    return NULL;
+
+  int len = p - path + 1;
+
+  int i;
+  for (i = 0; i < io_profile_table.n_profiles; i++) {
+    IoProfile *profile = &io_profile_table.profiles[i];
+    if (strncasecmp(profile->mount_point, path, len) == 0 && profile->mount_point[len] == '\0')
+      return profile;
+  }
+
+  return NULL;
+}
+
+int ioProfileGetReadSize(const char *path) {
+  sceKernelLockLwMutex(&io_profile_mutex, 1, NULL);
+  IoProfile *profile = findProfile(path);
+  int read_size = profile ? profile->read_size : 0;
+  sceKernelUnlockLwMutex(&io_profile_mutex, 1);
+
+  return read_size ? read_size : TRANSFER_SIZE;
+}
+
+int ioProfileGetWriteSize(const char *path) {
+  sceKernelLockLwMutex(&io_profile_mutex, 1, NULL);
+  IoProfile *profile = findProfile(path);
+  int write_size = profile ? profile->write_size : 0;
+  sceKernelUnlockLwMutex(&io_profile_mutex, 1);
+
+  return write_size ? write_size : TRANSFER_SIZE;
+}
+
+int ioProfileGetTransferSize(const char *src_path, const char *dst_path) {
+  sceKernelLockLwMutex(&io_profile_mutex, 1, NULL);
+
+  IoProfile *src = src_path ? findProfile(src_path) : NULL;
+  IoProfile *dst = dst_path ? findProfile(dst_path) : NULL;
+
+  // A direction without a measurement keeps the size the transfer ring was tuned for
+  int read_size = (src && src->read_size) ? src->read_size : TRANSFER_BUFFER_SIZE;
+  int write_size = (dst && dst->write_size) ? dst->write_size : TRANSFER_BUFFER_SIZE;
+
+  sceKernelUnlockLwMutex(&io_profile_mutex, 1);
+
+  if (!src_path)
+    read_size = 0;
+  if (!dst_path)
+    write_size = 0;
+
+  if (!src_path && !dst_path)
+    return TRANSFER_BUFFER_SIZE;
+
+  return MAX(read_size, write_size);
+}
+
+static uint32_t getThroughput(uint64_t bytes, uint64_t micros) {
+  if (micros == 0)
+    micros = 1;
+
+  return (uint32_t)((bytes * 1000000ULL) / micros / 1024);
+}
+
+// Use the smallest block size that comes within 5% of the best throughput
+static uint32_t getBestSize(uint32_t *kbs) {
+  uint32_t best = 0;
+
+  int i;
+  for (i = 0; i < IO_PROFILE_N_SIZES; i++) {
+    if (kbs[i] > best)
+      best = kbs[i];
+  }
+
+  if (best == 0)
+    return 0;
+
+  for (i = 0; i < IO_PROFILE_N_SIZES; i++) {
+    if ((uint64_t)kbs[i] * 100 >= (uint64_t)best * 95)
+      return block_sizes[i];
+  }
+
+  return 0;
+}
+
+static int measureWrite(const char *path, void *buf, int block_size, uint64_t *micros) {
+  SceUID fd = sceIoOpen(path, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
+  if (fd < 0)
+    return fd;
+
+  uint64_t time_start = sceKernelGetProcessTimeWide();
+
+  int res = 0;
+  uint32_t left = IO_PROFILE_TEST_SIZE;
+  while (left > 0) {
+    int written = sceIoWrite(fd, buf, MIN(left, block_size));
+    if (written <= 0) {
+      res = written < 0 ? written : -1;
+      break;
+    }
+
+    left -= written;
+  }
+
+  // Closing flushes the data, so it belongs to the measurement
+  sceIoClose(fd);
+
+  *micros = sceKernelGetProcessTimeWide() - time_start;
+  return res;
+}
+
+static int measureRead(const char *path, SceOff offset, void *buf, int block_size, uint64_t *micros) {
+  SceUID fd = sceIoOpen(path, SCE_O_RDONLY, 0);
+  if (fd < 0)
+    return fd;
+
+  uint64_t time_start = sceKernelGetProcessTimeWide();
+
+  int res = 0;
+  uint32_t left = IO_PROFILE_TEST_SIZE;
+  while (left > 0) {
+    int read = sceIoPread(fd, buf, MIN(left, block_size), offset);
+    if (read < 0)
+      res = read;
+
+    if (read <= 0)
+      break;
+
+    left -= read;
+    offset += read;
+  }
+
+  sceIoClose(fd);
+
+  *micros = sceKernelGetProcessTimeWide() - time_start;
+  return res;
+}
+
+/*
+  A file that was just written is still in the cache. Reads are measured on
+  an existing file instead, each block size on its own part of it.
+*/
+static int findReadTestFile(const char *mount_point, char *result) {
+  char (*folders)[MAX_PATH_LENGTH] = malloc(IO_PROFILE_MAX_SCAN_FOLDERS * MAX_PATH_LENGTH);
+  if (!folders)
+    return 0;
+
+  int n_folders = 1, found = 0;
+  strcpy(folders[0], mount_point);
+
+  int i;
+  for (i = 0; i < n_folders && !found; i++) {
+    SceUID dfd = sceIoDopen(folders[i]);
+    if (dfd < 0)
+      continue;
+
+    SceIoDirent dir;
+    memset(&dir, 0, sizeof(SceIoDirent));
+
+    while (!found && sceIoDread(dfd, &dir) > 0) {
+      if (SCE_S_ISDIR(dir.d_stat.st_mode)) {
+        if (n_folders < IO_PROFILE_MAX_SCAN_FOLDERS) {
+          snprintf(folders[n_folders], MAX_PATH_LENGTH, "%s%s/", folders[i], dir.d_name);
+          n_folders++;
+        }
+      } else if (dir.d_stat.st_size >= (SceOff)IO_PROFILE_TEST_SIZE * IO_PROFILE_N_SIZES) {
+        snprintf(result, MAX_PATH_LENGTH, "%s%s", folders[i], dir.d_name);
+        found = 1;
+      }
+
+      memset(&dir, 0, sizeof(SceIoDirent));
+    }
+
+    sceIoDclose(dfd);
+  }
+
+  free(folders);
+
+  return found;
+}
+
+int ioProfileCalibrate(const char *mount_point) {
+  IoProfile profile;
+  memset(&profile, 0, sizeof(IoProfile));
+  strncpy(profile.mount_point, mount_point, MAX_MOUNT_POINT_LENGTH - 1);
+
+  char path[MAX_PATH_LENGTH];
+  snprintf(path, MAX_PATH_LENGTH, "%s%s", mount_point, IO_PROFILE_TEST_NAME);
+
+  void *buf = memalign(4096, block_sizes[IO_PROFILE_N_SIZES - 1]);
+  if (!buf)
+    return -1;
+
+  memset(buf, 0xA5, block_sizes[IO_PROFILE_N_SIZES - 1]);
+
+  char read_path[MAX_PATH_LENGTH];
+  int has_read_file = findReadTestFile(mount_point, read_path);
+
+  int res = 0;
+
+  int i;
+  for (i = 0; i < IO_PROFILE_N_SIZES; i++) {
+    uint64_t micros = 0;
+
+    res = measureWrite(path, buf, block_sizes[i], &micros);
+    if (res < 0)
+      break;
+
+    profile.write_kbs[i] = getThroughput(IO_PROFILE_TEST_SIZE, micros);
+
+    if (has_read_file)
+      res = measureRead(read_path, (SceOff)i * IO_PROFILE_TEST_SIZE, buf, block_sizes[i], &micros);
+    else
+      res = measureRead(path, 0, buf, block_sizes[i], &micros);
+    if (res < 0)
+      break;
+
+    profile.read_kbs[i] = getThroughput(IO_PROFILE_TEST_SIZE, micros);
+  }
+
+  sceIoRemove(path);
+  free(buf);
+
+  if (res < 0)
+    return res;
+
+  profile.read_size = getBestSize(profile.read_kbs);
+  profile.write_size = getBestSize(profile.write_kbs);
+
+  sceKernelLockLwMutex(&io_profile_mutex, 1, NULL);
+
+  IoProfile *old = findProfile(mount_point);
+  if (old) {
+    memcpy(old, &profile, sizeof(IoProfile));
+  } else if (io_profile_table.n_profiles < IO_PROFILE_MAX_DEVICES) {
+    memcpy(&io_profile_table.profiles[io_profile_table.n_profiles], &profile, sizeof(IoProfile));
+    io_profile_table.n_profiles++;
+  } else {
+    res = -1;
+  }
+
+  sceKernelUnlockLwMutex(&io_profile_mutex, 1);
+
+  return res;
+}
+
+int ioProfileCalibrateAll() {
+  int n = 0;
+
+  int i;
+  for (i = 0; i < N_WRITABLE_DEVICES; i++) {
+    if (is_safe_mode && strcmp(writable_devices[i], "ux0:") != 0)
+      continue;
+
+    if (!checkFolderExist(writable_devices[i]))
+      continue;
+
+    if (ioProfileCalibrate(writable_devices[i]) >= 0)
+      n++;
+  }
+
+  if (n > 0)
+    ioProfileSave();
+
+  return n;
+}
+
+int ioProfilePrint(char *buf, int size) {
+  int len = 0;
+
+  len += snprintf(buf + len, size - len, "%-8s", "KB/s");
+
+  int i, j;
+  for (i = 0; i < IO_PROFILE_N_SIZES && len < size; i++) {
+    len += snprintf(buf + len, size - len, " %11dK", block_sizes[i] / 1024);
+  }
+
+  sceKernelLockLwMutex(&io_profile_mutex, 1, NULL);
+
+  for (i = 0; i < io_profile_table.n_profiles && len < size; i++) {
+    IoProfile *profile = &io_profile_table.profiles[i];
+
+    len += snprintf(buf + len, size - len, "\r\n%-8s", profile->mount_point);
+    for (j = 0; j < IO_PROFILE_N_SIZES && len < size; j++) {
+      len += snprintf(buf + len, size - len, " %5u/%-6u", profile->read_kbs[j], profile->write_kbs[j]);
+    }
+
+    if (len < size)
+      len += snprintf(buf + len, size - len, " read %uK write %uK", profile->read_size / 1024, profile->write_size / 1024);
+  }
+
+  sceKernelUnlockLwMutex(&io_profile_mutex, 1);
+
+  return MIN(len, size - 1);
+}
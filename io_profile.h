@@ -0,0 +1,63 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __IO_PROFILE_H__
+#define __IO_PROFILE_H__
+
+#include "file.h"
+
+#define IO_PROFILE_FILE "ux0:VitaShell/internal/io_profile.bin"
+#define IO_PROFILE_MAGIC 0x464F5049 // IOPF
+#define IO_PROFILE_VERSION 1
+
+#define IO_PROFILE_TEST_NAME "VitaShell_io_profile.tmp"
+#define IO_PROFILE_TEST_SIZE (2 * 1024 * 1024)
+#define IO_PROFILE_MAX_SCAN_FOLDERS 64
+
+#define IO_PROFILE_N_SIZES 6
+#define IO_PROFILE_MAX_DEVICES 16
+
+typedef struct {
+  char mount_point[MAX_MOUNT_POINT_LENGTH];
+  uint32_t read_kbs[IO_PROFILE_N_SIZES];
+  uint32_t write_kbs[IO_PROFILE_N_SIZES];
+  uint32_t read_size;
+  uint32_t write_size;
+} IoProfile;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t n_profiles;
+  IoProfile profiles[IO_PROFILE_MAX_DEVICES];
+} IoProfileTable;
+
+int ioProfileLoad();
+int ioProfileSave();
+
+int ioProfileCalibrate(const char *mount_point);
+int ioProfileCalibrateAll();
+
+int ioProfileGetBlockSize(int i);
+int ioProfileGetReadSize(const char *path);
+int ioProfileGetWriteSize(const char *path);
+int ioProfileGetTransferSize(const char *src_path, const char *dst_path);
+
+int ioProfilePrint(char *buf, int size);
+
+#endif
@@ -82,6 +82,7 @@ void loadLanguage(int id) {
     LANGUAGE_ENTRY(EXTRACTING),
     LANGUAGE_ENTRY(COMPRESSING),
     LANGUAGE_ENTRY(HASHING),
+    LANGUAGE_ENTRY(VERIFYING),
     LANGUAGE_ENTRY(REFRESHING),
     LANGUAGE_ENTRY(SENDING),
     LANGUAGE_ENTRY(RECEIVING),
@@ -136,6 +137,8 @@ void loadLanguage(int id) {
     LANGUAGE_ENTRY(INSTALL_ALL),
     LANGUAGE_ENTRY(INSTALL_FOLDER),
     LANGUAGE_ENTRY(CALCULATE_SHA1),
+    LANGUAGE_ENTRY(CREATE_HASH_MANIFEST),
+    LANGUAGE_ENTRY(VERIFY_HASH_MANIFEST),
     LANGUAGE_ENTRY(OPEN_DECRYPTED),
     LANGUAGE_ENTRY(EXPORT_MEDIA),
     LANGUAGE_ENTRY(CUT),
@@ -196,6 +199,8 @@ void loadLanguage(int id) {
     LANGUAGE_ENTRY(INSTALL_WARNING),
     LANGUAGE_ENTRY(INSTALL_BRICK_WARNING),
     LANGUAGE_ENTRY(HASH_FILE_QUESTION),
+    LANGUAGE_ENTRY(HASH_MANIFEST_CREATED),
+    LANGUAGE_ENTRY(HASH_MANIFEST_VERIFIED),
     LANGUAGE_ENTRY(SAVE_MODIFICATIONS),
     LANGUAGE_ENTRY(REFRESH_LIVEAREA_QUESTION),
     LANGUAGE_ENTRY(REFRESH_LICENSE_DB_QUESTION),
@@ -219,6 +224,10 @@ void loadLanguage(int id) {
     LANGUAGE_ENTRY(VITASHELL_SETTINGS_USBDEVICE),
     LANGUAGE_ENTRY(VITASHELL_SETTINGS_SELECT_BUTTON),
     LANGUAGE_ENTRY(VITASHELL_SETTINGS_NO_AUTO_UPDATE),
+    LANGUAGE_ENTRY(VITASHELL_SETTINGS_DETECT_FILE_TYPES),
+    LANGUAGE_ENTRY(VITASHELL_SETTINGS_HASH_ALGORITHMS),
+    LANGUAGE_ENTRY(VITASHELL_SETTINGS_TEXT_CACHE_SIZE),
+    LANGUAGE_ENTRY(VITASHELL_SETTINGS_DEBUG_OVERLAY),
     LANGUAGE_ENTRY(VITASHELL_SETTINGS_RESTART_SHELL),
     LANGUAGE_ENTRY(VITASHELL_SETTINGS_POWER),
     LANGUAGE_ENTRY(VITASHELL_SETTINGS_REBOOT),
@@ -230,6 +239,7 @@ void loadLanguage(int id) {
     LANGUAGE_ENTRY(VITASHELL_SETTINGS_USB_PSVSD),
     LANGUAGE_ENTRY(VITASHELL_SETTINGS_SELECT_BUTTON_USB),
     LANGUAGE_ENTRY(VITASHELL_SETTINGS_SELECT_BUTTON_FTP),
+    LANGUAGE_ENTRY(VITASHELL_SETTINGS_HASH_ALL),
 
     // USB strings
     LANGUAGE_ENTRY(USB_CONNECTED),
@@ -275,6 +285,19 @@ void loadLanguage(int id) {
     LANGUAGE_ENTRY(ARCHIVE_NAME),
     LANGUAGE_ENTRY(COMPRESSION_LEVEL),
     LANGUAGE_ENTRY(ENTER_PASSWORD),
+    LANGUAGE_ENTRY(LOADING_ENTRIES),
+    LANGUAGE_ENTRY(SEARCH_QUERY),
+    LANGUAGE_ENTRY(SEARCH_PROGRESS),
+    LANGUAGE_ENTRY(SEARCH_DONE),
+    LANGUAGE_ENTRY(FIND_DUPLICATES),
+    LANGUAGE_ENTRY(FIND_DUPLICATES_QUESTION),
+    LANGUAGE_ENTRY(DUPLICATES_SCANNING),
+    LANGUAGE_ENTRY(DUPLICATES_COMPARING),
+    LANGUAGE_ENTRY(DUPLICATES_DONE),
+    LANGUAGE_ENTRY(DUPLICATES_GROUP),
+    LANGUAGE_ENTRY(GOTO_LINE),
+    LANGUAGE_ENTRY(ENTER_LINE_NUMBER),
+    LANGUAGE_ENTRY(TEXT_INDEXING),
   };
 
   // Load default config file
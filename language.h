@@ -41,6 +41,7 @@ enum LanguageContainer {
   EXTRACTING,
   COMPRESSING,
   HASHING,
+  VERIFYING,
   REFRESHING,
   SENDING,
   RECEIVING,
@@ -95,6 +96,8 @@ enum LanguageContainer {
   INSTALL_ALL,
   INSTALL_FOLDER,
   CALCULATE_SHA1,
+  CREATE_HASH_MANIFEST,
+  VERIFY_HASH_MANIFEST,
   OPEN_DECRYPTED,
   EXPORT_MEDIA,
   CUT,
@@ -155,6 +158,8 @@ enum LanguageContainer {
   INSTALL_WARNING,
   INSTALL_BRICK_WARNING,
   HASH_FILE_QUESTION,
+  HASH_MANIFEST_CREATED,
+  HASH_MANIFEST_VERIFIED,
   SAVE_MODIFICATIONS,
   REFRESH_LIVEAREA_QUESTION,
   REFRESH_LICENSE_DB_QUESTION,
@@ -178,6 +183,10 @@ enum LanguageContainer {
   VITASHELL_SETTINGS_USBDEVICE,
   VITASHELL_SETTINGS_SELECT_BUTTON,
   VITASHELL_SETTINGS_NO_AUTO_UPDATE,
+  VITASHELL_SETTINGS_DETECT_FILE_TYPES,
+  VITASHELL_SETTINGS_HASH_ALGORITHMS,
+  VITASHELL_SETTINGS_TEXT_CACHE_SIZE,
+  VITASHELL_SETTINGS_DEBUG_OVERLAY,
   VITASHELL_SETTINGS_RESTART_SHELL,
   VITASHELL_SETTINGS_POWER,
   VITASHELL_SETTINGS_REBOOT,
@@ -189,6 +198,7 @@ enum LanguageContainer {
   VITASHELL_SETTINGS_USB_PSVSD,
   VITASHELL_SETTINGS_SELECT_BUTTON_USB,
   VITASHELL_SETTINGS_SELECT_BUTTON_FTP,
+  VITASHELL_SETTINGS_HASH_ALL,
 
   // USB strings
   USB_CONNECTED,
@@ -234,6 +244,19 @@ enum LanguageContainer {
   ARCHIVE_NAME,
   COMPRESSION_LEVEL,
   ENTER_PASSWORD,
+  LOADING_ENTRIES,
+  SEARCH_QUERY,
+  SEARCH_PROGRESS,
+  SEARCH_DONE,
+  FIND_DUPLICATES,
+  FIND_DUPLICATES_QUESTION,
+  DUPLICATES_SCANNING,
+  DUPLICATES_COMPARING,
+  DUPLICATES_DONE,
+  DUPLICATES_GROUP,
+  GOTO_LINE,
+  ENTER_LINE_NUMBER,
+  TEXT_INDEXING,
   
   LANGUAGE_CONTAINER_SIZE,
 };
@@ -30,6 +30,14 @@
 #include "photo.h"
 #include "audioplayer.h"
 #include "file.h"
+#include "dir_loader.h"
+#include "dir_cache.h"
+#include "dir_prefetch.h"
+#include "search.h"
+#include "duplicates.h"
+#include "hash.h"
+#include "hash_manifest.h"
+#include "io_profile.h"
 #include "text.h"
 #include "hex.h"
 #include "settings.h"
@@ -62,6 +70,17 @@ char archive_path[MAX_PATH_LENGTH];
 static char install_path[MAX_PATH_LENGTH];
 static char focus_name[MAX_NAME_LENGTH], compress_name[MAX_NAME_LENGTH];
 
+// Background listing
+static char loader_focus_name[MAX_NAME_LENGTH];
+static int loader_base_pos = 0, loader_rel_pos = 0;
+static SceDateTime loader_mtime;
+static int loader_cache_store = 0;
+
+// Frame time without the wait for vblank, averaged over FRAME_TIME_WINDOW frames
+static uint32_t frame_time_sum = 0, frame_time_peak = 0;
+static int frame_count = 0;
+static uint32_t frame_time_avg = 0, frame_time_max = 0;
+
 // Position
 int base_pos = 0, rel_pos = 0;
 static int base_pos_list[MAX_DIR_LEVELS];
@@ -170,6 +189,13 @@ DIR_UP_RETURN:
 }
 
 static void setFocusOnFilename(const char *name) {
+  // Wait for the background listing to find the entry
+  if (dirLoaderIsRunning()) {
+    strncpy(loader_focus_name, name, MAX_NAME_LENGTH - 1);
+    loader_focus_name[MAX_NAME_LENGTH - 1] = '\0';
+    return;
+  }
+
   int name_pos = fileListGetNumberByName(&file_list, name);
   if (name_pos < 0 || name_pos >= file_list.length)
     return;
@@ -185,21 +211,47 @@ static void setFocusOnFilename(const char *name) {
   }
 }
 
-int refreshFileList() {
-  int ret = 0, res = 0;
+// Opens the folder of path and focuses its entry
+static void jumpToPath(const char *path) {
+  char folder[MAX_PATH_LENGTH];
+  strcpy(folder, path);
+  removeEndSlash(folder);
 
-  do {
-    fileListEmpty(&file_list);
+  char *p = strrchr(folder, '/');
+  if (!p)
+    p = strrchr(folder, ':');
+  if (!p)
+    return;
 
-    res = fileListGetEntries(&file_list, file_list.path, sort_mode);
+  char name[MAX_NAME_LENGTH];
+  snprintf(name, MAX_NAME_LENGTH, "%s%s", p + 1, path[strlen(path) - 1] == '/' ? "/" : "");
+  p[1] = '\0';
 
-    if (res < 0) {
-      ret = res;
-      dirUp();
+  strcpy(file_list.path, folder);
+
+  dir_level = 0;
+
+  int i;
+  for (i = 0; folder[i] != '\0'; i++) {
+    if (folder[i] == ':' || folder[i] == '/') {
+      base_pos_list[dir_level] = 0;
+      rel_pos_list[dir_level] = 0;
+      dir_level++;
     }
-  } while (res < 0);
-    
-  // Position correction
+  }
+
+  base_pos_list[dir_level] = 0;
+  rel_pos_list[dir_level] = 0;
+  base_pos = 0;
+  rel_pos = 0;
+
+  fileListEmpty(&mark_list);
+  WriteFile(VITASHELL_LASTDIR, file_list.path, strlen(file_list.path) + 1);
+  refreshFileList();
+  setFocusOnFilename(name);
+}
+
+static void correctPosition() {
   if (file_list.length >= MAX_POSITION) {
     if ((base_pos + rel_pos) >= file_list.length) {
       rel_pos = MAX_POSITION - 1;
@@ -215,10 +267,240 @@ int refreshFileList() {
     
     base_pos = 0;
   }
-  
+}
+
+static void updateFrameTime(uint32_t time) {
+  frame_time_sum += time;
+  frame_time_peak = MAX(frame_time_peak, time);
+
+  if (++frame_count == FRAME_TIME_WINDOW) {
+    frame_time_avg = frame_time_sum / FRAME_TIME_WINDOW;
+    frame_time_max = frame_time_peak;
+    frame_time_sum = 0;
+    frame_time_peak = 0;
+    frame_count = 0;
+  }
+}
+
+static void drawDebugOverlay() {
+  char lines[8][64];
+  int n_lines = 0;
+
+  DirCacheStats dir_cache_stats;
+  dirCacheGetStats(&dir_cache_stats);
+  snprintf(lines[n_lines++], sizeof(lines[0]), "Dir cache: %d hits, %d misses",
+           dir_cache_stats.hits, dir_cache_stats.misses);
+  snprintf(lines[n_lines++], sizeof(lines[0]), "Dir cache: %d folders, %d KB",
+           dir_cache_stats.n_dirs, dir_cache_stats.memory / 1024);
+
+  DirPrefetchStats dir_prefetch_stats;
+  dirPrefetchGetStats(&dir_prefetch_stats);
+  snprintf(lines[n_lines++], sizeof(lines[0]), "Prefetch: %d listed, %d hits, %d wasted, %d canceled",
+           dir_prefetch_stats.listed, dir_cache_stats.prefetch_hits,
+           dir_cache_stats.prefetch_wasted, dir_prefetch_stats.canceled);
+
+  snprintf(lines[n_lines++], sizeof(lines[0]), "File list: %d KB used, %d KB in %d chunks, peak %d KB",
+           file_list.arena.used / 1024, file_list.arena.reserved / 1024,
+           file_list.arena.n_chunks, file_list.arena.peak / 1024);
+
+  snprintf(lines[n_lines++], sizeof(lines[0]), "Frame: %d us average, %d us max",
+           (int)frame_time_avg, (int)frame_time_max);
+
+  int i;
+  for (i = 0; i < n_lines; i++) {
+    float y = SCREEN_HEIGHT - SHELL_MARGIN_Y - (n_lines - i) * FONT_Y_SPACE;
+    pgf_draw_text(ALIGN_RIGHT(SCREEN_WIDTH - SHELL_MARGIN_X, pgf_text_width(lines[i])), y, PATH_COLOR, lines[i]);
+  }
+}
+
+static void updatePrefetch() {
+  static char prefetch_folder[MAX_PATH_LENGTH], prefetch_parent[MAX_PATH_LENGTH];
+  static uint64_t focus_time = 0;
+  static int requested = 0;
+
+  // Leave the disk alone while operations or the listing run
+  if (getDialogStep() != DIALOG_STEP_NONE || dirLoaderIsRunning() || isInArchive()) {
+    if (prefetch_folder[0] != '\0' || prefetch_parent[0] != '\0')
+      dirPrefetchCancel();
+    prefetch_folder[0] = '\0';
+    prefetch_parent[0] = '\0';
+    return;
+  }
+
+  char folder[MAX_PATH_LENGTH], parent[MAX_PATH_LENGTH];
+  folder[0] = '\0';
+  parent[0] = '\0';
+
+  // Focused folder, named the way it is when entered
+  FileListEntry *file_entry = fileListGetNthEntry(&file_list, base_pos + rel_pos);
+  if (file_entry && file_entry->is_folder && strcmp(file_entry->name, DIR_UP) != 0) {
+    if (dir_level == 0) {
+      strcpy(folder, file_entry->name);
+    } else {
+      strcpy(folder, file_list.path);
+      if (dir_level > 1)
+        addEndSlash(folder);
+      strcat(folder, file_entry->name);
+    }
+  }
+
+  // Parent folder, named the way it is after going up
+  if (dir_level > 1) {
+    strcpy(parent, file_list.path);
+    removeEndSlash(parent);
+
+    char *p = strrchr(parent, '/');
+    if (!p)
+      p = strrchr(parent, ':');
+    if (p)
+      p[1] = '\0';
+    else
+      parent[0] = '\0';
+  }
+
+  if (strcmp(folder, prefetch_folder) != 0 || strcmp(parent, prefetch_parent) != 0) {
+    if (requested)
+      dirPrefetchCancel();
+
+    strcpy(prefetch_folder, folder);
+    strcpy(prefetch_parent, parent);
+    focus_time = sceKernelGetProcessTimeWide();
+    requested = 0;
+    return;
+  }
+
+  if (!requested && (folder[0] != '\0' || parent[0] != '\0') &&
+      sceKernelGetProcessTimeWide() - focus_time >= DIR_PREFETCH_DELAY) {
+    dirPrefetchRequest(folder[0] != '\0' ? folder : NULL, parent[0] != '\0' ? parent : NULL);
+    requested = 1;
+  }
+}
+
+static int getRenderKey() {
+  return 0x1000000 | (language & 0xFF) | ((date_format & 0xFF) << 8) | ((time_format & 0xFF) << 16);
+}
+
+static char *copyRenderString(const char *string) {
+  char *copy = fileListArenaAlloc(&file_list.arena, strlen(string) + 1);
+  if (!copy)
+    return "";
+
+  strcpy(copy, string);
+  return copy;
+}
+
+// The strings only change with the list or the system settings, so they are formatted once
+static void formatEntry(FileListEntry *file_entry, int render_key) {
+  char size_string[16], max_size_string[16];
+
+  size_string[0] = '\0';
+  max_size_string[0] = '\0';
+
+  if (dir_level == 0) {
+    if (file_entry->size != 0 && file_entry->size2 != 0) {
+      getSizeString(size_string, file_entry->size2 - file_entry->size);
+      getSizeString(max_size_string, file_entry->size2);
+    } else {
+      strcpy(size_string, "-");
+      strcpy(max_size_string, "-");
+    }
+  } else if (!file_entry->is_folder) {
+    getSizeString(size_string, file_entry->size);
+  }
+
+  char date_string[24];
+  getDateString(date_string, date_format, &file_entry->mtime);
+
+  char time_string[16];
+  getTimeString(time_string, time_format, &file_entry->mtime);
+
+  char string[64];
+  snprintf(string, sizeof(string), "%s %s", date_string, time_string);
+
+  if (dir_level != 0 && file_entry->is_folder)
+    file_entry->size_string = language_container[FOLDER];
+  else
+    file_entry->size_string = copyRenderString(size_string);
+
+  file_entry->max_size_string = copyRenderString(max_size_string);
+  file_entry->date_string = copyRenderString(string);
+
+  file_entry->name_width = pgf_text_width(file_entry->name);
+  file_entry->size_width = pgf_text_width(file_entry->size_string);
+  file_entry->max_size_width = pgf_text_width(file_entry->max_size_string);
+  file_entry->date_width = pgf_text_width(file_entry->date_string);
+
+  file_entry->render_key = render_key;
+}
+
+static int loadFileList(int async) {
+  int ret = 0, res = 0;
+
+  dirLoaderCancel();
+  loader_focus_name[0] = '\0';
+
+  do {
+    fileListEmpty(&file_list);
+    loader_cache_store = 0;
+
+    int is_folder = !isInArchive() && strcasecmp(file_list.path, HOME_PATH) != 0;
+    int cached = is_folder ? dirCacheLookup(&file_list, file_list.path, sort_mode, &loader_mtime) : -1;
+
+    if (cached == 1) {
+      res = 0;
+    } else if (async && is_folder) {
+      // Big folders on slow devices are read in the background
+      res = dirLoaderStart(&file_list, file_list.path);
+      loader_cache_store = (cached == 0);
+    } else {
+      res = fileListGetEntries(&file_list, file_list.path, sort_mode);
+      if (res >= 0 && cached == 0)
+        dirCacheStore(&file_list, &loader_mtime, 0);
+    }
+
+    if (res < 0) {
+      ret = res;
+      dirUp();
+    }
+  } while (res < 0);
+
+  // The position is corrected once the listing is complete
+  if (dirLoaderIsRunning()) {
+    loader_base_pos = base_pos;
+    loader_rel_pos = rel_pos;
+  } else {
+    correctPosition();
+  }
+
   return ret;
 }
 
+int refreshFileList() {
+  return loadFileList(1);
+}
+
+static void finishFileList() {
+  // Keep the focus on the entry that was selected while loading
+  if (loader_focus_name[0] == '\0' && (base_pos != loader_base_pos || rel_pos != loader_rel_pos)) {
+    FileListEntry *file_entry = fileListGetNthEntry(&file_list, base_pos + rel_pos);
+    if (file_entry)
+      strcpy(loader_focus_name, file_entry->name);
+  }
+
+  fileListSort(&file_list, sort_mode);
+  correctPosition();
+
+  if (loader_cache_store) {
+    dirCacheStore(&file_list, &loader_mtime, 0);
+    loader_cache_store = 0;
+  }
+
+  if (loader_focus_name[0] != '\0') {
+    setFocusOnFilename(loader_focus_name);
+    loader_focus_name[0] = '\0';
+  }
+}
+
 static void refreshMarkList() {
   if (isInArchive())
     return;
@@ -280,6 +562,8 @@ static int handleFile(const char *file, FileListEntry *entry) {
 	vita2d_wait_rendering_done();
 
   int type = getFileType(file);
+  if (vitashell_config.detect_file_types && !isInArchive())
+    type = detectFileType(file, &entry->mtime, type);
 
   switch (type) {
     case FILE_TYPE_PSP2DMP:
@@ -469,6 +753,8 @@ static void initFtp() {
   }
 
   ftpvita_ext_add_custom_command("PROM", ftpvita_PROM);
+  ftpvita_ext_add_custom_command("IOBENCH", ftpvita_IOBENCH);
+  ftpvita_ext_add_custom_command("IOPROFILE", ftpvita_IOPROFILE);
 }
 
 static void initUsb() {
@@ -597,7 +883,7 @@ static int dialogSteps() {
         
         int i;
         for (i = 0; i < copy_list.length; i++) {
-          fileListAddEntry(&mark_list, fileListCopyEntry(copy_entry), SORT_NONE);
+          fileListAddEntry(&mark_list, fileListCopyEntry(&mark_list, copy_entry), SORT_NONE);
 
           // Next
           copy_entry = copy_entry->next;
@@ -894,6 +1180,59 @@ static int dialogSteps() {
       break;
     }
 
+    case DIALOG_STEP_SEARCH:
+    {
+      if (ime_result == IME_DIALOG_RESULT_FINISHED) {
+        char *string = (char *)getImeDialogInputTextUTF8();
+        setDialogStep(DIALOG_STEP_NONE);
+
+        if (string[0] != '\0') {
+          char query[MAX_NAME_LENGTH];
+          strcpy(query, string);
+
+          char path[MAX_PATH_LENGTH];
+          int res = searchViewer(file_list.path, query, path);
+          if (res < 0) {
+            errorDialog(res);
+          } else if (res == 1) {
+            jumpToPath(path);
+          }
+        }
+      } else if (ime_result == IME_DIALOG_RESULT_CANCELED) {
+        setDialogStep(DIALOG_STEP_NONE);
+      }
+
+      break;
+    }
+
+    case DIALOG_STEP_FIND_DUPLICATES_QUESTION:
+    {
+      if (msg_result == MESSAGE_DIALOG_RESULT_YES) {
+        setDialogStep(DIALOG_STEP_NONE);
+
+        char path[MAX_PATH_LENGTH];
+        int res = duplicatesViewer(file_list.path, path);
+        if (res < 0) {
+          errorDialog(res);
+        } else {
+          // Files may have been deleted, also in other folders
+          dirCacheClear();
+
+          if (res == 1) {
+            jumpToPath(path);
+          } else {
+            refreshFileList();
+            refreshMarkList();
+            refreshCopyList();
+          }
+        }
+      } else if (msg_result == MESSAGE_DIALOG_RESULT_NO) {
+        setDialogStep(DIALOG_STEP_NONE);
+      }
+
+      break;
+    }
+
     case DIALOG_STEP_NEW_FOLDER:
     {
       if (ime_result == IME_DIALOG_RESULT_FINISHED) {
@@ -1030,8 +1369,11 @@ static int dialogSteps() {
         // Place the full file path in cur_file
         snprintf(cur_file, MAX_PATH_LENGTH - 1, "%s%s", file_list.path, file_entry->name);
 
+        static int hash_algorithms[] = { HASH_SHA1, HASH_SHA256, HASH_MD5, HASH_CRC32, HASH_ALL };
+
         HashArguments args;
         args.file_path = cur_file;
+        args.algorithms = hash_algorithms[vitashell_config.hash_algorithms % (sizeof(hash_algorithms) / sizeof(int))];
 
         setDialogStep(DIALOG_STEP_HASHING);
 
@@ -1043,6 +1385,66 @@ static int dialogSteps() {
 
       break;
     }
+
+    case DIALOG_STEP_HASH_MANIFEST_QUESTION:
+    {
+      if (msg_result == MESSAGE_DIALOG_RESULT_YES) {
+        initMessageDialog(MESSAGE_DIALOG_PROGRESS_BAR, language_container[HASHING]);
+        setDialogStep(DIALOG_STEP_HASH_MANIFEST_CONFIRMED);
+      } else if (msg_result == MESSAGE_DIALOG_RESULT_NO) {
+        setDialogStep(DIALOG_STEP_NONE);
+      }
+
+      break;
+    }
+
+    case DIALOG_STEP_HASH_MANIFEST_CONFIRMED:
+    {
+      if (msg_result == MESSAGE_DIALOG_RESULT_RUNNING) {
+        // "All" writes a .sha1 manifest
+        static int manifest_formats[] = { HASH_MANIFEST_FORMAT_SHA1, HASH_MANIFEST_FORMAT_SHA256, HASH_MANIFEST_FORMAT_MD5,
+                                          HASH_MANIFEST_FORMAT_SFV, HASH_MANIFEST_FORMAT_SHA1 };
+
+        HashManifestArguments args;
+        memset(&args, 0, sizeof(HashManifestArguments));
+        args.file_list = &file_list;
+        args.mark_list = &mark_list;
+        args.index = base_pos + rel_pos;
+        args.format = manifest_formats[vitashell_config.hash_algorithms % (sizeof(manifest_formats) / sizeof(int))];
+
+        setDialogStep(DIALOG_STEP_HASHING);
+
+        SceUID thid = sceKernelCreateThread("hash_manifest_thread", (SceKernelThreadEntry)hash_manifest_thread, 0x40, 0x100000, 0, 0, NULL);
+        if (thid >= 0)
+          sceKernelStartThread(thid, sizeof(HashManifestArguments), &args);
+      }
+
+      break;
+    }
+
+    case DIALOG_STEP_VERIFY_MANIFEST_CONFIRMED:
+    {
+      if (msg_result == MESSAGE_DIALOG_RESULT_RUNNING) {
+        FileListEntry *file_entry = fileListGetNthEntry(&file_list, base_pos + rel_pos);
+        if (!file_entry) {
+          setDialogStep(DIALOG_STEP_NONE);
+          break;
+        }
+
+        snprintf(cur_file, MAX_PATH_LENGTH - 1, "%s%s", file_list.path, file_entry->name);
+
+        VerifyManifestArguments args;
+        args.file_path = cur_file;
+
+        setDialogStep(DIALOG_STEP_HASHING);
+
+        SceUID thid = sceKernelCreateThread("verify_manifest_thread", (SceKernelThreadEntry)verify_manifest_thread, 0x40, 0x100000, 0, 0, NULL);
+        if (thid >= 0)
+          sceKernelStartThread(thid, sizeof(VerifyManifestArguments), &args);
+      }
+
+      break;
+    }
     
     case DIALOG_STEP_INSTALL_QUESTION:
     {
@@ -1586,7 +1988,7 @@ static int fileBrowserMenuCtrl() {
       FileListEntry *file_entry = fileListGetNthEntry(&file_list, base_pos + rel_pos);
       if (file_entry && strcmp(file_entry->name, DIR_UP) != 0) {
         if (!fileListFindEntry(&mark_list, file_entry->name)) {
-          fileListAddEntry(&mark_list, fileListCopyEntry(file_entry), SORT_NONE);
+          fileListAddEntry(&mark_list, fileListCopyEntry(&mark_list, file_entry), SORT_NONE);
         } else {
           fileListRemoveEntryByName(&mark_list, file_entry->name);
         }
@@ -1700,7 +2102,7 @@ static int shellMain() {
 
           lastdir[i] = ch2;
 
-          refreshFileList();
+          loadFileList(0);
           setFocusOnFilename(p + 1);
 
           strcpy(file_list.path, lastdir);
@@ -1720,6 +2122,8 @@ static int shellMain() {
   initSettingsMenu();
 
   while (1) {
+    uint64_t frame_start = sceKernelGetProcessTimeWide();
+
     readPad();
 
     int refresh = REFRESH_MODE_NONE;
@@ -1753,6 +2157,9 @@ static int shellMain() {
     }
 
     if (refresh != REFRESH_MODE_NONE) {
+      // Operations may change sizes and other folders without touching the folder mtime
+      dirCacheClear();
+
       // Refresh lists
       refreshFileList();
       refreshMarkList();
@@ -1763,18 +2170,40 @@ static int shellMain() {
         setFocusOnFilename(focus_name);
     }
 
+    // Take over the entries of the background listing, but not while a thread uses the list
+    if (getDialogStep() == DIALOG_STEP_NONE && dirLoaderUpdate(&file_list))
+      finishFileList();
+
+    // List the focused folder ahead of time while the cursor rests on it
+    updatePrefetch();
+
     // Start drawing
     startDrawing(bg_browser_image);
 
     // Draw shell info
     drawShellInfo(file_list.path);
 
+    // Loading indicator
+    if (dirLoaderIsRunning()) {
+      char string[64];
+      snprintf(string, sizeof(string), language_container[LOADING_ENTRIES], dirLoaderGetCount());
+      pgf_draw_text(ALIGN_RIGHT(SCREEN_WIDTH - SHELL_MARGIN_X, pgf_text_width(string)), PATH_Y + FONT_Y_SPACE, PATH_COLOR, string);
+    }
+
     // Draw scroll bar
     drawScrollBar(base_pos, file_list.length);
 
     // Draw
     FileListEntry *file_entry = fileListGetNthEntry(&file_list, base_pos);
     if (file_entry) {
+      int render_key = getRenderKey();
+
+      float max_size_x = 0.0f, separator_x = 0.0f;
+      if (dir_level == 0) {
+        max_size_x = ALIGN_RIGHT(INFORMATION_X, pgf_text_width("0000.00 MB"));
+        separator_x = ALIGN_RIGHT(max_size_x, pgf_text_width("  /  "));
+      }
+
       int i;
       for (i = 0; i < MAX_ENTRIES && (base_pos+i) < file_list.length; i++) {
         uint32_t color = FILE_COLOR;
@@ -1830,6 +2259,9 @@ static int shellMain() {
         if (icon)
           vita2d_draw_texture(icon, SHELL_MARGIN_X, y + 3.0f);
 
+        if (file_entry->render_key != render_key)
+          formatEntry(file_entry, render_key);
+
         // Current position
         if (i == rel_pos)
           color = FOCUS_COLOR;
@@ -1845,7 +2277,7 @@ static int shellMain() {
         float x = FILE_X;
         
         if (i == rel_pos) {
-          int width = (int)pgf_text_width(file_entry->name);
+          int width = (int)file_entry->name_width;
           if (width >= MAX_NAME_WIDTH) {
             if (scroll_count < 60) {
               scroll_x = x;
@@ -1871,47 +2303,20 @@ static int shellMain() {
         // File information
         if (strcmp(file_entry->name, DIR_UP) != 0) {
           if (dir_level == 0) {
-            char used_size_string[16], max_size_string[16];
-            int max_size_x = ALIGN_RIGHT(INFORMATION_X, pgf_text_width("0000.00 MB"));
-            int separator_x = ALIGN_RIGHT(max_size_x, pgf_text_width("  /  "));
-            if (file_entry->size != 0 && file_entry->size2 != 0) {
-              getSizeString(used_size_string, file_entry->size2 - file_entry->size);
-              getSizeString(max_size_string, file_entry->size2);
-            } else {
-              strcpy(used_size_string, "-");
-              strcpy(max_size_string, "-");
-            }
-            
-            float x = ALIGN_RIGHT(INFORMATION_X, pgf_text_width(max_size_string));
-            pgf_draw_text(x, y, color, max_size_string);
+            // Used size / max size
+            float x = ALIGN_RIGHT(INFORMATION_X, file_entry->max_size_width);
+            pgf_draw_text(x, y, color, file_entry->max_size_string);
             pgf_draw_text(separator_x, y, color, "  /");
-            x = ALIGN_RIGHT(separator_x, pgf_text_width(used_size_string));
-            pgf_draw_text(x, y, color, used_size_string);
+            x = ALIGN_RIGHT(separator_x, file_entry->size_width);
+            pgf_draw_text(x, y, color, file_entry->size_string);
           } else {
-            char *str = NULL;
-            if (!file_entry->is_folder) {
-              // Folder/size
-              char string[16];
-              getSizeString(string, file_entry->size);
-              str = string;
-            } else {
-              str = language_container[FOLDER];
-            }
-            pgf_draw_text(ALIGN_RIGHT(INFORMATION_X, pgf_text_width(str)), y, color, str);
+            // Folder/size
+            pgf_draw_text(ALIGN_RIGHT(INFORMATION_X, file_entry->size_width), y, color, file_entry->size_string);
           }
 
           // Date
-          char date_string[16];
-          getDateString(date_string, date_format, &file_entry->mtime);
-
-          char time_string[24];
-          getTimeString(time_string, time_format, &file_entry->mtime);
-
-          char string[64];
-          sprintf(string, "%s %s", date_string, time_string);
-
-          float x = ALIGN_RIGHT(SCREEN_WIDTH - SHELL_MARGIN_X, pgf_text_width(string));
-          pgf_draw_text(x, y, color, string);
+          float x = ALIGN_RIGHT(SCREEN_WIDTH - SHELL_MARGIN_X, file_entry->date_width);
+          pgf_draw_text(x, y, color, file_entry->date_string);
         }
 
         // Next
@@ -1919,6 +2324,10 @@ static int shellMain() {
       }
     }
 
+    // Draw debug overlay
+    if (vitashell_config.debug_overlay)
+      drawDebugOverlay();
+
     // Draw settings menu
     drawSettingsMenu();
 
@@ -1931,11 +2340,15 @@ static int shellMain() {
     // Draw property dialog
     drawPropertyDialog();
 
+    updateFrameTime((uint32_t)(sceKernelGetProcessTimeWide() - frame_start));
+
     // End drawing
     endDrawing();
   }
 
   // Empty lists
+  dirPrefetchExit();
+  dirLoaderCancel();
   fileListEmpty(&copy_list);
   fileListEmpty(&mark_list);
   fileListEmpty(&file_list);
@@ -1955,6 +2368,78 @@ void ftpvita_PROM(ftpvita_client_info_t *client) {
   }
 }
 
+static volatile int io_bench_running = 0;
+
+static int io_bench_thread(SceSize args, char *mount_point) {
+  // Calibrate the given device or all user devices
+  if (mount_point[0] != '\0') {
+    if (ioProfileCalibrate(mount_point) >= 0)
+      ioProfileSave();
+  } else {
+    ioProfileCalibrateAll();
+  }
+
+  io_bench_running = 0;
+
+  return sceKernelExitDeleteThread(0);
+}
+
+// Calibration takes a while, so it does not run on the control connection
+void ftpvita_IOBENCH(ftpvita_client_info_t *client) {
+  char cmd[64];
+  char mount_point[MAX_MOUNT_POINT_LENGTH];
+  memset(mount_point, 0, sizeof(mount_point));
+  sscanf(client->recv_buffer, "%63s %15s", cmd, mount_point);
+
+  if (io_bench_running) {
+    ftpvita_ext_client_send_ctrl_msg(client, "450 BUSY CALIBRATING\r\n");
+    return;
+  }
+
+  io_bench_running = 1;
+
+  SceUID thid = sceKernelCreateThread("io_bench_thread", (SceKernelThreadEntry)io_bench_thread, 0x10000100, 0x10000, 0, 0, NULL);
+  if (thid < 0) {
+    io_bench_running = 0;
+    ftpvita_ext_client_send_ctrl_msg(client, "500 ERROR CALIBRATING\r\n");
+    return;
+  }
+
+  sceKernelStartThread(thid, sizeof(mount_point), mount_point);
+
+  ftpvita_ext_client_send_ctrl_msg(client, "200 OK CALIBRATING, SEE IOPROFILE\r\n");
+}
+
+void ftpvita_IOPROFILE(ftpvita_client_info_t *client) {
+  if (io_bench_running) {
+    ftpvita_ext_client_send_ctrl_msg(client, "450 BUSY CALIBRATING\r\n");
+    return;
+  }
+
+  char *table = malloc(4096);
+  if (!table) {
+    ftpvita_ext_client_send_ctrl_msg(client, "500 ERROR\r\n");
+    return;
+  }
+
+  // Send the table as a multi-line reply
+  char line[128];
+  char *p = table;
+  ioProfilePrint(table, 4096);
+
+  while (*p) {
+    char *end = strstr(p, "\r\n");
+    int len = end ? end - p : strlen(p);
+    snprintf(line, sizeof(line), "200-%.*s\r\n", len, p);
+    ftpvita_ext_client_send_ctrl_msg(client, line);
+    p += end ? len + 2 : len;
+  }
+
+  ftpvita_ext_client_send_ctrl_msg(client, "200 OK\r\n");
+
+  free(table);
+}
+
 int main(int argc, const char *argv[]) {  
   // Create mutex
   sceKernelCreateLwMutex(&dialog_mutex, "dialog_mutex", 2, 0, NULL);
@@ -1970,6 +2455,16 @@ int main(int argc, const char *argv[]) {
   // Load settings
   loadSettingsConfig();
 
+  // Load I/O profile
+  ioProfileLoad();
+
+  // Init file type lookup
+  initFileTypes();
+
+  // Init folder cache and prefetching
+  dirCacheInit();
+  dirPrefetchInit();
+
   // Load theme
   loadTheme();
 
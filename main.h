@@ -143,6 +143,8 @@
 // Max entries
 #define MAX_QR_LENGTH 1024
 #define MAX_POSITION 16
+
+#define FRAME_TIME_WINDOW 60
 #define MAX_ENTRIES 17
 #define MAX_URL_LENGTH 128
 
@@ -217,6 +219,10 @@ enum DialogSteps {
   DIALOG_STEP_HASH_CONFIRMED,
   DIALOG_STEP_HASHING,
 
+  DIALOG_STEP_HASH_MANIFEST_QUESTION,
+  DIALOG_STEP_HASH_MANIFEST_CONFIRMED,
+  DIALOG_STEP_VERIFY_MANIFEST_CONFIRMED,
+
   DIALOG_STEP_SETTINGS_AGREEMENT,
   DIALOG_STEP_SETTINGS_STRING,
   
@@ -242,6 +248,9 @@ enum DialogSteps {
   DIALOG_STEP_ADHOC_RECEIVE_QUESTION,
   DIALOG_STEP_ADHOC_RECEIVING,
   DIALOG_STEP_ADHOC_RECEIVED,
+
+  DIALOG_STEP_SEARCH,
+  DIALOG_STEP_FIND_DUPLICATES_QUESTION,
 };
 
 extern FileList file_list, mark_list, copy_list, install_list;
@@ -275,5 +284,7 @@ int isInArchive();
 int refreshFileList();
 
 void ftpvita_PROM(ftpvita_client_info_t *client);
+void ftpvita_IOBENCH(ftpvita_client_info_t *client);
+void ftpvita_IOPROFILE(ftpvita_client_info_t *client);
 
 #endif
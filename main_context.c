@@ -19,8 +19,11 @@
 #include "main.h"
 #include "init.h"
 #include "io_process.h"
+#include "hash_manifest.h"
 #include "context_menu.h"
 #include "file.h"
+#include "dir_cache.h"
+#include "dir_prefetch.h"
 #include "language.h"
 #include "property_dialog.h"
 #include "message_dialog.h"
@@ -46,6 +49,8 @@ enum MenuHomeEntrys {
   MENU_HOME_ENTRY_UMOUNT_USB_UX0,
   MENU_HOME_ENTRY_MOUNT_GAMECARD_UX0,
   MENU_HOME_ENTRY_UMOUNT_GAMECARD_UX0,
+  MENU_HOME_ENTRY_SEARCH,
+  MENU_HOME_ENTRY_FIND_DUPLICATES,
 };
 
 MenuEntry menu_home_entries[] = {
@@ -61,6 +66,8 @@ MenuEntry menu_home_entries[] = {
   { UMOUNT_USB_UX0,      12, 0, CTX_INVISIBLE },
   { MOUNT_GAMECARD_UX0,  14, 0, CTX_INVISIBLE },
   { UMOUNT_GAMECARD_UX0, 15, 0, CTX_INVISIBLE },
+  { SEARCH,              17, 0, CTX_INVISIBLE },
+  { FIND_DUPLICATES,     18, 0, CTX_INVISIBLE },
 };
 
 #define N_MENU_HOME_ENTRIES (sizeof(menu_home_entries) / sizeof(MenuEntry))
@@ -77,6 +84,8 @@ enum MenuMainEntrys {
   MENU_MAIN_ENTRY_PROPERTIES,
   MENU_MAIN_ENTRY_SORT_BY,
   MENU_MAIN_ENTRY_MORE,
+  MENU_MAIN_ENTRY_SEARCH,
+  MENU_MAIN_ENTRY_FIND_DUPLICATES,
   MENU_MAIN_ENTRY_SEND,
   MENU_MAIN_ENTRY_RECEIVE,
 };
@@ -93,8 +102,10 @@ MenuEntry menu_main_entries[] = {
   { PROPERTIES,     11, 0, CTX_INVISIBLE },
   { SORT_BY,        13, CTX_FLAG_MORE, CTX_VISIBLE },
   { MORE,           14, CTX_FLAG_MORE, CTX_INVISIBLE },
-  { SEND,           17, 0, CTX_INVISIBLE }, // CTX_FLAG_BARRIER
-  { RECEIVE,        18, 0, CTX_INVISIBLE },
+  { SEARCH,         15, 0, CTX_INVISIBLE },
+  { FIND_DUPLICATES, 16, 0, CTX_INVISIBLE },
+  { SEND,           18, 0, CTX_INVISIBLE }, // CTX_FLAG_BARRIER
+  { RECEIVE,        19, 0, CTX_INVISIBLE },
 };
 
 #define N_MENU_MAIN_ENTRIES (sizeof(menu_main_entries) / sizeof(MenuEntry))
@@ -119,6 +130,8 @@ enum MenuMoreEntrys {
   MENU_MORE_ENTRY_INSTALL_FOLDER,
   MENU_MORE_ENTRY_EXPORT_MEDIA,
   MENU_MORE_ENTRY_CALCULATE_SHA1,
+  MENU_MORE_ENTRY_CREATE_HASH_MANIFEST,
+  MENU_MORE_ENTRY_VERIFY_HASH_MANIFEST,
 };
 
 MenuEntry menu_more_entries[] = {
@@ -127,6 +140,8 @@ MenuEntry menu_more_entries[] = {
   { INSTALL_FOLDER, 14, 0, CTX_INVISIBLE },
   { EXPORT_MEDIA,   15, 0, CTX_INVISIBLE },
   { CALCULATE_SHA1, 16, 0, CTX_INVISIBLE },
+  { CREATE_HASH_MANIFEST, 17, 0, CTX_INVISIBLE },
+  { VERIFY_HASH_MANIFEST, 18, 0, CTX_INVISIBLE },
 };
 
 #define N_MENU_MORE_ENTRIES (sizeof(menu_more_entries) / sizeof(MenuEntry))
@@ -233,6 +248,10 @@ int pfsMount(const char *path) {
 
   memset(klicensee, 0, sizeof(klicensee));
 
+  // Mounted game data is not the same as the listing of the plain folder
+  dirPrefetchCancel();
+  dirCacheClear();
+
 /*
   snprintf(work_path, MAX_PATH_LENGTH - 1, "%ssce_sys/package/work.bin", path);
   if (ReadFile(work_path, license_buf, sizeof(license_buf)) == sizeof(license_buf)) {
@@ -456,6 +475,12 @@ void setContextMenuMainVisibilities() {
     menu_main_entries[MENU_MAIN_ENTRY_RECEIVE].visibility = CTX_INVISIBLE;
   }
 
+  // Invisible 'Search' and 'Find duplicates' in archives
+  if (isInArchive()) {
+    menu_main_entries[MENU_MAIN_ENTRY_SEARCH].visibility = CTX_INVISIBLE;
+    menu_main_entries[MENU_MAIN_ENTRY_FIND_DUPLICATES].visibility = CTX_INVISIBLE;
+  }
+
   // Mark/Unmark all text
   if (mark_list.length == (file_list.length - 1)) { // All marked
     menu_main_entries[MENU_MAIN_ENTRY_MARK_UNMARK_ALL].name = UNMARK_ALL;
@@ -540,6 +565,8 @@ void setContextMenuMoreVisibilities() {
     menu_more_entries[MENU_MORE_ENTRY_INSTALL_FOLDER].visibility = CTX_INVISIBLE;
     menu_more_entries[MENU_MORE_ENTRY_EXPORT_MEDIA].visibility = CTX_INVISIBLE;
     menu_more_entries[MENU_MORE_ENTRY_CALCULATE_SHA1].visibility = CTX_INVISIBLE;
+    menu_more_entries[MENU_MORE_ENTRY_CREATE_HASH_MANIFEST].visibility = CTX_INVISIBLE;
+    menu_more_entries[MENU_MORE_ENTRY_VERIFY_HASH_MANIFEST].visibility = CTX_INVISIBLE;
   }
 
   // Invisble operations in archives
@@ -549,6 +576,13 @@ void setContextMenuMoreVisibilities() {
     menu_more_entries[MENU_MORE_ENTRY_INSTALL_FOLDER].visibility = CTX_INVISIBLE;
     menu_more_entries[MENU_MORE_ENTRY_EXPORT_MEDIA].visibility = CTX_INVISIBLE;
     menu_more_entries[MENU_MORE_ENTRY_CALCULATE_SHA1].visibility = CTX_INVISIBLE;
+    menu_more_entries[MENU_MORE_ENTRY_CREATE_HASH_MANIFEST].visibility = CTX_INVISIBLE;
+    menu_more_entries[MENU_MORE_ENTRY_VERIFY_HASH_MANIFEST].visibility = CTX_INVISIBLE;
+  }
+
+  // Verify only checksum files
+  if (file_entry->is_folder || hashManifestGetFormat(file_entry->name) < 0) {
+    menu_more_entries[MENU_MORE_ENTRY_VERIFY_HASH_MANIFEST].visibility = CTX_INVISIBLE;
   }
 
   if (file_entry->is_folder) {
@@ -780,6 +814,20 @@ static int contextMenuHomeEnterCallback(int sel, void *context) {
       }
       break;
     }
+
+    case MENU_HOME_ENTRY_SEARCH:
+    {
+      initImeDialog(language_container[SEARCH_QUERY], "", MAX_NAME_LENGTH, SCE_IME_TYPE_BASIC_LATIN, 0, 0);
+      setDialogStep(DIALOG_STEP_SEARCH);
+      break;
+    }
+
+    case MENU_HOME_ENTRY_FIND_DUPLICATES:
+    {
+      initMessageDialog(SCE_MSG_DIALOG_BUTTON_TYPE_YESNO, language_container[FIND_DUPLICATES_QUESTION]);
+      setDialogStep(DIALOG_STEP_FIND_DUPLICATES_QUESTION);
+      break;
+    }
   }
 
   return CONTEXT_MENU_CLOSING;
@@ -857,7 +905,7 @@ static int contextMenuMainEnterCallback(int sel, void *context) {
 
           int i;
           for (i = 0; i < file_list.length - 1; i++) {
-            fileListAddEntry(&mark_list, fileListCopyEntry(file_entry), SORT_NONE);
+            fileListAddEntry(&mark_list, fileListCopyEntry(&mark_list, file_entry), SORT_NONE);
 
             // Next
             file_entry = file_entry->next;
@@ -899,13 +947,13 @@ static int contextMenuMainEnterCallback(int sel, void *context) {
 
           int i;
           for (i = 0; i < mark_list.length; i++) {
-            fileListAddEntry(&copy_list, fileListCopyEntry(mark_entry), SORT_NONE);
+            fileListAddEntry(&copy_list, fileListCopyEntry(&copy_list, mark_entry), SORT_NONE);
 
             // Next
             mark_entry = mark_entry->next;
           }
         } else {
-          fileListAddEntry(&copy_list, fileListCopyEntry(file_entry), SORT_NONE);
+          fileListAddEntry(&copy_list, fileListCopyEntry(&copy_list, file_entry), SORT_NONE);
         }
 
         strcpy(copy_list.path, file_list.path);
@@ -1018,6 +1066,20 @@ static int contextMenuMainEnterCallback(int sel, void *context) {
       return CONTEXT_MENU_MORE_OPENING;
     }
 
+    case MENU_MAIN_ENTRY_SEARCH:
+    {
+      initImeDialog(language_container[SEARCH_QUERY], "", MAX_NAME_LENGTH, SCE_IME_TYPE_BASIC_LATIN, 0, 0);
+      setDialogStep(DIALOG_STEP_SEARCH);
+      break;
+    }
+
+    case MENU_MAIN_ENTRY_FIND_DUPLICATES:
+    {
+      initMessageDialog(SCE_MSG_DIALOG_BUTTON_TYPE_YESNO, language_container[FIND_DUPLICATES_QUESTION]);
+      setDialogStep(DIALOG_STEP_FIND_DUPLICATES_QUESTION);
+      break;
+    }
+
     case MENU_MAIN_ENTRY_SEND:
     {
       initNetCheckDialog(SCE_NETCHECK_DIALOG_MODE_PSP_ADHOC_JOIN, 60 * 1000 * 1000);
@@ -1051,8 +1113,9 @@ static int contextMenuSortEnterCallback(int sel, void *context) {
       break;
   }
 
-  // Refresh list
-  refreshFileList();
+  // Re-sort the entries in memory, the devices are always sorted by name
+  if (strcmp(file_list.path, HOME_PATH) != 0)
+    fileListSort(&file_list, sort_mode);
 
   return CONTEXT_MENU_CLOSING;
 }
@@ -1117,7 +1180,7 @@ static int contextMenuMoreEnterCallback(int sel, void *context) {
 
         int type = getFileType(path);
         if (type == FILE_TYPE_VPK) {
-          fileListAddEntry(&install_list, fileListCopyEntry(file_entry), SORT_NONE);
+          fileListAddEntry(&install_list, fileListCopyEntry(&install_list, file_entry), SORT_NONE);
         }
 
         // Next
@@ -1171,6 +1234,20 @@ static int contextMenuMoreEnterCallback(int sel, void *context) {
       setDialogStep(DIALOG_STEP_HASH_QUESTION);
       break;
     }
+
+    case MENU_MORE_ENTRY_CREATE_HASH_MANIFEST:
+    {
+      initMessageDialog(SCE_MSG_DIALOG_BUTTON_TYPE_YESNO, language_container[HASH_FILE_QUESTION]);
+      setDialogStep(DIALOG_STEP_HASH_MANIFEST_QUESTION);
+      break;
+    }
+
+    case MENU_MORE_ENTRY_VERIFY_HASH_MANIFEST:
+    {
+      initMessageDialog(MESSAGE_DIALOG_PROGRESS_BAR, language_container[VERIFYING]);
+      setDialogStep(DIALOG_STEP_VERIFY_MANIFEST_CONFIRMED);
+      break;
+    }
   }
 
   return CONTEXT_MENU_CLOSING;
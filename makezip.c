@@ -19,6 +19,7 @@
 #include "main.h"
 #include "io_process.h"
 #include "makezip.h"
+#include "io_profile.h"
 #include "file.h"
 #include "utils.h"
 
@@ -76,12 +77,13 @@ static int zipAddFile(zipFile zf, const char *path, int filename_start, int leve
   }
 
   // Add file to zip
-  void *buf = memalign(4096, TRANSFER_SIZE);
+  int buf_size = ioProfileGetReadSize(path);
+  void *buf = memalign(4096, buf_size);
 
   uint64_t seek = 0;
 
   while (1) {
-    int read = sceIoRead(fd, buf, TRANSFER_SIZE);
+    int read = sceIoRead(fd, buf, buf_size);
 
     if (read < 0) {
       free(buf);
@@ -251,15 +253,16 @@ int compress_thread(SceSize args_size, CompressArguments *args) {
 
   int count = 0;
   FileListEntry *head = NULL;
-  FileListEntry *mark_entry_one = NULL;
+  FileList mark_list_one;
+  memset(&mark_list_one, 0, sizeof(FileList));
 
   if (fileListFindEntry(args->mark_list, file_entry->name)) { // On marked entry
     count = args->mark_list->length;
     head = args->mark_list->head;
   } else {
     count = 1;
-    mark_entry_one = fileListCopyEntry(file_entry);
-    head = mark_entry_one;
+    fileListAddEntry(&mark_list_one, fileListCopyEntry(&mark_list_one, file_entry), SORT_NONE);
+    head = mark_list_one.head;
   }
 
   char path[MAX_PATH_LENGTH];
@@ -321,8 +324,7 @@ int compress_thread(SceSize args_size, CompressArguments *args) {
   setDialogStep(DIALOG_STEP_COMPRESSED);
 
 EXIT:
-  if (mark_entry_one)
-    free(mark_entry_one);
+  fileListEmpty(&mark_list_one);
 
   if (thid >= 0)
     sceKernelWaitThreadEnd(thid, NULL, NULL);
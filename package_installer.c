@@ -397,30 +397,6 @@ int install_thread(SceSize args_size, InstallArguments *args) {
       goto EXIT;
     }
 
-    // Team molecule's request: Full permission access warning
-    int unsafe = archiveCheckFilesForUnsafeFself(); // 0: Safe, 1: Unsafe, 2: Dangerous
-    if (unsafe) {
-      closeWaitDialog();
-
-      initMessageDialog(SCE_MSG_DIALOG_BUTTON_TYPE_YESNO, language_container[unsafe == 2 ? INSTALL_BRICK_WARNING : INSTALL_WARNING]);
-      setDialogStep(DIALOG_STEP_INSTALL_WARNING);
-
-      // Wait for response
-      while (getDialogStep() == DIALOG_STEP_INSTALL_WARNING) {
-        sceKernelDelayThread(10 * 1000);
-      }
-
-      // Canceled
-      if (getDialogStep() == DIALOG_STEP_CANCELED) {
-        closeWaitDialog();
-        goto EXIT;
-      }
-
-      // Init again
-      initMessageDialog(MESSAGE_DIALOG_PROGRESS_BAR, language_container[INSTALLING]);
-      setDialogStep(DIALOG_STEP_INSTALLING);
-    }
-
     // Src path
     char src_path[MAX_PATH_LENGTH];
     strcpy(src_path, args->file);
@@ -447,7 +423,9 @@ int install_thread(SceSize args_size, InstallArguments *args) {
     param.SetProgress = SetProgress;
     param.cancelHandler = cancelHandler;
 
-    res = extractArchivePath(src_path, PACKAGE_DIR "/", &param);
+    // The files are checked for unsafe imports while being extracted
+    int unsafe = 0; // 0: Safe, 1: Unsafe, 2: Dangerous
+    res = extractArchivePathCheckUnsafe(src_path, PACKAGE_DIR "/", &param, &unsafe);
     if (res <= 0) {
       closeWaitDialog();
       setDialogStep(DIALOG_STEP_CANCELED);
@@ -462,6 +440,34 @@ int install_thread(SceSize args_size, InstallArguments *args) {
       errorDialog(res);
       goto EXIT;
     }
+
+    // Team molecule's request: Full permission access warning
+    if (unsafe) {
+      closeWaitDialog();
+
+      if (thid >= 0) {
+        sceKernelWaitThreadEnd(thid, NULL, NULL);
+        thid = -1;
+      }
+
+      initMessageDialog(SCE_MSG_DIALOG_BUTTON_TYPE_YESNO, language_container[unsafe == 2 ? INSTALL_BRICK_WARNING : INSTALL_WARNING]);
+      setDialogStep(DIALOG_STEP_INSTALL_WARNING);
+
+      // Wait for response
+      while (getDialogStep() == DIALOG_STEP_INSTALL_WARNING) {
+        sceKernelDelayThread(10 * 1000);
+      }
+
+      // Canceled, the extracted files are removed on exit
+      if (getDialogStep() == DIALOG_STEP_CANCELED) {
+        closeWaitDialog();
+        goto EXIT;
+      }
+
+      // Init again
+      initMessageDialog(MESSAGE_DIALOG_PROGRESS_BAR, language_container[INSTALLING]);
+      setDialogStep(DIALOG_STEP_INSTALLING);
+    }
   }
 
   // Make head.bin
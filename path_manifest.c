@@ -0,0 +1,320 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "main.h"
+#include "path_manifest.h"
+#include "file.h"
+#include "utils.h"
+
+void pathManifestInit(PathManifest *manifest, uint32_t max_memory) {
+  memset(manifest, 0, sizeof(PathManifest));
+  manifest->max_memory = max_memory;
+}
+
+void pathManifestFree(PathManifest *manifest) {
+  PathManifestBlock *block = manifest->blocks;
+  while (block) {
+    PathManifestBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+
+  free(manifest->entries);
+
+  memset(manifest, 0, sizeof(PathManifest));
+}
+
+static void setOverflow(PathManifest *manifest) {
+  manifest->overflow = 1;
+
+  // Keep the roots only
+  uint32_t i, n = 0;
+  for (i = 0; i < manifest->n_entries; i++) {
+    if (manifest->entries[i].parent < 0)
+      manifest->entries[n++] = manifest->entries[i];
+  }
+
+  manifest->n_entries = n;
+}
+
+static const char *storeName(PathManifest *manifest, const char *name, int root) {
+  uint32_t len = strlen(name) + 1;
+
+  PathManifestBlock *block = manifest->blocks;
+  if (!block || block->used + len > PATH_MANIFEST_BLOCK_SIZE) {
+    if (!root && manifest->memory + PATH_MANIFEST_BLOCK_SIZE > manifest->max_memory)
+      return NULL;
+
+    block = malloc(sizeof(PathManifestBlock) + PATH_MANIFEST_BLOCK_SIZE);
+    if (!block)
+      return NULL;
+
+    block->used = 0;
+    block->next = manifest->blocks;
+    manifest->blocks = block;
+    manifest->memory += PATH_MANIFEST_BLOCK_SIZE;
+  }
+
+  char *p = block->data + block->used;
+  memcpy(p, name, len);
+  block->used += len;
+
+  return p;
+}
+
+// Returns the index of the entry or -1 if it was not stored
+static int addEntry(PathManifest *manifest, int parent, const char *name, SceIoStat *stat, int root) {
+  if (!root && (manifest->overflow || parent < 0))
+    return -1;
+
+  if (manifest->n_entries == manifest->max_entries) {
+    uint32_t max_entries = manifest->max_entries ? manifest->max_entries * 2 : 256;
+    uint32_t memory = (max_entries - manifest->max_entries) * sizeof(PathManifestEntry);
+
+    if (!root && manifest->memory + memory > manifest->max_memory) {
+      setOverflow(manifest);
+      return -1;
+    }
+
+    PathManifestEntry *entries = realloc(manifest->entries, max_entries * sizeof(PathManifestEntry));
+    if (!entries) {
+      setOverflow(manifest);
+      return -1;
+    }
+
+    manifest->entries = entries;
+    manifest->max_entries = max_entries;
+    manifest->memory += memory;
+  }
+
+  const char *p = storeName(manifest, name, root);
+  if (!p) {
+    setOverflow(manifest);
+    return -1;
+  }
+
+  PathManifestEntry *entry = &manifest->entries[manifest->n_entries];
+  entry->name = p;
+  entry->parent = root ? -1 : parent;
+  entry->mode = stat->st_mode;
+  entry->size = stat->st_size;
+  memcpy(&entry->mtime, &stat->st_mtime, sizeof(SceDateTime));
+
+  return manifest->n_entries++;
+}
+
+static int addFolder(PathManifest *manifest, SceUID dfd, char *path, int parent, int (* handler)(const char *path)) {
+  int len = strlen(path);
+  int slash = !hasEndSlash(path);
+  int res = 0;
+
+  do {
+    SceIoDirent dir;
+    memset(&dir, 0, sizeof(SceIoDirent));
+
+    res = sceIoDread(dfd, &dir);
+    if (res > 0) {
+      snprintf(path + len, MAX_PATH_LENGTH - len, "%s%s", slash ? "/" : "", dir.d_name);
+
+      if (handler && handler(path))
+        continue;
+
+      int index = addEntry(manifest, parent, dir.d_name, &dir.d_stat, 0);
+
+      if (SCE_S_ISDIR(dir.d_stat.st_mode)) {
+        SceUID child = sceIoDopen(path);
+        if (child < 0) {
+          path[len] = '\0';
+          return child;
+        }
+
+        int ret = addFolder(manifest, child, path, index, handler);
+        sceIoDclose(child);
+
+        if (ret <= 0) {
+          path[len] = '\0';
+          return ret;
+        }
+
+        manifest->folders++;
+      } else {
+        manifest->size += dir.d_stat.st_size;
+        manifest->files++;
+      }
+    }
+  } while (res > 0);
+
+  path[len] = '\0';
+
+  return 1;
+}
+
+int pathManifestAdd(PathManifest *manifest, const char *base, const char *name, int (* handler)(const char *path)) {
+  char path[MAX_PATH_LENGTH];
+  snprintf(path, MAX_PATH_LENGTH, "%s%s", base, name);
+
+  SceIoStat stat;
+  memset(&stat, 0, sizeof(SceIoStat));
+
+  SceUID dfd = sceIoDopen(path);
+  if (dfd >= 0) {
+    sceIoGetstatByFd(dfd, &stat);
+
+    int index = addEntry(manifest, -1, name, &stat, 1);
+    int res = addFolder(manifest, dfd, path, index, handler);
+
+    sceIoDclose(dfd);
+
+    if (res <= 0)
+      return res;
+
+    manifest->folders++;
+  } else {
+    if (handler && handler(path))
+      return 1;
+
+    int res = sceIoGetstat(path, &stat);
+    if (res < 0)
+      return res;
+
+    addEntry(manifest, -1, name, &stat, 1);
+
+    manifest->size += stat.st_size;
+    manifest->files++;
+  }
+
+  return 1;
+}
+
+int pathManifestGetPath(PathManifest *manifest, int index, const char *base, char *path, int size) {
+  PathManifestEntry *entry = &manifest->entries[index];
+
+  if (entry->parent < 0)
+    return snprintf(path, size, "%s%s", base, entry->name);
+
+  int len = pathManifestGetPath(manifest, entry->parent, base, path, size);
+  if (len >= size - 1)
+    return len;
+
+  return len + snprintf(path + len, size - len, "%s%s", hasEndSlash(path) ? "" : "/", entry->name);
+}
+
+static int copyFolder(const char *src_path, const char *dst_path, SceMode mode, FileProcessParam *param) {
+  int ret = sceIoMkdir(dst_path, (mode | SCE_S_IWUSR) & 0xFFF);
+  if (ret < 0 && ret != SCE_ERROR_ERRNO_EEXIST)
+    return ret;
+
+  if (ret == SCE_ERROR_ERRNO_EEXIST) {
+    SceIoStat stat;
+    memset(&stat, 0, sizeof(SceIoStat));
+    if (sceIoGetstat(src_path, &stat) >= 0) {
+      stat.st_mode |= SCE_S_IWUSR;
+      sceIoChstat(dst_path, &stat, 0x3B);
+    }
+  }
+
+  if (param) {
+    if (param->value)
+      (*param->value) += DIRECTORY_SIZE;
+
+    if (param->SetProgress)
+      param->SetProgress(param->value ? *param->value : 0, param->max);
+
+    if (param->cancelHandler && param->cancelHandler())
+      return 0;
+  }
+
+  return 1;
+}
+
+int pathManifestCopy(PathManifest *manifest, const char *src_base, const char *dst_base, FileProcessParam *param) {
+  char src_path[MAX_PATH_LENGTH], dst_path[MAX_PATH_LENGTH];
+
+  uint32_t i;
+  for (i = 0; i < manifest->n_entries; i++) {
+    PathManifestEntry *entry = &manifest->entries[i];
+
+    pathManifestGetPath(manifest, i, src_base, src_path, MAX_PATH_LENGTH);
+    pathManifestGetPath(manifest, i, dst_base, dst_path, MAX_PATH_LENGTH);
+
+    int res = 0;
+
+    if (manifest->overflow) {
+      res = copyPath(src_path, dst_path, param);
+    } else {
+      if (entry->parent < 0) {
+        // The source and destination paths are identical
+        if (strcasecmp(src_path, dst_path) == 0)
+          return -1;
+
+        // The destination is a subfolder of the source folder
+        int len = strlen(src_path);
+        if (strncasecmp(src_path, dst_path, len) == 0 && (dst_path[len] == '/' || dst_path[len - 1] == '/'))
+          return -2;
+      }
+
+      if (SCE_S_ISDIR(entry->mode)) {
+        res = copyFolder(src_path, dst_path, entry->mode, param);
+      } else {
+        res = copyFile(src_path, dst_path, param);
+      }
+    }
+
+    if (res <= 0)
+      return res;
+  }
+
+  return 1;
+}
+
+int pathManifestRemove(PathManifest *manifest, const char *base, FileProcessParam *param) {
+  char path[MAX_PATH_LENGTH];
+
+  // Walk backwards, so that folders are empty when they are reached
+  int i;
+  for (i = manifest->n_entries - 1; i >= 0; i--) {
+    PathManifestEntry *entry = &manifest->entries[i];
+
+    pathManifestGetPath(manifest, i, base, path, MAX_PATH_LENGTH);
+
+    if (manifest->overflow) {
+      int res = removePath(path, param);
+      if (res <= 0)
+        return res;
+
+      continue;
+    }
+
+    int ret = SCE_S_ISDIR(entry->mode) ? sceIoRmdir(path) : sceIoRemove(path);
+    if (ret < 0)
+      return ret;
+
+    if (param) {
+      if (param->value)
+        (*param->value)++;
+
+      if (param->SetProgress)
+        param->SetProgress(param->value ? *param->value : 0, param->max);
+
+      if (param->cancelHandler && param->cancelHandler())
+        return 0;
+    }
+  }
+
+  return 1;
+}
@@ -0,0 +1,64 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __PATH_MANIFEST_H__
+#define __PATH_MANIFEST_H__
+
+#include "file.h"
+
+#define PATH_MANIFEST_BLOCK_SIZE (64 * 1024)
+#define PATH_MANIFEST_MAX_MEMORY (8 * 1024 * 1024)
+
+typedef struct PathManifestBlock {
+  struct PathManifestBlock *next;
+  uint32_t used;
+  char data[];
+} PathManifestBlock;
+
+typedef struct {
+  const char *name;
+  int32_t parent; // -1 for the paths passed to pathManifestAdd
+  SceMode mode;
+  uint64_t size;
+  SceDateTime mtime;
+} PathManifestEntry;
+
+// Entries are stored in pre-order, so a folder always comes before its content
+typedef struct {
+  PathManifestEntry *entries;
+  uint32_t n_entries;
+  uint32_t max_entries;
+  PathManifestBlock *blocks;
+  uint32_t memory;
+  uint32_t max_memory;
+  int overflow; // Only the roots are kept, the transfer pass walks them again
+  uint64_t size;
+  uint32_t folders;
+  uint32_t files;
+} PathManifest;
+
+void pathManifestInit(PathManifest *manifest, uint32_t max_memory);
+void pathManifestFree(PathManifest *manifest);
+
+int pathManifestAdd(PathManifest *manifest, const char *base, const char *name, int (* handler)(const char *path));
+int pathManifestGetPath(PathManifest *manifest, int index, const char *base, char *path, int size);
+
+int pathManifestCopy(PathManifest *manifest, const char *src_base, const char *dst_base, FileProcessParam *param);
+int pathManifestRemove(PathManifest *manifest, const char *base, FileProcessParam *param);
+
+#endif
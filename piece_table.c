@@ -0,0 +1,374 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "piece_table.h"
+
+#define SUM_LENGTH(node) ((node) ? (node)->sum_length : 0)
+#define SUM_BREAKS(node) ((node) ? (node)->sum_breaks : 0)
+
+static uint32_t countBreaks(const char *data, uint32_t size) {
+  uint32_t breaks = 0;
+  const char *end = data + size;
+
+  while (data < end) {
+    data = memchr(data, '\n', end - data);
+    if (!data)
+      break;
+
+    breaks++;
+    data++;
+  }
+
+  return breaks;
+}
+
+static const char *getPieceData(PieceTable *table, PieceNode *node) {
+  return (node->source == PIECE_SOURCE_ORIGINAL ? table->original : table->add) + node->start;
+}
+
+static uint32_t nextPriority(PieceTable *table) {
+  // xorshift32
+  uint32_t x = table->seed;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  table->seed = x;
+  return x;
+}
+
+static void updateNode(PieceNode *node) {
+  node->sum_length = SUM_LENGTH(node->left) + node->length + SUM_LENGTH(node->right);
+  node->sum_breaks = SUM_BREAKS(node->left) + node->breaks + SUM_BREAKS(node->right);
+}
+
+static int reserveNodes(PieceTable *table) {
+  int i;
+  for (i = 0; i < 2; i++) {
+    if (!table->spare[i]) {
+      table->spare[i] = malloc(sizeof(PieceNode));
+      if (!table->spare[i])
+        return PIECE_TABLE_ERROR_NO_MEMORY;
+    }
+  }
+
+  return 0;
+}
+
+static PieceNode *takeNode(PieceTable *table, int source, uint32_t start, uint32_t length, uint32_t breaks) {
+  PieceNode *node = table->spare[0] ? table->spare[0] : table->spare[1];
+  if (node == table->spare[0])
+    table->spare[0] = NULL;
+  else
+    table->spare[1] = NULL;
+
+  memset(node, 0, sizeof(PieceNode));
+  node->priority = nextPriority(table);
+  node->source = source;
+  node->start = start;
+  node->length = length;
+  node->breaks = breaks;
+  updateNode(node);
+
+  return node;
+}
+
+static void freeNodes(PieceNode *node) {
+  if (!node)
+    return;
+
+  freeNodes(node->left);
+  freeNodes(node->right);
+  free(node);
+}
+
+// Splits the text of node in the first offset bytes and the rest
+static void splitNodes(PieceTable *table, PieceNode *node, uint32_t offset, PieceNode **left, PieceNode **right) {
+  if (!node) {
+    *left = NULL;
+    *right = NULL;
+    return;
+  }
+
+  uint32_t left_length = SUM_LENGTH(node->left);
+
+  if (offset <= left_length) {
+    splitNodes(table, node->left, offset, left, &node->left);
+    updateNode(node);
+    *right = node;
+  } else if (offset >= left_length + node->length) {
+    splitNodes(table, node->right, offset - left_length - node->length, &node->right, right);
+    updateNode(node);
+    *left = node;
+  } else {
+    // Split the piece, only the shorter part is scanned for line breaks
+    uint32_t length = offset - left_length;
+    const char *data = getPieceData(table, node);
+
+    uint32_t rest_breaks;
+    if (length < node->length - length)
+      rest_breaks = node->breaks - countBreaks(data, length);
+    else
+      rest_breaks = countBreaks(data + length, node->length - length);
+
+    PieceNode *rest = takeNode(table, node->source, node->start + length, node->length - length, rest_breaks);
+
+    // Same priority keeps the heap order
+    rest->priority = node->priority;
+    rest->right = node->right;
+    updateNode(rest);
+
+    node->length = length;
+    node->breaks -= rest_breaks;
+    node->right = NULL;
+    updateNode(node);
+
+    *left = node;
+    *right = rest;
+  }
+}
+
+static PieceNode *mergeNodes(PieceNode *left, PieceNode *right) {
+  if (!left)
+    return right;
+  if (!right)
+    return left;
+
+  if (left->priority >= right->priority) {
+    left->right = mergeNodes(left->right, right);
+    updateNode(left);
+    return left;
+  } else {
+    right->left = mergeNodes(left, right->left);
+    updateNode(right);
+    return right;
+  }
+}
+
+int pieceTableInit(PieceTable *table, const char *data, uint32_t size) {
+  memset(table, 0, sizeof(PieceTable));
+  table->original = data;
+  table->original_size = size;
+  table->seed = 0x9E3779B9 ^ size;
+
+  // Small pieces keep splits cheap
+  uint32_t offset;
+  for (offset = 0; offset < size; offset += PIECE_TABLE_CHUNK_SIZE) {
+    uint32_t length = size - offset < PIECE_TABLE_CHUNK_SIZE ? size - offset : PIECE_TABLE_CHUNK_SIZE;
+
+    if (reserveNodes(table) < 0) {
+      pieceTableFree(table);
+      return PIECE_TABLE_ERROR_NO_MEMORY;
+    }
+
+    PieceNode *node = takeNode(table, PIECE_SOURCE_ORIGINAL, offset, length, countBreaks(data + offset, length));
+    table->root = mergeNodes(table->root, node);
+  }
+
+  return 0;
+}
+
+void pieceTableFree(PieceTable *table) {
+  freeNodes(table->root);
+  free(table->spare[0]);
+  free(table->spare[1]);
+  free(table->add);
+  memset(table, 0, sizeof(PieceTable));
+}
+
+uint32_t pieceTableSize(PieceTable *table) {
+  return SUM_LENGTH(table->root);
+}
+
+uint32_t pieceTableLines(PieceTable *table) {
+  return SUM_BREAKS(table->root);
+}
+
+// Returns the offset after the line-th line break, the size if there is none
+uint32_t pieceTableLineOffset(PieceTable *table, uint32_t line) {
+  PieceNode *node = table->root;
+  uint32_t offset = 0;
+
+  if (line == 0)
+    return 0;
+
+  while (node) {
+    if (line <= SUM_BREAKS(node->left)) {
+      node = node->left;
+      continue;
+    }
+
+    line -= SUM_BREAKS(node->left);
+    offset += SUM_LENGTH(node->left);
+
+    if (line <= node->breaks) {
+      const char *data = getPieceData(table, node);
+      const char *p = data;
+
+      while (1) {
+        p = memchr(p, '\n', node->length - (p - data));
+        if (--line == 0)
+          return offset + (p - data) + 1;
+        p++;
+      }
+    }
+
+    line -= node->breaks;
+    offset += node->length;
+    node = node->right;
+  }
+
+  return pieceTableSize(table);
+}
+
+// Returns the number of line breaks before offset
+uint32_t pieceTableOffsetLine(PieceTable *table, uint32_t offset) {
+  PieceNode *node = table->root;
+  uint32_t line = 0;
+
+  while (node) {
+    if (offset < SUM_LENGTH(node->left)) {
+      node = node->left;
+      continue;
+    }
+
+    line += SUM_BREAKS(node->left);
+    offset -= SUM_LENGTH(node->left);
+
+    if (offset < node->length)
+      return line + countBreaks(getPieceData(table, node), offset);
+
+    line += node->breaks;
+    offset -= node->length;
+    node = node->right;
+  }
+
+  return line;
+}
+
+static void readNodes(PieceTable *table, PieceNode *node, uint32_t node_offset, uint32_t offset, char *data, uint32_t size) {
+  if (!node)
+    return;
+
+  uint32_t piece_offset = node_offset + SUM_LENGTH(node->left);
+  uint32_t piece_end = piece_offset + node->length;
+
+  if (offset < piece_offset)
+    readNodes(table, node->left, node_offset, offset, data, size);
+
+  uint32_t start = offset > piece_offset ? offset : piece_offset;
+  uint32_t end = offset + size < piece_end ? offset + size : piece_end;
+  if (start < end)
+    memcpy(data + (start - offset), getPieceData(table, node) + (start - piece_offset), end - start);
+
+  if (offset + size > piece_end)
+    readNodes(table, node->right, piece_end, offset, data, size);
+}
+
+// Copies up to size bytes at offset and returns how many were copied
+uint32_t pieceTableRead(PieceTable *table, uint32_t offset, char *data, uint32_t size) {
+  uint32_t table_size = pieceTableSize(table);
+  if (offset >= table_size)
+    return 0;
+
+  if (size > table_size - offset)
+    size = table_size - offset;
+
+  readNodes(table, table->root, 0, offset, data, size);
+
+  return size;
+}
+
+int pieceTableInsert(PieceTable *table, uint32_t offset, const char *data, uint32_t size) {
+  if (offset > pieceTableSize(table))
+    return PIECE_TABLE_ERROR_RANGE;
+
+  if (size == 0)
+    return 0;
+
+  if (table->add_size + size > table->max_add_size) {
+    uint32_t max_add_size = table->max_add_size ? table->max_add_size : PIECE_TABLE_CHUNK_SIZE;
+    while (table->add_size + size > max_add_size)
+      max_add_size *= 2;
+
+    char *add = realloc(table->add, max_add_size);
+    if (!add)
+      return PIECE_TABLE_ERROR_NO_MEMORY;
+
+    table->add = add;
+    table->max_add_size = max_add_size;
+  }
+
+  if (reserveNodes(table) < 0)
+    return PIECE_TABLE_ERROR_NO_MEMORY;
+
+  memcpy(table->add + table->add_size, data, size);
+
+  PieceNode *left, *right;
+  splitNodes(table, table->root, offset, &left, &right);
+
+  PieceNode *node = takeNode(table, PIECE_SOURCE_ADD, table->add_size, size, countBreaks(data, size));
+  table->add_size += size;
+
+  table->root = mergeNodes(mergeNodes(left, node), right);
+
+  return 0;
+}
+
+int pieceTableDelete(PieceTable *table, uint32_t offset, uint32_t size) {
+  if (offset > pieceTableSize(table) || size > pieceTableSize(table) - offset)
+    return PIECE_TABLE_ERROR_RANGE;
+
+  if (size == 0)
+    return 0;
+
+  if (reserveNodes(table) < 0)
+    return PIECE_TABLE_ERROR_NO_MEMORY;
+
+  PieceNode *left, *middle, *right;
+  splitNodes(table, table->root, offset, &left, &right);
+  splitNodes(table, right, size, &middle, &right);
+
+  freeNodes(middle);
+
+  table->root = mergeNodes(left, right);
+
+  return 0;
+}
+
+static int forEachNode(PieceTable *table, PieceNode *node, int (* handler)(void *argp, const char *data, uint32_t size), void *argp) {
+  if (!node)
+    return 0;
+
+  int res = forEachNode(table, node->left, handler, argp);
+  if (res < 0)
+    return res;
+
+  res = handler(argp, getPieceData(table, node), node->length);
+  if (res < 0)
+    return res;
+
+  return forEachNode(table, node->right, handler, argp);
+}
+
+// Passes the pieces in order, stops at the first negative result of handler
+int pieceTableForEach(PieceTable *table, int (* handler)(void *argp, const char *data, uint32_t size), void *argp) {
+  return forEachNode(table, table->root, handler, argp);
+}
@@ -0,0 +1,81 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __PIECE_TABLE_H__
+#define __PIECE_TABLE_H__
+
+#include <stdint.h>
+
+// This buffer only depends on libc and also builds against POSIX
+
+#define PIECE_TABLE_CHUNK_SIZE (16 * 1024)
+
+#define PIECE_TABLE_ERROR_NO_MEMORY ((int)0x80101501)
+#define PIECE_TABLE_ERROR_RANGE ((int)0x80101502)
+
+enum PieceSources {
+  PIECE_SOURCE_ORIGINAL,
+  PIECE_SOURCE_ADD,
+};
+
+typedef struct PieceNode {
+  struct PieceNode *left;
+  struct PieceNode *right;
+  uint32_t priority;
+  int source;
+  uint32_t start;
+  uint32_t length;
+  uint32_t breaks;     // Line breaks in this piece
+  uint32_t sum_length; // Of the subtree
+  uint32_t sum_breaks;
+} PieceNode;
+
+/*
+  The text is the in-order sequence of pieces, each one a range of the
+  original file or of the append-only add buffer. The pieces are kept in a
+  treap with the length and line breaks of every subtree, so edits and line
+  lookups are O(log n).
+*/
+typedef struct {
+  const char *original;
+  uint32_t original_size;
+  char *add;
+  uint32_t add_size;
+  uint32_t max_add_size;
+  PieceNode *root;
+  PieceNode *spare[2]; // Splits never fail
+  uint32_t seed;
+} PieceTable;
+
+int pieceTableInit(PieceTable *table, const char *data, uint32_t size);
+void pieceTableFree(PieceTable *table);
+
+uint32_t pieceTableSize(PieceTable *table);
+uint32_t pieceTableLines(PieceTable *table);
+
+uint32_t pieceTableLineOffset(PieceTable *table, uint32_t line);
+uint32_t pieceTableOffsetLine(PieceTable *table, uint32_t offset);
+
+uint32_t pieceTableRead(PieceTable *table, uint32_t offset, char *data, uint32_t size);
+
+int pieceTableInsert(PieceTable *table, uint32_t offset, const char *data, uint32_t size);
+int pieceTableDelete(PieceTable *table, uint32_t offset, uint32_t size);
+
+int pieceTableForEach(PieceTable *table, int (* handler)(void *argp, const char *data, uint32_t size), void *argp);
+
+#endif
@@ -18,313 +18,263 @@
 
 #include "main.h"
 #include "psarc.h"
+#include "psarc_reader.h"
+#include "transfer.h"
+#include "io_profile.h"
 #include "file.h"
 #include "utils.h"
 
-#define SCE_FIOS_FH_SIZE 80
-#define SCE_FIOS_DH_SIZE 80
-#define SCE_FIOS_OP_SIZE 168
-#define SCE_FIOS_CHUNK_SIZE 64
-
-#define SCE_FIOS_ALIGN_UP(val, align) (((val) + ((align) - 1)) & ~((align) - 1))
-#define SCE_FIOS_STORAGE_SIZE(num, size) (((num) * (size)) + SCE_FIOS_ALIGN_UP(SCE_FIOS_ALIGN_UP((num), 8) / 8, 8))
-
-#define SCE_FIOS_DH_STORAGE_SIZE(numDHs, pathMax) SCE_FIOS_STORAGE_SIZE(numDHs, SCE_FIOS_DH_SIZE + pathMax)
-#define SCE_FIOS_FH_STORAGE_SIZE(numFHs, pathMax) SCE_FIOS_STORAGE_SIZE(numFHs, SCE_FIOS_FH_SIZE + pathMax)
-#define SCE_FIOS_OP_STORAGE_SIZE(numOps, pathMax) SCE_FIOS_STORAGE_SIZE(numOps, SCE_FIOS_OP_SIZE + pathMax)
-#define SCE_FIOS_CHUNK_STORAGE_SIZE(numChunks) SCE_FIOS_STORAGE_SIZE(numChunks, SCE_FIOS_CHUNK_SIZE)
-
-#define SCE_FIOS_BUFFER_INITIALIZER  { 0, 0 }
-#define SCE_FIOS_PSARC_DEARCHIVER_CONTEXT_INITIALIZER { sizeof(SceFiosPsarcDearchiverContext), 0, 0, 0, {0, 0, 0} }
-#define SCE_FIOS_PARAMS_INITIALIZER { 0, sizeof(SceFiosParams), 0, 0, 2, 1, 0, 0, 256 * 1024, 2, 0, 0, 0, 0, 0, SCE_FIOS_BUFFER_INITIALIZER, SCE_FIOS_BUFFER_INITIALIZER, SCE_FIOS_BUFFER_INITIALIZER, SCE_FIOS_BUFFER_INITIALIZER, NULL, NULL, NULL, { 66, 189, 66 }, { 0x40000, 0, 0x40000}, { 8 * 1024, 16 * 1024, 8 * 1024}}
-
-typedef int32_t SceFiosFH;
-typedef int32_t SceFiosDH;
-typedef uint64_t SceFiosDate;
-typedef int64_t SceFiosOffset;
-typedef int64_t SceFiosSize;
-
-typedef struct SceFiosPsarcDearchiverContext {
-  size_t sizeOfContext;
-  size_t workBufferSize;
-  void *pWorkBuffer;
-  intptr_t flags;
-  intptr_t reserved[3];
-} SceFiosPsarcDearchiverContext;
-
-typedef struct SceFiosBuffer {
-  void *pPtr;
-  size_t length;
-} SceFiosBuffer;
-
-typedef struct SceFiosParams {
-  uint32_t initialized : 1;
-  uint32_t paramsSize : 15;
-  uint32_t pathMax : 16;
-  uint32_t profiling;
-  uint32_t ioThreadCount;
-  uint32_t threadsPerScheduler;
-  uint32_t extraFlag1 : 1;
-  uint32_t extraFlags : 31;
-  uint32_t maxChunk;
-  uint8_t maxDecompressorThreadCount;
-  uint8_t reserved1;   
-  uint8_t reserved2;
-  uint8_t reserved3;
-  intptr_t reserved4;
-  intptr_t reserved5;
-  SceFiosBuffer opStorage;
-  SceFiosBuffer fhStorage;
-  SceFiosBuffer dhStorage;
-  SceFiosBuffer chunkStorage;
-  void *pVprintf;
-  void *pMemcpy;
-  void *pProfileCallback;
-  int threadPriority[3];
-  int threadAffinity[3];
-  int threadStackSize[3];
-} SceFiosParams;
-
-typedef struct SceFiosDirEntry {
-  SceFiosOffset fileSize;
-  uint32_t statFlags;
-  uint16_t nameLength;
-  uint16_t fullPathLength;
-  uint16_t offsetToName;
-  uint16_t reserved[3];
-  char fullPath[1024];
-} SceFiosDirEntry;
-
-typedef struct SceFiosStat {
-	SceFiosOffset fileSize;
-	SceFiosDate accessDate;
-	SceFiosDate modificationDate;
-	SceFiosDate creationDate;
-	uint32_t statFlags;
-	uint32_t reserved;
-	int64_t uid;
-	int64_t gid;
-	int64_t dev;
-	int64_t ino;
-	int64_t mode;
-} SceFiosStat;
-
-int sceFiosInitialize(const SceFiosParams *params);
-void sceFiosTerminate();
-
-SceFiosSize sceFiosArchiveGetMountBufferSizeSync(const void *attr, const char *path, void *params);
-int sceFiosArchiveMountSync(const void *attr, SceFiosFH *fh, const char *path, const char *mount_point, SceFiosBuffer mount_buffer, void *params);
-int sceFiosArchiveUnmountSync(const void *attr, SceFiosFH fh);
-
-int sceFiosStatSync(const void *attr, const char *path, SceFiosStat *stat);
-
-int sceFiosFHOpenSync(const void *attr, SceFiosFH *fh, const char *path, const void *params);
-SceFiosSize sceFiosFHReadSync(const void *attr, SceFiosFH fh, void *data, SceFiosSize size);
-int sceFiosFHCloseSync(const void *attr, SceFiosFH fh);
-
-int sceFiosDHOpenSync(const void *attr, SceFiosDH *dh, const char *path, SceFiosBuffer buf);
-int sceFiosDHReadSync(const void *attr, SceFiosDH dh, SceFiosDirEntry *dir);
-int sceFiosDHCloseSync(const void *attr, SceFiosDH dh);
-
-SceDateTime *sceFiosDateToSceDateTime(SceFiosDate date, SceDateTime *sce_date);
-
-int sceFiosIOFilterAdd(int index, void (* callback)(), void *context);
-int sceFiosIOFilterRemove(int index);
- 
-void sceFiosIOFilterPsarcDearchiver();
-
-int64_t g_OpStorage[SCE_FIOS_OP_STORAGE_SIZE(64, MAX_PATH_LENGTH) / sizeof(int64_t) + 1];
-int64_t g_ChunkStorage[SCE_FIOS_CHUNK_STORAGE_SIZE(1024) / sizeof(int64_t) + 1];
-int64_t g_FHStorage[SCE_FIOS_FH_STORAGE_SIZE(32, MAX_PATH_LENGTH) / sizeof(int64_t) + 1];
-int64_t g_DHStorage[SCE_FIOS_DH_STORAGE_SIZE(32, MAX_PATH_LENGTH) / sizeof(int64_t) + 1];
-
-SceFiosPsarcDearchiverContext g_DearchiverContext = SCE_FIOS_PSARC_DEARCHIVER_CONTEXT_INITIALIZER;
-char g_DearchiverWorkBuffer[0x30000] __attribute__((aligned(64)));
-int g_ArchiveIndex = 0;
-SceFiosBuffer g_MountBuffer = SCE_FIOS_BUFFER_INITIALIZER;
-SceFiosFH g_ArchiveFH = -1;
+#define PSARC_FD 0x50534152
+#define PSARC_EXTRACT_THREADS 3
+
+typedef struct {
+  int pos;
+  char prefix[MAX_PATH_LENGTH];
+  int prefix_length;
+  char folder[MAX_PATH_LENGTH];
+} PsarcDir;
+
+typedef struct {
+  SceUID fd;
+  TransferWriter *writer; // NULL for small entries, they are written directly
+  FileProcessParam *param;
+} PsarcWriteArgs;
+
+static PsarcArchive *psarc_archive = NULL;
+static PsarcEntry **psarc_entries = NULL; // Sorted by name
+static int psarc_path_start = 0;
+static SceIoStat psarc_stat;
+static PsarcEntryReader *psarc_reader = NULL;
+
+static int psarcEntryCompare(const void *a, const void *b) {
+  return strcasecmp((*(PsarcEntry **)a)->name, (*(PsarcEntry **)b)->name);
+}
+
+// First sorted entry that is not less than name in its first length characters
+static int psarcLowerBound(const char *name, int length) {
+  int low = 0, high = psarc_archive->n_entries;
+
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (strncasecmp(psarc_entries[mid]->name, name, length) < 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return low;
+}
+
+static const char *psarcInnerPath(const char *path, char *inner) {
+  if (strlen(path) < psarc_path_start)
+    inner[0] = '\0';
+  else
+    strcpy(inner, path + psarc_path_start);
+
+  removeEndSlash(inner);
+  return inner;
+}
+
+static PsarcEntry *psarcFindEntry(const char *path) {
+  char name[MAX_PATH_LENGTH];
+  psarcInnerPath(path, name);
+
+  int length = strlen(name);
+  if (length == 0)
+    return NULL;
+
+  int pos = psarcLowerBound(name, length + 1);
+  if (pos < psarc_archive->n_entries && strcasecmp(psarc_entries[pos]->name, name) == 0)
+    return psarc_entries[pos];
+
+  return NULL;
+}
+
+// Entries below a folder form a contiguous range of the sorted entries
+static int psarcOpenDir(PsarcDir *dir, const char *path) {
+  psarcInnerPath(path, dir->prefix);
+  if (dir->prefix[0] != '\0')
+    addEndSlash(dir->prefix);
+
+  dir->prefix_length = strlen(dir->prefix);
+  dir->folder[0] = '\0';
+  dir->pos = psarcLowerBound(dir->prefix, dir->prefix_length);
+
+  if (dir->prefix_length > 0 && (dir->pos >= psarc_archive->n_entries ||
+      strncasecmp(psarc_entries[dir->pos]->name, dir->prefix, dir->prefix_length) != 0))
+    return -1;
+
+  return 0;
+}
+
+// Get the next child. entry is NULL for folders
+static int psarcReadDir(PsarcDir *dir, char *name, PsarcEntry **entry) {
+  while (dir->pos < psarc_archive->n_entries) {
+    PsarcEntry *curr = psarc_entries[dir->pos++];
+    if (strncasecmp(curr->name, dir->prefix, dir->prefix_length) != 0)
+      return 0;
+
+    const char *rest = curr->name + dir->prefix_length;
+    const char *p = strchr(rest, '/');
+
+    if (!p) {
+      strcpy(name, rest);
+      *entry = curr;
+      return 1;
+    }
+
+    // Skip the other files of the same subfolder
+    strncpy(name, rest, p - rest);
+    name[p - rest] = '\0';
+    if (strcasecmp(name, dir->folder) == 0)
+      continue;
+
+    strcpy(dir->folder, name);
+    *entry = NULL;
+    return 1;
+  }
+
+  return 0;
+}
 
 int psarcOpen(const char *file) {
-  int res;
-  
-  SceFiosParams params = SCE_FIOS_PARAMS_INITIALIZER;
-  params.opStorage.pPtr = g_OpStorage;
-  params.opStorage.length = sizeof(g_OpStorage);
-  params.chunkStorage.pPtr = g_ChunkStorage;
-  params.chunkStorage.length = sizeof(g_ChunkStorage);
-  params.fhStorage.pPtr = g_FHStorage;
-  params.fhStorage.length = sizeof(g_FHStorage);
-  params.dhStorage.pPtr = g_DHStorage;
-  params.dhStorage.length = sizeof(g_DHStorage);  
-  params.pathMax = MAX_PATH_LENGTH;
-  
-  res = sceFiosInitialize(&params);
-  if (res < 0)
-    goto ERROR_INITIALIZE;
-  
-  g_DearchiverContext.workBufferSize = sizeof(g_DearchiverWorkBuffer);
-  g_DearchiverContext.pWorkBuffer = g_DearchiverWorkBuffer;
+  psarcClose();
 
-  res = sceFiosIOFilterAdd(g_ArchiveIndex, sceFiosIOFilterPsarcDearchiver, &g_DearchiverContext);
+  int res = sceIoGetstat(file, &psarc_stat);
   if (res < 0)
-    goto ERROR_FILTER_ADD;
-  
-  SceFiosSize result = sceFiosArchiveGetMountBufferSizeSync(NULL, file, NULL);
-  if (result < 0) {
-    res = (int)result;
-    goto ERROR_ARCHIVE_GET_MOUNT_BUFFER_SIZE;
+    return res;
+
+  res = psarcArchiveOpen(&psarc_archive, file);
+  if (res < 0) {
+    psarc_archive = NULL;
+    return res;
   }
 
-  g_MountBuffer.length = (size_t)result;
-  g_MountBuffer.pPtr = malloc(g_MountBuffer.length);
+  psarc_entries = malloc(psarc_archive->n_entries * sizeof(PsarcEntry *) + 1);
+  if (!psarc_entries) {
+    psarcArchiveClose(psarc_archive);
+    psarc_archive = NULL;
+    return -1;
+  }
 
-  res = sceFiosArchiveMountSync(NULL, &g_ArchiveFH, file, file, g_MountBuffer, NULL);
-  if (res < 0)
-    goto ERROR_ARCHIVE_MOUNT;
+  int i;
+  for (i = 0; i < psarc_archive->n_entries; i++) {
+    psarc_entries[i] = &psarc_archive->entries[i];
+  }
 
-  return res;
+  qsort(psarc_entries, psarc_archive->n_entries, sizeof(PsarcEntry *), psarcEntryCompare);
 
-ERROR_ARCHIVE_MOUNT:
-  free(g_MountBuffer.pPtr);
-  
-ERROR_ARCHIVE_GET_MOUNT_BUFFER_SIZE:
-  sceFiosIOFilterRemove(g_ArchiveIndex);
-  
-ERROR_FILTER_ADD:
-  sceFiosTerminate();
-  
-ERROR_INITIALIZE:
-  return res;
+  // Start position of the archive path
+  psarc_path_start = strlen(file) + 1;
+
+  return 0;
 }
 
 int psarcClose() {
-  sceFiosArchiveUnmountSync(NULL, g_ArchiveFH);
-  free(g_MountBuffer.pPtr);
-  sceFiosIOFilterRemove(g_ArchiveIndex);
-  sceFiosTerminate();
+  psarcEntryClose(psarc_reader);
+  psarc_reader = NULL;
+
+  free(psarc_entries);
+  psarc_entries = NULL;
+
+  psarcArchiveClose(psarc_archive);
+  psarc_archive = NULL;
 
   return 0;
 }
 
+static void psarcSetStat(SceIoStat *stat, PsarcEntry *entry) {
+  memset(stat, 0, sizeof(SceIoStat));
+  stat->st_mode = entry ? SCE_S_IFREG : SCE_S_IFDIR;
+  stat->st_size = entry ? entry->size : 0;
+
+  // The format has no timestamps, use the ones of the archive
+  memcpy(&stat->st_ctime, &psarc_stat.st_ctime, sizeof(SceDateTime));
+  memcpy(&stat->st_mtime, &psarc_stat.st_mtime, sizeof(SceDateTime));
+  memcpy(&stat->st_atime, &psarc_stat.st_atime, sizeof(SceDateTime));
+}
+
 int fileListGetPsarcEntries(FileList *list, const char *path, int sort) {
   int res;
   
   if (!list)
     return -1;
 
-  SceFiosDH dh = -1;
-  SceFiosBuffer buf = SCE_FIOS_BUFFER_INITIALIZER;
-  res = sceFiosDHOpenSync(NULL, &dh, path, buf);
+  PsarcDir dir;
+  res = psarcOpenDir(&dir, path);
   if (res < 0)
     return res;
 
-  FileListEntry *entry = malloc(sizeof(FileListEntry));
-  if (entry) {
-    entry->name_length = strlen(DIR_UP);
-    entry->name = malloc(entry->name_length + 1);
-    strcpy(entry->name, DIR_UP);
-    entry->is_folder = 1;
-    entry->type = FILE_TYPE_UNKNOWN;
-    fileListAddEntry(list, entry, sort);
-  }
-
-  do {
-    SceFiosDirEntry dir;
-    memset(&dir, 0, sizeof(SceFiosDirEntry));
+  fileListAddEntry(list, fileListCreateUpEntry(&list->arena), SORT_NONE);
+
+  char name[MAX_PATH_LENGTH];
+  PsarcEntry *psarc_entry = NULL;
+
+  while (psarcReadDir(&dir, name, &psarc_entry)) {
+    int is_folder = psarc_entry == NULL;
+
+    FileListEntry *entry = fileListAllocEntry(&list->arena, strlen(name) + (is_folder ? 1 : 0));
+    if (entry) {
+      entry->is_folder = is_folder;
+      strcpy(entry->name, name);
+      if (entry->is_folder) {
+        addEndSlash(entry->name);
+        entry->type = FILE_TYPE_UNKNOWN;
+        list->folders++;
+      } else {
+        entry->type = getFileType(entry->name);
+        list->files++;
+      }
 
-    res = sceFiosDHReadSync(NULL, dh, &dir);
-    
-    if (res >= 0) {
-      char *name = dir.fullPath + dir.offsetToName;
+      SceIoStat stat;
+      psarcSetStat(&stat, psarc_entry);
 
-      SceFiosStat stat;
-      memset(&stat, 0, sizeof(SceFiosStat));
+      entry->size = stat.st_size;
       
-      if (sceFiosStatSync(NULL, dir.fullPath, &stat) >= 0) {
-        FileListEntry *entry = malloc(sizeof(FileListEntry));
-        if (entry) {
-          entry->is_folder = stat.statFlags & 0x1;
-          if (entry->is_folder) {
-            entry->name_length = strlen(name) + 1;
-            entry->name = malloc(entry->name_length + 1);
-            strcpy(entry->name, name);
-            addEndSlash(entry->name);
-            entry->type = FILE_TYPE_UNKNOWN;
-            list->folders++;
-          } else {
-            entry->name_length = strlen(name);
-            entry->name = malloc(entry->name_length + 1);
-            strcpy(entry->name, name);
-            entry->type = getFileType(entry->name);
-            list->files++;
-          }
-
-          entry->size = stat.fileSize;
-          
-          SceDateTime time;
-          
-          sceFiosDateToSceDateTime(stat.accessDate, &time);
-          memcpy(&entry->ctime, (SceDateTime *)&time, sizeof(SceDateTime));
-          
-          sceFiosDateToSceDateTime(stat.modificationDate, &time);
-          memcpy(&entry->mtime, (SceDateTime *)&time, sizeof(SceDateTime));
-          
-          sceFiosDateToSceDateTime(stat.creationDate, &time);
-          memcpy(&entry->atime, (SceDateTime *)&time, sizeof(SceDateTime));
-          
-          fileListAddEntry(list, entry, sort);
-        }
-      }
+      memcpy(&entry->ctime, (SceDateTime *)&stat.st_ctime, sizeof(SceDateTime));
+      memcpy(&entry->mtime, (SceDateTime *)&stat.st_mtime, sizeof(SceDateTime));
+      memcpy(&entry->atime, (SceDateTime *)&stat.st_atime, sizeof(SceDateTime));
+      
+      fileListAddEntry(list, entry, SORT_NONE);
     }
-  } while (res >= 0);
+  }
 
-  sceFiosDHCloseSync(NULL, dh);
+  fileListSort(list, sort);
 
   return 0;
 }
 
 int getPsarcPathInfo(const char *path, uint64_t *size, uint32_t *folders, uint32_t *files, int (* handler)(const char *path)) {
-  SceFiosDH dh = -1;
-  SceFiosBuffer buf = SCE_FIOS_BUFFER_INITIALIZER;
-  if (sceFiosDHOpenSync(NULL, &dh, path, buf) >= 0) {
-    int res = 0;
-
-    do {
-      SceFiosDirEntry dir;
-      memset(&dir, 0, sizeof(SceFiosDirEntry));
-
-      res = sceFiosDHReadSync(NULL, dh, &dir);
-      if (res >= 0) {
-        char *name = dir.fullPath + dir.offsetToName;
-        
-        char *new_path = malloc(strlen(path) + strlen(name) + 2);
-        snprintf(new_path, MAX_PATH_LENGTH - 1, "%s%s%s", path, hasEndSlash(path) ? "" : "/", name);
-
-        if (handler && handler(new_path)) {
-          free(new_path);
-          continue;
-        }
+  PsarcDir dir;
+  if (psarcOpenDir(&dir, path) >= 0) {
+    char name[MAX_PATH_LENGTH];
+    PsarcEntry *entry = NULL;
 
-        if (dir.statFlags & 0x1) {
-          int ret = getPsarcPathInfo(new_path, size, folders, files, handler);
-          if (ret <= 0) {
-            free(new_path);
-            sceFiosDHCloseSync(NULL, dh);
-            return ret;
-          }
-        } else {
-          if (size)
-            (*size) += dir.fileSize;
-
-          if (files)
-            (*files)++;
-        }
+    while (psarcReadDir(&dir, name, &entry)) {
+      char *new_path = malloc(strlen(path) + strlen(name) + 2);
+      snprintf(new_path, MAX_PATH_LENGTH - 1, "%s%s%s", path, hasEndSlash(path) ? "" : "/", name);
 
+      if (handler && handler(new_path)) {
         free(new_path);
+        continue;
       }
-    } while (res >= 0);
 
-    sceFiosDHCloseSync(NULL, dh);
+      if (!entry) {
+        int ret = getPsarcPathInfo(new_path, size, folders, files, handler);
+        if (ret <= 0) {
+          free(new_path);
+          return ret;
+        }
+      } else {
+        if (size)
+          (*size) += entry->size;
+
+        if (files)
+          (*files)++;
+      }
+
+      free(new_path);
+    }
 
     if (folders)
       (*folders)++;
@@ -332,16 +282,12 @@ int getPsarcPathInfo(const char *path, uint64_t *size, uint32_t *folders, uint32
     if (handler && handler(path))
       return 1;
 
-    if (size) {
-      SceFiosStat stat;
-      memset(&stat, 0, sizeof(SceFiosStat));
-      
-      int res = sceFiosStatSync(NULL, path, &stat);
-      if (res < 0)
-        return res;
-      
-      (*size) += stat.fileSize;
-    }
+    PsarcEntry *entry = psarcFindEntry(path);
+    if (!entry)
+      return -1;
+
+    if (size)
+      (*size) += entry->size;
 
     if (files)
       (*files)++;
@@ -350,86 +296,84 @@ int getPsarcPathInfo(const char *path, uint64_t *size, uint32_t *folders, uint32
   return 1;
 }
 
-int extractPsarcFile(const char *src_path, const char *dst_path, FileProcessParam *param) {
-  SceUID fdsrc = psarcFileOpen(src_path, SCE_O_RDONLY, 0);
-  if (fdsrc < 0)
-    return fdsrc;
+static int psarcWrite(void *argp, const void *data, uint32_t size) {
+  PsarcWriteArgs *args = (PsarcWriteArgs *)argp;
+  FileProcessParam *param = args->param;
 
-  SceUID fddst = sceIoOpen(dst_path, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
-  if (fddst < 0) {
-    psarcFileClose(fdsrc);
-    return fddst;
-  }
+  int res;
+  if (args->writer)
+    res = transferWrite(args->writer, data, size);
+  else
+    res = sceIoWrite(args->fd, data, size);
 
-  void *buf = memalign(4096, TRANSFER_SIZE);
+  if (res < 0)
+    return res;
 
-  while (1) {
-    int read = psarcFileRead(fdsrc, buf, TRANSFER_SIZE);
+  if (param) {
+    if (param->value)
+      (*param->value) += size;
 
-    if (read < 0) {
-      free(buf);
+    if (param->SetProgress)
+      param->SetProgress(param->value ? *param->value : 0, param->max);
 
-      sceIoClose(fddst);
-      psarcFileClose(fdsrc);
+    if (param->cancelHandler && param->cancelHandler())
+      return 0;
+  }
 
-      sceIoRemove(dst_path);
+  return 1;
+}
 
-      return read;
-    }
+int extractPsarcFile(const char *src_path, const char *dst_path, FileProcessParam *param) {
+  PsarcEntry *entry = psarcFindEntry(src_path);
+  if (!entry)
+    return -1;
 
-    if (read == 0)
-      break;
+  SceUID fddst = sceIoOpen(dst_path, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
+  if (fddst < 0)
+    return fddst;
 
-    int written = sceIoWrite(fddst, buf, read);
+  PsarcWriteArgs args;
+  args.fd = fddst;
+  args.writer = NULL;
+  args.param = param;
 
-    if (written < 0) {
-      free(buf);
+  int buffer_size = ioProfileGetWriteSize(dst_path);
+  int res = 0;
 
+  if (entry->size > (buffer_size > 0 ? buffer_size : TRANSFER_BUFFER_SIZE)) {
+    res = transferOpen(&args.writer, fddst, entry->size, buffer_size);
+    if (res < 0) {
       sceIoClose(fddst);
-      psarcFileClose(fdsrc);
-
       sceIoRemove(dst_path);
-
-      return written;
+      return res;
     }
+  }
 
-    if (param) {
-      if (param->value)
-        (*param->value) += read;
-
-      if (param->SetProgress)
-        param->SetProgress(param->value ? *param->value : 0, param->max);
-
-      if (param->cancelHandler && param->cancelHandler()) {
-        free(buf);
-
-        sceIoClose(fddst);
-        psarcFileClose(fdsrc);
-
-        sceIoRemove(dst_path);
+  // Blocks are decompressed on worker threads and written out in order by the transfer thread
+  res = psarcEntryExtract(psarc_archive, entry, PSARC_EXTRACT_THREADS, psarcWrite, &args);
 
-        return 0;
-      }
-    }
+  if (args.writer) {
+    int ret = transferClose(args.writer, res <= 0);
+    if (res > 0 && ret < 0)
+      res = ret;
   }
 
-  free(buf);
-
   sceIoClose(fddst);
-  psarcFileClose(fdsrc);
+
+  if (res <= 0) {
+    sceIoRemove(dst_path);
+    return res;
+  }
 
   return 1;
 }
 
 int extractPsarcPath(const char *src_path, const char *dst_path, FileProcessParam *param) {
-  SceFiosDH dh = -1;
-  SceFiosBuffer buf = SCE_FIOS_BUFFER_INITIALIZER;
-  if (sceFiosDHOpenSync(NULL, &dh, src_path, buf) >= 0) {
+  PsarcDir dir;
+  if (psarcOpenDir(&dir, src_path) >= 0) {
     int ret = sceIoMkdir(dst_path, 0777);
-    if (ret < 0 && ret != SCE_ERROR_ERRNO_EEXIST) {
-      sceFiosDHCloseSync(NULL, dh);
+    if (ret < 0 && ret != SCE_ERROR_ERRNO_EEXIST)
       return ret;
-    }
     
     if (param) {
       if (param->value)
@@ -438,47 +382,34 @@ int extractPsarcPath(const char *src_path, const char *dst_path, FileProcessPara
       if (param->SetProgress)
         param->SetProgress(param->value ? *param->value : 0, param->max);
 
-      if (param->cancelHandler && param->cancelHandler()) {
-        sceFiosDHCloseSync(NULL, dh);
+      if (param->cancelHandler && param->cancelHandler())
         return 0;
-      }
     }
 
-    int res = 0;
-
-    do {
-      SceFiosDirEntry dir;
-      memset(&dir, 0, sizeof(SceFiosDirEntry));
+    char name[MAX_PATH_LENGTH];
+    PsarcEntry *entry = NULL;
 
-      res = sceFiosDHReadSync(NULL, dh, &dir);
-      if (res >= 0) {
-        char *name = dir.fullPath + dir.offsetToName;
+    while (psarcReadDir(&dir, name, &entry)) {
+      char *new_src_path = malloc(strlen(src_path) + strlen(name) + 2);
+      snprintf(new_src_path, MAX_PATH_LENGTH - 1, "%s%s%s", src_path, hasEndSlash(src_path) ? "" : "/", name);
 
-        char *new_src_path = malloc(strlen(src_path) + strlen(name) + 2);
-        snprintf(new_src_path, MAX_PATH_LENGTH - 1, "%s%s%s", src_path, hasEndSlash(src_path) ? "" : "/", name);
-
-        char *new_dst_path = malloc(strlen(dst_path) + strlen(name) + 2);
-        snprintf(new_dst_path, MAX_PATH_LENGTH - 1, "%s%s%s", dst_path, hasEndSlash(dst_path) ? "" : "/", name);
-
-        int ret = 0;
-
-        if (dir.statFlags & 0x1) {
-          ret = extractPsarcPath(new_src_path, new_dst_path, param);
-        } else {
-          ret = extractPsarcFile(new_src_path, new_dst_path, param);
-        }
+      char *new_dst_path = malloc(strlen(dst_path) + strlen(name) + 2);
+      snprintf(new_dst_path, MAX_PATH_LENGTH - 1, "%s%s%s", dst_path, hasEndSlash(dst_path) ? "" : "/", name);
 
-        free(new_dst_path);
-        free(new_src_path);
+      int ret = 0;
 
-        if (ret <= 0) {
-          sceFiosDHCloseSync(NULL, dh);
-          return ret;
-        }
+      if (!entry) {
+        ret = extractPsarcPath(new_src_path, new_dst_path, param);
+      } else {
+        ret = extractPsarcFile(new_src_path, new_dst_path, param);
       }
-    } while (res >= 0);
 
-    sceFiosDHCloseSync(NULL, dh);
+      free(new_dst_path);
+      free(new_src_path);
+
+      if (ret <= 0)
+        return ret;
+    }
   } else {
     return extractPsarcFile(src_path, dst_path, param);
   }
@@ -487,45 +418,50 @@ int extractPsarcPath(const char *src_path, const char *dst_path, FileProcessPara
 }
 
 int psarcFileGetstat(const char *file, SceIoStat *stat) {
-  SceFiosStat fios_stat;
-  memset(&fios_stat, 0, sizeof(SceFiosStat));
-  int res = sceFiosStatSync(NULL, file, &fios_stat);
-  if (res < 0)
-    return res;
-  
-  if (stat) {
-    stat->st_mode = (fios_stat.statFlags & 0x1) ? SCE_S_IFDIR : SCE_S_IFREG;
-    stat->st_size = fios_stat.fileSize;
-    
-    SceDateTime time;
-    
-    sceFiosDateToSceDateTime(fios_stat.accessDate, &time);
-    memcpy(&stat->st_ctime, (SceDateTime *)&time, sizeof(SceDateTime));
-    
-    sceFiosDateToSceDateTime(fios_stat.modificationDate, &time);
-    memcpy(&stat->st_mtime, (SceDateTime *)&time, sizeof(SceDateTime));
-    
-    sceFiosDateToSceDateTime(fios_stat.creationDate, &time);
-    memcpy(&stat->st_atime, (SceDateTime *)&time, sizeof(SceDateTime));
+  PsarcEntry *entry = psarcFindEntry(file);
+  if (!entry) {
+    PsarcDir dir;
+    if (psarcOpenDir(&dir, file) < 0)
+      return -1;
   }
   
-  return res;
+  if (stat)
+    psarcSetStat(stat, entry);
+  
+  return 0;
 }
 
 int psarcFileOpen(const char *file, int flags, SceMode mode) {
-  SceFiosFH fh = -1;
-  
-  int res = sceFiosFHOpenSync(NULL, &fh, file, NULL);
-  if (res < 0)
+  // A file is already open
+  if (psarc_reader)
+    return -1;
+
+  PsarcEntry *entry = psarcFindEntry(file);
+  if (!entry)
+    return -1;
+
+  int res = psarcEntryOpen(&psarc_reader, psarc_archive, entry);
+  if (res < 0) {
+    psarc_reader = NULL;
     return res;
+  }
   
-  return fh;
+  return PSARC_FD;
 }
 
 int psarcFileRead(SceUID fd, void *data, SceSize size) {
-  return (int)sceFiosFHReadSync(NULL, fd, data, (SceFiosSize)size);
+  if (!psarc_reader || fd != PSARC_FD)
+    return -1;
+
+  return psarcEntryRead(psarc_reader, data, size);
 }
 
 int psarcFileClose(SceUID fd) {
-  return sceFiosFHCloseSync(NULL, fd);
+  if (!psarc_reader || fd != PSARC_FD)
+    return -1;
+
+  psarcEntryClose(psarc_reader);
+  psarc_reader = NULL;
+
+  return 0;
 }
\ No newline at end of file
@@ -0,0 +1,730 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <zlib.h>
+#include <lzma.h>
+
+#ifdef __vita__
+#include <vitasdk.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+#include "psarc_reader.h"
+
+#define PSARC_HEADER_SIZE 32
+#define PSARC_TOC_ENTRY_SIZE 30
+#define PSARC_FLAG_ENCRYPTED 0x4
+
+#define PSARC_MAX_THREADS 4
+#define PSARC_SLOTS_PER_THREAD 2
+
+#ifdef __vita__
+
+typedef SceKernelLwMutexWork PsarcMutex;
+typedef SceKernelLwCondWork PsarcCond;
+typedef SceUID PsarcThread;
+
+static int fileOpen(const char *path) {
+  return sceIoOpen(path, SCE_O_RDONLY, 0);
+}
+
+static int fileReadAt(int fd, void *data, uint32_t size, uint64_t offset) {
+  return sceIoPread(fd, data, size, offset);
+}
+
+static void fileClose(int fd) {
+  sceIoClose(fd);
+}
+
+static void mutexInit(PsarcMutex *mutex, PsarcCond *cond) {
+  sceKernelCreateLwMutex(mutex, "psarc_mutex", 0, 0, NULL);
+  sceKernelCreateLwCond(cond, "psarc_cond", 0, mutex, NULL);
+}
+
+static void mutexDestroy(PsarcMutex *mutex, PsarcCond *cond) {
+  sceKernelDeleteLwCond(cond);
+  sceKernelDeleteLwMutex(mutex);
+}
+
+static void mutexLock(PsarcMutex *mutex) {
+  sceKernelLockLwMutex(mutex, 1, NULL);
+}
+
+static void mutexUnlock(PsarcMutex *mutex) {
+  sceKernelUnlockLwMutex(mutex, 1);
+}
+
+static void condWait(PsarcCond *cond, PsarcMutex *mutex) {
+  sceKernelWaitLwCond(cond, NULL);
+}
+
+static void condBroadcast(PsarcCond *cond) {
+  sceKernelSignalLwCondAll(cond);
+}
+
+#else
+
+typedef pthread_mutex_t PsarcMutex;
+typedef pthread_cond_t PsarcCond;
+typedef pthread_t PsarcThread;
+
+static int fileOpen(const char *path) {
+  return open(path, O_RDONLY);
+}
+
+static int fileReadAt(int fd, void *data, uint32_t size, uint64_t offset) {
+  return pread(fd, data, size, offset);
+}
+
+static void fileClose(int fd) {
+  close(fd);
+}
+
+static void mutexInit(PsarcMutex *mutex, PsarcCond *cond) {
+  pthread_mutex_init(mutex, NULL);
+  pthread_cond_init(cond, NULL);
+}
+
+static void mutexDestroy(PsarcMutex *mutex, PsarcCond *cond) {
+  pthread_cond_destroy(cond);
+  pthread_mutex_destroy(mutex);
+}
+
+static void mutexLock(PsarcMutex *mutex) {
+  pthread_mutex_lock(mutex);
+}
+
+static void mutexUnlock(PsarcMutex *mutex) {
+  pthread_mutex_unlock(mutex);
+}
+
+static void condWait(PsarcCond *cond, PsarcMutex *mutex) {
+  pthread_cond_wait(cond, mutex);
+}
+
+static void condBroadcast(PsarcCond *cond) {
+  pthread_cond_broadcast(cond);
+}
+
+#endif
+
+struct PsarcEntryReader {
+  PsarcArchive *archive;
+  PsarcEntry *entry;
+  uint32_t block;
+  uint32_t n_blocks;
+  uint64_t offset;
+  uint8_t *in;
+  uint8_t *out;
+  uint32_t out_size;
+  uint32_t out_pos;
+};
+
+typedef struct {
+  int block; // Block of the entry held by this slot, -1 if free
+  int ready;
+  int result;
+  uint8_t *out;
+} PsarcSlot;
+
+typedef struct {
+  PsarcArchive *archive;
+  PsarcEntry *entry;
+  uint64_t *offsets;
+  uint32_t n_blocks;
+  uint32_t next;
+  int stop;
+  PsarcSlot slots[PSARC_MAX_THREADS * PSARC_SLOTS_PER_THREAD];
+  int n_slots;
+  PsarcMutex mutex;
+  PsarcCond cond;
+} PsarcExtract;
+
+static uint32_t getBe16(const uint8_t *p) {
+  return (p[0] << 8) | p[1];
+}
+
+static uint32_t getBe24(const uint8_t *p) {
+  return (p[0] << 16) | (p[1] << 8) | p[2];
+}
+
+static uint32_t getBe32(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static uint64_t getBe40(const uint8_t *p) {
+  return ((uint64_t)p[0] << 32) | getBe32(p + 1);
+}
+
+static int readAt(int fd, void *data, uint32_t size, uint64_t offset) {
+  uint8_t *p = data;
+
+  while (size > 0) {
+    int read = fileReadAt(fd, p, size, offset);
+    if (read < 0)
+      return read;
+
+    if (read == 0)
+      return PSARC_ERROR_FORMAT;
+
+    p += read;
+    offset += read;
+    size -= read;
+  }
+
+  return 0;
+}
+
+static uint32_t getEntryBlocks(PsarcArchive *archive, PsarcEntry *entry) {
+  return (entry->size + archive->block_size - 1) / archive->block_size;
+}
+
+static uint32_t getBlockOutputSize(PsarcArchive *archive, PsarcEntry *entry, uint32_t block) {
+  uint64_t left = entry->size - (uint64_t)block * archive->block_size;
+  return left < archive->block_size ? (uint32_t)left : archive->block_size;
+}
+
+static uint32_t getBlockInputSize(PsarcArchive *archive, uint32_t block_index) {
+  uint32_t size = archive->block_sizes[block_index];
+  return size ? size : archive->block_size;
+}
+
+static int inflateBlock(const uint8_t *in, uint32_t in_size, uint8_t *out, uint32_t out_size) {
+  uLongf length = out_size;
+  if (uncompress(out, &length, in, in_size) != Z_OK || length != out_size)
+    return PSARC_ERROR_DECOMPRESS;
+
+  return 0;
+}
+
+static int unlzmaBlock(const uint8_t *in, uint32_t in_size, uint8_t *out, uint32_t out_size) {
+  lzma_stream strm = LZMA_STREAM_INIT;
+
+  if (lzma_alone_decoder(&strm, UINT64_MAX) != LZMA_OK)
+    return PSARC_ERROR_DECOMPRESS;
+
+  strm.next_in = in;
+  strm.avail_in = in_size;
+  strm.next_out = out;
+  strm.avail_out = out_size;
+
+  lzma_ret ret = lzma_code(&strm, LZMA_FINISH);
+  lzma_end(&strm);
+
+  if ((ret != LZMA_OK && ret != LZMA_STREAM_END) || strm.avail_out != 0)
+    return PSARC_ERROR_DECOMPRESS;
+
+  return 0;
+}
+
+// Read block 'block' of an entry at 'offset' and decompress it to 'out'. 'in' must hold block_size bytes
+static int decompressBlock(PsarcArchive *archive, PsarcEntry *entry, uint32_t block, uint64_t offset,
+                           uint8_t *in, uint8_t *out) {
+  uint32_t block_index = entry->block_index + block;
+  if (block_index >= archive->n_blocks)
+    return PSARC_ERROR_FORMAT;
+
+  uint32_t in_size = getBlockInputSize(archive, block_index);
+  uint32_t out_size = getBlockOutputSize(archive, entry, block);
+
+  // Blocks that did not compress are stored as is
+  if (in_size == out_size || archive->block_sizes[block_index] == 0)
+    return readAt(archive->fd, out, out_size, offset);
+
+  if (in_size > archive->block_size)
+    return PSARC_ERROR_FORMAT;
+
+  int res = readAt(archive->fd, in, in_size, offset);
+  if (res < 0)
+    return res;
+
+  if (archive->compression == PSARC_COMPRESSION_ZLIB)
+    return inflateBlock(in, in_size, out, out_size);
+  else
+    return unlzmaBlock(in, in_size, out, out_size);
+}
+
+int psarcEntryOpen(PsarcEntryReader **reader, PsarcArchive *archive, PsarcEntry *entry) {
+  PsarcEntryReader *r = malloc(sizeof(PsarcEntryReader));
+  if (!r)
+    return PSARC_ERROR_NO_MEMORY;
+
+  memset(r, 0, sizeof(PsarcEntryReader));
+  r->archive = archive;
+  r->entry = entry;
+  r->n_blocks = getEntryBlocks(archive, entry);
+  r->offset = entry->offset;
+
+  r->in = malloc(archive->block_size);
+  r->out = malloc(archive->block_size);
+  if (!r->in || !r->out) {
+    psarcEntryClose(r);
+    return PSARC_ERROR_NO_MEMORY;
+  }
+
+  *reader = r;
+  return 0;
+}
+
+int psarcEntryRead(PsarcEntryReader *reader, void *data, uint32_t size) {
+  PsarcArchive *archive = reader->archive;
+  uint8_t *p = data;
+
+  while (size > 0) {
+    // Decompress the next block
+    if (reader->out_pos == reader->out_size) {
+      if (reader->block == reader->n_blocks)
+        break;
+
+      int res = decompressBlock(archive, reader->entry, reader->block, reader->offset, reader->in, reader->out);
+      if (res < 0)
+        return res;
+
+      reader->offset += getBlockInputSize(archive, reader->entry->block_index + reader->block);
+      reader->out_size = getBlockOutputSize(archive, reader->entry, reader->block);
+      reader->out_pos = 0;
+      reader->block++;
+    }
+
+    uint32_t length = reader->out_size - reader->out_pos;
+    if (length > size)
+      length = size;
+
+    memcpy(p, reader->out + reader->out_pos, length);
+    reader->out_pos += length;
+    p += length;
+    size -= length;
+  }
+
+  return p - (uint8_t *)data;
+}
+
+void psarcEntryClose(PsarcEntryReader *reader) {
+  if (!reader)
+    return;
+
+  free(reader->out);
+  free(reader->in);
+  free(reader);
+}
+
+static int extractWorker(PsarcExtract *extract) {
+  PsarcArchive *archive = extract->archive;
+
+  uint8_t *in = malloc(archive->block_size);
+
+  while (1) {
+    mutexLock(&extract->mutex);
+
+    // Wait until the slot of the next block has been written out
+    while (!extract->stop && extract->next < extract->n_blocks &&
+           extract->slots[extract->next % extract->n_slots].block != -1) {
+      condWait(&extract->cond, &extract->mutex);
+    }
+
+    if (extract->stop || extract->next >= extract->n_blocks) {
+      mutexUnlock(&extract->mutex);
+      break;
+    }
+
+    uint32_t block = extract->next++;
+    PsarcSlot *slot = &extract->slots[block % extract->n_slots];
+    slot->block = block;
+    slot->ready = 0;
+
+    mutexUnlock(&extract->mutex);
+
+    int res = in ? decompressBlock(archive, extract->entry, block, extract->offsets[block], in, slot->out)
+                 : PSARC_ERROR_NO_MEMORY;
+
+    mutexLock(&extract->mutex);
+    slot->result = res;
+    slot->ready = 1;
+    condBroadcast(&extract->cond);
+    mutexUnlock(&extract->mutex);
+  }
+
+  free(in);
+  return 0;
+}
+
+#ifdef __vita__
+
+static int extractThread(SceSize args, void *argp) {
+  extractWorker(*(PsarcExtract **)argp);
+  return sceKernelExitThread(0);
+}
+
+static int startThread(PsarcThread *thread, PsarcExtract *extract) {
+  *thread = sceKernelCreateThread("psarc_thread", (SceKernelThreadEntry)extractThread, 0x10000100, 0x10000, 0, 0x70000, NULL);
+  if (*thread < 0)
+    return *thread;
+
+  return sceKernelStartThread(*thread, sizeof(PsarcExtract *), &extract);
+}
+
+static void joinThread(PsarcThread thread) {
+  sceKernelWaitThreadEnd(thread, NULL, NULL);
+  sceKernelDeleteThread(thread);
+}
+
+#else
+
+static void *extractThread(void *argp) {
+  extractWorker(argp);
+  return NULL;
+}
+
+static int startThread(PsarcThread *thread, PsarcExtract *extract) {
+  return pthread_create(thread, NULL, extractThread, extract) == 0 ? 0 : -1;
+}
+
+static void joinThread(PsarcThread thread) {
+  pthread_join(thread, NULL);
+}
+
+#endif
+
+static int extractSequential(PsarcArchive *archive, PsarcEntry *entry,
+                             int (* write)(void *argp, const void *data, uint32_t size), void *argp) {
+  PsarcEntryReader *reader = NULL;
+  int res = psarcEntryOpen(&reader, archive, entry);
+  if (res < 0)
+    return res;
+
+  uint32_t n_blocks = getEntryBlocks(archive, entry);
+  uint32_t i;
+
+  for (i = 0; i < n_blocks; i++) {
+    res = decompressBlock(archive, entry, i, reader->offset, reader->in, reader->out);
+    if (res < 0)
+      break;
+
+    reader->offset += getBlockInputSize(archive, entry->block_index + i);
+
+    res = write(argp, reader->out, getBlockOutputSize(archive, entry, i));
+    if (res <= 0)
+      break;
+  }
+
+  psarcEntryClose(reader);
+
+  return n_blocks == 0 ? 1 : res;
+}
+
+int psarcEntryExtract(PsarcArchive *archive, PsarcEntry *entry, int n_threads,
+                      int (* write)(void *argp, const void *data, uint32_t size), void *argp) {
+  uint32_t n_blocks = getEntryBlocks(archive, entry);
+  if (entry->block_index + (uint64_t)n_blocks > archive->n_blocks)
+    return PSARC_ERROR_FORMAT;
+
+  if (n_threads > PSARC_MAX_THREADS)
+    n_threads = PSARC_MAX_THREADS;
+
+  if (n_threads <= 1 || n_blocks <= 1)
+    return extractSequential(archive, entry, write, argp);
+
+  PsarcExtract *extract = malloc(sizeof(PsarcExtract));
+  if (!extract)
+    return PSARC_ERROR_NO_MEMORY;
+
+  memset(extract, 0, sizeof(PsarcExtract));
+  extract->archive = archive;
+  extract->entry = entry;
+  extract->n_blocks = n_blocks;
+  extract->n_slots = n_threads * PSARC_SLOTS_PER_THREAD;
+
+  int res = 1;
+  int i;
+
+  // Blocks are independent once their file offsets are known
+  extract->offsets = malloc(n_blocks * sizeof(uint64_t));
+  if (!extract->offsets)
+    res = PSARC_ERROR_NO_MEMORY;
+
+  if (res > 0) {
+    uint64_t offset = entry->offset;
+    uint32_t block;
+    for (block = 0; block < n_blocks; block++) {
+      extract->offsets[block] = offset;
+      offset += getBlockInputSize(archive, entry->block_index + block);
+    }
+  }
+
+  for (i = 0; i < extract->n_slots; i++) {
+    extract->slots[i].block = -1;
+    extract->slots[i].out = malloc(archive->block_size);
+    if (!extract->slots[i].out)
+      res = PSARC_ERROR_NO_MEMORY;
+  }
+
+  if (res <= 0) {
+    for (i = 0; i < extract->n_slots; i++)
+      free(extract->slots[i].out);
+    free(extract->offsets);
+    free(extract);
+    return res;
+  }
+
+  mutexInit(&extract->mutex, &extract->cond);
+
+  PsarcThread threads[PSARC_MAX_THREADS];
+  int n_started = 0;
+
+  for (i = 0; i < n_threads; i++) {
+    if (startThread(&threads[n_started], extract) < 0)
+      break;
+    n_started++;
+  }
+
+  if (n_started == 0) {
+    res = PSARC_ERROR_NO_MEMORY;
+  } else {
+    // Write the blocks out in order while the workers decompress the next ones
+    uint32_t block;
+    for (block = 0; block < n_blocks; block++) {
+      PsarcSlot *slot = &extract->slots[block % extract->n_slots];
+
+      mutexLock(&extract->mutex);
+      while (!(slot->block == (int)block && slot->ready))
+        condWait(&extract->cond, &extract->mutex);
+      mutexUnlock(&extract->mutex);
+
+      if (slot->result < 0) {
+        res = slot->result;
+        break;
+      }
+
+      res = write(argp, slot->out, getBlockOutputSize(archive, entry, block));
+      if (res <= 0)
+        break;
+
+      mutexLock(&extract->mutex);
+      slot->block = -1;
+      slot->ready = 0;
+      condBroadcast(&extract->cond);
+      mutexUnlock(&extract->mutex);
+    }
+  }
+
+  // Stop the workers
+  mutexLock(&extract->mutex);
+  extract->stop = 1;
+  condBroadcast(&extract->cond);
+  mutexUnlock(&extract->mutex);
+
+  for (i = 0; i < n_started; i++)
+    joinThread(threads[i]);
+
+  mutexDestroy(&extract->mutex, &extract->cond);
+
+  for (i = 0; i < extract->n_slots; i++)
+    free(extract->slots[i].out);
+  free(extract->offsets);
+  free(extract);
+
+  return res;
+}
+
+static int readManifest(PsarcArchive *archive, PsarcEntry *manifest) {
+  PsarcEntryReader *reader = NULL;
+
+  if (manifest->size > 0x10000000)
+    return PSARC_ERROR_FORMAT;
+
+  archive->manifest = malloc(manifest->size + 1);
+  if (!archive->manifest)
+    return PSARC_ERROR_NO_MEMORY;
+
+  int res = psarcEntryOpen(&reader, archive, manifest);
+  if (res < 0)
+    return res;
+
+  res = psarcEntryRead(reader, archive->manifest, manifest->size);
+  psarcEntryClose(reader);
+
+  if (res < 0)
+    return res;
+
+  if ((uint64_t)res != manifest->size)
+    return PSARC_ERROR_FORMAT;
+
+  archive->manifest[manifest->size] = '\0';
+
+  // One path per line, in the order of the entries
+  char *p = archive->manifest;
+  uint32_t i;
+
+  for (i = 0; i < archive->n_entries; i++) {
+    if (*p == '\0')
+      return PSARC_ERROR_FORMAT;
+
+    char *end = strchr(p, '\n');
+    if (end)
+      *end = '\0';
+
+    // Absolute paths
+    while (*p == '/')
+      p++;
+
+    size_t length = strlen(p);
+    if (length > 0 && p[length - 1] == '\r')
+      p[length - 1] = '\0';
+
+    archive->entries[i].name = p;
+
+    p = end ? end + 1 : p + length;
+  }
+
+  return 0;
+}
+
+int psarcArchiveOpen(PsarcArchive **archive, const char *path) {
+  int res;
+  uint8_t header[PSARC_HEADER_SIZE];
+  uint8_t *toc = NULL;
+
+  PsarcArchive *a = malloc(sizeof(PsarcArchive));
+  if (!a)
+    return PSARC_ERROR_NO_MEMORY;
+
+  memset(a, 0, sizeof(PsarcArchive));
+
+  a->fd = fileOpen(path);
+  if (a->fd < 0) {
+    res = a->fd;
+    free(a);
+    return res;
+  }
+
+  res = readAt(a->fd, header, PSARC_HEADER_SIZE, 0);
+  if (res < 0)
+    goto ERROR;
+
+  uint32_t toc_length = getBe32(header + 12);
+  uint32_t toc_entry_size = getBe32(header + 16);
+  uint32_t n_entries = getBe32(header + 20);
+  uint32_t flags = getBe32(header + 28);
+
+  a->compression = getBe32(header + 8);
+  a->block_size = getBe32(header + 24);
+
+  if (getBe32(header) != PSARC_MAGIC || toc_entry_size < PSARC_TOC_ENTRY_SIZE || n_entries == 0 ||
+      toc_length < PSARC_HEADER_SIZE + (uint64_t)n_entries * toc_entry_size || a->block_size == 0) {
+    res = PSARC_ERROR_FORMAT;
+    goto ERROR;
+  }
+
+  if ((flags & PSARC_FLAG_ENCRYPTED) ||
+      (a->compression != PSARC_COMPRESSION_ZLIB && a->compression != PSARC_COMPRESSION_LZMA)) {
+    res = PSARC_ERROR_UNSUPPORTED;
+    goto ERROR;
+  }
+
+  // Read TOC and block size table at once
+  uint32_t toc_size = toc_length - PSARC_HEADER_SIZE;
+  toc = malloc(toc_size);
+  if (!toc) {
+    res = PSARC_ERROR_NO_MEMORY;
+    goto ERROR;
+  }
+
+  res = readAt(a->fd, toc, toc_size, PSARC_HEADER_SIZE);
+  if (res < 0)
+    goto ERROR;
+
+  // Block sizes are stored with as many bytes as needed for the block size
+  int size_bytes = 4;
+  if (a->block_size <= 0x10000)
+    size_bytes = 2;
+  else if (a->block_size <= 0x1000000)
+    size_bytes = 3;
+
+  uint8_t *table = toc + n_entries * toc_entry_size;
+  a->n_blocks = (toc_size - n_entries * toc_entry_size) / size_bytes;
+
+  a->block_sizes = malloc(a->n_blocks * sizeof(uint32_t) + 1);
+  a->entries = malloc(n_entries * sizeof(PsarcEntry));
+  if (!a->block_sizes || !a->entries) {
+    res = PSARC_ERROR_NO_MEMORY;
+    goto ERROR;
+  }
+
+  uint32_t i;
+  for (i = 0; i < a->n_blocks; i++) {
+    uint8_t *p = table + i * size_bytes;
+    if (size_bytes == 2)
+      a->block_sizes[i] = getBe16(p);
+    else if (size_bytes == 3)
+      a->block_sizes[i] = getBe24(p);
+    else
+      a->block_sizes[i] = getBe32(p);
+  }
+
+  for (i = 0; i < n_entries; i++) {
+    uint8_t *p = toc + i * toc_entry_size;
+    a->entries[i].name = NULL;
+    a->entries[i].block_index = getBe32(p + 16);
+    a->entries[i].size = getBe40(p + 20);
+    a->entries[i].offset = getBe40(p + 25);
+
+    if (a->entries[i].block_index + (uint64_t)getEntryBlocks(a, &a->entries[i]) > a->n_blocks) {
+      res = PSARC_ERROR_FORMAT;
+      goto ERROR;
+    }
+  }
+
+  free(toc);
+  toc = NULL;
+
+  // The first entry is the manifest holding the names of the others
+  PsarcEntry manifest = a->entries[0];
+  a->n_entries = n_entries - 1;
+  memmove(a->entries, a->entries + 1, a->n_entries * sizeof(PsarcEntry));
+
+  res = readManifest(a, &manifest);
+  if (res < 0)
+    goto ERROR;
+
+  *archive = a;
+  return 0;
+
+ERROR:
+  free(toc);
+  psarcArchiveClose(a);
+  return res;
+}
+
+void psarcArchiveClose(PsarcArchive *archive) {
+  if (!archive)
+    return;
+
+  if (archive->fd >= 0)
+    fileClose(archive->fd);
+
+  free(archive->manifest);
+  free(archive->entries);
+  free(archive->block_sizes);
+  free(archive);
+}
@@ -0,0 +1,65 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __PSARC_READER_H__
+#define __PSARC_READER_H__
+
+#include <stdint.h>
+
+// This reader only depends on zlib and liblzma and also builds against POSIX
+
+#define PSARC_MAGIC 0x50534152 // PSAR
+#define PSARC_COMPRESSION_ZLIB 0x7A6C6962 // zlib
+#define PSARC_COMPRESSION_LZMA 0x6C7A6D61 // lzma
+
+#define PSARC_ERROR_FORMAT ((int)0x80101201)
+#define PSARC_ERROR_UNSUPPORTED ((int)0x80101202)
+#define PSARC_ERROR_DECOMPRESS ((int)0x80101203)
+#define PSARC_ERROR_NO_MEMORY ((int)0x80101204)
+
+typedef struct PsarcEntry {
+  char *name;
+  uint64_t size;
+  uint64_t offset;
+  uint32_t block_index;
+} PsarcEntry;
+
+typedef struct PsarcArchive {
+  int fd;
+  uint32_t compression;
+  uint32_t block_size;
+  uint32_t n_blocks;
+  uint32_t *block_sizes; // Compressed size of each block, 0 for a full block stored as is
+  uint32_t n_entries;    // Without the manifest
+  PsarcEntry *entries;
+  char *manifest;
+} PsarcArchive;
+
+typedef struct PsarcEntryReader PsarcEntryReader;
+
+int psarcArchiveOpen(PsarcArchive **archive, const char *path);
+void psarcArchiveClose(PsarcArchive *archive);
+
+int psarcEntryOpen(PsarcEntryReader **reader, PsarcArchive *archive, PsarcEntry *entry);
+int psarcEntryRead(PsarcEntryReader *reader, void *data, uint32_t size);
+void psarcEntryClose(PsarcEntryReader *reader);
+
+int psarcEntryExtract(PsarcArchive *archive, PsarcEntry *entry, int n_threads,
+                      int (* write)(void *argp, const void *data, uint32_t size), void *argp);
+
+#endif
@@ -0,0 +1,858 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <onigmo.h>
+
+#include "main.h"
+#include "search.h"
+#include "dir_cache.h"
+#include "file.h"
+#include "language.h"
+#include "theme.h"
+#include "utils.h"
+#include "sqlite3.h"
+
+/*
+  Folders are read by several workers that share a stack of folders to visit.
+  Every folder is also stored in an index with its mtime. An unchanged folder
+  is answered from the index instead of being read again, and the index gives
+  the first matches before the walk starts.
+*/
+
+static char *index_schema =
+  "CREATE TABLE IF NOT EXISTS dirs(path TEXT PRIMARY KEY, mtime INTEGER, seen INTEGER);"
+  "CREATE TABLE IF NOT EXISTS entries(dir TEXT, name TEXT, is_folder INTEGER, size INTEGER, mtime INTEGER);"
+  "CREATE INDEX IF NOT EXISTS entries_dir ON entries(dir);";
+
+enum SearchStatements {
+  STMT_GET_DIR,
+  STMT_GET_ENTRIES,
+  STMT_SEEN_DIR,
+  STMT_DELETE_ENTRIES,
+  STMT_INSERT_ENTRY,
+  STMT_PUT_DIR,
+  N_STMTS,
+};
+
+static char *statements[N_STMTS] = {
+  "SELECT mtime FROM dirs WHERE path = ?",
+  "SELECT name, is_folder, size, mtime FROM entries WHERE dir = ?",
+  "UPDATE dirs SET seen = ? WHERE path = ?",
+  "DELETE FROM entries WHERE dir = ?",
+  "INSERT INTO entries VALUES(?, ?, ?, ?, ?)",
+  "INSERT OR REPLACE INTO dirs VALUES(?, ?, ?)",
+};
+
+typedef struct {
+  SearchQuery query;
+  regex_t *regex;
+
+  char roots[SEARCH_MAX_ROOTS][MAX_PATH_LENGTH];
+  int n_roots;
+
+  // Folders to visit and results, guarded by mutex
+  SceKernelLwMutexWork mutex;
+  char **stack;
+  int n_stack;
+  int max_stack;
+  int busy;
+  FileList results; // Shown, matches from the index first
+  FileList found;   // Matches of the walk, replace the results when it is complete
+  int n_folders;
+
+  // Index, guarded by db_mutex
+  SceKernelLwMutexWork db_mutex;
+  sqlite3 *db;
+  sqlite3_stmt *stmts[N_STMTS];
+  int64_t generation;
+
+  SceUID thid;
+  volatile int abort;
+  volatile int done;
+} Search;
+
+static Search search;
+
+static int parseSize(const char *string, SceOff *size) {
+  char *end = NULL;
+  double value = strtod(string, &end);
+  if (end == string || value < 0)
+    return -1;
+
+  switch (toupper((uint8_t)*end)) {
+    case 'K':
+      value *= 1024.0;
+      break;
+    case 'M':
+      value *= 1024.0 * 1024.0;
+      break;
+    case 'G':
+      value *= 1024.0 * 1024.0 * 1024.0;
+      break;
+  }
+
+  *size = (SceOff)value;
+  return 0;
+}
+
+static int parseDate(const char *string, uint64_t *tick) {
+  int year, month, day;
+  if (sscanf(string, "%d-%d-%d", &year, &month, &day) != 3)
+    return -1;
+
+  SceDateTime time;
+  memset(&time, 0, sizeof(SceDateTime));
+  time.year = year;
+  time.month = month;
+  time.day = day;
+
+  SceRtcTick rtc_tick;
+  if (sceRtcGetTick(&time, &rtc_tick) < 0)
+    return -1;
+
+  *tick = rtc_tick.tick;
+  return 0;
+}
+
+/*
+  Words like size>10M, size<1G, after:2018-01-31 and before:2019-01-01 are
+  filters, the other words are the name pattern. A pattern starting with re:
+  is a regular expression, one with * or ? a glob, anything else a substring.
+*/
+int searchParseQuery(SearchQuery *query, const char *string) {
+  memset(query, 0, sizeof(SearchQuery));
+  query->min_size = -1;
+  query->max_size = -1;
+
+  char buf[MAX_NAME_LENGTH];
+  strncpy(buf, string, MAX_NAME_LENGTH - 1);
+  buf[MAX_NAME_LENGTH - 1] = '\0';
+
+  int n_filters = 0;
+
+  char *save = NULL;
+  char *word = strtok_r(buf, " ", &save);
+  while (word) {
+    int res = 0;
+
+    if (strncasecmp(word, "size>", 5) == 0) {
+      res = parseSize(word + 5, &query->min_size);
+      n_filters++;
+    } else if (strncasecmp(word, "size<", 5) == 0) {
+      res = parseSize(word + 5, &query->max_size);
+      n_filters++;
+    } else if (strncasecmp(word, "after:", 6) == 0) {
+      res = parseDate(word + 6, &query->after);
+      n_filters++;
+    } else if (strncasecmp(word, "before:", 7) == 0) {
+      res = parseDate(word + 7, &query->before);
+      n_filters++;
+    } else {
+      if (query->pattern[0] != '\0')
+        strcat(query->pattern, " ");
+      strcat(query->pattern, word);
+    }
+
+    if (res < 0)
+      return SEARCH_ERROR_QUERY;
+
+    word = strtok_r(NULL, " ", &save);
+  }
+
+  if (query->pattern[0] == '\0' && n_filters == 0)
+    return SEARCH_ERROR_QUERY;
+
+  if (strncasecmp(query->pattern, "re:", 3) == 0) {
+    memmove(query->pattern, query->pattern + 3, strlen(query->pattern + 3) + 1);
+    query->mode = SEARCH_MODE_REGEX;
+  } else if (strpbrk(query->pattern, "*?")) {
+    query->mode = SEARCH_MODE_GLOB;
+  } else {
+    query->mode = SEARCH_MODE_SUBSTRING;
+  }
+
+  return 0;
+}
+
+static int globMatch(const char *pattern, const char *name) {
+  const char *star = NULL, *retry = NULL;
+
+  while (*name) {
+    if (*pattern == '*') {
+      star = pattern++;
+      retry = name;
+    } else if (*pattern == '?' || tolower((uint8_t)*pattern) == tolower((uint8_t)*name)) {
+      pattern++;
+      name++;
+    } else if (star) {
+      pattern = star + 1;
+      name = ++retry;
+    } else {
+      return 0;
+    }
+  }
+
+  while (*pattern == '*')
+    pattern++;
+
+  return *pattern == '\0';
+}
+
+static int matchEntry(const char *name, int is_folder, SceOff size, uint64_t tick) {
+  SearchQuery *query = &search.query;
+
+  if (!is_folder) {
+    if (query->min_size >= 0 && size <= query->min_size)
+      return 0;
+    if (query->max_size >= 0 && size >= query->max_size)
+      return 0;
+  } else if (query->min_size >= 0 || query->max_size >= 0) {
+    return 0;
+  }
+
+  if (query->after && tick < query->after)
+    return 0;
+  if (query->before && tick >= query->before)
+    return 0;
+
+  switch (query->mode) {
+    case SEARCH_MODE_GLOB:
+      return globMatch(query->pattern, name);
+
+    case SEARCH_MODE_REGEX:
+      return onig_search(search.regex, (const OnigUChar *)name, (const OnigUChar *)name + strlen(name),
+                         (const OnigUChar *)name, (const OnigUChar *)name + strlen(name), NULL, ONIG_OPTION_NONE) >= 0;
+
+    default:
+      return strcasestr(name, query->pattern) != NULL;
+  }
+}
+
+static void addResult(FileList *list, const char *path, int is_folder, SceOff size, uint64_t tick) {
+  FileListEntry *entry = fileListAllocEntry(&list->arena, strlen(path));
+  if (!entry)
+    return;
+
+  strcpy(entry->name, path);
+  entry->is_folder = is_folder;
+  entry->type = is_folder ? FILE_TYPE_UNKNOWN : getFileType(path);
+  entry->size = size;
+
+  SceRtcTick rtc_tick;
+  rtc_tick.tick = tick;
+  sceRtcSetTick(&entry->mtime, &rtc_tick);
+
+  fileListAddEntry(list, entry, SORT_NONE);
+}
+
+static void reportMatch(const char *folder, const char *name, int is_folder, SceOff size, uint64_t tick, int from_index) {
+  if (!matchEntry(name, is_folder, size, tick))
+    return;
+
+  char path[MAX_PATH_LENGTH];
+  snprintf(path, MAX_PATH_LENGTH, "%s%s%s", folder, name, is_folder ? "/" : "");
+
+  sceKernelLockLwMutex(&search.mutex, 1, NULL);
+
+  if (!from_index && search.found.length < SEARCH_MAX_RESULTS)
+    addResult(&search.found, path, is_folder, size, tick);
+
+  if (search.results.length < SEARCH_MAX_RESULTS && !fileListFindEntry(&search.results, path))
+    addResult(&search.results, path, is_folder, size, tick);
+
+  sceKernelUnlockLwMutex(&search.mutex, 1);
+}
+
+static void pushFolder(const char *path) {
+  char *copy = malloc(strlen(path) + 1);
+  if (!copy)
+    return;
+
+  strcpy(copy, path);
+
+  sceKernelLockLwMutex(&search.mutex, 1, NULL);
+
+  if (search.n_stack == search.max_stack) {
+    int max_stack = search.max_stack ? search.max_stack * 2 : 256;
+    char **stack = realloc(search.stack, max_stack * sizeof(char *));
+    if (!stack) {
+      sceKernelUnlockLwMutex(&search.mutex, 1);
+      free(copy);
+      return;
+    }
+
+    search.stack = stack;
+    search.max_stack = max_stack;
+  }
+
+  search.stack[search.n_stack++] = copy;
+
+  sceKernelUnlockLwMutex(&search.mutex, 1);
+}
+
+static uint64_t getTick(SceDateTime *time) {
+  SceRtcTick tick;
+  sceRtcGetTick(time, &tick);
+  return tick.tick;
+}
+
+// Returns the entries of an unchanged folder from the index
+static FileListEntry *readIndexedFolder(FileListArena *arena, const char *path, uint64_t mtime) {
+  FileListEntry *head = NULL;
+
+  sceKernelLockLwMutex(&search.db_mutex, 1, NULL);
+
+  sqlite3_stmt *stmt = search.stmts[STMT_GET_DIR];
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  int indexed = sqlite3_step(stmt) == SQLITE_ROW && (uint64_t)sqlite3_column_int64(stmt, 0) == mtime;
+  sqlite3_reset(stmt);
+
+  if (indexed) {
+    stmt = search.stmts[STMT_GET_ENTRIES];
+    sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      const char *name = (const char *)sqlite3_column_text(stmt, 0);
+
+      FileListEntry *entry = fileListAllocEntry(arena, strlen(name));
+      if (!entry)
+        break;
+
+      strcpy(entry->name, name);
+      entry->is_folder = sqlite3_column_int(stmt, 1);
+      entry->size = sqlite3_column_int64(stmt, 2);
+      entry->sort.tick = sqlite3_column_int64(stmt, 3);
+      entry->next = head;
+      head = entry;
+    }
+
+    sqlite3_reset(stmt);
+
+    stmt = search.stmts[STMT_SEEN_DIR];
+    sqlite3_bind_int64(stmt, 1, search.generation);
+    sqlite3_bind_text(stmt, 2, path, -1, SQLITE_STATIC);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+  }
+
+  sceKernelUnlockLwMutex(&search.db_mutex, 1);
+
+  // An empty folder is still indexed
+  return indexed && !head ? (FileListEntry *)-1 : head;
+}
+
+static FileListEntry *readFolder(FileListArena *arena, const char *path, uint64_t mtime) {
+  SceUID dfd = sceIoDopen(path);
+  if (dfd < 0)
+    return NULL;
+
+  FileListEntry *head = NULL;
+
+  int res = 0;
+
+  do {
+    SceIoDirent dir;
+    memset(&dir, 0, sizeof(SceIoDirent));
+
+    res = sceIoDread(dfd, &dir);
+    if (res > 0) {
+      FileListEntry *entry = fileListAllocEntry(arena, strlen(dir.d_name));
+      if (!entry)
+        break;
+
+      strcpy(entry->name, dir.d_name);
+      entry->is_folder = SCE_S_ISDIR(dir.d_stat.st_mode);
+      entry->size = dir.d_stat.st_size;
+      entry->sort.tick = getTick((SceDateTime *)&dir.d_stat.st_mtime);
+      entry->next = head;
+      head = entry;
+    }
+  } while (res > 0 && !search.abort);
+
+  sceIoDclose(dfd);
+
+  if (search.abort || !search.db)
+    return head ? head : (FileListEntry *)-1;
+
+  // Replace the folder in the index
+  sceKernelLockLwMutex(&search.db_mutex, 1, NULL);
+
+  sqlite3_stmt *stmt = search.stmts[STMT_DELETE_ENTRIES];
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_step(stmt);
+  sqlite3_reset(stmt);
+
+  stmt = search.stmts[STMT_INSERT_ENTRY];
+
+  FileListEntry *entry = head;
+  while (entry) {
+    sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, entry->name, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 3, entry->is_folder);
+    sqlite3_bind_int64(stmt, 4, entry->size);
+    sqlite3_bind_int64(stmt, 5, entry->sort.tick);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+
+    entry = entry->next;
+  }
+
+  stmt = search.stmts[STMT_PUT_DIR];
+  sqlite3_bind_text(stmt, 1, path, -1, SQLITE_STATIC);
+  sqlite3_bind_int64(stmt, 2, mtime);
+  sqlite3_bind_int64(stmt, 3, search.generation);
+  sqlite3_step(stmt);
+  sqlite3_reset(stmt);
+
+  sceKernelUnlockLwMutex(&search.db_mutex, 1);
+
+  return head ? head : (FileListEntry *)-1;
+}
+
+static void searchFolder(const char *path) {
+  SceDateTime time;
+  if (dirCacheGetMtime(path, &time) < 0)
+    return;
+
+  uint64_t mtime = getTick(&time);
+
+  FileListArena arena;
+  memset(&arena, 0, sizeof(FileListArena));
+
+  FileListEntry *head = search.db ? readIndexedFolder(&arena, path, mtime) : NULL;
+  if (!head)
+    head = readFolder(&arena, path, mtime);
+
+  if (head == (FileListEntry *)-1)
+    head = NULL;
+
+  FileListEntry *entry = head;
+  while (entry && !search.abort) {
+    reportMatch(path, entry->name, entry->is_folder, entry->size, entry->sort.tick, 0);
+
+    if (entry->is_folder) {
+      char folder[MAX_PATH_LENGTH];
+      snprintf(folder, MAX_PATH_LENGTH, "%s%s/", path, entry->name);
+      pushFolder(folder);
+    }
+
+    entry = entry->next;
+  }
+
+  fileListArenaFree(&arena);
+
+  sceKernelLockLwMutex(&search.mutex, 1, NULL);
+  search.n_folders++;
+  sceKernelUnlockLwMutex(&search.mutex, 1);
+}
+
+static int search_worker_thread(SceSize args, void *argp) {
+  while (!search.abort) {
+    sceKernelLockLwMutex(&search.mutex, 1, NULL);
+
+    // Done when no folder is left and no worker can add one
+    if (search.n_stack == 0) {
+      int busy = search.busy;
+      sceKernelUnlockLwMutex(&search.mutex, 1);
+
+      if (busy == 0)
+        break;
+
+      sceKernelDelayThread(1000);
+      continue;
+    }
+
+    char *path = search.stack[--search.n_stack];
+    search.busy++;
+
+    sceKernelUnlockLwMutex(&search.mutex, 1);
+
+    searchFolder(path);
+    free(path);
+
+    sceKernelLockLwMutex(&search.mutex, 1, NULL);
+    search.busy--;
+    sceKernelUnlockLwMutex(&search.mutex, 1);
+  }
+
+  return sceKernelExitThread(0);
+}
+
+static int openIndex() {
+  int rc = sqlite3_open_v2(SEARCH_INDEX_FILE, &search.db, SQLITE_OPEN_CREATE | SQLITE_OPEN_READWRITE, NULL);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_exec(search.db, "PRAGMA journal_mode = MEMORY; PRAGMA synchronous = OFF;", NULL, NULL, NULL);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_exec(search.db, index_schema, NULL, NULL, NULL);
+
+  int i;
+  for (i = 0; i < N_STMTS && rc == SQLITE_OK; i++)
+    rc = sqlite3_prepare_v2(search.db, statements[i], -1, &search.stmts[i], NULL);
+
+  if (rc != SQLITE_OK) {
+    for (i = 0; i < N_STMTS; i++) {
+      sqlite3_finalize(search.stmts[i]);
+      search.stmts[i] = NULL;
+    }
+
+    sqlite3_close(search.db);
+    search.db = NULL;
+    return -1;
+  }
+
+  return 0;
+}
+
+static void closeIndex() {
+  int i;
+  for (i = 0; i < N_STMTS; i++) {
+    sqlite3_finalize(search.stmts[i]);
+    search.stmts[i] = NULL;
+  }
+
+  sqlite3_close(search.db);
+  search.db = NULL;
+}
+
+// Gives the first matches from the index, before any folder is read
+static void searchIndex(const char *root) {
+  // All paths starting with root
+  char end[MAX_PATH_LENGTH];
+  strcpy(end, root);
+  end[strlen(end) - 1]++;
+
+  sqlite3_stmt *stmt = NULL;
+  if (sqlite3_prepare_v2(search.db, "SELECT dir, name, is_folder, size, mtime FROM entries WHERE dir >= ? AND dir < ?",
+                         -1, &stmt, NULL) != SQLITE_OK)
+    return;
+
+  sqlite3_bind_text(stmt, 1, root, -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 2, end, -1, SQLITE_STATIC);
+
+  while (!search.abort && sqlite3_step(stmt) == SQLITE_ROW) {
+    reportMatch((const char *)sqlite3_column_text(stmt, 0), (const char *)sqlite3_column_text(stmt, 1),
+                sqlite3_column_int(stmt, 2), sqlite3_column_int64(stmt, 3), sqlite3_column_int64(stmt, 4), 1);
+  }
+
+  sqlite3_finalize(stmt);
+}
+
+// Drops deleted files, their folders may keep the same mtime
+void searchIndexRemoveFiles(char **paths, int n_paths) {
+  sqlite3 *db = NULL;
+  if (sqlite3_open_v2(SEARCH_INDEX_FILE, &db, SQLITE_OPEN_READWRITE, NULL) != SQLITE_OK) {
+    sqlite3_close(db);
+    return;
+  }
+
+  sqlite3_stmt *stmt = NULL;
+  if (sqlite3_prepare_v2(db, "DELETE FROM entries WHERE dir = ? AND name = ?", -1, &stmt, NULL) == SQLITE_OK) {
+    sqlite3_exec(db, "BEGIN", NULL, NULL, NULL);
+
+    int i;
+    for (i = 0; i < n_paths; i++) {
+      char *name = strrchr(paths[i], '/');
+      if (!name)
+        name = strchr(paths[i], ':');
+      if (!name)
+        continue;
+
+      name++;
+
+      sqlite3_bind_text(stmt, 1, paths[i], name - paths[i], SQLITE_STATIC);
+      sqlite3_bind_text(stmt, 2, name, -1, SQLITE_STATIC);
+      sqlite3_step(stmt);
+      sqlite3_reset(stmt);
+    }
+
+    sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
+  }
+
+  sqlite3_finalize(stmt);
+  sqlite3_close(db);
+}
+
+// Removes folders below root that the walk did not find anymore
+static void pruneIndex(const char *root) {
+  char end[MAX_PATH_LENGTH];
+  strcpy(end, root);
+  end[strlen(end) - 1]++;
+
+  static char *queries[] = {
+    "DELETE FROM entries WHERE dir IN (SELECT path FROM dirs WHERE path >= ?1 AND path < ?2 AND seen != ?3)",
+    "DELETE FROM dirs WHERE path >= ?1 AND path < ?2 AND seen != ?3",
+  };
+
+  int i;
+  for (i = 0; i < sizeof(queries) / sizeof(char *); i++) {
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(search.db, queries[i], -1, &stmt, NULL) != SQLITE_OK)
+      continue;
+
+    sqlite3_bind_text(stmt, 1, root, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, end, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 3, search.generation);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+  }
+}
+
+static int search_thread(SceSize args, void *argp) {
+  int i;
+
+  if (search.db) {
+    sqlite3_exec(search.db, "BEGIN", NULL, NULL, NULL);
+
+    for (i = 0; i < search.n_roots && !search.abort; i++)
+      searchIndex(search.roots[i]);
+  }
+
+  for (i = 0; i < search.n_roots; i++)
+    pushFolder(search.roots[i]);
+
+  SceUID thids[SEARCH_N_WORKERS];
+  for (i = 0; i < SEARCH_N_WORKERS; i++) {
+    thids[i] = sceKernelCreateThread("search_worker_thread", (SceKernelThreadEntry)search_worker_thread, 0x10000100, 0x10000, 0, 0, NULL);
+    if (thids[i] >= 0)
+      sceKernelStartThread(thids[i], 0, NULL);
+  }
+
+  for (i = 0; i < SEARCH_N_WORKERS; i++) {
+    if (thids[i] >= 0) {
+      sceKernelWaitThreadEnd(thids[i], NULL, NULL);
+      sceKernelDeleteThread(thids[i]);
+    }
+  }
+
+  if (search.db) {
+    if (!search.abort) {
+      for (i = 0; i < search.n_roots; i++)
+        pruneIndex(search.roots[i]);
+    }
+
+    sqlite3_exec(search.db, "COMMIT", NULL, NULL, NULL);
+  }
+
+  sceKernelLockLwMutex(&search.mutex, 1, NULL);
+
+  // The walk is complete, its matches replace the ones of the index
+  if (!search.abort) {
+    fileListEmpty(&search.results);
+    memcpy(&search.results, &search.found, sizeof(FileList));
+    memset(&search.found, 0, sizeof(FileList));
+  }
+
+  fileListSort(&search.results, SORT_BY_NAME);
+
+  search.done = 1;
+
+  sceKernelUnlockLwMutex(&search.mutex, 1);
+
+  return sceKernelExitThread(0);
+}
+
+static int startSearch(const char *path, SearchQuery *query) {
+  memset(&search, 0, sizeof(Search));
+  memcpy(&search.query, query, sizeof(SearchQuery));
+  search.thid = -1;
+
+  if (query->mode == SEARCH_MODE_REGEX) {
+    OnigErrorInfo einfo;
+    int res = onig_new(&search.regex, (const OnigUChar *)query->pattern,
+                       (const OnigUChar *)query->pattern + strlen(query->pattern),
+                       ONIG_OPTION_IGNORECASE, ONIG_ENCODING_UTF8, ONIG_SYNTAX_DEFAULT, &einfo);
+    if (res != ONIG_NORMAL)
+      return SEARCH_ERROR_REGEX;
+  }
+
+  // All storages from home
+  if (strcasecmp(path, HOME_PATH) == 0) {
+    static char *roots[] = { "ux0:", "uma0:", "imc0:" };
+
+    int i;
+    for (i = 0; i < sizeof(roots) / sizeof(char *); i++) {
+      if (checkFolderExist(roots[i]))
+        strcpy(search.roots[search.n_roots++], roots[i]);
+    }
+  } else {
+    strcpy(search.roots[search.n_roots++], path);
+  }
+
+  SceRtcTick tick;
+  sceRtcGetCurrentTick(&tick);
+  search.generation = (int64_t)tick.tick;
+
+  sceKernelCreateLwMutex(&search.mutex, "search_mutex", 2, 0, NULL);
+  sceKernelCreateLwMutex(&search.db_mutex, "search_db_mutex", 2, 0, NULL);
+
+  // Search without the index if it cannot be opened
+  openIndex();
+
+  search.thid = sceKernelCreateThread("search_thread", (SceKernelThreadEntry)search_thread, 0x10000100, 0x10000, 0, 0, NULL);
+  if (search.thid < 0) {
+    int res = search.thid;
+    closeIndex();
+    sceKernelDeleteLwMutex(&search.db_mutex);
+    sceKernelDeleteLwMutex(&search.mutex);
+    if (search.regex)
+      onig_free(search.regex);
+    return res;
+  }
+
+  sceKernelStartThread(search.thid, 0, NULL);
+
+  return 0;
+}
+
+static void stopSearch() {
+  search.abort = 1;
+
+  sceKernelWaitThreadEnd(search.thid, NULL, NULL);
+  sceKernelDeleteThread(search.thid);
+  search.thid = -1;
+
+  closeIndex();
+
+  int i;
+  for (i = 0; i < search.n_stack; i++)
+    free(search.stack[i]);
+  free(search.stack);
+
+  fileListEmpty(&search.results);
+  fileListEmpty(&search.found);
+
+  sceKernelDeleteLwMutex(&search.db_mutex);
+  sceKernelDeleteLwMutex(&search.mutex);
+
+  if (search.regex)
+    onig_free(search.regex);
+}
+
+// Returns 1 and the path of the chosen match, 0 if closed
+int searchViewer(const char *path, const char *string, char *result) {
+  SearchQuery query;
+  int res = searchParseQuery(&query, string);
+  if (res < 0)
+    return res;
+
+  res = startSearch(path, &query);
+  if (res < 0)
+    return res;
+
+  int base_pos = 0, rel_pos = 0;
+  int ret = 0;
+
+  char title[MAX_PATH_LENGTH];
+  snprintf(title, MAX_PATH_LENGTH, "%s: %s", language_container[SEARCH], string);
+
+  while (1) {
+    readPad();
+
+    sceKernelLockLwMutex(&search.mutex, 1, NULL);
+
+    int length = search.results.length;
+
+    if (hold_pad[PAD_UP] || hold2_pad[PAD_LEFT_ANALOG_UP]) {
+      if (rel_pos > 0) {
+        rel_pos--;
+      } else if (base_pos > 0) {
+        base_pos--;
+      }
+    } else if (hold_pad[PAD_DOWN] || hold2_pad[PAD_LEFT_ANALOG_DOWN]) {
+      if ((base_pos + rel_pos + 1) < length) {
+        if ((rel_pos + 1) < MAX_POSITION) {
+          rel_pos++;
+        } else {
+          base_pos++;
+        }
+      }
+    }
+
+    // The results are replaced when the walk is complete
+    if (base_pos + rel_pos >= length) {
+      base_pos = MAX(0, length - MAX_POSITION);
+      rel_pos = MAX(0, length - 1 - base_pos);
+    }
+
+    // Stop the search and keep the matches so far
+    if (pressed_pad[PAD_TRIANGLE])
+      search.abort = 1;
+
+    if (pressed_pad[PAD_ENTER]) {
+      FileListEntry *entry = fileListGetNthEntry(&search.results, base_pos + rel_pos);
+      if (entry) {
+        strcpy(result, entry->name);
+        ret = 1;
+      }
+    }
+
+    // Start drawing
+    startDrawing(bg_browser_image);
+
+    // Draw shell info
+    drawShellInfo(title);
+
+    // Draw scroll bar
+    drawScrollBar(base_pos, length);
+
+    // Status
+    if (search.done) {
+      pgf_draw_textf(SHELL_MARGIN_X, START_Y, PATH_COLOR, language_container[SEARCH_DONE], length);
+    } else {
+      pgf_draw_textf(SHELL_MARGIN_X, START_Y, PATH_COLOR, language_container[SEARCH_PROGRESS],
+                     search.n_folders, length);
+    }
+
+    // Matches
+    FileListEntry *entry = fileListGetNthEntry(&search.results, base_pos);
+
+    int i;
+    for (i = 0; i < MAX_POSITION && entry; i++) {
+      float y = START_Y + ((i + 1) * FONT_Y_SPACE);
+
+      uint32_t color = entry->is_folder ? FOLDER_COLOR : FILE_COLOR;
+      if (i == rel_pos)
+        color = FOCUS_COLOR;
+
+      vita2d_enable_clipping();
+      vita2d_set_clip_rectangle(SHELL_MARGIN_X, y, INFORMATION_X - 20.0f, y + FONT_Y_SPACE);
+      pgf_draw_text(SHELL_MARGIN_X, y, color, entry->name);
+      vita2d_disable_clipping();
+
+      if (!entry->is_folder) {
+        char size_string[16];
+        getSizeString(size_string, entry->size);
+        pgf_draw_text(ALIGN_RIGHT(SCREEN_WIDTH - SHELL_MARGIN_X, pgf_text_width(size_string)), y, color, size_string);
+      }
+
+      entry = entry->next;
+    }
+
+    sceKernelUnlockLwMutex(&search.mutex, 1);
+
+    // End drawing
+    endDrawing();
+
+    if (ret || pressed_pad[PAD_CANCEL])
+      break;
+  }
+
+  stopSearch();
+
+  return ret;
+}
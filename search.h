@@ -0,0 +1,53 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SEARCH_H__
+#define __SEARCH_H__
+
+#include "file.h"
+
+#define SEARCH_INDEX_FILE "ux0:VitaShell/internal/search_index.db"
+
+#define SEARCH_N_WORKERS 3
+#define SEARCH_MAX_RESULTS 10000
+#define SEARCH_MAX_ROOTS 4
+
+#define SEARCH_ERROR_QUERY ((int)0x80101301)
+#define SEARCH_ERROR_REGEX ((int)0x80101302)
+
+enum SearchModes {
+  SEARCH_MODE_SUBSTRING,
+  SEARCH_MODE_GLOB,
+  SEARCH_MODE_REGEX,
+};
+
+typedef struct {
+  int mode;
+  char pattern[MAX_NAME_LENGTH];
+  SceOff min_size; // -1 if not set
+  SceOff max_size;
+  uint64_t after;  // mtime as tick, 0 if not set
+  uint64_t before;
+} SearchQuery;
+
+int searchParseQuery(SearchQuery *query, const char *string);
+int searchViewer(const char *path, const char *string, char *result);
+
+void searchIndexRemoveFiles(char **paths, int n_paths);
+
+#endif
@@ -19,6 +19,7 @@
 #include "main.h"
 #include "config.h"
 #include "init.h"
+#include "dir_cache.h"
 #include "theme.h"
 #include "language.h"
 #include "settings.h"
@@ -41,6 +42,8 @@ static int n_settings_entries = 0;
 
 static char *usbdevice_options[4];
 static char *select_button_options[2];
+static char *hash_algorithms_options[5];
+static char *text_cache_size_options[4];
 
 static char **theme_options = NULL;
 static int theme_count = 0;
@@ -50,6 +53,10 @@ static ConfigEntry settings_entries[] = {
   { "USBDEVICE", CONFIG_TYPE_DECIMAL, (int *)&vitashell_config.usbdevice },
   { "SELECT_BUTTON", CONFIG_TYPE_DECIMAL, (int *)&vitashell_config.select_button },
   { "DISABLE_AUTOUPDATE", CONFIG_TYPE_BOOLEAN, (int *)&vitashell_config.disable_autoupdate },
+  { "DEBUG_OVERLAY", CONFIG_TYPE_BOOLEAN, (int *)&vitashell_config.debug_overlay },
+  { "DETECT_FILE_TYPES", CONFIG_TYPE_BOOLEAN, (int *)&vitashell_config.detect_file_types },
+  { "HASH_ALGORITHMS", CONFIG_TYPE_DECIMAL, (int *)&vitashell_config.hash_algorithms },
+  { "TEXT_CACHE_SIZE", CONFIG_TYPE_DECIMAL, (int *)&vitashell_config.text_cache_size },
 };
 
 static ConfigEntry theme_entries[] = {
@@ -65,6 +72,12 @@ SettingsMenuOption main_settings[] = {
   { VITASHELL_SETTINGS_SELECT_BUTTON,  SETTINGS_OPTION_TYPE_OPTIONS, NULL, NULL, 0,
     select_button_options, sizeof(select_button_options) / sizeof(char **), &vitashell_config.select_button },
   { VITASHELL_SETTINGS_NO_AUTO_UPDATE, SETTINGS_OPTION_TYPE_BOOLEAN, NULL, NULL, 0, NULL, 0, &vitashell_config.disable_autoupdate },
+  { VITASHELL_SETTINGS_DETECT_FILE_TYPES, SETTINGS_OPTION_TYPE_BOOLEAN, NULL, NULL, 0, NULL, 0, &vitashell_config.detect_file_types },
+  { VITASHELL_SETTINGS_HASH_ALGORITHMS, SETTINGS_OPTION_TYPE_OPTIONS, NULL, NULL, 0,
+    hash_algorithms_options, sizeof(hash_algorithms_options) / sizeof(char **), &vitashell_config.hash_algorithms },
+  { VITASHELL_SETTINGS_TEXT_CACHE_SIZE, SETTINGS_OPTION_TYPE_OPTIONS, NULL, NULL, 0,
+    text_cache_size_options, sizeof(text_cache_size_options) / sizeof(char **), &vitashell_config.text_cache_size },
+  { VITASHELL_SETTINGS_DEBUG_OVERLAY,  SETTINGS_OPTION_TYPE_BOOLEAN, NULL, NULL, 0, NULL, 0, &vitashell_config.debug_overlay },
   
   { VITASHELL_SETTINGS_RESTART_SHELL,  SETTINGS_OPTION_TYPE_CALLBACK, (void *)restartShell, NULL, 0, NULL, 0, NULL },
 };
@@ -92,6 +105,9 @@ void saveSettingsConfig() {
   // Save settings config file
   writeConfig("ux0:VitaShell/settings.txt", settings_entries, sizeof(settings_entries) / sizeof(ConfigEntry));
 
+  // Cached listings keep the file types they were read with
+  dirCacheClear();
+
   if (sceKernelGetModel() == SCE_KERNEL_MODEL_VITATV) {
     vitashell_config.select_button = SELECT_BUTTON_MODE_FTP;
   }
@@ -136,6 +152,17 @@ void initSettingsMenu() {
 
   select_button_options[0] = language_container[VITASHELL_SETTINGS_SELECT_BUTTON_USB];
   select_button_options[1] = language_container[VITASHELL_SETTINGS_SELECT_BUTTON_FTP];
+
+  hash_algorithms_options[0] = "SHA1";
+  hash_algorithms_options[1] = "SHA256";
+  hash_algorithms_options[2] = "MD5";
+  hash_algorithms_options[3] = "CRC32";
+  hash_algorithms_options[4] = language_container[VITASHELL_SETTINGS_HASH_ALL];
+
+  text_cache_size_options[0] = "4 MB";
+  text_cache_size_options[1] = "8 MB";
+  text_cache_size_options[2] = "16 MB";
+  text_cache_size_options[3] = "32 MB";
   
   theme_options = malloc(MAX_THEMES * sizeof(char *));
   
@@ -15,19 +15,22 @@
 #include "sha1.h"
 
 /****************************** MACROS ******************************/
-#define ROTLEFT(a, b) ((a << b) | (a >> (32 - b)))
+#define ROTLEFT(a, b) (((a) << (b)) | ((a) >> (32 - (b))))
+
+// The message schedule is kept in 16 words that are reused every round
+#define BLK0(i) (m[i] = (data[(i) * 4] << 24) | (data[(i) * 4 + 1] << 16) | (data[(i) * 4 + 2] << 8) | data[(i) * 4 + 3])
+#define BLK(i) (m[(i) & 15] = ROTLEFT(m[((i) + 13) & 15] ^ m[((i) + 8) & 15] ^ m[((i) + 2) & 15] ^ m[(i) & 15], 1))
+
+#define R0(v, w, x, y, z, i) z += ((w & (x ^ y)) ^ y) + BLK0(i) + 0x5a827999 + ROTLEFT(v, 5); w = ROTLEFT(w, 30);
+#define R1(v, w, x, y, z, i) z += ((w & (x ^ y)) ^ y) + BLK(i) + 0x5a827999 + ROTLEFT(v, 5); w = ROTLEFT(w, 30);
+#define R2(v, w, x, y, z, i) z += (w ^ x ^ y) + BLK(i) + 0x6ed9eba1 + ROTLEFT(v, 5); w = ROTLEFT(w, 30);
+#define R3(v, w, x, y, z, i) z += (((w | x) & y) | (w & x)) + BLK(i) + 0x8f1bbcdc + ROTLEFT(v, 5); w = ROTLEFT(w, 30);
+#define R4(v, w, x, y, z, i) z += (w ^ x ^ y) + BLK(i) + 0xca62c1d6 + ROTLEFT(v, 5); w = ROTLEFT(w, 30);
 
 /*********************** FUNCTION DEFINITIONS ***********************/
 void sha1_transform(SHA1_CTX *ctx, const BYTE data[])
 {
-  WORD a, b, c, d, e, i, j, t, m[80];
-
-  for (i = 0, j = 0; i < 16; ++i, j += 4)
-    m[i] = (data[j] << 24) + (data[j + 1] << 16) + (data[j + 2] << 8) + (data[j + 3]);
-  for ( ; i < 80; ++i) {
-    m[i] = (m[i - 3] ^ m[i - 8] ^ m[i - 14] ^ m[i - 16]);
-    m[i] = (m[i] << 1) | (m[i] >> 31);
-  }
+  WORD a, b, c, d, e, m[16];
 
   a = ctx->state[0];
   b = ctx->state[1];
@@ -35,38 +38,26 @@ void sha1_transform(SHA1_CTX *ctx, const BYTE data[])
   d = ctx->state[3];
   e = ctx->state[4];
 
-  for (i = 0; i < 20; ++i) {
-    t = ROTLEFT(a, 5) + ((b & c) ^ (~b & d)) + e + ctx->k[0] + m[i];
-    e = d;
-    d = c;
-    c = ROTLEFT(b, 30);
-    b = a;
-    a = t;
-  }
-  for ( ; i < 40; ++i) {
-    t = ROTLEFT(a, 5) + (b ^ c ^ d) + e + ctx->k[1] + m[i];
-    e = d;
-    d = c;
-    c = ROTLEFT(b, 30);
-    b = a;
-    a = t;
-  }
-  for ( ; i < 60; ++i) {
-    t = ROTLEFT(a, 5) + ((b & c) ^ (b & d) ^ (c & d))  + e + ctx->k[2] + m[i];
-    e = d;
-    d = c;
-    c = ROTLEFT(b, 30);
-    b = a;
-    a = t;
-  }
-  for ( ; i < 80; ++i) {
-    t = ROTLEFT(a, 5) + (b ^ c ^ d) + e + ctx->k[3] + m[i];
-    e = d;
-    d = c;
-    c = ROTLEFT(b, 30);
-    b = a;
-    a = t;
-  }
+  R0(a, b, c, d, e, 0); R0(e, a, b, c, d, 1); R0(d, e, a, b, c, 2); R0(c, d, e, a, b, 3);
+  R0(b, c, d, e, a, 4); R0(a, b, c, d, e, 5); R0(e, a, b, c, d, 6); R0(d, e, a, b, c, 7);
+  R0(c, d, e, a, b, 8); R0(b, c, d, e, a, 9); R0(a, b, c, d, e, 10); R0(e, a, b, c, d, 11);
+  R0(d, e, a, b, c, 12); R0(c, d, e, a, b, 13); R0(b, c, d, e, a, 14); R0(a, b, c, d, e, 15);
+  R1(e, a, b, c, d, 16); R1(d, e, a, b, c, 17); R1(c, d, e, a, b, 18); R1(b, c, d, e, a, 19);
+  R2(a, b, c, d, e, 20); R2(e, a, b, c, d, 21); R2(d, e, a, b, c, 22); R2(c, d, e, a, b, 23);
+  R2(b, c, d, e, a, 24); R2(a, b, c, d, e, 25); R2(e, a, b, c, d, 26); R2(d, e, a, b, c, 27);
+  R2(c, d, e, a, b, 28); R2(b, c, d, e, a, 29); R2(a, b, c, d, e, 30); R2(e, a, b, c, d, 31);
+  R2(d, e, a, b, c, 32); R2(c, d, e, a, b, 33); R2(b, c, d, e, a, 34); R2(a, b, c, d, e, 35);
+  R2(e, a, b, c, d, 36); R2(d, e, a, b, c, 37); R2(c, d, e, a, b, 38); R2(b, c, d, e, a, 39);
+  R3(a, b, c, d, e, 40); R3(e, a, b, c, d, 41); R3(d, e, a, b, c, 42); R3(c, d, e, a, b, 43);
+  R3(b, c, d, e, a, 44); R3(a, b, c, d, e, 45); R3(e, a, b, c, d, 46); R3(d, e, a, b, c, 47);
+  R3(c, d, e, a, b, 48); R3(b, c, d, e, a, 49); R3(a, b, c, d, e, 50); R3(e, a, b, c, d, 51);
+  R3(d, e, a, b, c, 52); R3(c, d, e, a, b, 53); R3(b, c, d, e, a, 54); R3(a, b, c, d, e, 55);
+  R3(e, a, b, c, d, 56); R3(d, e, a, b, c, 57); R3(c, d, e, a, b, 58); R3(b, c, d, e, a, 59);
+  R4(a, b, c, d, e, 60); R4(e, a, b, c, d, 61); R4(d, e, a, b, c, 62); R4(c, d, e, a, b, 63);
+  R4(b, c, d, e, a, 64); R4(a, b, c, d, e, 65); R4(e, a, b, c, d, 66); R4(d, e, a, b, c, 67);
+  R4(c, d, e, a, b, 68); R4(b, c, d, e, a, 69); R4(a, b, c, d, e, 70); R4(e, a, b, c, d, 71);
+  R4(d, e, a, b, c, 72); R4(c, d, e, a, b, 73); R4(b, c, d, e, a, 74); R4(a, b, c, d, e, 75);
+  R4(e, a, b, c, d, 76); R4(d, e, a, b, c, 77); R4(c, d, e, a, b, 78); R4(b, c, d, e, a, 79);
 
   ctx->state[0] += a;
   ctx->state[1] += b;
@@ -92,17 +83,29 @@ void sha1_init(SHA1_CTX *ctx)
 
 void sha1_update(SHA1_CTX *ctx, const BYTE data[], size_t len)
 {
-  size_t i;
-
-  for (i = 0; i < len; ++i) {
-    ctx->data[ctx->datalen] = data[i];
-    ctx->datalen++;
-    if (ctx->datalen == 64) {
-      sha1_transform(ctx, ctx->data);
-      ctx->bitlen += 512;
-      ctx->datalen = 0;
-    }
+  size_t i = 0;
+
+  // Complete a block left over from the last call
+  if (ctx->datalen > 0) {
+    while (i < len && ctx->datalen < 64)
+      ctx->data[ctx->datalen++] = data[i++];
+
+    if (ctx->datalen < 64)
+      return;
+
+    sha1_transform(ctx, ctx->data);
+    ctx->bitlen += 512;
+    ctx->datalen = 0;
   }
+
+  // Whole blocks are transformed straight from the input
+  for ( ; i + 64 <= len; i += 64) {
+    sha1_transform(ctx, &data[i]);
+    ctx->bitlen += 512;
+  }
+
+  memcpy(ctx->data, &data[i], len - i);
+  ctx->datalen = len - i;
 }
 
 void sha1_final(SHA1_CTX *ctx, BYTE hash[])
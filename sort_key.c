@@ -0,0 +1,184 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sort_key.h"
+
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+
+#define GET_KEYS(item, keys_offset) ((const SortKeys *)((const char *)(item) + (keys_offset)))
+
+/*
+  Build a key that orders like strnatcasecmp when compared with strcmp.
+  Spaces are skipped and letters are folded to upper case. Digit runs are
+  encoded once: runs with a leading zero compare left-aligned and come
+  first, other runs are prefixed with their length so that longer numbers
+  are greater. Both markers sort like a digit against the other characters.
+  Returns the length of the key.
+*/
+int sortKeyCreate(char *key, int size, const char *name, int name_length) {
+  int len = 0;
+
+  // Ignore the end slash of folders
+  if (name_length > 0 && name[name_length - 1] == '/')
+    name_length--;
+
+  int i = 0;
+  while (i < name_length && len < size - 3) {
+    uint8_t c = name[i];
+
+    if (isspace(c)) {
+      i++;
+    } else if (isdigit(c)) {
+      int start = i;
+      while (i < name_length && isdigit((uint8_t)name[i]))
+        i++;
+
+      int n = MIN(i - start, size - 3 - len);
+      n = MIN(n, 0xFF);
+
+      if (c == '0') {
+        key[len++] = '0';
+        memcpy(key + len, name + start, n);
+        len += n;
+        key[len++] = 0x01;
+      } else {
+        key[len++] = '1';
+        key[len++] = (char)n;
+        memcpy(key + len, name + start, n);
+        len += n;
+      }
+    } else {
+      key[len++] = toupper(c);
+      i++;
+    }
+  }
+
+  key[len] = '\0';
+
+  return len;
+}
+
+static int compareNames(const SortKeys *a, const SortKeys *b) {
+  return strcmp(a->key ? a->key : "", b->key ? b->key : "");
+}
+
+// Returns < 0 if a comes before b
+int sortKeysCompare(const SortKeys *a, const SortKeys *b, int sort) {
+  // '..' is always at first
+  if (a->rank != b->rank)
+    return a->rank - b->rank;
+
+  if (sort == SORT_BY_NAME) {
+    // First folders then files
+    if (a->is_folder != b->is_folder)
+      return b->is_folder - a->is_folder;
+
+    // Sort by name within the same type
+    return compareNames(a, b);
+  } else if (sort == SORT_BY_SIZE) {
+    // First files then folders
+    if (a->is_folder != b->is_folder)
+      return a->is_folder - b->is_folder;
+
+    // Sort by size for files
+    if (!a->is_folder && a->size != b->size)
+      return a->size > b->size ? -1 : 1;
+
+    // Sort by name for folders and files with the same size
+    return compareNames(a, b);
+  } else if (sort == SORT_BY_DATE) {
+    // First files then folders
+    if (a->is_folder != b->is_folder)
+      return a->is_folder - b->is_folder;
+
+    // Sort by date within the same type
+    if (a->tick != b->tick)
+      return a->tick > b->tick ? -1 : 1;
+
+    // Sort by name for files and folders with the same date
+    return compareNames(a, b);
+  }
+
+  return 0;
+}
+
+int sortKeysFindInsert(void **items, int n_items, int keys_offset, const SortKeys *keys, int sort) {
+  if (sort == SORT_NONE)
+    return n_items;
+
+  int low = 0, high = n_items;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (sortKeysCompare(keys, GET_KEYS(items[mid], keys_offset), sort) < 0) {
+      high = mid;
+    } else {
+      low = mid + 1;
+    }
+  }
+
+  return low;
+}
+
+static void mergeSort(void **items, void **temp, int n, int keys_offset, int sort) {
+  if (n < 2)
+    return;
+
+  int half = n / 2;
+  mergeSort(items, temp, half, keys_offset, sort);
+  mergeSort(items + half, temp, n - half, keys_offset, sort);
+
+  // Already in order
+  if (sortKeysCompare(GET_KEYS(items[half - 1], keys_offset), GET_KEYS(items[half], keys_offset), sort) <= 0)
+    return;
+
+  memcpy(temp, items, half * sizeof(void *));
+
+  // Merge, taking from the left half on ties to keep the sort stable
+  int i = 0, j = half, k = 0;
+  while (i < half && j < n) {
+    if (sortKeysCompare(GET_KEYS(items[j], keys_offset), GET_KEYS(temp[i], keys_offset), sort) < 0) {
+      items[k++] = items[j++];
+    } else {
+      items[k++] = temp[i++];
+    }
+  }
+
+  while (i < half) {
+    items[k++] = temp[i++];
+  }
+}
+
+// Returns -1 if there is no memory for the merge buffer
+int sortKeysSort(void **items, int n_items, int keys_offset, int sort) {
+  if (sort == SORT_NONE || n_items < 2)
+    return 0;
+
+  void **temp = malloc((n_items / 2) * sizeof(void *));
+  if (!temp)
+    return -1;
+
+  mergeSort(items, temp, n_items, keys_offset, sort);
+  free(temp);
+
+  return 0;
+}
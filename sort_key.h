@@ -0,0 +1,58 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SORT_KEY_H__
+#define __SORT_KEY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Only depends on libc, so it also builds against POSIX
+
+// Enough for any name of name_length characters
+#define SORT_KEY_SIZE(name_length) (3 * (name_length) + 1)
+
+enum FileSortFlags {
+  SORT_NONE,
+  SORT_BY_NAME,
+  SORT_BY_SIZE,
+  SORT_BY_DATE,
+};
+
+// Everything an entry is ordered by, computed once when it is added
+typedef struct {
+  char *key;     // Natural order collation key of the name
+  int rank;      // 0 for '..', 1 otherwise
+  int is_folder;
+  int64_t size;  // Only used for files
+  uint64_t tick; // mtime as tick
+} SortKeys;
+
+int sortKeyCreate(char *key, int size, const char *name, int name_length);
+
+int sortKeysCompare(const SortKeys *a, const SortKeys *b, int sort);
+
+/*
+  Items are pointers to structs holding their SortKeys at keys_offset.
+  sortKeysFindInsert returns the index after all items that do not come
+  after keys, sortKeysSort is a stable merge sort.
+*/
+int sortKeysFindInsert(void **items, int n_items, int keys_offset, const SortKeys *keys, int sort);
+int sortKeysSort(void **items, int n_items, int keys_offset, int sort);
+
+#endif
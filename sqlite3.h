@@ -187,6 +187,13 @@ SQLITE_API int sqlite3_finalize(sqlite3_stmt*);
 SQLITE_API int sqlite3_column_bytes(sqlite3_stmt*, int);
 SQLITE_API const void *sqlite3_column_blob(sqlite3_stmt*, int);
 SQLITE_API int sqlite3_bind_blob(sqlite3_stmt*, int, const void*, int, void(*)(void*));
+SQLITE_API int sqlite3_bind_int(sqlite3_stmt*, int, int);
+SQLITE_API int sqlite3_bind_int64(sqlite3_stmt*, int, sqlite3_int64);
+SQLITE_API int sqlite3_bind_text(sqlite3_stmt*, int, const char*, int, void(*)(void*));
+SQLITE_API int sqlite3_column_int(sqlite3_stmt*, int);
+SQLITE_API sqlite3_int64 sqlite3_column_int64(sqlite3_stmt*, int);
+SQLITE_API const unsigned char *sqlite3_column_text(sqlite3_stmt*, int);
+SQLITE_API int sqlite3_reset(sqlite3_stmt*);
 SQLITE_API sqlite3_vfs *sqlite3_vfs_find(const char *);
 SQLITE_API int sqlite3_vfs_register(sqlite3_vfs*, int);
 SQLITE_API int sqlite3_vfs_unregister(sqlite3_vfs*);
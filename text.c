@@ -21,6 +21,9 @@
 #include "archive.h"
 #include "file.h"
 #include "text.h"
+#include "piece_table.h"
+#include "text_rows.h"
+#include "text_stream.h"
 #include "hex.h"
 #include "theme.h"
 #include "utils.h"
@@ -36,6 +39,7 @@ enum TextMenuEntrys {
   TEXT_MENU_ENTRY_DELETE,
   TEXT_MENU_ENTRY_INSERT_EMPTY_LINE,
   TEXT_MENU_ENTRY_SEARCH,
+  TEXT_MENU_ENTRY_GOTO_LINE,
   TEXT_MENU_ENTRY_HEX_EDITOR,
 };
 
@@ -47,11 +51,14 @@ MenuEntry text_menu_entries[] = {
   { DELETE,      6, 0, CTX_VISIBLE },
   { INSERT_EMPTY_LINE, 7, 0, CTX_VISIBLE },
   { SEARCH,      9, 0, CTX_VISIBLE },
+  { GOTO_LINE,   10, 0, CTX_VISIBLE },
   { OPEN_HEX_EDITOR,  11, 0, CTX_VISIBLE },
 };
 
 #define N_TEXT_MENU_ENTRIES (sizeof(text_menu_entries) / sizeof(MenuEntry))
 
+static int text_cache_sizes[] = { 4 * 1024 * 1024, 8 * 1024 * 1024, 16 * 1024 * 1024, 32 * 1024 * 1024 };
+
 static int contextMenuEnterCallback(int pos, void *context);
 
 static ContextMenu context_menu_text = {
@@ -63,14 +70,21 @@ static ContextMenu context_menu_text = {
   .sel = -1,
 };
 
+
 typedef struct TextEditorState {
   int running;
-  char *buffer;
-  int size;
-  int base_pos;
+  int streaming; // Files bigger than BIG_BUFFER_SIZE are read through the stream
+  PieceTable table;
+  TextRows rows;
+  int row_index; // 0 if the rows are not indexed, like for streams
+  TextStream stream;
+  SceOff size;
+  int n_lines;
+  SceOff top;   // Offset of the first row on screen
+  int top_line; // -1 if not indexed yet
   int rel_pos;
-  int offset_list[MAX_LINES];
-  int selection_list[MAX_SELECTION];
+  SceOff row_offsets[MAX_ENTRIES + 1];
+  SceOff selection_list[MAX_SELECTION]; // Offsets of the selected rows
   int n_selections;
   int n_copied_lines;
   int copy_reset;
@@ -78,16 +92,14 @@ typedef struct TextEditorState {
   CopyEntry copy_buffer[MAX_COPY_BUFFER_SIZE];
   TextList list;
   int changed;
-  int edit_line;
+  SceOff edit_line; // Offset of the edited row
   char search_term[MAX_LINE_CHARACTERS];
-  int search_result_offsets[MAX_SEARCH_RESULTS];
+  SceOff search_result_offsets[MAX_SEARCH_RESULTS];
   int search_term_input;
+  int goto_line_input;
   int n_search_results;
   int search_thid;
-  int count_lines_thid;
   int hex_viewer;
-  int count_lines_running;
-  int n_lines;
   int search_running;
 } TextEditorState;
 
@@ -96,9 +108,11 @@ typedef struct SearchParams {
   char search_term[MAX_LINE_CHARACTERS];
 } SearchParams;
 
-typedef struct CountParams {
-  TextEditorState *state;
-} CountParams;
+typedef struct TextWriter {
+  SceUID fd;
+  char *buffer;
+  int used;
+} TextWriter;
 
 void initTextContextMenuWidth() {
   int i;
@@ -143,99 +157,189 @@ static void textListEmpty(TextList *list) {
 
 #define TAB_SIZE 4
 
-static int textReadLine(char *buffer, int offset, int size, char *line) {
-  // Get line
-  int line_width = 0;
-  int count = 0;
+#define TEXT_INDEX_BUDGET 4000 // us of every frame
 
-  int i;
-  for (i = 0; i < MIN(size, MIN(size-offset, MAX_LINE_CHARACTERS - 1)); i++) {
-    char ch = buffer[offset + i];
-    char ch_width = 0;
+static TextLayout text_layout;
 
-    // Line break
-    if (ch == '\n') {
-      i++; // Skip it
-      break;
-    }
+static int textRead(TextEditorState *state, SceOff offset, char *data, int size) {
+  if (state->streaming)
+    return textStreamRead(&state->stream, offset, data, size);
 
-    // Tab
-    if (ch == '\t') {
-      ch_width = TAB_SIZE * font_size_cache[' '];
-    } else {
-      ch_width = font_size_cache[(int)ch];
-      if (ch_width == 0) {
-        ch = ' '; // Change invalid characters to space
-        ch_width = font_size_cache[(int)ch];
-      }
-    }
+  return pieceTableRead(&state->table, offset, data, size);
+}
 
-    // Too long
-    if ((line_width+ch_width) >= (MAX_WIDTH-TEXT_START_X + SHELL_MARGIN_X))
-      break;
+static SceOff textGetLineStart(TextEditorState *state, SceOff offset) {
+  if (state->streaming)
+    return textStreamLineStart(&state->stream, offset);
 
-    // Increase line width
-    line_width += ch_width;
+  return pieceTableLineOffset(&state->table, pieceTableOffsetLine(&state->table, offset));
+}
 
-    // Add to line string
-    if (line)
-      line[count++] = ch;
-  }
+// Returns -1 if the line is not known yet
+static int textGetLineNumber(TextEditorState *state, SceOff offset) {
+  if (state->streaming)
+    return textStreamOffsetLine(&state->stream, offset);
+
+  return pieceTableOffsetLine(&state->table, offset);
+}
+
+// Rows end at a line break or at the width of the screen
+static int textReadRow(TextEditorState *state, SceOff offset, char *line) {
+  char buffer[MAX_LINE_CHARACTERS];
+  int size = MAX_LINE_CHARACTERS - 1;
 
-  // End of line
-  if (line)
-    line[count] = '\0';
+  // Rows don't cross blocks, like textStreamLineStart
+  if (state->streaming)
+    size = MIN(size, TEXT_STREAM_BLOCK_SIZE - (offset % TEXT_STREAM_BLOCK_SIZE));
 
-  return i;
+  size = textRead(state, offset, buffer, size);
+  return textLayoutReadRow(&text_layout, buffer, size, line);
 }
 
-static void updateTextEntry(TextEditorState *state, TextListEntry* entry, int rel_pos) {
-  entry->line_number = state->base_pos + rel_pos;
+// Returns the offset of the row containing offset
+static SceOff textGetRowStart(TextEditorState *state, SceOff offset) {
+  if (state->row_index) {
+    int row = textRowsFind(&state->rows, offset);
+    if (row >= 0)
+      return state->rows.offsets[row];
+  }
+
+  SceOff row = textGetLineStart(state, offset);
 
-  // Mark entry as selected
-  entry->selected = 0;
-  int j = 0;
-  for (j = 0; j < state->n_selections; j++) {
-    if (entry->line_number == state->selection_list[j]) {
-      entry->selected = 1;
+  while (1) {
+    int length = textReadRow(state, row, NULL);
+    if (length <= 0 || row + length > offset)
       break;
-    }
+
+    row += length;
   }
 
-  int length = textReadLine(state->buffer, state->offset_list[state->base_pos + rel_pos], state->size, entry->line);
-  state->offset_list[state->base_pos + rel_pos + 1] = state->offset_list[state->base_pos + rel_pos] + length;
+  return row;
+}
+
+static SceOff textGetPreviousRow(TextEditorState *state, SceOff offset) {
+  if (offset <= 0)
+    return 0;
+
+  return textGetRowStart(state, offset - 1);
 }
 
 static void updateTextEntries(TextEditorState *state) {
+  SceOff offset = state->top;
+  int line = textGetLineNumber(state, offset);
+
+  char previous = '\n';
+  if (offset > 0)
+    textRead(state, offset - 1, &previous, 1);
+
+  int line_start = previous == '\n';
+
+  state->top_line = line;
+
   TextListEntry *entry = state->list.head;
   int i;
   for (i = 0; i < MAX_ENTRIES; i++) {
     if (!entry) {
       break;
     }
-    
-    updateTextEntry(state, entry, i);
+
+    state->row_offsets[i] = offset;
+
+    // Mark entry as selected
+    entry->selected = 0;
+    int j = 0;
+    for (j = 0; j < state->n_selections; j++) {
+      if (offset == state->selection_list[j]) {
+        entry->selected = 1;
+        break;
+      }
+    }
+
+    if (offset < state->size) {
+      int length = textReadRow(state, offset, entry->line);
+
+      entry->line_number = line;
+      entry->line_start = line_start;
+
+      // The line break is not part of the string
+      line_start = length > strlen(entry->line);
+      if (line_start && line >= 0)
+        line++;
+
+      offset += length;
+    } else {
+      entry->line[0] = '\0';
+      entry->line_number = -1;
+      entry->line_start = 0;
+    }
 
     entry = entry->next;
   }
+
+  state->row_offsets[i] = offset;
+}
+
+static void stopTextRows(TextEditorState *state) {
+  if (state->row_index) {
+    textRowsFree(&state->rows);
+    state->row_index = 0;
+  }
+}
+
+// Indexes the rows until the time budget of the frame is used
+static void indexTextRows(TextEditorState *state) {
+  if (!state->row_index)
+    return;
+
+  SceUInt64 start = sceKernelGetProcessTimeWide();
+
+  while (!state->rows.done && (sceKernelGetProcessTimeWide() - start) < TEXT_INDEX_BUDGET) {
+    if (textRowsBuild(&state->rows, &state->table, TEXT_ROWS_CHUNK_SIZE) < 0) {
+      stopTextRows(state);
+      break;
+    }
+  }
 }
 
+static void updateTextRows(TextEditorState *state, SceOff offset, int deleted, int inserted) {
+  if (state->row_index && textRowsEdit(&state->rows, &state->table, offset, deleted, inserted) < 0)
+    stopTextRows(state);
+}
+
+static void updateTextSize(TextEditorState *state) {
+  if (state->streaming) {
+    state->size = state->stream.size;
+    state->n_lines = state->stream.n_lines;
+    return;
+  }
+
+  state->size = pieceTableSize(&state->table);
+  state->n_lines = pieceTableLines(&state->table);
+}
+
+// Keeps the first row at a row start and the cursor on a row after edits
+static void correctTextPosition(TextEditorState *state) {
+  state->top = textGetRowStart(state, MIN(state->top, state->size - 1));
+
+  updateTextEntries(state);
+
+  while (state->rel_pos > 0 && state->row_offsets[state->rel_pos] >= state->size)
+    state->rel_pos--;
+}
 
-static CopyEntry *copy_line(TextEditorState *state, int line_number) {
+static CopyEntry *copy_line(TextEditorState *state, SceOff line_start) {
   if (state->copy_reset) {
     state->copy_reset = 0;
     state->n_copied_lines = 0;
   }
 
   // Get current line
-  int line_start = state->offset_list[line_number];
-  char line[MAX_LINE_CHARACTERS];
-  int length = textReadLine(state->buffer, line_start, state->size, line);
+  int length = textReadRow(state, line_start, NULL);
 
   CopyEntry *entry = &state->copy_buffer[state->n_copied_lines];
 
   // Copy line into copy_buffer
-  memcpy(entry->line, &state->buffer[line_start], length);
+  textRead(state, line_start, entry->line, length);
 
   // Make sure line end with a newline
   if (entry->line[length-1] != '\n') {
@@ -251,107 +355,98 @@ static CopyEntry *copy_line(TextEditorState *state, int line_number) {
   return entry;
 }
 
-
-static void delete_line(TextEditorState *state, int line_number) {
+static void delete_line(TextEditorState *state, SceOff line_start) {
   // Get current line
-  int line_start = state->offset_list[line_number];
-  char line[MAX_LINE_CHARACTERS];
-  int length = textReadLine(state->buffer, line_start, state->size, line);
+  int length = textReadRow(state, line_start, NULL);
 
   // Remove line
-  memmove(&state->buffer[line_start], &state->buffer[line_start+length], state->size-line_start);  
-  state->size -= length;
-  state->n_lines -= 1;
+  pieceTableDelete(&state->table, line_start, length);
+  updateTextRows(state, line_start, length, 0);
 
   // Add empty line if resulting buffer is empty
-  if (state->size == 0) {
-    state->size = 1;
-    state->n_lines = 1;
-    state->buffer[0] = '\n';
-  } 
-
-  if (state->base_pos+state->rel_pos >= state->n_lines) {
-    state->rel_pos = state->n_lines-state->base_pos-1;
+  if (pieceTableSize(&state->table) == 0) {
+    pieceTableInsert(&state->table, 0, "\n", 1);
+    updateTextRows(state, 0, 0, 1);
   }
 
-  if (state->rel_pos < 0) {
-    state->base_pos += state->rel_pos;
-    state->rel_pos = 0;
-  }
+  updateTextSize(state);
 
   state->changed = 1;
   state->n_selections = 0;
   
   // Update entries
-  updateTextEntries(state);
+  correctTextPosition(state);
 }
 
-static void insert_line(TextEditorState *state, char *line, int pos) {
-  int offset = state->offset_list[pos];
-
-  // calculated size of inserted line
-  int length = strlen(line);
-
-  // Make space for inserted line
-  memmove(&state->buffer[offset+length], &state->buffer[offset], state->size-offset);
-  state->size += length;
-
-  // Insert the lines
-  memcpy(&state->buffer[offset], line, length);
+static void insert_line(TextEditorState *state, char *line, SceOff offset) {
+  pieceTableInsert(&state->table, offset, line, strlen(line));
+  updateTextRows(state, offset, 0, strlen(line));
+  updateTextSize(state);
 
-  int i;
-  for (i = 0; i < length; i++) {
-    if (line[i] == '\n') {
-      state->n_lines++;
-    }
-  }
-  
   state->n_selections = 0;
   state->changed = 1;
   state->copy_reset = 1;
 
   // Update entries
-  updateTextEntries(state);
+  correctTextPosition(state);
 }
 
-static void cut_line(TextEditorState *state, int line_number) {
-  copy_line(state, line_number);
-  delete_line(state, line_number);
+static void cut_line(TextEditorState *state, SceOff line_start) {
+  copy_line(state, line_start);
+  delete_line(state, line_start);
 }
 
-static void paste_lines(TextEditorState *state, int pos) {
-  int line_start = state->offset_list[pos];
-
-  // calculated size of pasted content
-  int length = 0, i;
-  for (i = 0; i < state->n_copied_lines; i++) {
-    length += strlen(state->copy_buffer[i].line);
-  }
-
-  // Make space for pasted lines
-  memmove(&state->buffer[line_start+length], &state->buffer[line_start], state->size-line_start);
-  state->size += length;
+static void paste_lines(TextEditorState *state, SceOff offset) {
+  SceOff start = offset;
 
   // Paste the lines
+  int i;
   for (i = 0; i < state->n_copied_lines; i++) {
     int line_length = strlen(state->copy_buffer[i].line);
 
-    memcpy(&state->buffer[line_start], state->copy_buffer[i].line, line_length);
-    line_start += line_length;
+    pieceTableInsert(&state->table, offset, state->copy_buffer[i].line, line_length);
+    offset += line_length;
   }
 
-  state->n_lines += state->n_copied_lines;
-  
+  updateTextRows(state, start, 0, offset - start);
+  updateTextSize(state);
+
   state->changed = 1;
   state->copy_reset = 1;
   state->n_selections = 0;
 
   // Update entries
-  updateTextEntries(state);
+  correctTextPosition(state);
 }
 
 static int cmp (const void * a, const void * b) {
-   return ( *(int*)a - *(int*)b );
+   SceOff diff = *(SceOff*)a - *(SceOff*)b;
+   return diff < 0 ? -1 : (diff > 0);
+}
+
+// Takes a line number or a percentage of the file like 50%
+static void goto_line(TextEditorState *state, const char *input) {
+  char *end;
+  long long value = strtoll(input, &end, 10);
+  while (*end == ' ')
+    end++;
+
+  value = MAX(value, 0);
+
+  SceOff offset;
+  if (*end == '%') {
+    offset = (state->size * MIN(value, 100)) / 100;
+  } else if (state->streaming) {
+    // Lines that are not indexed yet end up at the last indexed one
+    offset = textStreamLineOffset(&state->stream, MIN(value, 0x7FFFFFFF));
+  } else {
+    offset = pieceTableLineOffset(&state->table, MIN(value, state->n_lines));
+  }
+
+  state->top = textGetRowStart(state, MIN(offset, state->size - 1));
+  state->rel_pos = 0;
+
+  updateTextEntries(state);
 }
 
 static int contextMenuEnterCallback(int sel, void *context) {
@@ -363,6 +458,11 @@ static int contextMenuEnterCallback(int sel, void *context) {
       state->search_term_input = 1;
       break;
 
+    case TEXT_MENU_ENTRY_GOTO_LINE:
+      initImeDialog(language_container[ENTER_LINE_NUMBER], "", 32, SCE_IME_TYPE_BASIC_LATIN, 0, 0);
+      state->goto_line_input = 1;
+      break;
+
     case TEXT_MENU_ENTRY_HEX_EDITOR:
       state->hex_viewer = 1;
       if (state->changed) {
@@ -374,7 +474,7 @@ static int contextMenuEnterCallback(int sel, void *context) {
       state->n_copied_lines = 0;
 
       // Sort the selection list
-      qsort(state->selection_list, state->n_selections, sizeof(int), cmp);
+      qsort(state->selection_list, state->n_selections, sizeof(SceOff), cmp);
     
       int i;
       for (i = 0; i < state->n_selections; i++) {
@@ -388,34 +488,37 @@ static int contextMenuEnterCallback(int sel, void *context) {
       state->n_copied_lines = 0;
 
       // Sort the selection list
-      qsort(state->selection_list, state->n_selections, sizeof(int), cmp);
+      qsort(state->selection_list, state->n_selections, sizeof(SceOff), cmp);
+
+      // Deleting a line clears the selections
+      int n_selections = state->n_selections;
 
       // Cut the lines in reversed order to not break the offsets
-      for (i = state->n_selections-1; i >= 0; i--) {
+      for (i = n_selections-1; i >= 0; i--) {
         cut_line(state, state->selection_list[i]);
       }
 
       // Reverse the order of the copied lines
       int j;
-      for (i = 0, j = state->n_selections-1; i < j; i++, j--) {
+      for (i = 0, j = n_selections-1; i < j; i++, j--) {
         CopyEntry tmp = state->copy_buffer[i];
-        state->copy_buffer[j] = state->copy_buffer[i];
-        state->copy_buffer[i] = tmp;
+        state->copy_buffer[i] = state->copy_buffer[j];
+        state->copy_buffer[j] = tmp;
       }
 
       state->n_selections = 0;
       break;
 
     case TEXT_MENU_ENTRY_PASTE:
-      paste_lines(state, state->base_pos+state->rel_pos + 1);
+      paste_lines(state, state->row_offsets[state->rel_pos + 1]);
       break;
 
     case TEXT_MENU_ENTRY_DELETE:
-      delete_line(state, state->base_pos+state->rel_pos);
+      delete_line(state, state->row_offsets[state->rel_pos]);
       break;
 
     case TEXT_MENU_ENTRY_INSERT_EMPTY_LINE:
-      insert_line(state, "\n", state->base_pos+state->rel_pos + 1);
+      insert_line(state, "\n", state->row_offsets[state->rel_pos + 1]);
       break;
 
     case TEXT_MENU_ENTRY_MARK_UNMARK_ALL:
@@ -435,6 +538,17 @@ static void setContextMenuVisibilities(TextEditorState *state) {
 
   // Paste only visible when at least one line is in copy buffer
   text_menu_entries[TEXT_MENU_ENTRY_PASTE].visibility = state->n_copied_lines == 0 ? CTX_INVISIBLE : CTX_VISIBLE;
+
+  // Read-only files can only be copied from
+  if (!state->modify_allowed) {
+    text_menu_entries[TEXT_MENU_ENTRY_CUT].visibility = CTX_INVISIBLE;
+    text_menu_entries[TEXT_MENU_ENTRY_PASTE].visibility = CTX_INVISIBLE;
+    text_menu_entries[TEXT_MENU_ENTRY_DELETE].visibility = CTX_INVISIBLE;
+    text_menu_entries[TEXT_MENU_ENTRY_INSERT_EMPTY_LINE].visibility = CTX_INVISIBLE;
+  } else {
+    text_menu_entries[TEXT_MENU_ENTRY_DELETE].visibility = CTX_VISIBLE;
+    text_menu_entries[TEXT_MENU_ENTRY_INSERT_EMPTY_LINE].visibility = CTX_VISIBLE;
+  }
   
   // Go to first entry
   int i;
@@ -449,81 +563,157 @@ static void setContextMenuVisibilities(TextEditorState *state) {
     context_menu_text.sel = -1;
 }
 
-static int count_lines_thread(SceSize args, CountParams *params) {
-  TextEditorState *state = params->state;
-
-  state->count_lines_running = 1;
-  state->n_lines = 0;
-
-  int offset = 0;
-
-  while (state->count_lines_running && offset < state->size && state->n_lines < MAX_LINES) {
-    offset += textReadLine(state->buffer, offset, state->size, NULL);
-    state->n_lines++;
-
-    sceKernelDelayThread(1000);
-  }
-
-  return sceKernelExitDeleteThread(0);
-}
-
 static int search_thread(SceSize args, SearchParams *argp) {
   TextEditorState *state = argp->state;
   char *search_term = argp->search_term;
   int search_term_length = strlen(search_term);
-  int *search_result_offsets = state->search_result_offsets; 
+  SceOff *search_result_offsets = state->search_result_offsets;
 
   state->search_running = 1;
   state->n_search_results = 0;
 
-  int offset = 0;
+  char *chunk = malloc(TEXT_SEARCH_CHUNK_SIZE + MAX_LINE_CHARACTERS);
+  if (!chunk) {
+    state->search_running = 0;
+    return sceKernelExitDeleteThread(0);
+  }
 
-  // make sure buffer is null-terminated
-  state->buffer[state->size] = '\0';
+  SceOff offset = 0;
 
-  char *r;
   while (state->search_running && offset < state->size && state->n_search_results < MAX_SEARCH_RESULTS) {
-    r = strcasestr(state->buffer+offset, search_term);
+    // Overlap the chunks to find matches across them
+    int size;
+    if (state->streaming)
+      size = textStreamReadUncached(&state->stream, offset, chunk, TEXT_SEARCH_CHUNK_SIZE + search_term_length - 1);
+    else
+      size = pieceTableRead(&state->table, offset, chunk, TEXT_SEARCH_CHUNK_SIZE + search_term_length - 1);
+
+    if (size <= 0)
+      break;
 
-    if (r == NULL) {
-      state->search_running = 0;
-      continue;
-    }
+    chunk[size] = '\0';
+
+    char *r = chunk;
+    while (state->n_search_results < MAX_SEARCH_RESULTS) {
+      r = strcasestr(r, search_term);
+      if (r == NULL || (r - chunk) >= TEXT_SEARCH_CHUNK_SIZE)
+        break;
 
-    int index = r - state->buffer;
+      search_result_offsets[state->n_search_results++] = offset + (r - chunk);
+      r++;
+    }
 
-    search_result_offsets[state->n_search_results++] = index;
-    offset = index + 1;
+    offset += TEXT_SEARCH_CHUNK_SIZE;
 
     sceKernelDelayThread(1000);
   }
 
+  free(chunk);
+
   state->search_running = 0;
 
   return sceKernelExitDeleteThread(0);
 }
 
+static int textFlush(TextWriter *writer) {
+  int res = 0;
+
+  if (writer->used > 0)
+    res = sceIoWrite(writer->fd, writer->buffer, writer->used);
+
+  writer->used = 0;
+
+  return res;
+}
+
+// Collects the pieces, most of them are much smaller than a write
+static int textWritePiece(void *argp, const char *data, uint32_t size) {
+  TextWriter *writer = (TextWriter *)argp;
+
+  while (size > 0) {
+    int length = MIN(size, TEXT_WRITE_BUFFER_SIZE - writer->used);
+    memcpy(writer->buffer + writer->used, data, length);
+    writer->used += length;
+    data += length;
+    size -= length;
+
+    if (writer->used == TEXT_WRITE_BUFFER_SIZE) {
+      int res = textFlush(writer);
+      if (res < 0)
+        return res;
+    }
+  }
+
+  return 0;
+}
+
+static int textSave(TextEditorState *state, const char *file, const char *bom, int bom_size) {
+  TextWriter writer;
+  writer.used = 0;
+  writer.buffer = malloc(TEXT_WRITE_BUFFER_SIZE);
+  if (!writer.buffer)
+    return PIECE_TABLE_ERROR_NO_MEMORY;
+
+  writer.fd = sceIoOpen(file, SCE_O_WRONLY | SCE_O_TRUNC, 0777);
+  if (writer.fd < 0) {
+    free(writer.buffer);
+    return writer.fd;
+  }
+
+  int res = textWritePiece(&writer, bom, bom_size);
+  if (res >= 0)
+    res = pieceTableForEach(&state->table, textWritePiece, &writer);
+  if (res >= 0)
+    res = textFlush(&writer);
+
+  sceIoClose(writer.fd);
+  free(writer.buffer);
+
+  return res;
+}
+
 int textViewer(const char *file) {
   TextEditorState *s = malloc(sizeof(TextEditorState));
   if (!s) 
     return -1;
 
-  char *buffer_base = memalign(4096, BIG_BUFFER_SIZE);
-  if (!buffer_base)
-    return -1;
+  s->streaming = 0;
+  s->row_index = 0;
+
+  SceIoStat stat;
+  if (!isInArchive() && sceIoGetstat(file, &stat) >= 0 && stat.st_size > BIG_BUFFER_SIZE)
+    s->streaming = 1;
+
+  char *buffer_base = NULL;
+  if (!s->streaming) {
+    buffer_base = memalign(4096, BIG_BUFFER_SIZE);
+    if (!buffer_base) {
+      free(s);
+      return -1;
+    }
+  }
 
   s->running = 1;
   s->hex_viewer = 0; 
   s->n_copied_lines = 0;
   s->copy_reset = 0;
   s->modify_allowed = 1;
-  s->offset_list[0] = 0;
-  s->count_lines_running = 0;
-  s->n_lines = 0;
   s->search_running = 0;
   s->edit_line = -1;
 
-  if (isInArchive()) {
+  if (s->streaming) {
+    int cache_size = text_cache_sizes[vitashell_config.text_cache_size % (sizeof(text_cache_sizes) / sizeof(int))];
+    int res = textStreamOpen(&s->stream, file, cache_size);
+    if (res < 0) {
+      free(s);
+      return res;
+    }
+
+    s->size = s->stream.size;
+
+    // Only the cached blocks are in memory
+    s->modify_allowed = 0;
+  } else if (isInArchive()) {
     s->size = ReadArchiveFile(file, buffer_base, BIG_BUFFER_SIZE);
     s->modify_allowed = 0;
   } else {
@@ -531,30 +721,46 @@ int textViewer(const char *file) {
   }
 
   if (s->size < 0) {
+    int res = s->size;
+    free(s);
     free(buffer_base);
-    return s->size;
+    return res;
   }
 
-  s->buffer = buffer_base;
-
   int has_utf8_bom = 0;
   char utf8_bom[3] = {0xEF, 0xBB, 0xBF};
-  if (s->size >= 3 && memcmp(buffer_base, utf8_bom, 3) == 0) {
-    s->buffer += 3;
-    has_utf8_bom = 1;
-    s->size -= 3;
-  }
 
-  if (s->size == 0) {
-    s->size = 1;
-    s->buffer[0] = '\n';
-  }
+  if (!s->streaming) {
+    char *buffer = buffer_base;
+
+    if (s->size >= 3 && memcmp(buffer_base, utf8_bom, 3) == 0) {
+      buffer += 3;
+      has_utf8_bom = 1;
+      s->size -= 3;
+    }
+
+    // The file stays in buffer_base, edits go to the add buffer of the table
+    int res = pieceTableInit(&s->table, buffer, s->size);
+    if (res < 0) {
+      free(s);
+      free(buffer_base);
+      return res;
+    }
 
-  if (s->buffer[s->size-1] != '\n') {
-    s->buffer[s->size++] = '\n';
+    if (s->size == 0 || buffer[s->size-1] != '\n') {
+      pieceTableInsert(&s->table, s->size, "\n", 1);
+    }
+
+    // Rows are wrapped like textReadRow and indexed while the text is shown
+    textLayoutInit(&text_layout, font_size_cache, TAB_SIZE, MAX_WIDTH - TEXT_START_X + SHELL_MARGIN_X, MAX_LINE_CHARACTERS);
+    s->row_index = textRowsInit(&s->rows, &text_layout) >= 0;
+    if (!s->row_index)
+      textRowsFree(&s->rows);
   }
 
-  s->base_pos = 0;
+  updateTextSize(s);
+
+  s->top = 0;
   s->rel_pos = 0;
   s->n_selections = 0;
   memset(&s->list, 0, sizeof(TextList));
@@ -565,26 +771,16 @@ int textViewer(const char *file) {
   int i;
   for (i = 0; i < MAX_ENTRIES; i++) {
     TextListEntry *entry = malloc(sizeof(TextListEntry));
-    entry->line_number = i;
-    entry->selected = 0;
-
-    int length = textReadLine(s->buffer, s->offset_list[i], s->size, entry->line);
-    s->offset_list[i + 1] = s->offset_list[i] + length;
-    
     textListAddEntry(&s->list, entry);
   }
 
-  CountParams count_params;
-  count_params.state = s;
-
-  s->count_lines_thid = sceKernelCreateThread("count_lines_thread", (SceKernelThreadEntry)count_lines_thread, 0x10000100, 0x10000, 0, 0x70000, NULL);
-  if (s->count_lines_thid >= 0)
-    sceKernelStartThread(s->count_lines_thid, sizeof(CountParams), &count_params);
+  updateTextEntries(s);
 
   s->edit_line = -1;
   s->changed = 0;
 
   s->search_term_input = 0;
+  s->goto_line_input = 0;
   s->search_thid = 0;
   s->n_search_results = 0;
 
@@ -611,86 +807,39 @@ int textViewer(const char *file) {
           if (s->rel_pos > 0) {
             s->rel_pos--;
           } else {
-            if (s->base_pos > 0) {
-              s->base_pos--;
-
-              // Tail to head
-              s->list.tail->next = s->list.head;
-              s->list.head->previous = s->list.tail;
-              s->list.head = s->list.tail;
-
-              // Second last to tail
-              s->list.tail = s->list.tail->previous;
-              s->list.tail->next = NULL;
-
-              // No previous
-              s->list.head->previous = NULL;
+            if (s->top > 0) {
+              s->top = textGetPreviousRow(s, s->top);
 
-              // Update line_number
-              s->list.head->line_number = s->base_pos;
-
-              // Read
-              textReadLine(s->buffer, s->offset_list[s->base_pos], s->size, s->list.head->line);
-
-              // Update the entry
-              updateTextEntry(s, s->list.head, 0);
+              // Update entries
+              updateTextEntries(s);
             }
           }
           s->copy_reset = 1;
         } else if (hold_pad[PAD_DOWN] || hold2_pad[PAD_LEFT_ANALOG_DOWN]) {
-          if (s->offset_list[s->rel_pos + 1] < s->size) {
+          if (s->row_offsets[s->rel_pos + 1] < s->size) {
             if ((s->rel_pos + 1) < MAX_POSITION) {
-              if (s->base_pos+s->rel_pos < s->n_lines - 1) 
-                s->rel_pos++;
+              s->rel_pos++;
             } else {
-              if (s->offset_list[s->base_pos+s->rel_pos + 1] < s->size) {
-                s->base_pos++;
+              s->top = s->row_offsets[1];
 
-                // Head to tail
-                s->list.head->previous = s->list.tail;
-                s->list.tail->next = s->list.head;
-                s->list.tail = s->list.head;
-
-                // Second first to head
-                s->list.head = s->list.head->next;
-                s->list.head->previous = NULL;
-
-                // No next
-                s->list.tail->next = NULL;
-
-                // Update line_number
-                s->list.tail->line_number = s->base_pos+MAX_ENTRIES-1;
-
-                // Read
-                int length = textReadLine(s->buffer, s->offset_list[s->base_pos+MAX_ENTRIES-1], s->size, s->list.tail->line);
-                s->offset_list[s->base_pos+MAX_ENTRIES] = s->offset_list[s->base_pos+MAX_ENTRIES-1] + length;
-
-                // Update the entry
-                updateTextEntry(s, s->list.tail, MAX_ENTRIES - 1);
-              }
+              // Update entries
+              updateTextEntries(s);
             }
           }
           s->copy_reset = 1;
         }
 
         if (s->n_search_results > 0) {
+          SceOff entry_start_offset = s->row_offsets[s->rel_pos];
+          SceOff entry_end_offset = s->row_offsets[s->rel_pos + 1];
 
-          TextListEntry *entry = s->list.head;
-          
-          int i;
-          for (i = 0; i < s->rel_pos; i++)
-            entry = entry->next;
-
-          int entry_start_offset = s->offset_list[entry->line_number];
-          int entry_end_offset = s->offset_list[entry->line_number + 1]; 
-
-          int target_offset = 0;
+          SceOff target_offset = -1;
 
           // Skip to next search result
           if (pressed_pad[PAD_RTRIGGER]) {
             for (i = 0; i < s->n_search_results; i++) {
-              if (s->search_result_offsets[i] > entry_end_offset) {
-                target_offset = s->search_result_offsets[i] - entry_start_offset;
+              if (s->search_result_offsets[i] >= entry_end_offset) {
+                target_offset = s->search_result_offsets[i];
                 break;
               }
             }
@@ -698,53 +847,43 @@ int textViewer(const char *file) {
           else if (pressed_pad[PAD_LTRIGGER]) {
             for (i = s->n_search_results-1; i >= 0; i--) {
               if (s->search_result_offsets[i] < entry_start_offset) {
-                target_offset = s->search_result_offsets[i] - entry_start_offset;
+                target_offset = s->search_result_offsets[i];
                 break;
               }
             }
           }
 
-          if (target_offset != 0) {
-            int dir = target_offset > 0 ? 1 : -1;
-            int line = s->base_pos+s->rel_pos;
-            int offset = s->offset_list[line];
-
-            while (offset < s->size && offset >= 0 && target_offset != 0) {
-              offset += dir;
-              target_offset -= dir;
-
-              if (s->buffer[offset] == '\n') {
-                line += dir;
-                if (dir > 0) {
-                  s->offset_list[line] = offset + 1;
-                } else {
-                  s->offset_list[line + 1] = offset + 1;
-                }
-              }
-            }
-
-            if (target_offset == 0) {
-              s->base_pos = line;
-              s->rel_pos = 0;
+          if (target_offset >= 0) {
+            s->top = textGetRowStart(s, target_offset);
+            s->rel_pos = 0;
 
-              updateTextEntries(s);
-            }
+            updateTextEntries(s);
           }
         } else {
           // Page skip
           if (hold_pad[PAD_LTRIGGER] || hold_pad[PAD_RTRIGGER]) {
 
             if (hold_pad[PAD_LTRIGGER]) {  // Skip page up
-              s->base_pos = s->base_pos-MAX_ENTRIES;
-              if (s->base_pos < 0) {
-                s->base_pos = 0;
+              for (i = 0; i < MAX_ENTRIES && s->top > 0; i++)
+                s->top = textGetPreviousRow(s, s->top);
+
+              if (s->top == 0)
                 s->rel_pos = 0;
-              }
             } else {  // Skip page down
-              s->base_pos = s->base_pos+MAX_ENTRIES;
-              if (s->base_pos >= s->n_lines-MAX_POSITION) {
-                s->base_pos = MAX(s->n_lines-MAX_POSITION, 0);
-                s->rel_pos = MIN(MAX_POSITION-1, s->n_lines - 1);
+              // Only the offsets are moved, the screen stays filled at the end
+              for (i = 0; i < MAX_ENTRIES && s->row_offsets[MAX_POSITION] < s->size; i++) {
+                memmove(&s->row_offsets[0], &s->row_offsets[1], MAX_ENTRIES * sizeof(SceOff));
+
+                SceOff last = s->row_offsets[MAX_ENTRIES - 1];
+                s->row_offsets[MAX_ENTRIES] = last < s->size ? last + textReadRow(s, last, NULL) : s->size;
+              }
+
+              s->top = s->row_offsets[0];
+
+              if (i < MAX_ENTRIES) {
+                s->rel_pos = MAX_POSITION - 1;
+                while (s->rel_pos > 0 && s->row_offsets[s->rel_pos] >= s->size)
+                  s->rel_pos--;
               }
             }
 
@@ -755,25 +894,25 @@ int textViewer(const char *file) {
       
         // buffer modifying actions
         if (s->modify_allowed && !s->search_running) {
-          if(s->edit_line <= 0 && pressed_pad[PAD_ENTER]) {
-            int line_start = s->offset_list[s->base_pos+s->rel_pos];
+          if(s->edit_line < 0 && pressed_pad[PAD_ENTER]) {
+            SceOff line_start = s->row_offsets[s->rel_pos];
             
             char line[MAX_LINE_CHARACTERS];
-            textReadLine(s->buffer, line_start, s->size, line);
+            textReadRow(s, line_start, line);
 
             initImeDialog(language_container[EDIT_LINE], line, MAX_LINE_CHARACTERS, SCE_IME_TYPE_DEFAULT, SCE_IME_OPTION_MULTILINE, 0);
 
-            s->edit_line = s->base_pos+s->rel_pos;
+            s->edit_line = line_start;
           }
 
           // Delete line
           if (pressed_pad[PAD_LEFT] && s->n_copied_lines < MAX_COPY_BUFFER_SIZE) {
-            delete_line(s, s->base_pos+s->rel_pos);
+            delete_line(s, s->row_offsets[s->rel_pos]);
           } 
 
           // Insert new line
           if (pressed_pad[PAD_RIGHT]) {
-            insert_line(s, "\n", s->base_pos+s->rel_pos + 1);
+            insert_line(s, "\n", s->row_offsets[s->rel_pos + 1]);
           }
         }
 
@@ -793,7 +932,7 @@ int textViewer(const char *file) {
 
         // (De-)select current line
         if (pressed_pad[PAD_SQUARE]) {
-          int cur_line = s->base_pos+s->rel_pos;
+          SceOff cur_line = s->row_offsets[s->rel_pos];
           int line_selected = 1;
 
           int i;
@@ -808,7 +947,7 @@ int textViewer(const char *file) {
             }
           }
 
-          if (line_selected) {
+          if (line_selected && s->n_selections < MAX_SELECTION) {
             // Add current line to selections
             s->selection_list[s->n_selections++] = cur_line;
           }
@@ -823,12 +962,7 @@ int textViewer(const char *file) {
     } else {
       int msg_result = updateMessageDialog();
       if (msg_result == MESSAGE_DIALOG_RESULT_YES) {
-        SceUID fd = sceIoOpen(file, SCE_O_WRONLY | SCE_O_TRUNC, 0777);
-        if (fd >= 0) {
-          sceIoWrite(fd, buffer_base, has_utf8_bom ? s->size + sizeof(utf8_bom) : s->size);
-          sceIoClose(fd);
-        }
-
+        textSave(s, file, utf8_bom, has_utf8_bom ? sizeof(utf8_bom) : 0);
         break;
       } else if (msg_result == MESSAGE_DIALOG_RESULT_NO) {
         break;
@@ -868,40 +1002,39 @@ int textViewer(const char *file) {
         }
       }
 
+      if (s->goto_line_input) {
+        if (ime_result == IME_DIALOG_RESULT_FINISHED) {
+          goto_line(s, (char *)getImeDialogInputTextUTF8());
+          s->goto_line_input = 0;
+        } else if (ime_result == IME_DIALOG_RESULT_CANCELED) {
+          s->goto_line_input = 0;
+        }
+      }
+
       if (s->edit_line >= 0) {
         if (ime_result == IME_DIALOG_RESULT_FINISHED) {
-          int line_start = s->offset_list[s->edit_line];
-          
-          char line[MAX_LINE_CHARACTERS];
-          int length = textReadLine(s->buffer, line_start, s->size, line);
+          SceOff line_start = s->edit_line;
+          int length = textReadRow(s, line_start, NULL);
 
           // Don't count newline 
-          if (s->buffer[line_start+length-1] == '\n') {
+          char last = '\0';
+          pieceTableRead(&s->table, line_start + length - 1, &last, 1);
+          if (last == '\n') {
             length--;
           }
 
           char *new_line = (char *)getImeDialogInputTextUTF8();
           int new_length = strlen(new_line);
 
-          // Move data if size has changed
-          if (new_length != length) {
-            memmove(&s->buffer[line_start+new_length], &s->buffer[line_start+length], s->size-line_start-length);
-            s->size += (new_length-length);
-          }
+          // Replace the row
+          pieceTableDelete(&s->table, line_start, length);
+          pieceTableInsert(&s->table, line_start, new_line, new_length);
+          updateTextRows(s, line_start, length, new_length);
 
-          // Copy new line into buffer
-          memcpy(&s->buffer[line_start], new_line, new_length);
+          updateTextSize(s);
 
-          // Add new lines to n_lines
-          int i;
-          for (i = 0; i < new_length; i++) {
-            if (new_line[i] == '\n') {
-              s->n_lines++;
-            }
-          }
-          
           // Update entries
-          updateTextEntries(s);
+          correctTextPosition(s);
 
           s->edit_line = -1;
           s->changed = 1;
@@ -912,14 +1045,28 @@ int textViewer(const char *file) {
       }
     }
 
+    indexTextRows(s);
+
     // Start drawing
     startDrawing(bg_text_image);
 
     // Draw shell info
-    drawShellInfo(file);
+    if (s->streaming && !s->stream.index_done) {
+      char progress[64], title[MAX_PATH_LENGTH];
+      snprintf(progress, sizeof(progress), language_container[TEXT_INDEXING], textStreamGetProgress(&s->stream));
+      snprintf(title, sizeof(title), "%s (%s)", file, progress);
+      drawShellInfo(title);
+    } else {
+      drawShellInfo(file);
+    }
 
-    // Draw scroll bar
-    drawScrollBar(s->base_pos, s->n_lines);
+    // Draw scroll bar, by blocks as the lines of a stream may not be known, by rows once they are indexed
+    if (s->streaming)
+      drawScrollBar(s->top / TEXT_STREAM_BLOCK_SIZE, s->size / TEXT_STREAM_BLOCK_SIZE + 1);
+    else if (s->row_index && s->rows.done)
+      drawScrollBar(textRowsFind(&s->rows, s->top), s->rows.n_rows);
+    else
+      drawScrollBar(s->top_line, s->n_lines);
 
     // Text
     TextListEntry *entry = s->list.head;
@@ -931,20 +1078,21 @@ int textViewer(const char *file) {
 
       int search_result_on_line = 0;
 
-      int entry_start_offset = s->offset_list[entry->line_number];
-      int entry_end_offset = entry_start_offset+line_lenght; 
+      SceOff entry_start_offset = s->row_offsets[i];
+      SceOff entry_end_offset = entry_start_offset+line_lenght;
 
       if (s->n_search_results > 0) {
         int j; 
         for (j = 0; j < s->n_search_results; j++) {
-          int search_offset = s->search_result_offsets[j];
+          SceOff search_offset = s->search_result_offsets[j];
           if (entry_start_offset <= search_offset && entry_end_offset >= search_offset) {
             search_result_on_line = 1;
           }
         }
       }
 
-      if (entry->line_number < s->n_lines) {
+      // Number only the first row of a line
+      if (entry->line_number >= 0 && entry->line_start) {
         char line_str[5];
         snprintf(line_str, 5, "%04i", entry->line_number);
 
@@ -1011,9 +1159,6 @@ int textViewer(const char *file) {
     endDrawing();
   }
 
-  s->count_lines_running = 0;
-  sceKernelWaitThreadEnd(s->count_lines_thid, NULL, NULL);
-
   if (s->search_running) {
     s->search_running = 0;
     sceKernelWaitThreadEnd(s->search_thid, NULL, NULL);
@@ -1021,6 +1166,13 @@ int textViewer(const char *file) {
 
   textListEmpty(&s->list);
 
+  if (s->streaming)
+    textStreamClose(&s->stream);
+  else
+    pieceTableFree(&s->table);
+
+  stopTextRows(s);
+
   int hex_viewer = s->hex_viewer;
 
   free(s);
@@ -19,7 +19,6 @@
 #ifndef __TEXT_H__
 #define __TEXT_H__
 
-#define MAX_LINES 0x10000
 #define MAX_LINE_CHARACTERS 1024
 #define MAX_COPY_BUFFER_SIZE 1024
 
@@ -30,10 +29,14 @@
 #define MAX_SEARCH_RESULTS 1024 * 1024
 #define MIN_SEARCH_TERM_LENGTH 1
 
+#define TEXT_SEARCH_CHUNK_SIZE (64 * 1024)
+#define TEXT_WRITE_BUFFER_SIZE (128 * 1024)
+
 typedef struct TextListEntry {
   struct TextListEntry *next;
   struct TextListEntry *previous;
   int line_number;
+  int line_start; // First row of the line
   int selected;
   char line[MAX_LINE_CHARACTERS];
 } TextListEntry;
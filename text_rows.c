@@ -0,0 +1,310 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "text_rows.h"
+
+#define HAS_ZERO_BYTE(x) (((x) - 0x01010101) & ~(x) & 0x80808080)
+
+void textLayoutInit(TextLayout *layout, const char *font_widths, int tab_size, float max_width, int max_characters) {
+  int i;
+  for (i = 0; i < 256; i++) {
+    char ch = i;
+    char ch_width = 0;
+
+    if (ch == '\t') {
+      ch_width = tab_size * font_widths[' '];
+    } else {
+      ch_width = font_widths[i];
+      if (ch_width == 0) {
+        ch = ' ';
+        ch_width = font_widths[' '];
+      }
+    }
+
+    layout->widths[i] = ch_width;
+    layout->characters[i] = ch;
+  }
+
+  layout->max_width = (int)max_width;
+  if (layout->max_width < max_width)
+    layout->max_width++;
+  layout->max_characters = max_characters;
+}
+
+// Rows end at a line break or at the width of the screen. Returns the length of the row
+int textLayoutReadRow(TextLayout *layout, const char *data, int size, char *row) {
+  int line_width = 0;
+  int count = 0;
+
+  int i;
+  for (i = 0; i < size && i < layout->max_characters - 1; i++) {
+    uint8_t ch = data[i];
+
+    // Line break
+    if (ch == '\n') {
+      i++; // Skip it
+      break;
+    }
+
+    // Too long, but a row always holds one character
+    if (i > 0 && (line_width + layout->widths[ch]) >= layout->max_width)
+      break;
+
+    line_width += layout->widths[ch];
+
+    if (row)
+      row[count++] = layout->characters[ch];
+  }
+
+  if (row)
+    row[count] = '\0';
+
+  return i;
+}
+
+/*
+  Same as textLayoutReadRow without the row string. While there is no line
+  break, four characters are measured at once, and as no glyph is narrower
+  than zero they all fit if their sum does.
+*/
+static int measureRow(TextLayout *layout, const char *data, int size) {
+  int line_width = 0;
+
+  if (size > layout->max_characters - 1)
+    size = layout->max_characters - 1;
+
+  int i = 0;
+  while (i + 4 <= size) {
+    uint32_t word;
+    memcpy(&word, data + i, 4);
+    if (HAS_ZERO_BYTE(word ^ 0x0A0A0A0A))
+      break;
+
+    int width = layout->widths[(uint8_t)data[i]] + layout->widths[(uint8_t)data[i + 1]] +
+                layout->widths[(uint8_t)data[i + 2]] + layout->widths[(uint8_t)data[i + 3]];
+    if ((line_width + width) >= layout->max_width)
+      break;
+
+    line_width += width;
+    i += 4;
+  }
+
+  for (; i < size; i++) {
+    uint8_t ch = data[i];
+
+    if (ch == '\n')
+      return i + 1;
+
+    if (i > 0 && (line_width + layout->widths[ch]) >= layout->max_width)
+      break;
+
+    line_width += layout->widths[ch];
+  }
+
+  return i;
+}
+
+// Returns the first row that starts at or after offset
+static uint32_t findFirstRow(TextRows *rows, uint32_t offset) {
+  uint32_t low = 0, high = rows->n_rows;
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    if (rows->offsets[mid] < offset)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return low;
+}
+
+static int reserveRows(TextRows *rows, uint32_t n_rows) {
+  if (n_rows <= rows->max_rows)
+    return 0;
+
+  if (n_rows > TEXT_ROWS_MAX_ROWS)
+    return TEXT_ROWS_ERROR_NO_MEMORY;
+
+  uint32_t max_rows = rows->max_rows ? rows->max_rows : 1024;
+  while (max_rows < n_rows)
+    max_rows *= 2;
+
+  if (max_rows > TEXT_ROWS_MAX_ROWS)
+    max_rows = TEXT_ROWS_MAX_ROWS;
+
+  uint32_t *offsets = realloc(rows->offsets, max_rows * sizeof(uint32_t));
+  if (!offsets)
+    return TEXT_ROWS_ERROR_NO_MEMORY;
+
+  rows->offsets = offsets;
+  rows->max_rows = max_rows;
+
+  return 0;
+}
+
+// Adds the rows from indexed up to end, which must be a row start, reading about budget bytes
+static int indexRows(TextRows *rows, PieceTable *table, uint32_t end, uint32_t budget) {
+  uint32_t max_length = rows->layout->max_characters - 1;
+  uint32_t read = 0;
+
+  while (rows->indexed < end && read < budget) {
+    uint32_t size = end - rows->indexed;
+    if (size > TEXT_ROWS_CHUNK_SIZE)
+      size = TEXT_ROWS_CHUNK_SIZE;
+
+    size = pieceTableRead(table, rows->indexed, rows->chunk, size);
+    if (size == 0)
+      break;
+
+    int last = rows->indexed + size >= end;
+
+    uint32_t pos = 0;
+    while (pos < size) {
+      uint32_t left = size - pos;
+
+      // The row may go on in the next chunk
+      if (!last && left < max_length)
+        break;
+
+      uint32_t length = measureRow(rows->layout, rows->chunk + pos, left);
+
+      int res = reserveRows(rows, rows->n_rows + 1);
+      if (res < 0) {
+        rows->indexed += pos;
+        return res;
+      }
+
+      rows->offsets[rows->n_rows++] = rows->indexed + pos;
+      pos += length;
+    }
+
+    rows->indexed += pos;
+    read += pos;
+  }
+
+  return 0;
+}
+
+int textRowsInit(TextRows *rows, TextLayout *layout) {
+  memset(rows, 0, sizeof(TextRows));
+  rows->layout = layout;
+
+  rows->chunk = malloc(TEXT_ROWS_CHUNK_SIZE);
+  if (!rows->chunk)
+    return TEXT_ROWS_ERROR_NO_MEMORY;
+
+  return 0;
+}
+
+void textRowsFree(TextRows *rows) {
+  free(rows->offsets);
+  free(rows->chunk);
+  memset(rows, 0, sizeof(TextRows));
+}
+
+// Returns 1 once every row is indexed
+int textRowsBuild(TextRows *rows, PieceTable *table, uint32_t budget) {
+  if (rows->done)
+    return 1;
+
+  uint32_t size = pieceTableSize(table);
+
+  int res = indexRows(rows, table, size, budget);
+  if (res < 0)
+    return res;
+
+  if (rows->indexed >= size)
+    rows->done = 1;
+
+  return rows->done;
+}
+
+/*
+  Call after replacing deleted bytes at offset by inserted bytes. The text
+  before the line of offset and after the line of the edit's end is the same,
+  so only the rows in between are wrapped again.
+*/
+int textRowsEdit(TextRows *rows, PieceTable *table, uint32_t offset, uint32_t deleted, uint32_t inserted) {
+  uint32_t start = pieceTableLineOffset(table, pieceTableOffsetLine(table, offset));
+  uint32_t end = pieceTableLineOffset(table, pieceTableOffsetLine(table, offset + inserted) + 1);
+  uint32_t old_end = end - inserted + deleted;
+
+  uint32_t first = findFirstRow(rows, start);
+
+  if (start >= rows->indexed) {
+    rows->done = 0;
+    return 0;
+  }
+
+  // Index the rest later
+  if (old_end > rows->indexed) {
+    rows->n_rows = first;
+    rows->indexed = start;
+    rows->done = 0;
+    return 0;
+  }
+
+  uint32_t last = findFirstRow(rows, old_end);
+
+  TextRows edited;
+  memcpy(&edited, rows, sizeof(TextRows));
+  edited.offsets = NULL;
+  edited.n_rows = 0;
+  edited.max_rows = 0;
+  edited.indexed = start;
+
+  int res = indexRows(&edited, table, end, 0xFFFFFFFF);
+
+  uint32_t n_rows = rows->n_rows - (last - first) + edited.n_rows;
+  if (res >= 0)
+    res = reserveRows(rows, n_rows);
+
+  if (res < 0) {
+    free(edited.offsets);
+    rows->n_rows = first;
+    rows->indexed = start;
+    rows->done = 0;
+    return res;
+  }
+
+  memmove(rows->offsets + first + edited.n_rows, rows->offsets + last, (rows->n_rows - last) * sizeof(uint32_t));
+  memcpy(rows->offsets + first, edited.offsets, edited.n_rows * sizeof(uint32_t));
+
+  uint32_t i;
+  for (i = first + edited.n_rows; i < n_rows; i++)
+    rows->offsets[i] += inserted - deleted;
+
+  rows->n_rows = n_rows;
+  rows->indexed += inserted - deleted;
+
+  free(edited.offsets);
+
+  return 0;
+}
+
+// Returns the row containing offset, or -1 if it is not indexed yet
+int textRowsFind(TextRows *rows, uint32_t offset) {
+  if (offset >= rows->indexed || rows->n_rows == 0)
+    return -1;
+
+  uint32_t row = findFirstRow(rows, offset + 1);
+  return row - 1;
+}
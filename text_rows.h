@@ -0,0 +1,68 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __TEXT_ROWS_H__
+#define __TEXT_ROWS_H__
+
+#include <stdint.h>
+
+#include "piece_table.h"
+
+// Like the piece table, the row index only depends on libc
+
+#define TEXT_ROWS_CHUNK_SIZE (64 * 1024)
+#define TEXT_ROWS_MAX_ROWS (4 * 1024 * 1024)
+
+#define TEXT_ROWS_ERROR_NO_MEMORY ((int)0x80101701)
+
+// How rows are wrapped, from the glyph widths of the font
+typedef struct {
+  int widths[256];      // Tabs and invalid characters included
+  char characters[256]; // Invalid characters are shown as spaces
+  int max_width;        // Rounded up, as rows are measured in whole pixels
+  int max_characters;   // Of a row, with the terminator
+} TextLayout;
+
+/*
+  Start offset of every row of a piece table. Rows are found one after
+  another from the start, so the index can be built a budget at a time while
+  the text is shown. Edits only wrap the edited lines again and move the rows
+  behind them.
+*/
+typedef struct {
+  TextLayout *layout;
+  uint32_t *offsets;
+  uint32_t n_rows;
+  uint32_t max_rows;
+  uint32_t indexed; // Start of the next row to index
+  int done;
+  char *chunk;
+} TextRows;
+
+void textLayoutInit(TextLayout *layout, const char *font_widths, int tab_size, float max_width, int max_characters);
+int textLayoutReadRow(TextLayout *layout, const char *data, int size, char *row);
+
+int textRowsInit(TextRows *rows, TextLayout *layout);
+void textRowsFree(TextRows *rows);
+
+int textRowsBuild(TextRows *rows, PieceTable *table, uint32_t budget);
+int textRowsEdit(TextRows *rows, PieceTable *table, uint32_t offset, uint32_t deleted, uint32_t inserted);
+
+int textRowsFind(TextRows *rows, uint32_t offset);
+
+#endif
@@ -0,0 +1,367 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "main.h"
+#include "text_stream.h"
+#include "utils.h"
+
+// Must be called with the mutex locked
+static TextStreamBlock *textStreamGetBlock(TextStream *stream, SceOff offset) {
+  SceOff block_offset = offset - (offset % TEXT_STREAM_BLOCK_SIZE);
+  TextStreamBlock *lru = &stream->blocks[0];
+
+  int i;
+  for (i = 0; i < stream->n_blocks; i++) {
+    TextStreamBlock *block = &stream->blocks[i];
+
+    if (block->offset == block_offset) {
+      block->last_used = ++stream->clock;
+      return block;
+    }
+
+    if (block->offset < 0 || block->last_used < lru->last_used)
+      lru = block;
+  }
+
+  int size = sceIoPread(stream->fd, lru->data, MIN(TEXT_STREAM_BLOCK_SIZE, stream->size - block_offset),
+                        stream->base + block_offset);
+  if (size < 0) {
+    lru->offset = -1;
+    return NULL;
+  }
+
+  lru->offset = block_offset;
+  lru->size = size;
+  lru->last_used = ++stream->clock;
+
+  return lru;
+}
+
+int textStreamRead(TextStream *stream, SceOff offset, char *data, int size) {
+  int read = 0;
+
+  sceKernelLockLwMutex(&stream->mutex, 1, NULL);
+
+  while (read < size && offset < stream->size) {
+    TextStreamBlock *block = textStreamGetBlock(stream, offset);
+    if (!block)
+      break;
+
+    int start = offset - block->offset;
+    if (start >= block->size)
+      break;
+
+    int length = MIN(size - read, block->size - start);
+    memcpy(data + read, block->data + start, length);
+
+    read += length;
+    offset += length;
+  }
+
+  sceKernelUnlockLwMutex(&stream->mutex, 1);
+
+  return read;
+}
+
+// For long sequential reads that should not evict the cached blocks
+int textStreamReadUncached(TextStream *stream, SceOff offset, char *data, int size) {
+  if (offset >= stream->size)
+    return 0;
+
+  return sceIoPread(stream->fd, data, MIN(size, stream->size - offset), stream->base + offset);
+}
+
+// Returns the offset after count line breaks, or end if there are less
+static SceOff textStreamSkipLines(TextStream *stream, SceOff offset, SceOff end, int count) {
+  sceKernelLockLwMutex(&stream->mutex, 1, NULL);
+
+  while (count > 0 && offset < end) {
+    TextStreamBlock *block = textStreamGetBlock(stream, offset);
+    if (!block)
+      break;
+
+    int start = offset - block->offset;
+    int length = MIN(block->size - start, end - offset);
+    if (length <= 0)
+      break;
+
+    char *p = block->data + start;
+    char *block_end = p + length;
+
+    while (count > 0 && (p = memchr(p, '\n', block_end - p))) {
+      p++;
+      count--;
+    }
+
+    offset = count > 0 ? offset + length : block->offset + (p - block->data);
+  }
+
+  sceKernelUnlockLwMutex(&stream->mutex, 1);
+
+  return MIN(offset, end);
+}
+
+static int textStreamCountLines(TextStream *stream, SceOff offset, SceOff end) {
+  int count = 0;
+
+  sceKernelLockLwMutex(&stream->mutex, 1, NULL);
+
+  while (offset < end) {
+    TextStreamBlock *block = textStreamGetBlock(stream, offset);
+    if (!block)
+      break;
+
+    int start = offset - block->offset;
+    int length = MIN(block->size - start, end - offset);
+    if (length <= 0)
+      break;
+
+    char *p = block->data + start;
+    char *block_end = p + length;
+
+    while ((p = memchr(p, '\n', block_end - p))) {
+      p++;
+      count++;
+    }
+
+    offset += length;
+  }
+
+  sceKernelUnlockLwMutex(&stream->mutex, 1);
+
+  return count;
+}
+
+static int textStreamAddCheckpoint(TextStream *stream, SceOff offset) {
+  sceKernelLockLwMutex(&stream->mutex, 1, NULL);
+
+  if (stream->n_checkpoints == stream->max_checkpoints) {
+    int max_checkpoints = stream->max_checkpoints * 2;
+    SceOff *checkpoints = realloc(stream->checkpoints, max_checkpoints * sizeof(SceOff));
+    if (!checkpoints) {
+      sceKernelUnlockLwMutex(&stream->mutex, 1);
+      return TEXT_STREAM_ERROR_NO_MEMORY;
+    }
+
+    stream->checkpoints = checkpoints;
+    stream->max_checkpoints = max_checkpoints;
+  }
+
+  stream->checkpoints[stream->n_checkpoints++] = offset;
+
+  sceKernelUnlockLwMutex(&stream->mutex, 1);
+
+  return 0;
+}
+
+static int text_stream_index_thread(SceSize args, TextStream **argp) {
+  TextStream *stream = *argp;
+
+  char *buffer = malloc(TEXT_STREAM_INDEX_BUFFER_SIZE);
+  if (!buffer) {
+    stream->index_done = 1;
+    return sceKernelExitThread(0);
+  }
+
+  SceOff offset = 0;
+  int n_lines = 0;
+
+  while (!stream->abort && offset < stream->size) {
+    int size = textStreamReadUncached(stream, offset, buffer, TEXT_STREAM_INDEX_BUFFER_SIZE);
+    if (size <= 0)
+      break;
+
+    char *p = buffer;
+    char *end = buffer + size;
+
+    while ((p = memchr(p, '\n', end - p))) {
+      p++;
+      n_lines++;
+
+      if ((n_lines % TEXT_STREAM_CHECKPOINT_LINES) == 0) {
+        if (textStreamAddCheckpoint(stream, offset + (p - buffer)) < 0)
+          goto EXIT;
+      }
+    }
+
+    offset += size;
+
+    // Lines are only reported for the fully indexed part
+    sceKernelLockLwMutex(&stream->mutex, 1, NULL);
+    stream->n_lines = n_lines;
+    stream->indexed = offset;
+    sceKernelUnlockLwMutex(&stream->mutex, 1);
+
+    sceKernelDelayThread(1000);
+  }
+
+EXIT:
+  free(buffer);
+
+  stream->index_done = 1;
+
+  return sceKernelExitThread(0);
+}
+
+int textStreamOpen(TextStream *stream, const char *path, int cache_size) {
+  memset(stream, 0, sizeof(TextStream));
+
+  stream->fd = sceIoOpen(path, SCE_O_RDONLY, 0);
+  if (stream->fd < 0)
+    return stream->fd;
+
+  stream->size = sceIoLseek(stream->fd, 0, SCE_SEEK_END);
+  if (stream->size < 0) {
+    int res = (int)stream->size;
+    sceIoClose(stream->fd);
+    return res;
+  }
+
+  char utf8_bom[3] = {0xEF, 0xBB, 0xBF};
+  char bom[3];
+  if (sceIoPread(stream->fd, bom, sizeof(bom), 0) == sizeof(bom) && memcmp(bom, utf8_bom, sizeof(bom)) == 0) {
+    stream->base = sizeof(bom);
+    stream->size -= sizeof(bom);
+  }
+
+  stream->n_blocks = MAX(cache_size / TEXT_STREAM_BLOCK_SIZE, TEXT_STREAM_MIN_BLOCKS);
+  stream->cache = memalign(4096, stream->n_blocks * TEXT_STREAM_BLOCK_SIZE);
+  stream->blocks = malloc(stream->n_blocks * sizeof(TextStreamBlock));
+  stream->max_checkpoints = 1024;
+  stream->checkpoints = malloc(stream->max_checkpoints * sizeof(SceOff));
+
+  if (!stream->cache || !stream->blocks || !stream->checkpoints) {
+    free(stream->checkpoints);
+    free(stream->blocks);
+    free(stream->cache);
+    sceIoClose(stream->fd);
+    return TEXT_STREAM_ERROR_NO_MEMORY;
+  }
+
+  int i;
+  for (i = 0; i < stream->n_blocks; i++) {
+    stream->blocks[i].offset = -1;
+    stream->blocks[i].size = 0;
+    stream->blocks[i].last_used = 0;
+    stream->blocks[i].data = stream->cache + i * TEXT_STREAM_BLOCK_SIZE;
+  }
+
+  // Line 0
+  stream->checkpoints[stream->n_checkpoints++] = 0;
+
+  sceKernelCreateLwMutex(&stream->mutex, "text_stream_mutex", 2, 0, NULL);
+
+  stream->thid = sceKernelCreateThread("text_stream_index_thread", (SceKernelThreadEntry)text_stream_index_thread,
+                                       0x10000100, 0x10000, 0, 0, NULL);
+  if (stream->thid < 0) {
+    int res = stream->thid;
+    sceKernelDeleteLwMutex(&stream->mutex);
+    free(stream->checkpoints);
+    free(stream->blocks);
+    free(stream->cache);
+    sceIoClose(stream->fd);
+    return res;
+  }
+
+  sceKernelStartThread(stream->thid, sizeof(TextStream *), &stream);
+
+  return 0;
+}
+
+void textStreamClose(TextStream *stream) {
+  stream->abort = 1;
+  sceKernelWaitThreadEnd(stream->thid, NULL, NULL);
+  sceKernelDeleteThread(stream->thid);
+
+  sceKernelDeleteLwMutex(&stream->mutex);
+
+  free(stream->checkpoints);
+  free(stream->blocks);
+  free(stream->cache);
+
+  sceIoClose(stream->fd);
+}
+
+int textStreamGetProgress(TextStream *stream) {
+  if (stream->index_done || stream->size == 0)
+    return 100;
+
+  return (int)((stream->indexed * 100) / stream->size);
+}
+
+// Block starts count as line starts, so the scan never leaves the block
+SceOff textStreamLineStart(TextStream *stream, SceOff offset) {
+  SceOff block_offset = offset - (offset % TEXT_STREAM_BLOCK_SIZE);
+
+  if (offset == block_offset)
+    return offset;
+
+  sceKernelLockLwMutex(&stream->mutex, 1, NULL);
+
+  TextStreamBlock *block = textStreamGetBlock(stream, block_offset);
+  if (block) {
+    char *p = block->data + MIN(offset - block_offset, block->size);
+    while (p > block->data && p[-1] != '\n')
+      p--;
+
+    offset = block_offset + (p - block->data);
+  }
+
+  sceKernelUnlockLwMutex(&stream->mutex, 1);
+
+  return offset;
+}
+
+// Lines past the indexed part end up at the end of that part
+SceOff textStreamLineOffset(TextStream *stream, int line) {
+  if (line <= 0)
+    return 0;
+
+  sceKernelLockLwMutex(&stream->mutex, 1, NULL);
+  SceOff indexed = stream->indexed;
+  int checkpoint = MIN(line / TEXT_STREAM_CHECKPOINT_LINES, stream->n_checkpoints - 1);
+  SceOff offset = stream->checkpoints[checkpoint];
+  sceKernelUnlockLwMutex(&stream->mutex, 1);
+
+  return textStreamSkipLines(stream, offset, indexed, line - checkpoint * TEXT_STREAM_CHECKPOINT_LINES);
+}
+
+// Returns -1 if the offset has not been indexed yet
+int textStreamOffsetLine(TextStream *stream, SceOff offset) {
+  sceKernelLockLwMutex(&stream->mutex, 1, NULL);
+
+  if (offset > stream->indexed) {
+    sceKernelUnlockLwMutex(&stream->mutex, 1);
+    return -1;
+  }
+
+  int low = 0, high = stream->n_checkpoints - 1;
+  while (low < high) {
+    int mid = (low + high + 1) / 2;
+    if (stream->checkpoints[mid] <= offset)
+      low = mid;
+    else
+      high = mid - 1;
+  }
+
+  SceOff checkpoint_offset = stream->checkpoints[low];
+
+  sceKernelUnlockLwMutex(&stream->mutex, 1);
+
+  return low * TEXT_STREAM_CHECKPOINT_LINES + textStreamCountLines(stream, checkpoint_offset, offset);
+}
@@ -0,0 +1,73 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __TEXT_STREAM_H__
+#define __TEXT_STREAM_H__
+
+#define TEXT_STREAM_BLOCK_SIZE (64 * 1024)
+#define TEXT_STREAM_INDEX_BUFFER_SIZE (1 * 1024 * 1024)
+#define TEXT_STREAM_CHECKPOINT_LINES 1024
+#define TEXT_STREAM_MIN_BLOCKS 4
+
+#define TEXT_STREAM_ERROR_NO_MEMORY ((int)0x80101601)
+
+typedef struct {
+  SceOff offset; // -1 if unused
+  int size;
+  uint32_t last_used;
+  char *data;
+} TextStreamBlock;
+
+/*
+  Files too big for memory are read through a small LRU cache of blocks.
+  A thread walks the file once and keeps the offset of every
+  TEXT_STREAM_CHECKPOINT_LINES-th line, lines in between are found by
+  scanning from the nearest checkpoint.
+*/
+typedef struct {
+  SceUID fd;
+  SceOff base; // Offsets are relative to the text after a UTF-8 BOM
+  SceOff size;
+  SceKernelLwMutexWork mutex;
+  char *cache;
+  TextStreamBlock *blocks;
+  int n_blocks;
+  uint32_t clock;
+  SceOff *checkpoints; // Offset of line i * TEXT_STREAM_CHECKPOINT_LINES
+  int n_checkpoints;
+  int max_checkpoints;
+  volatile SceOff indexed; // Everything before has been indexed
+  volatile int n_lines;    // Line breaks before indexed
+  volatile int index_done;
+  volatile int abort;
+  SceUID thid;
+} TextStream;
+
+int textStreamOpen(TextStream *stream, const char *path, int cache_size);
+void textStreamClose(TextStream *stream);
+
+int textStreamRead(TextStream *stream, SceOff offset, char *data, int size);
+int textStreamReadUncached(TextStream *stream, SceOff offset, char *data, int size);
+
+int textStreamGetProgress(TextStream *stream);
+
+SceOff textStreamLineStart(TextStream *stream, SceOff offset);
+SceOff textStreamLineOffset(TextStream *stream, int line);
+int textStreamOffsetLine(TextStream *stream, SceOff offset);
+
+#endif
@@ -0,0 +1,295 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "main.h"
+#include "transfer.h"
+#include "file.h"
+
+// The caller reads into a ring of buffers while a thread writes them out
+struct TransferWriter {
+  SceUID fd;
+  SceUID thid;
+  SceUID free_sema;
+  SceUID full_sema;
+  void *buffers[TRANSFER_BUFFERS];
+  int lengths[TRANSFER_BUFFERS];
+  int buffer_size;
+  int read_index;
+  int write_index;
+  int held;
+  int fill;
+  int preallocated;
+  uint64_t size;
+  uint64_t written;
+  volatile int error;
+  volatile int abort;
+};
+
+static int writer_thread(SceSize args, void *argp) {
+  TransferWriter *writer = *(TransferWriter **)argp;
+
+  while (1) {
+    sceKernelWaitSema(writer->full_sema, 1, NULL);
+
+    // A zero length marks the end
+    int length = writer->lengths[writer->write_index];
+    if (length <= 0)
+      break;
+
+    // Keep releasing buffers after an error or abort, so that the reader never blocks
+    if (writer->error == 0 && !writer->abort) {
+      int written = sceIoWrite(writer->fd, writer->buffers[writer->write_index], length);
+      if (written < 0)
+        writer->error = written;
+      else
+        writer->written += written;
+    }
+
+    writer->write_index = (writer->write_index + 1) % TRANSFER_BUFFERS;
+    sceKernelSignalSema(writer->free_sema, 1);
+  }
+
+  return sceKernelExitThread(0);
+}
+
+static void freeWriter(TransferWriter *writer) {
+  int i;
+  for (i = 0; i < TRANSFER_BUFFERS; i++) {
+    free(writer->buffers[i]);
+  }
+
+  if (writer->full_sema >= 0)
+    sceKernelDeleteSema(writer->full_sema);
+  if (writer->free_sema >= 0)
+    sceKernelDeleteSema(writer->free_sema);
+
+  free(writer);
+}
+
+int transferOpen(TransferWriter **writer, SceUID fd, uint64_t size, int buffer_size) {
+  TransferWriter *w = malloc(sizeof(TransferWriter));
+  if (!w)
+    return -1;
+
+  memset(w, 0, sizeof(TransferWriter));
+  w->fd = fd;
+  w->size = size;
+  w->buffer_size = buffer_size > 0 ? buffer_size : TRANSFER_BUFFER_SIZE;
+  w->thid = -1;
+
+  w->free_sema = sceKernelCreateSema("transfer_free_sema", 0, TRANSFER_BUFFERS, TRANSFER_BUFFERS, NULL);
+  w->full_sema = sceKernelCreateSema("transfer_full_sema", 0, 0, TRANSFER_BUFFERS, NULL);
+  if (w->free_sema < 0 || w->full_sema < 0) {
+    freeWriter(w);
+    return -1;
+  }
+
+  int i;
+  for (i = 0; i < TRANSFER_BUFFERS; i++) {
+    w->buffers[i] = memalign(4096, w->buffer_size);
+    if (!w->buffers[i]) {
+      freeWriter(w);
+      return -1;
+    }
+  }
+
+  // Preallocate the destination, so that it does not have to grow with every write
+  if (size > w->buffer_size) {
+    SceIoStat stat;
+    memset(&stat, 0, sizeof(SceIoStat));
+    stat.st_size = size;
+    w->preallocated = sceIoChstatByFd(fd, &stat, SCE_CST_SIZE) >= 0;
+  }
+
+  w->thid = sceKernelCreateThread("transfer_writer_thread", (SceKernelThreadEntry)writer_thread, 0x10000100, 0x4000, 0, 0, NULL);
+  if (w->thid < 0) {
+    freeWriter(w);
+    return -1;
+  }
+
+  sceKernelStartThread(w->thid, sizeof(TransferWriter *), &w);
+
+  *writer = w;
+  return 0;
+}
+
+void *transferGetBuffer(TransferWriter *writer) {
+  if (!writer->held) {
+    sceKernelWaitSema(writer->free_sema, 1, NULL);
+    writer->held = 1;
+    writer->fill = 0;
+  }
+
+  return writer->buffers[writer->read_index];
+}
+
+int transferCommit(TransferWriter *writer, int length) {
+  writer->lengths[writer->read_index] = length;
+  writer->read_index = (writer->read_index + 1) % TRANSFER_BUFFERS;
+  writer->held = 0;
+  writer->fill = 0;
+
+  sceKernelSignalSema(writer->full_sema, 1);
+
+  return writer->error;
+}
+
+int transferWrite(TransferWriter *writer, const void *data, SceSize size) {
+  const uint8_t *p = data;
+
+  while (size > 0) {
+    uint8_t *buf = transferGetBuffer(writer);
+
+    int length = MIN(size, writer->buffer_size - writer->fill);
+    memcpy(buf + writer->fill, p, length);
+    writer->fill += length;
+    p += length;
+    size -= length;
+
+    if (writer->fill == writer->buffer_size) {
+      int res = transferCommit(writer, writer->fill);
+      if (res < 0)
+        return res;
+    }
+  }
+
+  return writer->error;
+}
+
+int transferClose(TransferWriter *writer, int abort) {
+  if (abort) {
+    writer->abort = 1;
+  } else if (writer->held && writer->fill > 0) {
+    transferCommit(writer, writer->fill);
+  }
+
+  // Queue the end marker
+  transferGetBuffer(writer);
+  transferCommit(writer, 0);
+
+  sceKernelWaitThreadEnd(writer->thid, NULL, NULL);
+  sceKernelDeleteThread(writer->thid);
+
+  int res = writer->error;
+
+  // Trim the preallocated size if less was written
+  if (!abort && res >= 0 && writer->preallocated && writer->written != writer->size) {
+    SceIoStat stat;
+    memset(&stat, 0, sizeof(SceIoStat));
+    stat.st_size = writer->written;
+    sceIoChstatByFd(writer->fd, &stat, SCE_CST_SIZE);
+  }
+
+  freeWriter(writer);
+
+  return res;
+}
+
+// Small files are read and written at once, a writer thread would cost more than the copy
+static int transferSmallFile(TransferReadFunc read, void *argp, SceUID fddst, uint64_t size,
+                             FileProcessParam *param) {
+  int buffer_size = ALIGN(MAX(size, 1), 4096);
+
+  void *buf = memalign(4096, buffer_size);
+  if (!buf)
+    return -1;
+
+  int res = 1;
+
+  while (1) {
+    int length = read(argp, buf, buffer_size);
+    if (length <= 0) {
+      res = length < 0 ? length : 1;
+      break;
+    }
+
+    int written = sceIoWrite(fddst, buf, length);
+    if (written < 0) {
+      res = written;
+      break;
+    }
+
+    if (param) {
+      if (param->value)
+        (*param->value) += length;
+
+      if (param->SetProgress)
+        param->SetProgress(param->value ? *param->value : 0, param->max);
+
+      if (param->cancelHandler && param->cancelHandler()) {
+        res = 0;
+        break;
+      }
+    }
+  }
+
+  free(buf);
+
+  return res;
+}
+
+int transferFile(TransferReadFunc read, void *argp, SceUID fddst, uint64_t size, int buffer_size,
+                 FileProcessParam *param) {
+  if (size <= (buffer_size > 0 ? buffer_size : TRANSFER_BUFFER_SIZE))
+    return transferSmallFile(read, argp, fddst, size, param);
+
+  TransferWriter *writer = NULL;
+  int res = transferOpen(&writer, fddst, size, buffer_size);
+  if (res < 0)
+    return res;
+
+  while (1) {
+    void *buf = transferGetBuffer(writer);
+
+    int length = read(argp, buf, writer->buffer_size);
+
+    if (length < 0) {
+      transferClose(writer, 1);
+      return length;
+    }
+
+    if (length == 0)
+      break;
+
+    res = transferCommit(writer, length);
+
+    if (res < 0) {
+      transferClose(writer, 1);
+      return res;
+    }
+
+    if (param) {
+      if (param->value)
+        (*param->value) += length;
+
+      if (param->SetProgress)
+        param->SetProgress(param->value ? *param->value : 0, param->max);
+
+      if (param->cancelHandler && param->cancelHandler()) {
+        transferClose(writer, 1);
+        return 0;
+      }
+    }
+  }
+
+  res = transferClose(writer, 0);
+  if (res < 0)
+    return res;
+
+  return 1;
+}
@@ -0,0 +1,41 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __TRANSFER_H__
+#define __TRANSFER_H__
+
+#include "file.h"
+
+// Buffer size used when the devices have no I/O profile
+#define TRANSFER_BUFFER_SIZE (4 * TRANSFER_SIZE)
+#define TRANSFER_BUFFERS 4
+
+typedef int (* TransferReadFunc)(void *argp, void *data, SceSize size);
+
+typedef struct TransferWriter TransferWriter;
+
+int transferOpen(TransferWriter **writer, SceUID fd, uint64_t size, int buffer_size);
+void *transferGetBuffer(TransferWriter *writer);
+int transferCommit(TransferWriter *writer, int length);
+int transferWrite(TransferWriter *writer, const void *data, SceSize size);
+int transferClose(TransferWriter *writer, int abort);
+
+int transferFile(TransferReadFunc read, void *argp, SceUID fddst, uint64_t size, int buffer_size,
+                 FileProcessParam *param);
+
+#endif
@@ -31,10 +31,29 @@ enum SelectButtonModes {
   SELECT_BUTTON_MODE_FTP,
 };
 
+enum HashAlgorithmModes {
+  HASH_ALGORITHMS_MODE_SHA1,
+  HASH_ALGORITHMS_MODE_SHA256,
+  HASH_ALGORITHMS_MODE_MD5,
+  HASH_ALGORITHMS_MODE_CRC32,
+  HASH_ALGORITHMS_MODE_ALL,
+};
+
+enum TextCacheSizeModes {
+  TEXT_CACHE_SIZE_MODE_4MB,
+  TEXT_CACHE_SIZE_MODE_8MB,
+  TEXT_CACHE_SIZE_MODE_16MB,
+  TEXT_CACHE_SIZE_MODE_32MB,
+};
+
 typedef struct {
   int usbdevice;
   int select_button;
   int disable_autoupdate;
+  int debug_overlay;
+  int detect_file_types;
+  int hash_algorithms;
+  int text_cache_size;
 } VitaShellConfig;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,463 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "main.h"
+#include "zip_reader.h"
+#include "io_profile.h"
+#include "file.h"
+#include "utils.h"
+
+#define ZIP_LOCAL_HEADER_SIGNATURE 0x04034B50
+#define ZIP_CENTRAL_HEADER_SIGNATURE 0x02014B50
+#define ZIP_EOCD_SIGNATURE 0x06054B50
+#define ZIP64_EOCD_SIGNATURE 0x06064B50
+#define ZIP64_EOCD_LOCATOR_SIGNATURE 0x07064B50
+
+#define ZIP_LOCAL_HEADER_SIZE 30
+#define ZIP_CENTRAL_HEADER_SIZE 46
+#define ZIP_EOCD_SIZE 22
+#define ZIP64_EOCD_SIZE 56
+#define ZIP64_EOCD_LOCATOR_SIZE 20
+#define ZIP_MAX_COMMENT_SIZE 0xFFFF
+
+#define ZIP_EXTRA_ZIP64 0x0001
+#define ZIP_EXTRA_TIMESTAMP 0x5455
+
+#define ZIP_FLAG_ENCRYPTED 0x0001
+
+#define ZIP_HOST_UNIX 3
+
+#define ZIP_MAX_CENTRAL_DIRECTORY_SIZE (64 * 1024 * 1024)
+
+struct ZipEntryReader {
+  SceUID fd;
+  int method;
+  uint32_t crc;
+  uint32_t computed_crc;
+  uint64_t compressed_left;
+  uint64_t uncompressed_left;
+  z_stream strm;
+  uint8_t *buffer;
+  int buffer_size;
+};
+
+SceMode convert_stat_mode(mode_t mode);
+
+static uint16_t get16(const uint8_t *p) {
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t get64(const uint8_t *p) {
+  return get32(p) | ((uint64_t)get32(p + 4) << 32);
+}
+
+static int readAt(SceUID fd, uint64_t offset, void *data, SceSize size) {
+  if (sceIoLseek(fd, offset, SCE_SEEK_SET) < 0)
+    return ZIP_ERROR_FORMAT;
+
+  int read = sceIoRead(fd, data, size);
+  if (read < 0)
+    return read;
+
+  if (read != size)
+    return ZIP_ERROR_FORMAT;
+
+  return 0;
+}
+
+static void convertDosTime(SceDateTime *time, uint16_t dos_date, uint16_t dos_time) {
+  SceDateTime local_time;
+  memset(&local_time, 0, sizeof(SceDateTime));
+
+  local_time.year = 1980 + (dos_date >> 9);
+  local_time.month = (dos_date >> 5) & 0xF;
+  local_time.day = dos_date & 0x1F;
+  local_time.hour = dos_time >> 11;
+  local_time.minute = (dos_time >> 5) & 0x3F;
+  local_time.second = (dos_time & 0x1F) * 2;
+
+  convertLocalTimeToUtc(time, &local_time);
+}
+
+static int parseExtraFields(ZipEntry *entry, const uint8_t *extra, int extra_length,
+                            uint32_t compressed_size, uint32_t uncompressed_size, uint32_t header_offset) {
+  const uint8_t *end = extra + extra_length;
+
+  while (extra + 4 <= end) {
+    uint16_t id = get16(extra);
+    uint16_t size = get16(extra + 2);
+    const uint8_t *data = extra + 4;
+    const uint8_t *data_end = data + size;
+
+    if (data_end > end)
+      return ZIP_ERROR_FORMAT;
+
+    if (id == ZIP_EXTRA_ZIP64) {
+      // Only the fields that overflowed are present, in this order
+      if (uncompressed_size == 0xFFFFFFFF) {
+        if (data + 8 > data_end)
+          return ZIP_ERROR_FORMAT;
+        entry->uncompressed_size = get64(data);
+        data += 8;
+      }
+
+      if (compressed_size == 0xFFFFFFFF) {
+        if (data + 8 > data_end)
+          return ZIP_ERROR_FORMAT;
+        entry->compressed_size = get64(data);
+        data += 8;
+      }
+
+      if (header_offset == 0xFFFFFFFF) {
+        if (data + 8 > data_end)
+          return ZIP_ERROR_FORMAT;
+        entry->header_offset = get64(data);
+        data += 8;
+      }
+    } else if (id == ZIP_EXTRA_TIMESTAMP) {
+      // The central directory only carries the modification time
+      if (size >= 5 && (data[0] & 0x1)) {
+        SceDateTime time;
+        sceRtcSetTime_t(&time, (time_t)get32(data + 1));
+        convertLocalTimeToUtc(&entry->stat.st_mtime, &time);
+      }
+    }
+
+    extra = data_end;
+  }
+
+  return 0;
+}
+
+static int findCentralDirectory(SceUID fd, uint64_t *cd_offset, uint64_t *cd_size, uint64_t *n_entries) {
+  int res;
+
+  SceOff file_size = sceIoLseek(fd, 0, SCE_SEEK_END);
+  if (file_size < ZIP_EOCD_SIZE)
+    return ZIP_ERROR_FORMAT;
+
+  // The end of central directory record is followed by a comment of up to 64KB
+  int tail_size = MIN(file_size, ZIP_EOCD_SIZE + ZIP_MAX_COMMENT_SIZE + ZIP64_EOCD_LOCATOR_SIZE);
+  uint64_t tail_offset = file_size - tail_size;
+
+  uint8_t *tail = malloc(tail_size);
+  if (!tail)
+    return -1;
+
+  res = readAt(fd, tail_offset, tail, tail_size);
+  if (res < 0) {
+    free(tail);
+    return res;
+  }
+
+  int pos;
+  for (pos = tail_size - ZIP_EOCD_SIZE; pos >= 0; pos--) {
+    if (get32(tail + pos) == ZIP_EOCD_SIGNATURE && pos + ZIP_EOCD_SIZE + get16(tail + pos + 20) <= tail_size)
+      break;
+  }
+
+  if (pos < 0) {
+    free(tail);
+    return ZIP_ERROR_FORMAT;
+  }
+
+  uint8_t *eocd = tail + pos;
+
+  // Multi-disk archives are not supported
+  if (get16(eocd + 4) != 0 || get16(eocd + 6) != 0) {
+    free(tail);
+    return ZIP_ERROR_UNSUPPORTED;
+  }
+
+  *n_entries = get16(eocd + 10);
+  *cd_size = get32(eocd + 12);
+  *cd_offset = get32(eocd + 16);
+
+  // ZIP64 end of central directory locator
+  if (pos >= ZIP64_EOCD_LOCATOR_SIZE && get32(eocd - ZIP64_EOCD_LOCATOR_SIZE) == ZIP64_EOCD_LOCATOR_SIGNATURE) {
+    uint64_t eocd64_offset = get64(eocd - ZIP64_EOCD_LOCATOR_SIZE + 8);
+    free(tail);
+
+    uint8_t eocd64[ZIP64_EOCD_SIZE];
+    res = readAt(fd, eocd64_offset, eocd64, ZIP64_EOCD_SIZE);
+    if (res < 0)
+      return res;
+
+    if (get32(eocd64) != ZIP64_EOCD_SIGNATURE)
+      return ZIP_ERROR_FORMAT;
+
+    *n_entries = get64(eocd64 + 32);
+    *cd_size = get64(eocd64 + 40);
+    *cd_offset = get64(eocd64 + 48);
+  } else {
+    free(tail);
+  }
+
+  if (*cd_offset + *cd_size > (uint64_t)file_size)
+    return ZIP_ERROR_FORMAT;
+
+  return 0;
+}
+
+int zipReadCentralDirectory(const char *file, int (* handler)(ZipEntry *entry, void *argp), void *argp) {
+  int res;
+  uint64_t cd_offset = 0, cd_size = 0, n_entries = 0;
+
+  SceUID fd = sceIoOpen(file, SCE_O_RDONLY, 0);
+  if (fd < 0)
+    return fd;
+
+  res = findCentralDirectory(fd, &cd_offset, &cd_size, &n_entries);
+  if (res < 0) {
+    sceIoClose(fd);
+    return res;
+  }
+
+  if (cd_size > ZIP_MAX_CENTRAL_DIRECTORY_SIZE) {
+    sceIoClose(fd);
+    return ZIP_ERROR_UNSUPPORTED;
+  }
+
+  // Read the whole central directory at once
+  uint8_t *cd = malloc(cd_size);
+  if (!cd) {
+    sceIoClose(fd);
+    return -1;
+  }
+
+  res = readAt(fd, cd_offset, cd, cd_size);
+  sceIoClose(fd);
+
+  if (res < 0) {
+    free(cd);
+    return res;
+  }
+
+  char name[MAX_PATH_LENGTH];
+  uint8_t *p = cd;
+  uint8_t *end = cd + cd_size;
+  uint64_t i;
+
+  for (i = 0; i < n_entries; i++) {
+    if (p + ZIP_CENTRAL_HEADER_SIZE > end || get32(p) != ZIP_CENTRAL_HEADER_SIGNATURE) {
+      res = ZIP_ERROR_FORMAT;
+      break;
+    }
+
+    uint16_t version = get16(p + 4);
+    uint16_t flags = get16(p + 8);
+    uint16_t name_length = get16(p + 28);
+    uint16_t extra_length = get16(p + 30);
+    uint16_t comment_length = get16(p + 32);
+    uint32_t external_attributes = get32(p + 38);
+
+    uint8_t *next = p + ZIP_CENTRAL_HEADER_SIZE + name_length + extra_length + comment_length;
+    if (next > end) {
+      res = ZIP_ERROR_FORMAT;
+      break;
+    }
+
+    // Encrypted entries are left to libarchive
+    if (flags & ZIP_FLAG_ENCRYPTED) {
+      res = ZIP_ERROR_UNSUPPORTED;
+      break;
+    }
+
+    if (name_length == 0 || name_length >= MAX_PATH_LENGTH) {
+      res = ZIP_ERROR_FORMAT;
+      break;
+    }
+
+    memcpy(name, p + ZIP_CENTRAL_HEADER_SIZE, name_length);
+    name[name_length] = '\0';
+
+    ZipEntry entry;
+    memset(&entry, 0, sizeof(ZipEntry));
+    entry.name = name;
+    entry.method = get16(p + 10);
+    entry.crc = get32(p + 16);
+    entry.compressed_size = get32(p + 20);
+    entry.uncompressed_size = get32(p + 24);
+    entry.header_offset = get32(p + 42);
+
+    convertDosTime(&entry.stat.st_mtime, get16(p + 14), get16(p + 12));
+
+    res = parseExtraFields(&entry, p + ZIP_CENTRAL_HEADER_SIZE + name_length, extra_length,
+                           get32(p + 20), get32(p + 24), get32(p + 42));
+    if (res < 0)
+      break;
+
+    memcpy(&entry.stat.st_ctime, &entry.stat.st_mtime, sizeof(SceDateTime));
+    memcpy(&entry.stat.st_atime, &entry.stat.st_mtime, sizeof(SceDateTime));
+
+    // Directories end with a slash or carry the directory attribute
+    int is_folder = name[name_length - 1] == '/' || (external_attributes & 0x10);
+    if ((version >> 8) == ZIP_HOST_UNIX && (external_attributes >> 16) != 0)
+      is_folder = SCE_S_ISDIR(convert_stat_mode(external_attributes >> 16));
+
+    if (is_folder) {
+      entry.stat.st_mode = SCE_S_IFDIR;
+    } else {
+      if (entry.method != ZIP_METHOD_STORE && entry.method != ZIP_METHOD_DEFLATE) {
+        res = ZIP_ERROR_UNSUPPORTED;
+        break;
+      }
+
+      entry.stat.st_mode = SCE_S_IFREG;
+      entry.stat.st_size = entry.uncompressed_size;
+    }
+
+    res = handler(&entry, argp);
+    if (res < 0)
+      break;
+
+    p = next;
+  }
+
+  free(cd);
+
+  return res < 0 ? res : 0;
+}
+
+int zipEntryOpen(ZipEntryReader **reader, const char *file, int method, uint32_t crc,
+                 uint64_t header_offset, uint64_t compressed_size, uint64_t uncompressed_size) {
+  int res;
+
+  ZipEntryReader *r = malloc(sizeof(ZipEntryReader));
+  if (!r)
+    return -1;
+
+  memset(r, 0, sizeof(ZipEntryReader));
+  r->method = method;
+  r->crc = crc;
+  r->computed_crc = crc32(0, Z_NULL, 0);
+  r->compressed_left = compressed_size;
+  r->uncompressed_left = uncompressed_size;
+
+  r->fd = sceIoOpen(file, SCE_O_RDONLY, 0);
+  if (r->fd < 0) {
+    res = r->fd;
+    free(r);
+    return res;
+  }
+
+  // The local header may have a different extra field length than the central one
+  uint8_t header[ZIP_LOCAL_HEADER_SIZE];
+  res = readAt(r->fd, header_offset, header, ZIP_LOCAL_HEADER_SIZE);
+  if (res >= 0 && get32(header) != ZIP_LOCAL_HEADER_SIGNATURE)
+    res = ZIP_ERROR_FORMAT;
+
+  if (res >= 0) {
+    uint64_t data_offset = header_offset + ZIP_LOCAL_HEADER_SIZE + get16(header + 26) + get16(header + 28);
+    if (sceIoLseek(r->fd, data_offset, SCE_SEEK_SET) < 0)
+      res = ZIP_ERROR_FORMAT;
+  }
+
+  if (res >= 0 && method == ZIP_METHOD_DEFLATE) {
+    r->buffer_size = ioProfileGetReadSize(file);
+    r->buffer = memalign(4096, r->buffer_size);
+    if (!r->buffer)
+      res = -1;
+    else if (inflateInit2(&r->strm, -MAX_WBITS) != Z_OK)
+      res = ZIP_ERROR_FORMAT;
+  }
+
+  if (res < 0) {
+    sceIoClose(r->fd);
+    free(r->buffer);
+    free(r);
+    return res;
+  }
+
+  *reader = r;
+  return 0;
+}
+
+int zipEntryRead(ZipEntryReader *reader, void *data, SceSize size) {
+  int length = 0;
+
+  if (size > reader->uncompressed_left)
+    size = reader->uncompressed_left;
+
+  if (size == 0)
+    return 0;
+
+  if (reader->method == ZIP_METHOD_STORE) {
+    length = sceIoRead(reader->fd, data, size);
+    if (length < 0)
+      return length;
+  } else {
+    z_stream *strm = &reader->strm;
+    strm->next_out = data;
+    strm->avail_out = size;
+
+    while (strm->avail_out > 0) {
+      if (strm->avail_in == 0) {
+        if (reader->compressed_left == 0)
+          break;
+
+        int read = sceIoRead(reader->fd, reader->buffer, MIN(reader->compressed_left, reader->buffer_size));
+        if (read < 0)
+          return read;
+
+        if (read == 0)
+          break;
+
+        strm->next_in = reader->buffer;
+        strm->avail_in = read;
+        reader->compressed_left -= read;
+      }
+
+      int ret = inflate(strm, Z_NO_FLUSH);
+      if (ret == Z_STREAM_END)
+        break;
+
+      if (ret != Z_OK)
+        return ZIP_ERROR_FORMAT;
+    }
+
+    length = size - strm->avail_out;
+  }
+
+  if (length == 0)
+    return ZIP_ERROR_FORMAT;
+
+  reader->uncompressed_left -= length;
+  reader->computed_crc = crc32(reader->computed_crc, data, length);
+
+  if (reader->uncompressed_left == 0 && reader->computed_crc != reader->crc)
+    return ZIP_ERROR_CRC;
+
+  return length;
+}
+
+void zipEntryClose(ZipEntryReader *reader) {
+  if (!reader)
+    return;
+
+  if (reader->method == ZIP_METHOD_DEFLATE)
+    inflateEnd(&reader->strm);
+
+  sceIoClose(reader->fd);
+  free(reader->buffer);
+  free(reader);
+}
@@ -0,0 +1,48 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __ZIP_READER_H__
+#define __ZIP_READER_H__
+
+#define ZIP_METHOD_STORE 0
+#define ZIP_METHOD_DEFLATE 8
+
+#define ZIP_ERROR_FORMAT ((int)0x80101101)
+#define ZIP_ERROR_UNSUPPORTED ((int)0x80101102)
+#define ZIP_ERROR_CRC ((int)0x80101103)
+
+typedef struct ZipEntry {
+  char *name;
+  SceIoStat stat;
+  int method;
+  uint32_t crc;
+  uint64_t compressed_size;
+  uint64_t uncompressed_size;
+  uint64_t header_offset;
+} ZipEntry;
+
+typedef struct ZipEntryReader ZipEntryReader;
+
+int zipReadCentralDirectory(const char *file, int (* handler)(ZipEntry *entry, void *argp), void *argp);
+
+int zipEntryOpen(ZipEntryReader **reader, const char *file, int method, uint32_t crc,
+                 uint64_t header_offset, uint64_t compressed_size, uint64_t uncompressed_size);
+int zipEntryRead(ZipEntryReader *reader, void *data, SceSize size);
+void zipEntryClose(ZipEntryReader *reader);
+
+#endif